@@ -0,0 +1,432 @@
+/**
+ * @file cold_cache_benchmark.c
+ *
+ * Host handshake and first record latency with cold caches.
+ *
+ * A device that connects rarely is served by a host whose caches and branch
+ * predictors were used by other work since the last handshake. The other
+ * benchmarks repeat the handshake back to back, which keeps the session state,
+ * the handshake buffer and the crypto tables in the caches.
+ *
+ * A client and a host with fixed keys first do one handshake in memory, and
+ * the client sends one record. The bytes sent by the client are recorded and
+ * then replayed to the host in each iteration, so every iteration does the
+ * same work as the host of a real session. Each iteration times:
+ *
+ *  handshake       salt_create, salt_init_session_using_key and salt_handshake
+ *                  until the session is established.
+ *  first record    salt_read_begin of the first record.
+ *
+ * The iterations are run hot, i.e., back to back, and cold. Before each cold
+ * iteration a buffer larger than the last level cache is written and read so
+ * that the data and crypto tables are evicted. With pinning, each cold
+ * iteration is also moved to another core of the allowed set, which gives cold
+ * private caches, TLB and branch predictors as well.
+ *
+ * Usage: benchmark_test cold [-n iterations] [-e evict_mb] [-p]
+ *
+ */
+
+/*======= Includes ==========================================================*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include "salt.h"
+#include "cold_cache_benchmark.h"
+
+/*======= Local Macro Definitions ===========================================*/
+
+#define COLD_CACHE_LINE_SIZE        (64U)
+#define COLD_CACHE_TRANSCRIPT_SIZE  (512U)
+#define COLD_CACHE_BUFFER_SIZE      (256U)
+#define COLD_CACHE_MESSAGE_SIZE     (32U)
+
+/*======= Type Definitions ==================================================*/
+
+typedef struct byte_queue_s {
+    uint8_t     data[COLD_CACHE_TRANSCRIPT_SIZE];
+    uint32_t    write_pos;
+    uint32_t    read_pos;
+} byte_queue_t;
+
+typedef struct latency_s {
+    uint64_t    *p_handshake;           /**< Handshake time of each iteration [ns]. */
+    uint64_t    *p_first_record;        /**< First record time of each iteration [ns]. */
+} latency_t;
+
+/*======= Local function prototypes =========================================*/
+
+static bool record_transcript(void);
+static bool host_iteration(uint64_t *p_handshake, uint64_t *p_first_record);
+static bool run_mode(const char *name, uint32_t iterations,
+                     uint8_t *p_evict, size_t evict_size, bool pin,
+                     latency_t *p_latency);
+static void evict(uint8_t *p_evict, size_t evict_size);
+static void pin_next_cpu(void);
+static void print_row(const char *name, const char *what,
+                      uint64_t *p_values, uint32_t count);
+static salt_ret_t queue_write(salt_io_channel_t *p_wchannel);
+static salt_ret_t queue_read(salt_io_channel_t *p_rchannel);
+static salt_ret_t replay_write(salt_io_channel_t *p_wchannel);
+static salt_ret_t replay_read(salt_io_channel_t *p_rchannel);
+static uint64_t now_ns(void);
+static int compare_u64(const void *a, const void *b);
+
+/*======= Local variable declarations =======================================*/
+
+static const uint8_t client_sk_sec[64] = {
+    0x55, 0xf4, 0xd1, 0xd1, 0x98, 0x09, 0x3c, 0x84,
+    0xde, 0x9e, 0xe9, 0xa6, 0x29, 0x9e, 0x0f, 0x68,
+    0x91, 0xc2, 0xe1, 0xd0, 0xb3, 0x69, 0xef, 0xb5,
+    0x92, 0xa9, 0xe3, 0xf1, 0x69, 0xfb, 0x0f, 0x79,
+    0x55, 0x29, 0xce, 0x8c, 0xcf, 0x68, 0xc0, 0xb8,
+    0xac, 0x19, 0xd4, 0x37, 0xab, 0x0f, 0x5b, 0x32,
+    0x72, 0x37, 0x82, 0x60, 0x8e, 0x93, 0xc6, 0x26,
+    0x4f, 0x18, 0x4b, 0xa1, 0x52, 0xc2, 0x35, 0x7b
+};
+static const uint8_t client_ek_sec[32] = {
+    0x77, 0x07, 0x6d, 0x0a, 0x73, 0x18, 0xa5, 0x7d,
+    0x3c, 0x16, 0xc1, 0x72, 0x51, 0xb2, 0x66, 0x45,
+    0xdf, 0x4c, 0x2f, 0x87, 0xeb, 0xc0, 0x99, 0x2a,
+    0xb1, 0x77, 0xfb, 0xa5, 0x1d, 0xb9, 0x2c, 0x2a
+};
+static const uint8_t client_ek_pub[32] = {
+    0x85, 0x20, 0xf0, 0x09, 0x89, 0x30, 0xa7, 0x54,
+    0x74, 0x8b, 0x7d, 0xdc, 0xb4, 0x3e, 0xf7, 0x5a,
+    0x0d, 0xbf, 0x3a, 0x0d, 0x26, 0x38, 0x1a, 0xf4,
+    0xeb, 0xa4, 0xa9, 0x8e, 0xaa, 0x9b, 0x4e, 0x6a
+};
+static const uint8_t host_sk_sec[64] = {
+    0x7a, 0x77, 0x2f, 0xa9, 0x01, 0x4b, 0x42, 0x33,
+    0x00, 0x07, 0x6a, 0x2f, 0xf6, 0x46, 0x46, 0x39,
+    0x52, 0xf1, 0x41, 0xe2, 0xaa, 0x8d, 0x98, 0x26,
+    0x3c, 0x69, 0x0c, 0x0d, 0x72, 0xee, 0xd5, 0x2d,
+    0x07, 0xe2, 0x8d, 0x4e, 0xe3, 0x2b, 0xfd, 0xc4,
+    0xb0, 0x7d, 0x41, 0xc9, 0x21, 0x93, 0xc0, 0xc2,
+    0x5e, 0xe6, 0xb3, 0x09, 0x4c, 0x62, 0x96, 0xf3,
+    0x73, 0x41, 0x3b, 0x37, 0x3d, 0x36, 0x16, 0x8b
+};
+static const uint8_t host_ek_sec[32] = {
+    0x5d, 0xab, 0x08, 0x7e, 0x62, 0x4a, 0x8a, 0x4b,
+    0x79, 0xe1, 0x7f, 0x8b, 0x83, 0x80, 0x0e, 0xe6,
+    0x6f, 0x3b, 0xb1, 0x29, 0x26, 0x18, 0xb6, 0xfd,
+    0x1c, 0x2f, 0x8b, 0x27, 0xff, 0x88, 0xe0, 0xeb
+};
+static const uint8_t host_ek_pub[32] = {
+    0xde, 0x9e, 0xdb, 0x7d, 0x7b, 0x7d, 0xc1, 0xb4,
+    0xd3, 0x5b, 0x61, 0xc2, 0xec, 0xe4, 0x35, 0x37,
+    0x3f, 0x83, 0x43, 0xc8, 0x5b, 0x78, 0x67, 0x4d,
+    0xad, 0xfc, 0x7e, 0x14, 0x6f, 0x88, 0x2b, 0x4f
+};
+
+/* Bytes sent by the client, replayed to the host. */
+static byte_queue_t client_to_host;
+static byte_queue_t host_to_client;
+
+/* Host session state, as kept by a host between handshakes. */
+static salt_channel_t host_channel;
+static uint8_t host_hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
+static uint8_t host_rx_buffer[COLD_CACHE_BUFFER_SIZE];
+
+static volatile uint8_t evict_sink;
+
+/*======= Global function implementations ===================================*/
+
+bool run_cold_cache_benchmark(uint32_t iterations, uint32_t evict_mb, bool pin)
+{
+    size_t evict_size = (size_t) evict_mb * 1024U * 1024U;
+    uint8_t *p_evict = malloc(evict_size);
+    latency_t latency;
+    bool ret = false;
+
+    latency.p_handshake = malloc(sizeof(uint64_t) * iterations);
+    latency.p_first_record = malloc(sizeof(uint64_t) * iterations);
+
+    if ((NULL == p_evict) || (NULL == latency.p_handshake) ||
+        (NULL == latency.p_first_record) || (0U == iterations)) {
+        printf("Could not set up the cold cache benchmark.\r\n");
+        goto out;
+    }
+
+    if (!record_transcript()) {
+        printf("Could not record the handshake.\r\n");
+        goto out;
+    }
+
+    printf("-------------------------------------------------------------------------\r\n");
+    printf("| Host handshake and first record, %4u iterations, %4u MB evicted     |\r\n",
+           iterations, evict_mb);
+    printf("-------------------------------------------------------------------------\r\n");
+    printf("| Mode       | Latency           | Mean [us]  | p50 [us]   | p99 [us]   |\r\n");
+    printf("-------------------------------------------------------------------------\r\n");
+
+    ret = run_mode("hot", iterations, NULL, 0, false, &latency) &&
+          run_mode(pin ? "cold, pin" : "cold", iterations, p_evict, evict_size, pin, &latency);
+
+    printf("-------------------------------------------------------------------------\r\n");
+
+out:
+    free(latency.p_first_record);
+    free(latency.p_handshake);
+    free(p_evict);
+
+    return ret;
+}
+
+/*======= Local function implementations ====================================*/
+
+/**
+ * @brief Runs one handshake and one record in memory and records the client bytes.
+ *
+ * Both sides use fixed keys and no time implementation, so the host replies
+ * are the same in every replay.
+ */
+static bool record_transcript(void)
+{
+    salt_channel_t client;
+    uint8_t client_hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
+    uint8_t client_tx_buffer[COLD_CACHE_BUFFER_SIZE];
+    uint8_t message[COLD_CACHE_MESSAGE_SIZE];
+    salt_ret_t client_ret = SALT_PENDING;
+    salt_ret_t host_ret = SALT_PENDING;
+    salt_msg_t msg;
+
+    memset(&client_to_host, 0x00, sizeof(client_to_host));
+    memset(&host_to_client, 0x00, sizeof(host_to_client));
+
+    salt_create(&client, SALT_CLIENT, queue_write, queue_read, NULL);
+    salt_set_signature(&client, client_sk_sec);
+    salt_init_session_using_key(&client, client_hndsk_buffer, sizeof(client_hndsk_buffer),
+                                client_ek_pub, client_ek_sec);
+    salt_set_context(&client, &client_to_host, &host_to_client);
+
+    salt_create(&host_channel, SALT_SERVER, queue_write, queue_read, NULL);
+    salt_set_signature(&host_channel, host_sk_sec);
+    salt_init_session_using_key(&host_channel, host_hndsk_buffer, sizeof(host_hndsk_buffer),
+                                host_ek_pub, host_ek_sec);
+    salt_set_context(&host_channel, &host_to_client, &client_to_host);
+
+    while ((client_ret | host_ret) != SALT_SUCCESS) {
+        if (SALT_SUCCESS != client_ret) {
+            client_ret = salt_handshake(&client, NULL);
+        }
+        if (SALT_SUCCESS != host_ret) {
+            host_ret = salt_handshake(&host_channel, NULL);
+        }
+        if ((SALT_ERROR == client_ret) || (SALT_ERROR == host_ret)) {
+            return false;
+        }
+    }
+
+    memset(message, 0xA5, sizeof(message));
+    if ((salt_write_begin(client_tx_buffer, sizeof(client_tx_buffer), &msg) != SALT_SUCCESS) ||
+        (salt_write_next(&msg, message, sizeof(message)) != SALT_SUCCESS) ||
+        (salt_write_execute(&client, &msg, false) != SALT_SUCCESS)) {
+        return false;
+    }
+
+    /* The replay starts from the first byte again. */
+    client_to_host.read_pos = 0;
+
+    return true;
+}
+
+/**
+ * @brief Serves one client as the host, using the recorded client bytes.
+ */
+static bool host_iteration(uint64_t *p_handshake, uint64_t *p_first_record)
+{
+    salt_ret_t ret;
+    salt_msg_t msg;
+    uint64_t start;
+    uint64_t established;
+
+    client_to_host.read_pos = 0;
+
+    start = now_ns();
+
+    salt_create(&host_channel, SALT_SERVER, replay_write, replay_read, NULL);
+    salt_set_signature(&host_channel, host_sk_sec);
+    salt_init_session_using_key(&host_channel, host_hndsk_buffer, sizeof(host_hndsk_buffer),
+                                host_ek_pub, host_ek_sec);
+    salt_set_context(&host_channel, NULL, &client_to_host);
+
+    do {
+        ret = salt_handshake(&host_channel, NULL);
+    } while (SALT_PENDING == ret);
+
+    established = now_ns();
+
+    if (SALT_SUCCESS != ret) {
+        return false;
+    }
+
+    do {
+        ret = salt_read_begin(&host_channel, host_rx_buffer, sizeof(host_rx_buffer), &msg);
+    } while (SALT_PENDING == ret);
+
+    *p_first_record = now_ns() - established;
+    *p_handshake = established - start;
+
+    return (SALT_SUCCESS == ret) && (COLD_CACHE_MESSAGE_SIZE == msg.read.message_size);
+}
+
+static bool run_mode(const char *name, uint32_t iterations,
+                     uint8_t *p_evict, size_t evict_size, bool pin,
+                     latency_t *p_latency)
+{
+    /* One iteration to load the code and tables before the hot runs. */
+    if (!host_iteration(&p_latency->p_handshake[0], &p_latency->p_first_record[0])) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (pin) {
+            pin_next_cpu();
+        }
+        if (NULL != p_evict) {
+            evict(p_evict, evict_size);
+        }
+        if (!host_iteration(&p_latency->p_handshake[i], &p_latency->p_first_record[i])) {
+            printf("Handshake %u failed.\r\n", i);
+            return false;
+        }
+    }
+
+    print_row(name, "handshake", p_latency->p_handshake, iterations);
+    print_row(name, "first record", p_latency->p_first_record, iterations);
+
+    return true;
+}
+
+/**
+ * @brief Writes and reads every cache line of the buffer.
+ *
+ * Written lines must be written back before they are replaced, so the whole
+ * cache hierarchy is filled with the buffer.
+ */
+static void evict(uint8_t *p_evict, size_t evict_size)
+{
+    uint8_t sum = 0;
+
+    for (size_t i = 0; i < evict_size; i += COLD_CACHE_LINE_SIZE) {
+        p_evict[i] = (uint8_t) i;
+    }
+    for (size_t i = 0; i < evict_size; i += COLD_CACHE_LINE_SIZE) {
+        sum ^= p_evict[i];
+    }
+
+    evict_sink = sum;
+}
+
+/**
+ * @brief Moves the calling thread to the next core of the allowed set.
+ */
+static void pin_next_cpu(void)
+{
+#ifdef __linux__
+    static cpu_set_t allowed;
+    static int cpu = -1;
+    cpu_set_t next;
+
+    if (cpu < 0) {
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+            return;
+        }
+    }
+
+    for (int i = 0; i < CPU_SETSIZE; i++) {
+        cpu = (cpu + 1) % CPU_SETSIZE;
+        if (CPU_ISSET(cpu, &allowed)) {
+            break;
+        }
+    }
+
+    CPU_ZERO(&next);
+    CPU_SET(cpu, &next);
+    sched_setaffinity(0, sizeof(next), &next);
+#endif
+}
+
+static void print_row(const char *name, const char *what,
+                      uint64_t *p_values, uint32_t count)
+{
+    uint64_t sum = 0;
+
+    for (uint32_t i = 0; i < count; i++) {
+        sum += p_values[i];
+    }
+    qsort(p_values, count, sizeof(uint64_t), compare_u64);
+
+    printf("| %-11.11s| %-18.18s| %-11.1f| %-11.1f| %-11.1f|\r\n",
+           name, what,
+           (double) sum / count / 1000.0,
+           (double) p_values[count / 2U] / 1000.0,
+           (double) p_values[(count * 99U) / 100U] / 1000.0);
+}
+
+static salt_ret_t queue_write(salt_io_channel_t *p_wchannel)
+{
+    byte_queue_t *p_queue = (byte_queue_t *) p_wchannel->p_context;
+
+    if ((p_queue->write_pos + p_wchannel->size_expected) > sizeof(p_queue->data)) {
+        return SALT_ERROR;
+    }
+
+    memcpy(&p_queue->data[p_queue->write_pos], p_wchannel->p_data, p_wchannel->size_expected);
+    p_queue->write_pos += p_wchannel->size_expected;
+    p_wchannel->size = p_wchannel->size_expected;
+
+    return SALT_SUCCESS;
+}
+
+static salt_ret_t queue_read(salt_io_channel_t *p_rchannel)
+{
+    byte_queue_t *p_queue = (byte_queue_t *) p_rchannel->p_context;
+    uint32_t available = p_queue->write_pos - p_queue->read_pos;
+    uint32_t size = p_rchannel->size_expected - p_rchannel->size;
+
+    if (available < size) {
+        size = available;
+    }
+
+    memcpy(&p_rchannel->p_data[p_rchannel->size], &p_queue->data[p_queue->read_pos], size);
+    p_queue->read_pos += size;
+    p_rchannel->size += size;
+
+    return (p_rchannel->size == p_rchannel->size_expected) ? SALT_SUCCESS : SALT_PENDING;
+}
+
+/* The host replies are known from the recording. */
+static salt_ret_t replay_write(salt_io_channel_t *p_wchannel)
+{
+    p_wchannel->size = p_wchannel->size_expected;
+    return SALT_SUCCESS;
+}
+
+static salt_ret_t replay_read(salt_io_channel_t *p_rchannel)
+{
+    salt_ret_t ret = queue_read(p_rchannel);
+    return (SALT_PENDING == ret) ? SALT_ERROR : ret;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000U) + (uint64_t) ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
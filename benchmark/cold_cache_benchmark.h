@@ -0,0 +1,45 @@
+#ifndef _COLD_CACHE_BENCHMARK_H_
+#define _COLD_CACHE_BENCHMARK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file cold_cache_benchmark.h
+ *
+ * Host handshake and first record latency with cold caches.
+ *
+ */
+
+/*======= Includes ==========================================================*/
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*======= Public macro definitions ==========================================*/
+
+#define COLD_CACHE_DEFAULT_ITERATIONS   (100U)
+#define COLD_CACHE_DEFAULT_EVICT_MB     (64U)
+
+/*======= Type Definitions and declarations =================================*/
+/*======= Public variable declarations ======================================*/
+/*======= Public function declarations ======================================*/
+
+/**
+ * @brief Runs the benchmark hot and with cold caches and prints the result.
+ *
+ * @param iterations    Number of handshakes in each mode.
+ * @param evict_mb      Size of the buffer streamed over to evict the caches,
+ *                      should be larger than the last level cache.
+ * @param pin           Moves to another core before each cold handshake.
+ *
+ * @return true if all handshakes succeeded.
+ */
+bool run_cold_cache_benchmark(uint32_t iterations, uint32_t evict_mb, bool pin);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _COLD_CACHE_BENCHMARK_H_ */
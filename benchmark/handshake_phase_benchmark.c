@@ -0,0 +1,471 @@
+/**
+ * @file handshake_phase_benchmark.c
+ *
+ * Per phase cost of the handshake.
+ *
+ * Each phase of the host and client handshake is executed in isolation with the
+ * same canned keys and messages as the handshake benchmarks. Before each
+ * execution the input of the phase is restored, i.e., the received message or
+ * nonce, so that every iteration does the same work as in a real handshake.
+ * The outputs are verified against the canned messages before the phases are
+ * timed.
+ *
+ * The result is printed as the average time of each phase and its share of the
+ * sum of all phases. Build with "make tweetnacl" and "make libsodium" to compare
+ * the crypto backends.
+ *
+ */
+
+/*======= Includes ==========================================================*/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include "salt.h"
+#include "salti_handshake.h"
+#include "time_stamp.h"
+#include "handshake_phase_benchmark.h"
+
+/*======= Local Macro Definitions ===========================================*/
+
+#define NUM_ITERATIONS 1000
+
+/*======= Type Definitions ==================================================*/
+
+typedef struct phase_s {
+    const char  *name;
+    bool        (*run)(void);       /**< One execution of the phase. */
+    bool        (*done)(void);      /**< Verifies and saves the output of run, may be NULL. */
+    double      average;            /**< Average time in ms. */
+} phase_t;
+
+/*======= Local function prototypes =========================================*/
+
+static void init_session(salt_mode_t mode,
+                         const uint8_t *sk_sec,
+                         const uint8_t *ek_pub,
+                         const uint8_t *ek_sec);
+static bool run_phases(const char *title, phase_t *phases, uint32_t count);
+static salt_ret_t dummy_io(salt_io_channel_t *p_channel);
+
+static bool box_keypair_run(void);
+
+static bool host_handle_m1_run(void);
+static bool host_create_m2_run(void);
+static bool host_create_m2_done(void);
+static bool host_beforenm_run(void);
+static bool host_create_m3_sig_run(void);
+static bool host_create_m3_sig_done(void);
+static bool host_wrap_m3_run(void);
+static bool host_wrap_m3_done(void);
+static bool host_unwrap_m4_run(void);
+static bool host_unwrap_m4_done(void);
+static bool host_verify_m4_sig_run(void);
+
+static bool client_create_m1_run(void);
+static bool client_create_m1_done(void);
+static bool client_handle_m2_run(void);
+static bool client_create_m4_sig_run(void);
+static bool client_create_m4_sig_done(void);
+static bool client_unwrap_m3_run(void);
+static bool client_unwrap_m3_done(void);
+static bool client_verify_m3_sig_run(void);
+static bool client_wrap_m4_run(void);
+static bool client_wrap_m4_done(void);
+
+/*======= Local variable declarations =======================================*/
+
+static const uint8_t client_sk_sec[64] = {
+    0x55, 0xf4, 0xd1, 0xd1, 0x98, 0x09, 0x3c, 0x84,
+    0xde, 0x9e, 0xe9, 0xa6, 0x29, 0x9e, 0x0f, 0x68,
+    0x91, 0xc2, 0xe1, 0xd0, 0xb3, 0x69, 0xef, 0xb5,
+    0x92, 0xa9, 0xe3, 0xf1, 0x69, 0xfb, 0x0f, 0x79,
+    0x55, 0x29, 0xce, 0x8c, 0xcf, 0x68, 0xc0, 0xb8,
+    0xac, 0x19, 0xd4, 0x37, 0xab, 0x0f, 0x5b, 0x32,
+    0x72, 0x37, 0x82, 0x60, 0x8e, 0x93, 0xc6, 0x26,
+    0x4f, 0x18, 0x4b, 0xa1, 0x52, 0xc2, 0x35, 0x7b
+};
+static const uint8_t client_ek_sec[32] = {
+    0x77, 0x07, 0x6d, 0x0a, 0x73, 0x18, 0xa5, 0x7d,
+    0x3c, 0x16, 0xc1, 0x72, 0x51, 0xb2, 0x66, 0x45,
+    0xdf, 0x4c, 0x2f, 0x87, 0xeb, 0xc0, 0x99, 0x2a,
+    0xb1, 0x77, 0xfb, 0xa5, 0x1d, 0xb9, 0x2c, 0x2a
+};
+static const uint8_t client_ek_pub[32] = {
+    0x85, 0x20, 0xf0, 0x09, 0x89, 0x30, 0xa7, 0x54,
+    0x74, 0x8b, 0x7d, 0xdc, 0xb4, 0x3e, 0xf7, 0x5a,
+    0x0d, 0xbf, 0x3a, 0x0d, 0x26, 0x38, 0x1a, 0xf4,
+    0xeb, 0xa4, 0xa9, 0x8e, 0xaa, 0x9b, 0x4e, 0x6a
+};
+static const uint8_t host_sk_sec[64] = {
+    0x7a, 0x77, 0x2f, 0xa9, 0x01, 0x4b, 0x42, 0x33,
+    0x00, 0x07, 0x6a, 0x2f, 0xf6, 0x46, 0x46, 0x39,
+    0x52, 0xf1, 0x41, 0xe2, 0xaa, 0x8d, 0x98, 0x26,
+    0x3c, 0x69, 0x0c, 0x0d, 0x72, 0xee, 0xd5, 0x2d,
+    0x07, 0xe2, 0x8d, 0x4e, 0xe3, 0x2b, 0xfd, 0xc4,
+    0xb0, 0x7d, 0x41, 0xc9, 0x21, 0x93, 0xc0, 0xc2,
+    0x5e, 0xe6, 0xb3, 0x09, 0x4c, 0x62, 0x96, 0xf3,
+    0x73, 0x41, 0x3b, 0x37, 0x3d, 0x36, 0x16, 0x8b
+};
+static const uint8_t host_ek_sec[32] = {
+    0x5d, 0xab, 0x08, 0x7e, 0x62, 0x4a, 0x8a, 0x4b,
+    0x79, 0xe1, 0x7f, 0x8b, 0x83, 0x80, 0x0e, 0xe6,
+    0x6f, 0x3b, 0xb1, 0x29, 0x26, 0x18, 0xb6, 0xfd,
+    0x1c, 0x2f, 0x8b, 0x27, 0xff, 0x88, 0xe0, 0xeb
+};
+static const uint8_t host_ek_pub[32] = {
+    0xde, 0x9e, 0xdb, 0x7d, 0x7b, 0x7d, 0xc1, 0xb4,
+    0xd3, 0x5b, 0x61, 0xc2, 0xec, 0xe4, 0x35, 0x37,
+    0x3f, 0x83, 0x43, 0xc8, 0x5b, 0x78, 0x67, 0x4d,
+    0xad, 0xfc, 0x7e, 0x14, 0x6f, 0x88, 0x2b, 0x4f
+};
+static const uint8_t m1[46] = {
+    0x2a, 0x00, 0x00, 0x00, // 42
+    0x53, 0x43, 0x76, 0x32, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x85, 0x20, 0xf0, 0x09, 0x89, 0x30,
+    0xa7, 0x54, 0x74, 0x8b, 0x7d, 0xdc, 0xb4, 0x3e,
+    0xf7, 0x5a, 0x0d, 0xbf, 0x3a, 0x0d, 0x26, 0x38,
+    0x1a, 0xf4, 0xeb, 0xa4, 0xa9, 0x8e, 0xaa, 0x9b,
+    0x4e, 0x6a
+};
+static const uint8_t m2[42] = {
+    0x26, 0x00, 0x00, 0x00, // 38
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0xde, 0x9e,
+    0xdb, 0x7d, 0x7b, 0x7d, 0xc1, 0xb4, 0xd3, 0x5b,
+    0x61, 0xc2, 0xec, 0xe4, 0x35, 0x37, 0x3f, 0x83,
+    0x43, 0xc8, 0x5b, 0x78, 0x67, 0x4d, 0xad, 0xfc,
+    0x7e, 0x14, 0x6f, 0x88, 0x2b, 0x4f
+};
+static const uint8_t m3[124] = {
+    0x78, 0x00, 0x00, 0x00, // 120
+    0x06, 0x00, 0xe4, 0x7d, 0x66, 0xe9, 0x07, 0x02,
+    0xaa, 0x81, 0xa7, 0xb4, 0x57, 0x10, 0x27, 0x8d,
+    0x02, 0xa8, 0xc6, 0xcd, 0xdb, 0x69, 0xb8, 0x6e,
+    0x29, 0x9a, 0x47, 0xa9, 0xb1, 0xf1, 0xc1, 0x86,
+    0x66, 0xe5, 0xcf, 0x8b, 0x00, 0x07, 0x42, 0xba,
+    0xd6, 0x09, 0xbf, 0xd9, 0xbf, 0x2e, 0xf2, 0x79,
+    0x87, 0x43, 0xee, 0x09, 0x2b, 0x07, 0xeb, 0x32,
+    0xa4, 0x5f, 0x27, 0xcd, 0xa2, 0x2c, 0xbb, 0xd0,
+    0xf0, 0xbb, 0x7a, 0xd2, 0x64, 0xbe, 0x1c, 0x8f,
+    0x6e, 0x08, 0x0d, 0x05, 0x3b, 0xe0, 0x16, 0xd5,
+    0xb0, 0x4a, 0x4a, 0xeb, 0xff, 0xc1, 0x9b, 0x6f,
+    0x81, 0x6f, 0x9a, 0x02, 0xe7, 0x1b, 0x49, 0x6f,
+    0x46, 0x28, 0xae, 0x47, 0x1c, 0x8e, 0x40, 0xf9,
+    0xaf, 0xc0, 0xde, 0x42, 0xc9, 0x02, 0x3c, 0xfc,
+    0xd1, 0xb0, 0x78, 0x07, 0xf4, 0x3b, 0x4e, 0x25
+};
+static const uint8_t m4[124] = {
+    0x78, 0x00, 0x00, 0x00, // 120
+    0x06, 0x00, 0xb4, 0xc3, 0xe5, 0xc6, 0xe4, 0xa4,
+    0x05, 0xe9, 0x1e, 0x69, 0xa1, 0x13, 0xb3, 0x96,
+    0xb9, 0x41, 0xb3, 0x2f, 0xfd, 0x05, 0x3d, 0x58,
+    0xa5, 0x4b, 0xdc, 0xc8, 0xee, 0xf6, 0x0a, 0x47,
+    0xd0, 0xbf, 0x53, 0x05, 0x74, 0x18, 0xb6, 0x05,
+    0x4e, 0xb2, 0x60, 0xcc, 0xa4, 0xd8, 0x27, 0xc0,
+    0x68, 0xed, 0xff, 0x9e, 0xfb, 0x48, 0xf0, 0xeb,
+    0x84, 0x54, 0xee, 0x0b, 0x12, 0x15, 0xdf, 0xa0,
+    0x8b, 0x3e, 0xbb, 0x3e, 0xcd, 0x29, 0x77, 0xd9,
+    0xb6, 0xbd, 0xe0, 0x3d, 0x47, 0x26, 0x41, 0x10,
+    0x82, 0xc9, 0xb7, 0x35, 0xe4, 0xba, 0x74, 0xe4,
+    0xa2, 0x25, 0x78, 0xfa, 0xf6, 0xcf, 0x36, 0x97,
+    0x36, 0x4e, 0xfe, 0x2b, 0xe6, 0x63, 0x5c, 0x4c,
+    0x61, 0x7a, 0xd1, 0x2e, 0x6d, 0x18, 0xf7, 0x7a,
+    0x23, 0xeb, 0x06, 0x9f, 0x8c, 0xb3, 0x81, 0x73
+};
+
+static salt_channel_t channel;
+static uint8_t hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
+static uint8_t keypair[64];
+
+/* Saved inputs, restored before each execution of a phase. */
+static uint8_t saved_write_nonce[api_crypto_box_NONCEBYTES];
+static uint8_t saved_read_nonce[api_crypto_box_NONCEBYTES];
+static uint8_t saved_my_clear[SALT_M3M4_CLEAR_SIZE];
+static uint8_t saved_peer_clear[SALT_M3M4_CLEAR_SIZE];
+
+/* Output of the latest execution. */
+static uint8_t *p_out;
+static uint32_t out_size;
+
+/*======= Global function implementations ===================================*/
+
+bool run_handshake_phase_benchmark(void)
+{
+    phase_t host_phases[] = {
+        { "api_crypto_box_keypair",            box_keypair_run,             NULL,                        0 },
+        { "salti_handle_m1",                   host_handle_m1_run,          NULL,                        0 },
+        { "salti_create_m2",                   host_create_m2_run,          host_create_m2_done,         0 },
+        { "api_crypto_box_beforenm",           host_beforenm_run,           NULL,                        0 },
+        { "salti_create_m3m4_sig",             host_create_m3_sig_run,      host_create_m3_sig_done,     0 },
+        { "salti_wrap (M3)",                   host_wrap_m3_run,            host_wrap_m3_done,           0 },
+        { "salti_unwrap (M4)",                 host_unwrap_m4_run,          host_unwrap_m4_done,         0 },
+        { "salti_verify_m3m4_sig",             host_verify_m4_sig_run,      NULL,                        0 },
+    };
+    phase_t client_phases[] = {
+        { "api_crypto_box_keypair",            box_keypair_run,             NULL,                        0 },
+        { "salti_create_m1",                   client_create_m1_run,        client_create_m1_done,       0 },
+        { "salti_handle_m2 (with beforenm)",   client_handle_m2_run,        NULL,                        0 },
+        { "salti_sign_m3m4",                   client_create_m4_sig_run,    client_create_m4_sig_done,   0 },
+        { "salti_unwrap (M3)",                 client_unwrap_m3_run,        client_unwrap_m3_done,       0 },
+        { "salti_verify_m3m4_sig",             client_verify_m3_sig_run,    NULL,                        0 },
+        { "salti_wrap (M4)",                   client_wrap_m4_run,          client_wrap_m4_done,         0 },
+    };
+
+    init_session(SALT_SERVER, host_sk_sec, host_ek_pub, host_ek_sec);
+    if (!run_phases("Handshake phases, host", host_phases,
+                    sizeof(host_phases) / sizeof(phase_t))) {
+        return false;
+    }
+
+    init_session(SALT_CLIENT, client_sk_sec, client_ek_pub, client_ek_sec);
+    return run_phases("Handshake phases, client", client_phases,
+                      sizeof(client_phases) / sizeof(phase_t));
+}
+
+/*======= Local function implementations ====================================*/
+
+static void init_session(salt_mode_t mode,
+                         const uint8_t *sk_sec,
+                         const uint8_t *ek_pub,
+                         const uint8_t *ek_sec)
+{
+    salt_create(&channel, mode, dummy_io, dummy_io, NULL);
+    salt_set_signature(&channel, sk_sec);
+    salt_init_session_using_key(&channel, hndsk_buffer, sizeof(hndsk_buffer),
+                                ek_pub, ek_sec);
+
+    /* M3 and M4 are the first encrypted messages. */
+    memcpy(saved_write_nonce, channel.write_nonce, sizeof(saved_write_nonce));
+    memcpy(saved_read_nonce, channel.read_nonce, sizeof(saved_read_nonce));
+}
+
+/**
+ * @brief Runs and times the phases in order and prints the result.
+ *
+ * Each phase is first executed once and verified, the output is the input of
+ * the following phases.
+ */
+static bool run_phases(const char *title, phase_t *phases, uint32_t count)
+{
+    double total = 0;
+    double start;
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (!phases[i].run() || ((NULL != phases[i].done) && !phases[i].done())) {
+            printf("Phase %s failed.\r\n", phases[i].name);
+            return false;
+        }
+
+        start = time_stamps_get_millis();
+        for (uint32_t j = 0; j < NUM_ITERATIONS; j++) {
+            phases[i].run();
+        }
+        phases[i].average = (time_stamps_get_millis() - start) / NUM_ITERATIONS;
+        total += phases[i].average;
+    }
+
+    printf("-------------------------------------------------------------\r\n");
+    printf("| %-57.56s |\r\n", title);
+    printf("-------------------------------------------------------------\r\n");
+    printf("| Phase                           | Average [ms] | Share    |\r\n");
+    printf("-------------------------------------------------------------\r\n");
+    for (uint32_t i = 0; i < count; i++) {
+        printf("| %-32.31s| %-13.4f| %6.2f %% |\r\n",
+               phases[i].name, phases[i].average,
+               (total > 0) ? (100.0 * phases[i].average / total) : 0.0);
+    }
+    printf("-------------------------------------------------------------\r\n");
+    printf("| %-32.31s| %-13.4f| %6.2f %% |\r\n", "Total", total, 100.0);
+    printf("-------------------------------------------------------------\r\n");
+
+    return true;
+}
+
+static salt_ret_t dummy_io(salt_io_channel_t *p_channel)
+{
+    (void) p_channel;
+    return SALT_ERROR;
+}
+
+/* Ephemeral key pair created by salt_init_session. */
+static bool box_keypair_run(void)
+{
+    return api_crypto_box_keypair(keypair, &keypair[32]) == 0;
+}
+
+static bool host_handle_m1_run(void)
+{
+    /* M1 is hashed in place. */
+    memcpy(&hndsk_buffer[SALT_M1_HASH_OFFSET], &m1[4], sizeof(m1) - 4U);
+    return salti_handle_m1(&channel,
+                           &hndsk_buffer[SALT_M1_HASH_OFFSET],
+                           sizeof(m1) - 4U,
+                           &hndsk_buffer[SALT_M1_HASH_OFFSET]) == SALT_M2_INIT;
+}
+
+static bool host_create_m2_run(void)
+{
+    channel.state = SALT_M2_INIT;
+    return salti_create_m2(&channel,
+                           &hndsk_buffer[SALT_M2_HOST_OFFSET],
+                           &out_size,
+                           &hndsk_buffer[SALT_M2_HASH_OFFSET]) == SALT_M2_IO_AND_SESSION_KEY;
+}
+
+static bool host_create_m2_done(void)
+{
+    return (sizeof(m2) == out_size) &&
+           (memcmp(&hndsk_buffer[SALT_M2_HOST_OFFSET], m2, sizeof(m2)) == 0);
+}
+
+static bool host_beforenm_run(void)
+{
+    return api_crypto_box_beforenm(channel.ek_common,
+                                   &hndsk_buffer[SALT_HOST_TMP_PEER_EK_PUB_OFFSET],
+                                   &hndsk_buffer[SALT_SEC_ENC_OFFSET]) == 0;
+}
+
+static bool host_create_m3_sig_run(void)
+{
+    return salti_create_m3m4_sig(&channel,
+                                 &hndsk_buffer[SALT_M3_HOST_CLEAR_OFFSET],
+                                 &out_size) == SALT_SUCCESS;
+}
+
+static bool host_create_m3_sig_done(void)
+{
+    memcpy(saved_my_clear, &hndsk_buffer[SALT_M3_HOST_CLEAR_OFFSET], SALT_M3M4_CLEAR_SIZE);
+    return (SALT_M3M4_CLEAR_SIZE == out_size);
+}
+
+static bool host_wrap_m3_run(void)
+{
+    /* M3 is encrypted in place, and the write nonce is increased. */
+    memcpy(&hndsk_buffer[SALT_M3_HOST_CLEAR_OFFSET], saved_my_clear, SALT_M3M4_CLEAR_SIZE);
+    memcpy(channel.write_nonce, saved_write_nonce, sizeof(saved_write_nonce));
+    return salti_wrap(&channel,
+                      &hndsk_buffer[SALT_M3_HOST_WRAPPED_OFFSET],
+                      SALT_M3M4_CLEAR_SIZE,
+                      0x03U,
+                      &p_out,
+                      &out_size,
+                      false) == SALT_SUCCESS;
+}
+
+static bool host_wrap_m3_done(void)
+{
+    return (sizeof(m3) == out_size) && (memcmp(p_out, m3, sizeof(m3)) == 0);
+}
+
+static bool host_unwrap_m4_run(void)
+{
+    uint8_t *header;
+    memcpy(&hndsk_buffer[SALT_M4_HOST_IO_WRAPPED_OFFSET], &m4[4], SALT_M3M4_WRAPPED_SIZE);
+    memcpy(channel.read_nonce, saved_read_nonce, sizeof(saved_read_nonce));
+    return (salti_unwrap(&channel,
+                         &hndsk_buffer[SALT_M4_HOST_WRAPPED_OFFSET],
+                         SALT_M3M4_WRAPPED_SIZE,
+                         &header,
+                         &p_out,
+                         &out_size) == SALT_SUCCESS) &&
+           (0x04U == header[0]);
+}
+
+static bool host_unwrap_m4_done(void)
+{
+    memcpy(saved_peer_clear, p_out, SALT_M3M4_CLEAR_SIZE);
+    return (SALT_M3M4_CLEAR_SIZE == out_size);
+}
+
+static bool host_verify_m4_sig_run(void)
+{
+    /* The signed message is opened on top of M4. */
+    memcpy(&hndsk_buffer[SALT_M4_HOST_WRAPPED_OFFSET + SALT_WRAP_OVERHEAD_SIZE], saved_peer_clear, SALT_M3M4_CLEAR_SIZE);
+    return salti_verify_m3m4_sig(&channel,
+                                 &hndsk_buffer[SALT_M4_HOST_WRAPPED_OFFSET + SALT_WRAP_OVERHEAD_SIZE],
+                                 SALT_M3M4_CLEAR_SIZE) == SALT_SUCCESS;
+}
+
+static bool client_create_m1_run(void)
+{
+    return salti_create_m1(&channel,
+                           &hndsk_buffer[SALT_M2_HASH_OFFSET],
+                           &out_size,
+                           &hndsk_buffer[SALT_M1_HASH_OFFSET],
+                           NULL) == SALT_SUCCESS;
+}
+
+static bool client_create_m1_done(void)
+{
+    return (sizeof(m1) == out_size) &&
+           (memcmp(&hndsk_buffer[SALT_M2_HASH_OFFSET], m1, sizeof(m1)) == 0);
+}
+
+static bool client_handle_m2_run(void)
+{
+    /* M2 is hashed in place. */
+    memcpy(&hndsk_buffer[SALT_M2_HASH_OFFSET], &m2[4], sizeof(m2) - 4U);
+    return salti_handle_m2(&channel,
+                           &hndsk_buffer[SALT_M2_HASH_OFFSET],
+                           sizeof(m2) - 4U,
+                           &hndsk_buffer[SALT_M2_HASH_OFFSET]) == SALT_M3_INIT;
+}
+
+static bool client_create_m4_sig_run(void)
+{
+    /* The client keeps the signature in the handshake buffer until M3 is verified. */
+    return salti_sign_m3m4(&channel) == SALT_SUCCESS;
+}
+
+static bool client_create_m4_sig_done(void)
+{
+    memcpy(saved_my_clear, channel.my_sk_pub, api_crypto_sign_PUBLICKEYBYTES);
+    memcpy(&saved_my_clear[api_crypto_sign_PUBLICKEYBYTES], hndsk_buffer, api_crypto_sign_BYTES);
+    return true;
+}
+
+static bool client_unwrap_m3_run(void)
+{
+    uint8_t *header;
+    memcpy(&hndsk_buffer[SALT_M3_CLIENT_IO_WRAPPED_OFFSET], &m3[4], SALT_M3M4_WRAPPED_SIZE);
+    memcpy(channel.read_nonce, saved_read_nonce, sizeof(saved_read_nonce));
+    return (salti_unwrap(&channel,
+                         &hndsk_buffer[SALT_M3_CLIENT_WRAPPED_OFFSET],
+                         SALT_M3M4_WRAPPED_SIZE,
+                         &header,
+                         &p_out,
+                         &out_size) == SALT_SUCCESS) &&
+           (0x03U == header[0]);
+}
+
+static bool client_unwrap_m3_done(void)
+{
+    memcpy(saved_peer_clear, p_out, SALT_M3M4_CLEAR_SIZE);
+    return (SALT_M3M4_CLEAR_SIZE == out_size);
+}
+
+static bool client_verify_m3_sig_run(void)
+{
+    memcpy(&hndsk_buffer[SALT_M3_CLIENT_WRAPPED_OFFSET + SALT_WRAP_OVERHEAD_SIZE], saved_peer_clear, SALT_M3M4_CLEAR_SIZE);
+    return salti_verify_m3m4_sig(&channel,
+                                 &hndsk_buffer[SALT_M3_CLIENT_WRAPPED_OFFSET + SALT_WRAP_OVERHEAD_SIZE],
+                                 SALT_M3M4_CLEAR_SIZE) == SALT_SUCCESS;
+}
+
+static bool client_wrap_m4_run(void)
+{
+    memcpy(&hndsk_buffer[SALT_M4_CLIENT_CLEAR_OFFSET], saved_my_clear, SALT_M3M4_CLEAR_SIZE);
+    memcpy(channel.write_nonce, saved_write_nonce, sizeof(saved_write_nonce));
+    return salti_wrap(&channel,
+                      &hndsk_buffer[SALT_M4_CLIENT_IO_WRAPPED_OFFSET],
+                      SALT_M3M4_CLEAR_SIZE,
+                      0x04U,
+                      &p_out,
+                      &out_size,
+                      false) == SALT_SUCCESS;
+}
+
+static bool client_wrap_m4_done(void)
+{
+    return (sizeof(m4) == out_size) && (memcmp(p_out, m4, sizeof(m4)) == 0);
+}
@@ -0,0 +1,30 @@
+#ifndef _HANDSHAKE_PHASE_BENCHMARK_H_
+#define _HANDSHAKE_PHASE_BENCHMARK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file handshake_phase_benchmark.h
+ *
+ * Per phase cost of the host and client handshake.
+ *
+ */
+
+/*======= Includes ==========================================================*/
+
+#include <stdbool.h>
+
+/*======= Public macro definitions ==========================================*/
+/*======= Type Definitions and declarations =================================*/
+/*======= Public variable declarations ======================================*/
+/*======= Public function declarations ======================================*/
+
+bool run_handshake_phase_benchmark(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _HANDSHAKE_PHASE_BENCHMARK_H_ */
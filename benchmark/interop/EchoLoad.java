@@ -0,0 +1,135 @@
+import java.net.Socket;
+import java.util.Arrays;
+import java.util.Locale;
+
+import saltchannel.CryptoLib;
+import saltchannel.SocketChannel;
+import saltchannel.util.KeyPair;
+import saltchannel.util.Rand;
+import saltchannel.v2.ApplicationChannel;
+import saltchannel.v2.SaltClientSession;
+
+/**
+ * Load client for an echo host using the Java reference implementation,
+ * the Java counterpart of examples/client_load.c. Takes the same options and
+ * prints the same RESULT line, see benchmark_interop.sh.
+ *
+ * Usage: java -cp salt-channel-2.5.jar:. EchoLoad [-a addr] [-p port]
+ *        [-n handshakes] [-e echoes] [-s size]
+ */
+public class EchoLoad {
+    private static final byte ECHO_COMMAND = 1;
+    private static final int CONNECT_RETRIES = 50;
+
+    public static void main(String[] args) throws Exception {
+        String addr = "127.0.0.1";
+        int port = 2033;
+        int handshakes = 200;
+        int echoes = 2000;
+        int size = 64;
+
+        for (int i = 0; i + 1 < args.length; i += 2) {
+            String value = args[i + 1];
+            if (args[i].equals("-a")) {
+                addr = value;
+            } else if (args[i].equals("-p")) {
+                port = Integer.parseInt(value);
+            } else if (args[i].equals("-n")) {
+                handshakes = Integer.parseInt(value);
+            } else if (args[i].equals("-e")) {
+                echoes = Integer.parseInt(value);
+            } else if (args[i].equals("-s")) {
+                size = Integer.parseInt(value);
+            } else {
+                throw new IllegalArgumentException("unknown option " + args[i]);
+            }
+        }
+
+        if (size < 1 || echoes < 1) {
+            throw new IllegalArgumentException("echo size and count must be at least 1");
+        }
+
+        Rand rand = CryptoLib.createSecureRand();
+        KeyPair sigKeyPair = CryptoLib.createSigKeys(rand);
+
+        // A tenth of the handshakes and echoes are run untimed, to measure
+        // the JIT compiled code and a warm peer.
+        long start = 0;
+        for (int i = 0; i < handshakes + handshakes / 10; i++) {
+            if (i == handshakes / 10) {
+                start = System.nanoTime();
+            }
+            Socket socket = connect(addr, port);
+            handshake(socket, sigKeyPair, rand);
+            socket.close();
+        }
+        long elapsed = System.nanoTime() - start;
+        double handshakesPerS = elapsed > 0 ? 1e9 * handshakes / elapsed : 0;
+
+        Socket socket = connect(addr, port);
+        ApplicationChannel channel = handshake(socket, sigKeyPair, rand).getChannel();
+
+        byte[] request = new byte[size];
+        Arrays.fill(request, (byte) 0xA5);
+        request[0] = ECHO_COMMAND;
+
+        for (int i = 0; i < echoes / 10; i++) {
+            echo(channel, request);
+        }
+
+        long[] latency = new long[echoes];
+        long sum = 0;
+        start = System.nanoTime();
+        for (int i = 0; i < echoes; i++) {
+            long t0 = System.nanoTime();
+            echo(channel, request);
+            latency[i] = (System.nanoTime() - t0) / 1000;
+            sum += latency[i];
+        }
+        elapsed = (System.nanoTime() - start) / 1000;
+        socket.close();
+
+        // Both directions are counted.
+        double throughput = elapsed > 0 ? 2.0 * size * echoes / elapsed : 0;
+
+        Arrays.sort(latency);
+
+        System.out.println(String.format(Locale.ROOT,
+                "RESULT handshakes_per_s=%.1f echo_mean_us=%.1f echo_p50_us=%d echo_p99_us=%d throughput_mb_s=%.2f",
+                handshakesPerS,
+                (double) sum / echoes,
+                latency[echoes / 2],
+                latency[(int) ((long) echoes * 99 / 100)],
+                throughput));
+    }
+
+    private static Socket connect(String addr, int port) throws Exception {
+        for (int i = 0; ; i++) {
+            try {
+                return new Socket(addr, port);
+            } catch (java.io.IOException e) {
+                // The host may still be starting.
+                if (i >= CONNECT_RETRIES) {
+                    throw e;
+                }
+                Thread.sleep(100);
+            }
+        }
+    }
+
+    private static SaltClientSession handshake(Socket socket, KeyPair sigKeyPair, Rand rand) throws Exception {
+        SaltClientSession session = new SaltClientSession(sigKeyPair, new SocketChannel(socket));
+        session.setEncKeyPair(rand);
+        session.setBufferM4(false);
+        session.handshake();
+        return session;
+    }
+
+    private static void echo(ApplicationChannel channel, byte[] request) throws Exception {
+        channel.write(false, request);
+        byte[] response = channel.read();
+        if (response.length != request.length || response[0] != ECHO_COMMAND) {
+            throw new IllegalStateException("bad echo response, " + response.length + " bytes");
+        }
+    }
+}
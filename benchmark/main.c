@@ -7,30 +7,45 @@
 
 /*======= Includes ==========================================================*/
 
+#define _GNU_SOURCE
+
 #include <sys/time.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <assert.h>
 #include "time_stamp.h"
 #include "salt.h"
 #include "crypto_benchmark.h"
 #include "client_handshake_benchmark.h"
 #include "host_handshake_benchmark.h"
+#include "handshake_phase_benchmark.h"
+#include "cold_cache_benchmark.h"
 
 /*======= Local Macro Definitions ===========================================*/
 /*======= Type Definitions ==================================================*/
 /*======= Local function prototypes =========================================*/
+
+static int run_cold(int argc, char *argv[]);
+
 /*======= Local variable declarations =======================================*/
 /*======= Global function implementations ===================================*/
 
-int main(void) {
+int main(int argc, char *argv[]) {
 
     time_stamps_t stamps;
+
+    if ((argc > 1) && (strcmp(argv[1], "cold") == 0)) {
+        return run_cold(argc - 1, &argv[1]);
+    }
+
     time_stamps_init(&stamps, "Benchmark");
 
     assert(run_crypto_benchmark(&stamps));
     assert(run_client_handshake_benchmark(&stamps));
     assert(run_host_handshake_benchmark(&stamps));
+    assert(run_handshake_phase_benchmark());
 
 
     time_stamps_result(&stamps);
@@ -40,3 +55,31 @@ int main(void) {
 
 /*======= Local function implementations ====================================*/
 
+/* benchmark_test cold [-n iterations] [-e evict_mb] [-p] */
+static int run_cold(int argc, char *argv[])
+{
+    uint32_t iterations = COLD_CACHE_DEFAULT_ITERATIONS;
+    uint32_t evict_mb = COLD_CACHE_DEFAULT_EVICT_MB;
+    bool pin = false;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:e:p")) != -1) {
+        switch (opt) {
+            case 'n':
+                iterations = (uint32_t) strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                evict_mb = (uint32_t) strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                pin = true;
+                break;
+            default:
+                printf("Usage: benchmark_test cold [-n iterations] [-e evict_mb] [-p]\r\n");
+                return 1;
+        }
+    }
+
+    return run_cold_cache_benchmark(iterations, evict_mb, pin) ? 0 : 1;
+}
+
@@ -0,0 +1,98 @@
+#!/bin/sh
+#
+# Handshake and echo load between the C implementation and the Java reference
+# implementation in salt-channel-2.5.jar, over loopback:
+#
+#   C -> C          client_load -> host_echo
+#   Java -> C       EchoLoad    -> host_echo
+#   C -> Java       client_load -> saltchannel.dev.TcpTestServer
+#   Java -> Java    EchoLoad    -> saltchannel.dev.TcpTestServer, reference
+#
+# Reports handshakes/s, echo round trip latency and echo throughput for each
+# pair and message size. A pair that is much slower than both its C -> C and
+# Java -> Java references points to an interop problem, e.g., record sizes or
+# write fragmentation.
+#
+# The C programs are compiled with -O2 and without SALT_DEBUG to a temporary
+# directory, since the CMake build prints every record.
+#
+# Usage: sh benchmark_interop.sh [handshakes] [echoes] ["sizes"]
+
+HANDSHAKES=${1:-200}
+ECHOES=${2:-2000}
+SIZES=${3:-"64 16384"}
+JAR=salt-channel-2.5.jar
+CC=${CC:-cc}
+
+OUT=$(mktemp -d)
+server=
+cleanup() {
+    if [ -n "$server" ]; then
+        kill $server 2>/dev/null
+        wait $server 2>/dev/null
+    fi
+    rm -rf "$OUT"
+}
+trap cleanup EXIT
+
+SALT_SRC="src/salt.c src/salti_util.c src/salti_handshake.c \
+    src/external/tweetnacl_modified/tweetnacl_modified.c \
+    src/external/tweetnacl_modified/tweetnacl_modified_wrapper.c \
+    examples/salt_io.c examples/randombytes_linux.c"
+
+if ! $CC -O2 -std=c99 -Isrc -Iexamples -o "$OUT/host_echo" examples/host_echo.c $SALT_SRC -pthread -lm ||
+   ! $CC -O2 -std=c99 -Isrc -Iexamples -o "$OUT/client_load" examples/client_load.c $SALT_SRC -pthread -lm ; then
+    echo "Failed to build C programs"
+    exit 1
+fi
+
+if ! javac -cp $JAR -d "$OUT" benchmark/interop/EchoLoad.java ; then
+    echo "Failed to build Java driver"
+    exit 1
+fi
+
+C_HOST="$OUT/host_echo"
+JAVA_HOST="java -cp $JAR saltchannel.dev.TcpTestServer"
+C_CLIENT="$OUT/client_load"
+JAVA_CLIENT="java -cp $JAR:$OUT EchoLoad"
+
+status=0
+
+run_pair() {
+    pair=$1
+    host=$2
+    client=$3
+
+    $host > /dev/null 2>&1 &
+    server=$!
+
+    for size in $SIZES; do
+        result=$($client -n $HANDSHAKES -e $ECHOES -s $size | tr -d '\r' | grep '^RESULT')
+        if [ -z "$result" ]; then
+            printf "%-14s %8s  failed\n" "$pair" "$size"
+            status=1
+            continue
+        fi
+        echo "$result" | awk -v pair="$pair" -v size="$size" '{
+            for (i = 2; i <= NF; i++) {
+                split($i, kv, "=");
+                v[kv[1]] = kv[2];
+            }
+            printf "%-14s %8s %14s %12s %10s %10s %12s\n", pair, size,
+                v["handshakes_per_s"], v["echo_mean_us"], v["echo_p50_us"],
+                v["echo_p99_us"], v["throughput_mb_s"];
+        }'
+    done
+
+    kill $server 2>/dev/null
+    wait $server 2>/dev/null
+    server=
+}
+
+printf "%-14s %8s %14s %12s %10s %10s %12s\n" "Pair" "Size" "Handshakes/s" "Mean [us]" "p50 [us]" "p99 [us]" "MB/s"
+run_pair "C -> C" "$C_HOST" "$C_CLIENT"
+run_pair "Java -> C" "$C_HOST" "$JAVA_CLIENT"
+run_pair "C -> Java" "$JAVA_HOST" "$C_CLIENT"
+run_pair "Java -> Java" "$JAVA_HOST" "$JAVA_CLIENT"
+
+exit $status
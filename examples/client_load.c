@@ -0,0 +1,334 @@
+/**
+ * @file client_load.c
+ *
+ * Load client for the echo host, used by benchmark_interop.sh.
+ *
+ * First runs a number of sequential handshakes, each on a new TCP connection,
+ * and then a number of echo round trips on one session. A tenth of the
+ * handshakes and echoes are first run untimed, so that a JIT compiled peer is
+ * measured warm. The result is printed on one line:
+ *
+ *  RESULT handshakes_per_s=<n> echo_mean_us=<n> echo_p50_us=<n> echo_p99_us=<n> throughput_mb_s=<n>
+ *
+ * The same line is printed by the Java driver benchmark/interop/EchoLoad.java
+ * so that C and Java clients can be compared against the same host.
+ *
+ * With -t, the M4 signature of each handshake is created on a helper thread,
+ * see salt_worker_init.
+ *
+ * With -f, TCP Fast Open is used and M1 is sent in the SYN once the host has
+ * given a cookie, see salt_io_fastopen_connect.
+ *
+ * Usage: client_load [-a addr] [-p port] [-n handshakes] [-e echoes] [-s size] [-t] [-f]
+ */
+
+/*======= Includes ==========================================================*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "salt.h"
+#include "salt_io.h"
+
+/*======= Local Macro Definitions ===========================================*/
+
+#define LOAD_DEFAULT_PORT       (2033U)
+#define LOAD_DEFAULT_HANDSHAKES (200U)
+#define LOAD_DEFAULT_ECHOES     (2000U)
+#define LOAD_DEFAULT_SIZE       (64U)
+#define LOAD_CONNECT_RETRIES    (50U)       /**< The host may still be starting. */
+#define LOAD_ECHO_COMMAND       (0x01U)
+
+/*======= Type Definitions ==================================================*/
+
+typedef struct load_config_s {
+    const char  *addr;
+    uint16_t    port;
+    uint32_t    handshakes;
+    uint32_t    echoes;
+    uint32_t    size;
+    bool        worker;
+    bool        fastopen;
+} load_config_t;
+
+/*======= Local function prototypes =========================================*/
+
+static uint64_t now_us(void);
+static int load_connect(const load_config_t *p_config);
+static int load_handshake(salt_channel_t *p_channel,
+                          int *p_sock,
+                          const uint8_t *p_sk_sec,
+                          uint8_t *p_hndsk_buffer,
+                          bool use_worker);
+static int load_echo(salt_channel_t *p_channel,
+                     uint8_t *p_tx_buffer,
+                     uint8_t *p_rx_buffer,
+                     uint32_t buffer_size,
+                     uint32_t size);
+static int compare_u64(const void *a, const void *b);
+
+/*======= Local variable declarations =======================================*/
+/*======= Global function implementations ===================================*/
+
+int main(int argc, char *argv[])
+{
+    load_config_t config = {
+        "127.0.0.1",
+        LOAD_DEFAULT_PORT,
+        LOAD_DEFAULT_HANDSHAKES,
+        LOAD_DEFAULT_ECHOES,
+        LOAD_DEFAULT_SIZE,
+        false,
+        false
+    };
+    salt_channel_t channel;
+    uint8_t hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
+    uint8_t sk_sec[api_crypto_sign_SECRETKEYBYTES];
+    uint8_t sk_pub[api_crypto_sign_PUBLICKEYBYTES];
+    uint64_t *p_latency;
+    uint8_t *p_tx_buffer;
+    uint8_t *p_rx_buffer;
+    uint32_t buffer_size;
+    uint64_t start = 0;
+    uint64_t elapsed;
+    uint64_t sum = 0;
+    double handshakes_per_s;
+    double throughput;
+    int sock;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:p:n:e:s:tf")) != -1) {
+        switch (opt) {
+            case 'a':
+                config.addr = optarg;
+                break;
+            case 'p':
+                config.port = (uint16_t) strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                config.handshakes = (uint32_t) strtoul(optarg, NULL, 0);
+                break;
+            case 'e':
+                config.echoes = (uint32_t) strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                config.size = (uint32_t) strtoul(optarg, NULL, 0);
+                break;
+            case 't':
+                config.worker = true;
+                break;
+            case 'f':
+                config.fastopen = true;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-a addr] [-p port] [-n handshakes] [-e echoes] [-s size] [-t] [-f]\r\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if ((config.size < 1) || (config.echoes < 1)) {
+        fprintf(stderr, "Echo size and count must be at least 1.\r\n");
+        return 1;
+    }
+
+    /* The signature key is the same for all sessions, as for a real client. */
+    api_crypto_sign_keypair(sk_pub, sk_sec);
+
+    buffer_size = config.size + SALT_READ_OVERHEAD_SIZE + SALT_WRITE_OVERHEAD_SIZE;
+    p_tx_buffer = malloc(buffer_size);
+    p_rx_buffer = malloc(buffer_size);
+    p_latency = malloc(sizeof(uint64_t) * config.echoes);
+    if ((NULL == p_tx_buffer) || (NULL == p_rx_buffer) || (NULL == p_latency)) {
+        fprintf(stderr, "Out of memory.\r\n");
+        return 1;
+    }
+
+    /* Handshakes, a new connection for each session. */
+    for (uint32_t i = 0; i < config.handshakes + (config.handshakes / 10U); i++) {
+        if (i == (config.handshakes / 10U)) {
+            start = now_us();
+        }
+        sock = load_connect(&config);
+        if ((sock < 0) || (load_handshake(&channel, &sock, sk_sec, hndsk_buffer, config.worker) != 0)) {
+            fprintf(stderr, "Handshake %u failed.\r\n", i);
+            return 1;
+        }
+        close(sock);
+    }
+    elapsed = now_us() - start;
+    handshakes_per_s = (elapsed > 0) ? (1e6 * config.handshakes / elapsed) : 0;
+
+    /* Echo round trips on one session. */
+    sock = load_connect(&config);
+    if ((sock < 0) || (load_handshake(&channel, &sock, sk_sec, hndsk_buffer, config.worker) != 0)) {
+        fprintf(stderr, "Echo session handshake failed.\r\n");
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < config.echoes / 10U; i++) {
+        if (load_echo(&channel, p_tx_buffer, p_rx_buffer, buffer_size, config.size) != 0) {
+            fprintf(stderr, "Echo %u failed.\r\n", i);
+            return 1;
+        }
+    }
+
+    start = now_us();
+    for (uint32_t i = 0; i < config.echoes; i++) {
+        uint64_t t0 = now_us();
+        if (load_echo(&channel, p_tx_buffer, p_rx_buffer, buffer_size, config.size) != 0) {
+            fprintf(stderr, "Echo %u failed.\r\n", i);
+            return 1;
+        }
+        p_latency[i] = now_us() - t0;
+        sum += p_latency[i];
+    }
+    elapsed = now_us() - start;
+    close(sock);
+
+    /* Both directions are counted. */
+    throughput = (elapsed > 0) ? (2.0 * config.size * config.echoes / elapsed) : 0;
+
+    qsort(p_latency, config.echoes, sizeof(uint64_t), compare_u64);
+
+    printf("RESULT handshakes_per_s=%.1f echo_mean_us=%.1f echo_p50_us=%llu echo_p99_us=%llu throughput_mb_s=%.2f\r\n",
+           handshakes_per_s,
+           (double) sum / config.echoes,
+           (unsigned long long) p_latency[config.echoes / 2],
+           (unsigned long long) p_latency[(config.echoes * 99U) / 100U],
+           throughput);
+
+    free(p_latency);
+    free(p_rx_buffer);
+    free(p_tx_buffer);
+
+    return 0;
+}
+
+/*======= Local function implementations ====================================*/
+
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000U) + ((uint64_t) ts.tv_nsec / 1000U);
+}
+
+static int load_connect(const load_config_t *p_config)
+{
+    struct sockaddr_in serv_addr;
+    struct timespec retry_delay = { 0, 100000000L };
+    static bool warned = false;
+
+    memset(&serv_addr, 0x00, sizeof(serv_addr));
+    serv_addr.sin_family = AF_INET;
+    serv_addr.sin_addr.s_addr = inet_addr(p_config->addr);
+    serv_addr.sin_port = htons(p_config->port);
+
+    for (uint32_t i = 0; i < LOAD_CONNECT_RETRIES; i++) {
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (sock < 0) {
+            return -1;
+        }
+        if (p_config->fastopen && (salt_io_fastopen_connect(sock) != SALT_SUCCESS) && !warned) {
+            fprintf(stderr, "TCP Fast Open not supported, using a normal connect.\r\n");
+            warned = true;
+        }
+        if (connect(sock, (struct sockaddr *) &serv_addr, sizeof(serv_addr)) == 0) {
+            return sock;
+        }
+        close(sock);
+        nanosleep(&retry_delay, NULL);
+    }
+
+    return -1;
+}
+
+static int load_handshake(salt_channel_t *p_channel,
+                          int *p_sock,
+                          const uint8_t *p_sk_sec,
+                          uint8_t *p_hndsk_buffer,
+                          bool use_worker)
+{
+    static salt_io_worker_t thread;
+    static salt_worker_t worker;
+    salt_ret_t ret;
+
+    if ((salt_create(p_channel, SALT_CLIENT, my_write, my_read, &my_time) != SALT_SUCCESS) ||
+        (salt_set_signature(p_channel, p_sk_sec) != SALT_SUCCESS) ||
+        (salt_init_session(p_channel, p_hndsk_buffer, SALT_HNDSHK_BUFFER_SIZE) != SALT_SUCCESS) ||
+        (salt_set_context(p_channel, p_sock, p_sock) != SALT_SUCCESS)) {
+        return -1;
+    }
+
+    if (use_worker &&
+        (salt_worker_init(p_channel, &worker, salt_io_worker_start,
+                          salt_io_worker_poll, &thread) != SALT_SUCCESS)) {
+        return -1;
+    }
+
+    do {
+        ret = salt_handshake(p_channel, NULL);
+    } while (ret == SALT_PENDING);
+
+    if (ret != SALT_SUCCESS) {
+        fprintf(stderr, "Salt error: 0x%02x\r\n", p_channel->err_code);
+        return -1;
+    }
+
+    return 0;
+}
+
+static int load_echo(salt_channel_t *p_channel,
+                     uint8_t *p_tx_buffer,
+                     uint8_t *p_rx_buffer,
+                     uint32_t buffer_size,
+                     uint32_t size)
+{
+    salt_msg_t msg_out;
+    salt_msg_t msg_in;
+    salt_ret_t ret;
+
+    if (salt_write_begin(p_tx_buffer, buffer_size, &msg_out) != SALT_SUCCESS) {
+        return -1;
+    }
+    msg_out.write.p_payload[0] = LOAD_ECHO_COMMAND;
+    memset(&msg_out.write.p_payload[1], 0xA5, size - 1);
+    if (salt_write_commit(&msg_out, size) != SALT_SUCCESS) {
+        return -1;
+    }
+
+    do {
+        ret = salt_write_execute(p_channel, &msg_out, false);
+    } while (ret == SALT_PENDING);
+
+    if (ret != SALT_SUCCESS) {
+        return -1;
+    }
+
+    do {
+        ret = salt_read_begin(p_channel, p_rx_buffer, buffer_size, &msg_in);
+    } while (ret == SALT_PENDING);
+
+    if ((ret != SALT_SUCCESS) ||
+        (msg_in.read.message_size != size) ||
+        (msg_in.read.p_payload[0] != LOAD_ECHO_COMMAND)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
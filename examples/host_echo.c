@@ -25,14 +25,29 @@ static uint8_t host_sk_sec[64] = {
     0x73, 0x41, 0x3b, 0x37, 0x3d, 0x36, 0x16, 0x8b
 };
 
+/*
+ * Each session runs on a small thread stack, the large buffers are kept in
+ * the heap allocated client info and the crypto temporaries in the scratch
+ * workspace.
+ */
+#define HOST_ECHO_STACK_SIZE    (32U * 1024U)
+
 struct clientInfo {
     int sock_fd;
     char ip_addr[16];
     struct sockaddr_in client;
     salt_channel_t channel;
+    salt_io_zc_t zc;
+    uint8_t hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
+    uint8_t rx_buffer[UINT16_MAX * 4];
+    uint8_t tx_buffer[UINT16_MAX * 4];
+    uint64_t crypto_scratch[api_crypto_scratch_BYTES / 8];
 };
 
-int main(void)
+/* Zerocopy threshold, 0 if zerocopy writes are not used. */
+static uint32_t zc_threshold = 0;
+
+int main(int argc, char *argv[])
 {
 
     int socket_desc;
@@ -42,8 +57,15 @@ int main(void)
 
     int c;
     struct sockaddr_in server;
+    pthread_attr_t attr;
     setbuf(stdout, NULL);
 
+    /* Usage: host_echo [-z [threshold]] */
+    if ((argc > 1) && (strcmp(argv[1], "-z") == 0)) {
+        zc_threshold = (argc > 2) ? (uint32_t) strtoul(argv[2], NULL, 0) : SALT_IO_ZC_DEFAULT_THRESHOLD;
+        printf("Using MSG_ZEROCOPY for records >= %u bytes.\r\n", zc_threshold);
+    }
+
     socket_desc = socket(AF_INET , SOCK_STREAM , 0);
 
     if (socket_desc == -1)
@@ -70,8 +92,16 @@ int main(void)
     }
     puts("bind done");
 
+    /* Clients with a cookie send M1 in the SYN, others connect as usual. */
+    if (salt_io_fastopen_listen(socket_desc, SALT_IO_FASTOPEN_QUEUE) == SALT_SUCCESS) {
+        puts("TCP Fast Open enabled");
+    }
+
     listen(socket_desc , 3);
 
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, HOST_ECHO_STACK_SIZE);
+
     while (1)
     {
         puts("Waiting for incoming connections...");
@@ -95,7 +125,7 @@ int main(void)
 
         pthread_t salt_thread;
 
-        if (pthread_create(&salt_thread, NULL,  connection_handler, (void*) client_info) < 0)
+        if (pthread_create(&salt_thread, &attr,  connection_handler, (void*) client_info) < 0)
         {
             puts("could not create thread");
             return 1;
@@ -115,17 +145,29 @@ static void *connection_handler(void *context)
     int sock = client->sock_fd;
     salt_ret_t ret;
 
-    uint8_t hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
-    uint8_t rx_buffer[UINT16_MAX * 4];
+    uint8_t *hndsk_buffer = client->hndsk_buffer;
+    uint8_t *rx_buffer = client->rx_buffer;
     salt_msg_t msg_in;
-    uint8_t tx_buffer[UINT16_MAX * 4];
+    uint8_t *tx_buffer = client->tx_buffer;
     salt_msg_t msg_out;
 
     uint8_t protocol_buffer[128];
     salt_protocols_t protocols;
     uint8_t version[2] = { 0x00, 0x01 };
 
-    ret = salt_create(&client->channel, SALT_SERVER, my_write, my_read, &my_time);
+    if (api_crypto_scratch_set(client->crypto_scratch, sizeof(client->crypto_scratch)) != 0) {
+        printf("Crypto scratch workspace not supported.\r\n");
+    }
+
+    if (zc_threshold > 0) {
+        if (salt_io_zc_init(&client->zc, sock, zc_threshold, NULL, NULL) != SALT_SUCCESS) {
+            printf("MSG_ZEROCOPY not supported, records will be copied.\r\n");
+        }
+        ret = salt_create(&client->channel, SALT_SERVER, my_write_zerocopy, my_read, &my_time);
+    }
+    else {
+        ret = salt_create(&client->channel, SALT_SERVER, my_write, my_read, &my_time);
+    }
     assert(ret == SALT_SUCCESS);
     ret = salt_protocols_init(&client->channel, &protocols, protocol_buffer, sizeof(protocol_buffer));
     assert(ret == SALT_SUCCESS);
@@ -133,10 +175,12 @@ static void *connection_handler(void *context)
     assert(ret == SALT_SUCCESS);
     ret = salt_set_signature(&client->channel, host_sk_sec);
     assert(ret == SALT_SUCCESS);
-    ret = salt_init_session(&client->channel, hndsk_buffer, sizeof(hndsk_buffer));
+    ret = salt_init_session(&client->channel, hndsk_buffer, sizeof(client->hndsk_buffer));
     assert(ret == SALT_SUCCESS);
 
-    ret = salt_set_context(&client->channel, &client->sock_fd, &client->sock_fd);
+    ret = salt_set_context(&client->channel,
+                           (zc_threshold > 0) ? (void *) &client->zc : (void *) &client->sock_fd,
+                           &client->sock_fd);
     assert(ret == SALT_SUCCESS);
     salt_set_delay_threshold(&client->channel, 20000);
     ret = salt_handshake(&client->channel, NULL);
@@ -168,10 +212,10 @@ static void *connection_handler(void *context)
 
     do
     {
-        memset(hndsk_buffer, 0, sizeof(hndsk_buffer));
+        memset(hndsk_buffer, 0, sizeof(client->hndsk_buffer));
 
         do {
-            ret = salt_read_begin(&client->channel, rx_buffer, sizeof(rx_buffer), &msg_in);
+            ret = salt_read_begin(&client->channel, rx_buffer, sizeof(client->rx_buffer), &msg_in);
         } while (ret == SALT_PENDING);
 
         if (ret == SALT_ERROR) {
@@ -182,7 +226,16 @@ static void *connection_handler(void *context)
             break;
         }
 
-        ret = salt_write_begin(tx_buffer, sizeof(tx_buffer), &msg_out);
+        /*
+         * The previous record may still be read by the kernel if it was sent
+         * with MSG_ZEROCOPY. Wait until it is released before reusing tx_buffer.
+         */
+        if ((zc_threshold > 0) && (salt_io_zc_flush(&client->zc, -1) != SALT_SUCCESS)) {
+            printf("Zerocopy completion failed.\r\n");
+            break;
+        }
+
+        ret = salt_write_begin(tx_buffer, sizeof(client->tx_buffer), &msg_out);
         assert(ret == SALT_SUCCESS);
         bool last = false;
 
@@ -231,6 +284,9 @@ static void *connection_handler(void *context)
 
     } while (ret == SALT_SUCCESS);
 
+    if (zc_threshold > 0) {
+        salt_io_zc_flush(&client->zc, 1000);
+    }
 
     close(sock);
 
@@ -0,0 +1,307 @@
+/**
+ * @file poll_latency.c
+ *
+ * Round trip latency of the hybrid busy poll/epoll loop, see salt_io_poll_read.
+ *
+ * A client and an echo host run on two threads connected by a UNIX socket
+ * pair. The client sends a message, waits for the echo and then sleeps for a
+ * gap before the next message, so that the host sees idle periods as with
+ * request/response traffic. Both sides read using salt_io_poll_read with the
+ * same maximum spin budget. For each budget, the round trip latency and the
+ * CPU time used by both threads, in percent of one core, are printed:
+ *
+ *  spin_us  mean_us  p50_us  p99_us  cpu_%  spin_reads  epoll_reads
+ *
+ * spin_reads and epoll_reads are counted by the client poll loop.
+ *
+ * Usage: poll_latency [-n messages] [-g gap_us] [-s size] [-b spin_us]
+ */
+
+/*======= Includes ==========================================================*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "salt.h"
+#include "salt_io.h"
+
+/*======= Local Macro Definitions ===========================================*/
+
+#define POLL_DEFAULT_MESSAGES   (2000U)
+#define POLL_DEFAULT_GAP_US     (100U)
+#define POLL_DEFAULT_SIZE       (64U)
+#define POLL_MAX_SIZE           (4096U)
+#define POLL_BUFFER_SIZE        (POLL_MAX_SIZE + SALT_READ_OVERHEAD_SIZE + SALT_WRITE_OVERHEAD_SIZE)
+
+/*======= Type Definitions ==================================================*/
+
+typedef struct poll_side_s {
+    salt_channel_t          channel;
+    int                     sock;
+    uint8_t                 hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
+    uint8_t                 rx_buffer[POLL_BUFFER_SIZE];
+    uint8_t                 tx_buffer[POLL_BUFFER_SIZE];
+    salt_io_poll_entry_t    entry;
+    salt_io_poll_t          poll;
+    uint32_t                max_spin_us;
+} poll_side_t;
+
+/*======= Local function prototypes =========================================*/
+
+static uint64_t now_ns(void);
+static uint64_t cpu_ns(void);
+static int side_create(poll_side_t *p_side, salt_mode_t mode, int sock);
+static int side_handshake(poll_side_t *p_side);
+static int side_write(poll_side_t *p_side, uint8_t *p_data, uint32_t size);
+static void *echo_thread(void *p_arg);
+static int run(uint32_t spin_us, uint32_t messages, uint32_t gap_us, uint32_t size);
+static int compare_u64(const void *a, const void *b);
+
+/*======= Local variable declarations =======================================*/
+
+static const uint32_t default_budgets[] = { 0, 10, 50, 200, 1000 };
+
+/*======= Global function implementations ===================================*/
+
+int main(int argc, char *argv[])
+{
+    uint32_t messages = POLL_DEFAULT_MESSAGES;
+    uint32_t gap_us = POLL_DEFAULT_GAP_US;
+    uint32_t size = POLL_DEFAULT_SIZE;
+    int32_t budget = -1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:g:s:b:")) != -1) {
+        switch (opt) {
+            case 'n':
+                messages = (uint32_t) strtoul(optarg, NULL, 0);
+                break;
+            case 'g':
+                gap_us = (uint32_t) strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                size = (uint32_t) strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                budget = (int32_t) strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-n messages] [-g gap_us] [-s size] [-b spin_us]\r\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if ((messages < 1) || (size < 1) || (size > POLL_MAX_SIZE)) {
+        fprintf(stderr, "Invalid message count or size.\r\n");
+        return 1;
+    }
+
+    printf("%u messages of %u bytes, %u us gap\r\n", messages, size, gap_us);
+    printf("%-8s %-8s %-8s %-8s %-7s %-11s %s\r\n",
+           "spin_us", "mean_us", "p50_us", "p99_us", "cpu_%", "spin_reads", "epoll_reads");
+
+    if (budget >= 0) {
+        return run((uint32_t) budget, messages, gap_us, size);
+    }
+
+    for (uint32_t i = 0; i < sizeof(default_budgets) / sizeof(default_budgets[0]); i++) {
+        if (run(default_budgets[i], messages, gap_us, size) != 0) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/*======= Local function implementations ====================================*/
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000U) + (uint64_t) ts.tv_nsec;
+}
+
+static uint64_t cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000U) + (uint64_t) ts.tv_nsec;
+}
+
+static int side_create(poll_side_t *p_side, salt_mode_t mode, int sock)
+{
+    p_side->sock = sock;
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, 0) | O_NONBLOCK);
+
+    if ((salt_create(&p_side->channel, mode, my_write_nonblock, my_read_nonblock, &my_time) != SALT_SUCCESS) ||
+        (salt_create_signature(&p_side->channel) != SALT_SUCCESS) ||
+        (salt_init_session(&p_side->channel, p_side->hndsk_buffer, sizeof(p_side->hndsk_buffer)) != SALT_SUCCESS) ||
+        (salt_set_context(&p_side->channel, &p_side->sock, &p_side->sock) != SALT_SUCCESS)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int side_handshake(poll_side_t *p_side)
+{
+    salt_ret_t ret;
+
+    do {
+        ret = salt_handshake(&p_side->channel, NULL);
+    } while (ret == SALT_PENDING);
+
+    if (ret != SALT_SUCCESS) {
+        return -1;
+    }
+
+    p_side->entry.p_channel = &p_side->channel;
+    p_side->entry.sock = p_side->sock;
+    p_side->entry.p_buffer = p_side->rx_buffer;
+    p_side->entry.buffer_size = sizeof(p_side->rx_buffer);
+
+    return (salt_io_poll_init(&p_side->poll, &p_side->entry, 1, p_side->max_spin_us) == SALT_SUCCESS) ? 0 : -1;
+}
+
+static int side_write(poll_side_t *p_side, uint8_t *p_data, uint32_t size)
+{
+    salt_msg_t msg;
+    salt_ret_t ret;
+
+    if ((salt_write_begin(p_side->tx_buffer, sizeof(p_side->tx_buffer), &msg) != SALT_SUCCESS) ||
+        (salt_write_next(&msg, p_data, size) != SALT_SUCCESS)) {
+        return -1;
+    }
+
+    do {
+        ret = salt_write_execute(&p_side->channel, &msg, false);
+    } while (ret == SALT_PENDING);
+
+    return (ret == SALT_SUCCESS) ? 0 : -1;
+}
+
+/* Echoes each message until the client closes the socket. */
+static void *echo_thread(void *p_arg)
+{
+    poll_side_t *p_host = (poll_side_t *) p_arg;
+    salt_msg_t msg;
+    uint32_t index;
+
+    if (side_handshake(p_host) != 0) {
+        return NULL;
+    }
+
+    while (salt_io_poll_read(&p_host->poll, &msg, &index, -1) == SALT_SUCCESS) {
+        if (side_write(p_host, msg.read.p_payload, msg.read.message_size) != 0) {
+            break;
+        }
+    }
+
+    salt_io_poll_close(&p_host->poll);
+    return NULL;
+}
+
+static int run(uint32_t spin_us, uint32_t messages, uint32_t gap_us, uint32_t size)
+{
+    poll_side_t *p_client = malloc(sizeof(poll_side_t));
+    poll_side_t *p_host = malloc(sizeof(poll_side_t));
+    uint64_t *p_latency = malloc(sizeof(uint64_t) * messages);
+    struct timespec gap = { 0, (long) gap_us * 1000L };
+    uint8_t message[POLL_MAX_SIZE];
+    pthread_t thread;
+    salt_msg_t msg;
+    uint32_t index;
+    uint64_t sum = 0;
+    uint64_t wall;
+    uint64_t cpu;
+    int socks[2];
+    int ret = -1;
+
+    if ((NULL == p_client) || (NULL == p_host) || (NULL == p_latency) ||
+        (socketpair(AF_UNIX, SOCK_STREAM, 0, socks) != 0)) {
+        fprintf(stderr, "Could not set up the benchmark.\r\n");
+        free(p_latency);
+        free(p_host);
+        free(p_client);
+        return -1;
+    }
+
+    p_client->max_spin_us = spin_us;
+    p_host->max_spin_us = spin_us;
+    memset(message, 0xA5, size);
+
+    if ((side_create(p_client, SALT_CLIENT, socks[0]) != 0) ||
+        (side_create(p_host, SALT_SERVER, socks[1]) != 0) ||
+        (pthread_create(&thread, NULL, echo_thread, p_host) != 0)) {
+        fprintf(stderr, "Could not create the sessions.\r\n");
+        goto out;
+    }
+
+    if (side_handshake(p_client) != 0) {
+        fprintf(stderr, "Handshake failed.\r\n");
+        close(socks[0]);
+        pthread_join(thread, NULL);
+        goto out;
+    }
+
+    wall = now_ns();
+    cpu = cpu_ns();
+
+    for (uint32_t i = 0; i < messages; i++) {
+        uint64_t t0 = now_ns();
+        if ((side_write(p_client, message, size) != 0) ||
+            (salt_io_poll_read(&p_client->poll, &msg, &index, -1) != SALT_SUCCESS) ||
+            (msg.read.message_size != size)) {
+            fprintf(stderr, "Echo %u failed.\r\n", i);
+            break;
+        }
+        p_latency[i] = now_ns() - t0;
+        sum += p_latency[i];
+        ret = (i == messages - 1U) ? 0 : -1;
+        if (gap_us > 0) {
+            nanosleep(&gap, NULL);
+        }
+    }
+
+    wall = now_ns() - wall;
+    cpu = cpu_ns() - cpu;
+
+    close(socks[0]);
+    pthread_join(thread, NULL);
+    salt_io_poll_close(&p_client->poll);
+
+    if (0 == ret) {
+        qsort(p_latency, messages, sizeof(uint64_t), compare_u64);
+        printf("%-8u %-8.1f %-8.1f %-8.1f %-7.1f %-11llu %llu\r\n",
+               spin_us,
+               (double) sum / messages / 1000.0,
+               (double) p_latency[messages / 2] / 1000.0,
+               (double) p_latency[(messages * 99U) / 100U] / 1000.0,
+               (wall > 0) ? (100.0 * cpu / wall) : 0.0,
+               (unsigned long long) p_client->poll.spin_reads,
+               (unsigned long long) p_client->poll.epoll_reads);
+    }
+
+out:
+    close(socks[1]);
+    free(p_latency);
+    free(p_host);
+    free(p_client);
+    return ret;
+}
+
+static int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
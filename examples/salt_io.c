@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "salt_io.h"
 
 #include <unistd.h>
@@ -7,9 +8,42 @@
 #include <stdio.h>
 #include <sys/time.h>
 #include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
 #include "salti_util.h"
 
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY     60
+#endif
+
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY    0x4000000
+#endif
+
+#define SALT_IO_HANDOVER_ACK    (0x06U)
+
+#ifndef TCP_FASTOPEN
+#define TCP_FASTOPEN            23
+#endif
+
+#ifndef TCP_FASTOPEN_CONNECT
+#define TCP_FASTOPEN_CONNECT    30
+#endif
+
 static salt_ret_t get_time(salt_time_t *p_time, uint32_t *time);
+static void zc_release_completed(salt_io_zc_t *p_zc, uint32_t completed_seq);
+static void *worker_thread(void *p_arg);
+static uint64_t poll_now_ns(void);
+static salt_ret_t poll_try_read(salt_io_poll_t *p_poll, salt_msg_t *p_msg, uint32_t *p_index);
 
 salt_time_t my_time = {
     get_time,
@@ -67,6 +101,677 @@ salt_ret_t my_read(salt_io_channel_t *p_rchannel)
 
 }
 
+salt_ret_t my_write_nonblock(salt_io_channel_t *p_wchannel)
+{
+    int sock = *((int *) p_wchannel->p_context);
+    uint32_t to_write = p_wchannel->size_expected - p_wchannel->size;
+
+    if (sock <= 0) {
+        return SALT_ERROR;
+    }
+
+    ssize_t n = write(sock,
+                      &p_wchannel->p_data[p_wchannel->size],
+                      to_write);
+
+    /* EINPROGRESS: TCP Fast Open without a cookie, the SYN is sent without data. */
+    if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR) ||
+                    (errno == EINPROGRESS))) {
+        return SALT_PENDING;
+    }
+
+    if (n <= 0) {
+        p_wchannel->err_code = SALT_ERR_CONNECTION_CLOSED;
+        return SALT_ERROR;
+    }
+
+    p_wchannel->size += n;
+
+    return (p_wchannel->size == p_wchannel->size_expected) ? SALT_SUCCESS : SALT_PENDING;
+}
+
+salt_ret_t my_read_nonblock(salt_io_channel_t *p_rchannel)
+{
+    int sock = *((int *) p_rchannel->p_context);
+    uint32_t to_read = p_rchannel->size_expected - p_rchannel->size;
+
+    if (sock <= 0) {
+        return SALT_ERROR;
+    }
+
+    ssize_t n = read(sock,
+                     &p_rchannel->p_data[p_rchannel->size],
+                     to_read);
+
+    if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))) {
+        return SALT_PENDING;
+    }
+
+    if (n <= 0) {
+        p_rchannel->err_code = SALT_ERR_CONNECTION_CLOSED;
+        return SALT_ERROR;
+    }
+
+    p_rchannel->size += n;
+
+    return (p_rchannel->size == p_rchannel->size_expected) ? SALT_SUCCESS : SALT_PENDING;
+}
+
+salt_ret_t my_udp_write(salt_io_channel_t *p_wchannel)
+{
+    int sock = *((int *) p_wchannel->p_context);
+
+    if (sock <= 0) {
+        return SALT_ERROR;
+    }
+
+    ssize_t n = send(sock, p_wchannel->p_data, p_wchannel->size_expected, 0);
+
+    if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR) ||
+                    (errno == ENOBUFS))) {
+        return SALT_PENDING;
+    }
+
+    if (n != (ssize_t) p_wchannel->size_expected) {
+        p_wchannel->err_code = SALT_ERR_IO_WRITE;
+        return SALT_ERROR;
+    }
+
+    p_wchannel->size = n;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t my_udp_read(salt_io_channel_t *p_rchannel)
+{
+    int sock = *((int *) p_rchannel->p_context);
+
+    if (sock <= 0) {
+        return SALT_ERROR;
+    }
+
+    /* MSG_TRUNC returns the real size of a too large datagram, which is dropped. */
+    ssize_t n = recv(sock, p_rchannel->p_data, p_rchannel->size_expected, MSG_TRUNC);
+
+    if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR) ||
+                    (errno == ECONNREFUSED))) {
+        return SALT_PENDING;
+    }
+
+    if (n < 0) {
+        p_rchannel->err_code = SALT_ERR_CONNECTION_CLOSED;
+        return SALT_ERROR;
+    }
+
+    p_rchannel->size = n;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_io_zc_init(salt_io_zc_t *p_zc,
+                           int sock,
+                           uint32_t threshold,
+                           salt_io_release_cb release,
+                           void *p_owner)
+{
+    int one = 1;
+
+    if (p_zc == NULL) {
+        return SALT_ERROR;
+    }
+
+    memset(p_zc, 0x00, sizeof(salt_io_zc_t));
+    p_zc->sock = sock;
+
+    /*
+     * The handshake buffer is cleared when the handshake is done, therefore
+     * handshake messages must always be copied.
+     */
+    p_zc->threshold = (threshold > SALT_HNDSHK_BUFFER_SIZE) ? threshold : SALT_HNDSHK_BUFFER_SIZE + 1U;
+    p_zc->release = release;
+    p_zc->p_owner = p_owner;
+    p_zc->enabled = (setsockopt(sock, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0);
+
+    return (p_zc->enabled) ? SALT_SUCCESS : SALT_ERROR;
+}
+
+salt_ret_t my_write_zerocopy(salt_io_channel_t *p_wchannel)
+{
+    salt_io_zc_t *p_zc = (salt_io_zc_t *) p_wchannel->p_context;
+    uint32_t to_write = p_wchannel->size_expected - p_wchannel->size;
+    int flags = 0;
+
+    if ((p_zc == NULL) || (p_zc->sock <= 0)) {
+        return SALT_ERROR;
+    }
+
+    if (p_wchannel->size == 0) {
+        /*
+         * New record. Pinning pages and handling the completion costs more
+         * than copying small records.
+         */
+        p_zc->record_sends = 0;
+        p_zc->record_zc = p_zc->enabled &&
+            (p_wchannel->size_expected >= p_zc->threshold);
+
+        if (p_zc->record_zc &&
+            (salt_io_zc_poll(p_zc) >= SALT_IO_ZC_MAX_PENDING)) {
+            p_zc->record_zc = false;
+        }
+    }
+
+    if (p_zc->record_zc) {
+        flags = MSG_ZEROCOPY;
+    }
+
+    ssize_t n = send(p_zc->sock,
+                     &p_wchannel->p_data[p_wchannel->size],
+                     to_write,
+                     flags);
+
+    if ((n < 0) && (flags != 0) && (errno == ENOBUFS)) {
+        /* Locked memory limit reached, copy this part of the record. */
+        flags = 0;
+        n = send(p_zc->sock,
+                 &p_wchannel->p_data[p_wchannel->size],
+                 to_write,
+                 0);
+    }
+
+    if (n <= 0) {
+        p_wchannel->err_code = SALT_ERR_CONNECTION_CLOSED;
+        return SALT_ERROR;
+    }
+
+    if (flags != 0) {
+        p_zc->next_seq++;
+        p_zc->record_sends++;
+    }
+
+    p_wchannel->size += n;
+
+    if (p_wchannel->size != p_wchannel->size_expected) {
+        return SALT_PENDING;
+    }
+
+    /* Copied records, e.g. handshake messages, may be reused directly. */
+    if (p_zc->record_sends > 0) {
+        uint32_t i = (p_zc->pending_first + p_zc->pending_count) % SALT_IO_ZC_MAX_PENDING;
+        p_zc->pending[i].p_buffer = p_wchannel->p_data;
+        p_zc->pending[i].last_seq = p_zc->next_seq - 1U;
+        p_zc->pending_count++;
+    }
+
+    return SALT_SUCCESS;
+}
+
+uint32_t salt_io_zc_poll(salt_io_zc_t *p_zc)
+{
+    uint8_t control[128];
+    struct msghdr msg;
+    struct cmsghdr *cm;
+    struct sock_extended_err *serr;
+
+    while (p_zc->pending_count > 0) {
+
+        memset(&msg, 0x00, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(p_zc->sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            break;
+        }
+
+        for (cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+
+            if (!((cm->cmsg_level == IPPROTO_IP && cm->cmsg_type == IP_RECVERR) ||
+                  (cm->cmsg_level == IPPROTO_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+
+            serr = (struct sock_extended_err *) CMSG_DATA(cm);
+            if ((serr->ee_errno != 0) || (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)) {
+                continue;
+            }
+
+            /*
+             * The kernel had to copy the data anyway, e.g. loopback. Then
+             * zerocopy only adds overhead for this socket.
+             */
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                p_zc->enabled = false;
+            }
+
+            /* Completed range is [ee_info, ee_data]. TCP completes in order. */
+            zc_release_completed(p_zc, serr->ee_data);
+        }
+    }
+
+    return p_zc->pending_count;
+}
+
+salt_ret_t salt_io_zc_flush(salt_io_zc_t *p_zc, int timeout_ms)
+{
+    struct pollfd pfd;
+
+    while (salt_io_zc_poll(p_zc) > 0) {
+        /* POLLERR is set when the error queue is not empty. */
+        pfd.fd = p_zc->sock;
+        pfd.events = 0;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, timeout_ms) <= 0) {
+            return SALT_ERROR;
+        }
+    }
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_io_fastopen_listen(int sock, int queue_len)
+{
+    if (setsockopt(sock, IPPROTO_TCP, TCP_FASTOPEN, &queue_len, sizeof(queue_len)) < 0) {
+        return SALT_ERROR;
+    }
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_io_fastopen_connect(int sock)
+{
+    int one = 1;
+
+    /*
+     * Unlike sendto with MSG_FASTOPEN, connect and write are used as usual,
+     * so the salt write implementations need no change.
+     */
+    if (setsockopt(sock, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &one, sizeof(one)) < 0) {
+        return SALT_ERROR;
+    }
+
+    return SALT_SUCCESS;
+}
+
+uint8_t *salt_io_shm_create(const char *name, uint32_t size)
+{
+    void *p_segment;
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    if (ftruncate(fd, size) < 0) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    p_segment = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (MAP_FAILED == p_segment) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    return (uint8_t *) p_segment;
+}
+
+uint8_t *salt_io_shm_open(const char *name, uint32_t *p_size)
+{
+    struct stat st;
+    void *p_segment;
+    int fd = shm_open(name, O_RDWR, 0);
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    /* The name is not needed anymore, the segment is removed when unmapped. */
+    shm_unlink(name);
+
+    if ((fstat(fd, &st) < 0) || (st.st_size <= 0) || (st.st_size > UINT32_MAX)) {
+        close(fd);
+        return NULL;
+    }
+
+    p_segment = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (MAP_FAILED == p_segment) {
+        return NULL;
+    }
+
+    *p_size = (uint32_t) st.st_size;
+
+    return (uint8_t *) p_segment;
+}
+
+void salt_io_shm_wipe(uint8_t *p_segment, uint32_t size)
+{
+    if (NULL == p_segment) {
+        return;
+    }
+
+    /* The mapping is shared, this also wipes the segment of the old process. */
+    memset(p_segment, 0x00, size);
+}
+
+void salt_io_shm_close(uint8_t *p_segment, uint32_t size)
+{
+    if (NULL == p_segment) {
+        return;
+    }
+
+    munmap(p_segment, size);
+}
+
+salt_ret_t salt_io_send_fds(int unix_sock, const int *p_fds, uint32_t count)
+{
+    union {
+        struct cmsghdr  align;
+        uint8_t         buf[CMSG_SPACE(sizeof(int) * SALT_IO_HANDOVER_MAX_FDS)];
+    } control;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *p_cmsg;
+    uint8_t count_bytes[4];
+
+    if ((count == 0) || (count > SALT_IO_HANDOVER_MAX_FDS)) {
+        return SALT_ERROR;
+    }
+
+    /* At least one byte must be sent with the file descriptors. */
+    salti_u32_to_bytes(count_bytes, count);
+    iov.iov_base = count_bytes;
+    iov.iov_len = sizeof(count_bytes);
+
+    memset(&msg, 0x00, sizeof(msg));
+    memset(&control, 0x00, sizeof(control));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+    p_cmsg = CMSG_FIRSTHDR(&msg);
+    p_cmsg->cmsg_level = SOL_SOCKET;
+    p_cmsg->cmsg_type = SCM_RIGHTS;
+    p_cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+    memcpy(CMSG_DATA(p_cmsg), p_fds, sizeof(int) * count);
+
+    if (sendmsg(unix_sock, &msg, 0) != (ssize_t) sizeof(count_bytes)) {
+        return SALT_ERROR;
+    }
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_io_recv_fds(int unix_sock, int *p_fds, uint32_t max_count, uint32_t *p_count)
+{
+    union {
+        struct cmsghdr  align;
+        uint8_t         buf[CMSG_SPACE(sizeof(int) * SALT_IO_HANDOVER_MAX_FDS)];
+    } control;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *p_cmsg;
+    uint8_t count_bytes[4];
+    uint32_t count;
+
+    iov.iov_base = count_bytes;
+    iov.iov_len = sizeof(count_bytes);
+
+    memset(&msg, 0x00, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    if (recvmsg(unix_sock, &msg, MSG_WAITALL | MSG_CMSG_CLOEXEC) != (ssize_t) sizeof(count_bytes)) {
+        return SALT_ERROR;
+    }
+
+    p_cmsg = CMSG_FIRSTHDR(&msg);
+    if ((NULL == p_cmsg) ||
+        (p_cmsg->cmsg_level != SOL_SOCKET) ||
+        (p_cmsg->cmsg_type != SCM_RIGHTS) ||
+        (msg.msg_flags & MSG_CTRUNC)) {
+        return SALT_ERROR;
+    }
+
+    count = (p_cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    if ((count != salti_bytes_to_u32(count_bytes)) || (count > max_count)) {
+        /* Don't leak the received sockets. */
+        for (uint32_t i = 0; i < count; i++) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(p_cmsg) + (sizeof(int) * i), sizeof(int));
+            close(fd);
+        }
+        return SALT_ERROR;
+    }
+
+    memcpy(p_fds, CMSG_DATA(p_cmsg), sizeof(int) * count);
+    *p_count = count;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_io_handover_ack(int unix_sock)
+{
+    uint8_t ack = SALT_IO_HANDOVER_ACK;
+    ssize_t n;
+
+    do {
+        n = write(unix_sock, &ack, sizeof(ack));
+    } while ((n < 0) && (EINTR == errno));
+
+    return (n == (ssize_t) sizeof(ack)) ? SALT_SUCCESS : SALT_ERROR;
+}
+
+salt_ret_t salt_io_handover_wait(int unix_sock)
+{
+    uint8_t ack = 0x00U;
+    ssize_t n;
+
+    do {
+        n = read(unix_sock, &ack, sizeof(ack));
+    } while ((n < 0) && (EINTR == errno));
+
+    /* A closed socket means the new process did not take over. */
+    if ((n != (ssize_t) sizeof(ack)) || (SALT_IO_HANDOVER_ACK != ack)) {
+        return SALT_ERROR;
+    }
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_io_worker_start(salt_worker_t *p_worker,
+                                salt_worker_task_t task,
+                                void *p_arg)
+{
+    salt_io_worker_t *p_thread = (salt_io_worker_t *) p_worker->p_context;
+
+    p_thread->task = task;
+    p_thread->p_arg = p_arg;
+    p_thread->done = false;
+
+    if (pthread_mutex_init(&p_thread->lock, NULL) != 0) {
+        return SALT_ERROR;
+    }
+
+    if (pthread_create(&p_thread->thread, NULL, worker_thread, p_thread) != 0) {
+        pthread_mutex_destroy(&p_thread->lock);
+        return SALT_ERROR;
+    }
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_io_worker_poll(salt_worker_t *p_worker)
+{
+    salt_io_worker_t *p_thread = (salt_io_worker_t *) p_worker->p_context;
+    bool done;
+
+    pthread_mutex_lock(&p_thread->lock);
+    done = p_thread->done;
+    pthread_mutex_unlock(&p_thread->lock);
+
+    if (!done) {
+        return SALT_PENDING;
+    }
+
+    pthread_join(p_thread->thread, NULL);
+    pthread_mutex_destroy(&p_thread->lock);
+
+    return SALT_SUCCESS;
+}
+
+static void *worker_thread(void *p_arg)
+{
+    salt_io_worker_t *p_thread = (salt_io_worker_t *) p_arg;
+
+    p_thread->task(p_thread->p_arg);
+
+    pthread_mutex_lock(&p_thread->lock);
+    p_thread->done = true;
+    pthread_mutex_unlock(&p_thread->lock);
+
+    return NULL;
+}
+
+salt_ret_t salt_io_poll_init(salt_io_poll_t *p_poll,
+                             salt_io_poll_entry_t *p_entries,
+                             uint32_t count,
+                             uint32_t max_spin_us)
+{
+    struct epoll_event ev;
+
+    memset(p_poll, 0x00, sizeof(salt_io_poll_t));
+    p_poll->p_entries = p_entries;
+    p_poll->count = count;
+    p_poll->max_spin_ns = (uint64_t) max_spin_us * 1000U;
+    p_poll->spin_ns = p_poll->max_spin_ns;
+
+    p_poll->epoll_fd = epoll_create1(0);
+    if (p_poll->epoll_fd < 0) {
+        return SALT_ERROR;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        if (epoll_ctl(p_poll->epoll_fd, EPOLL_CTL_ADD, p_entries[i].sock, &ev) != 0) {
+            close(p_poll->epoll_fd);
+            p_poll->epoll_fd = -1;
+            return SALT_ERROR;
+        }
+    }
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_io_poll_read(salt_io_poll_t *p_poll,
+                             salt_msg_t *p_msg,
+                             uint32_t *p_index,
+                             int timeout_ms)
+{
+    struct epoll_event events[SALT_IO_POLL_MAX_EVENTS];
+    uint64_t start = poll_now_ns();
+    uint64_t sleep_start;
+    uint64_t deadline;
+    uint64_t waited;
+    uint64_t now;
+    salt_ret_t ret;
+    int wait_ms = timeout_ms;
+    int n;
+
+    /* Spin with non-blocking reads over all channels. */
+    do {
+        ret = poll_try_read(p_poll, p_msg, p_index);
+        if (SALT_PENDING != ret) {
+            if (SALT_SUCCESS == ret) {
+                p_poll->spin_reads++;
+                p_poll->spin_ns += (p_poll->spin_ns / 8U) + 1U;
+                if (p_poll->spin_ns > p_poll->max_spin_ns) {
+                    p_poll->spin_ns = p_poll->max_spin_ns;
+                }
+            }
+            return ret;
+        }
+    } while ((poll_now_ns() - start) < p_poll->spin_ns);
+
+    /* Idle, block until any socket is readable. */
+    sleep_start = poll_now_ns();
+    deadline = sleep_start + (uint64_t) timeout_ms * 1000000U;
+    for (;;) {
+        n = epoll_wait(p_poll->epoll_fd, events, SALT_IO_POLL_MAX_EVENTS, wait_ms);
+        if ((n < 0) && (EINTR != errno)) {
+            return SALT_ERROR;
+        }
+        if (0 == n) {
+            return SALT_PENDING;
+        }
+        if (n > 0) {
+            /* Start with a channel that is known to be readable. */
+            p_poll->next = events[0].data.u32;
+        }
+
+        ret = poll_try_read(p_poll, p_msg, p_index);
+        if (SALT_PENDING != ret) {
+            break;
+        }
+
+        /* Only a part of a record has arrived, wait for the rest in the time left. */
+        if (timeout_ms >= 0) {
+            now = poll_now_ns();
+            if (now >= deadline) {
+                return SALT_PENDING;
+            }
+            wait_ms = (int) ((deadline - now + 999999U) / 1000000U);
+        }
+    }
+
+    if (SALT_SUCCESS == ret) {
+        p_poll->epoll_reads++;
+        waited = poll_now_ns() - sleep_start;
+        if (waited <= p_poll->max_spin_ns) {
+            p_poll->spin_ns = (2U * waited > p_poll->max_spin_ns) ? p_poll->max_spin_ns : 2U * waited;
+        }
+        else {
+            p_poll->spin_ns /= 2U;
+        }
+    }
+
+    return ret;
+}
+
+void salt_io_poll_close(salt_io_poll_t *p_poll)
+{
+    if (p_poll->epoll_fd >= 0) {
+        close(p_poll->epoll_fd);
+        p_poll->epoll_fd = -1;
+    }
+}
+
+static void zc_release_completed(salt_io_zc_t *p_zc, uint32_t completed_seq)
+{
+    while (p_zc->pending_count > 0) {
+        salt_io_zc_pending_t *p_pending = &p_zc->pending[p_zc->pending_first];
+
+        /* Sequence numbers wraps, compare using signed difference. */
+        if ((int32_t) (p_pending->last_seq - completed_seq) > 0) {
+            break;
+        }
+
+        if (p_zc->release != NULL) {
+            p_zc->release(p_zc->p_owner, p_pending->p_buffer);
+        }
+
+        p_zc->pending_first = (p_zc->pending_first + 1U) % SALT_IO_ZC_MAX_PENDING;
+        p_zc->pending_count--;
+    }
+}
+
 static salt_ret_t get_time(salt_time_t *p_time, uint32_t *time)
 {
     (void) *p_time;
@@ -77,3 +782,30 @@ static salt_ret_t get_time(salt_time_t *p_time, uint32_t *time)
     *time = rel_time;
     return SALT_SUCCESS;
 }
+
+static uint64_t poll_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t) ts.tv_sec * 1000000000U) + (uint64_t) ts.tv_nsec;
+}
+
+/* One non-blocking read attempt on each channel, round robin. */
+static salt_ret_t poll_try_read(salt_io_poll_t *p_poll, salt_msg_t *p_msg, uint32_t *p_index)
+{
+    for (uint32_t i = 0; i < p_poll->count; i++) {
+        uint32_t index = (p_poll->next + i) % p_poll->count;
+        salt_io_poll_entry_t *p_entry = &p_poll->p_entries[index];
+        salt_ret_t ret = salt_read_begin(p_entry->p_channel,
+                                         p_entry->p_buffer,
+                                         p_entry->buffer_size,
+                                         p_msg);
+        if (SALT_PENDING != ret) {
+            p_poll->next = (index + 1U) % p_poll->count;
+            *p_index = index;
+            return ret;
+        }
+    }
+
+    return SALT_PENDING;
+}
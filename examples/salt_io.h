@@ -1,11 +1,423 @@
 #ifndef SALT_IO_H
 #define SALT_IO_H
 
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
 #include "salt.h"
 
+#define SALT_IO_ZC_MAX_PENDING          (16U)       /**< Maximum number of records waiting for completion. */
+#define SALT_IO_ZC_DEFAULT_THRESHOLD    (32768U)    /**< Records smaller than this are copied. */
+#define SALT_IO_HANDOVER_MAX_FDS        (64U)       /**< Maximum number of sockets in one handover message. */
+#define SALT_IO_POLL_MAX_EVENTS         (64U)       /**< Maximum number of events from one epoll_wait. */
+
+/**
+ * @brief Called when a record buffer is no longer used by the kernel.
+ *
+ * @param p_owner   Owner context given in \ref salt_io_zc_init.
+ * @param p_buffer  Pointer to the written record, i.e., p_msg->write.p_buffer
+ *                  after \ref salt_write_execute.
+ */
+typedef void (*salt_io_release_cb)(void *p_owner, uint8_t *p_buffer);
+
+typedef struct salt_io_zc_pending_s {
+    uint8_t     *p_buffer;                  /**< Record waiting for completion. */
+    uint32_t    last_seq;                   /**< Last zerocopy send sequence number of the record. */
+} salt_io_zc_pending_t;
+
+/**
+ * @brief Context for \ref my_write_zerocopy.
+ *
+ * Records of at least threshold bytes are sent using MSG_ZEROCOPY. The kernel
+ * reads the record from user memory after send() returns, so the record buffer
+ * must not be modified until the release callback is called. Completions are
+ * read from the socket error queue by \ref salt_io_zc_poll and \ref salt_io_zc_flush.
+ * Smaller records, or all records if the socket doesn't support zerocopy, are
+ * copied and the buffer may be reused as soon as \ref salt_write_execute returns
+ * SALT_SUCCESS. The release callback is only called for zerocopy records.
+ */
+typedef struct salt_io_zc_s {
+    int                     sock;           /**< Socket. */
+    bool                    enabled;        /**< Zerocopy supported by socket. */
+    uint32_t                threshold;      /**< Minimum record size for zerocopy. */
+    uint32_t                next_seq;       /**< Sequence number of next zerocopy send. */
+    bool                    record_zc;      /**< Current record is sent using zerocopy. */
+    uint32_t                record_sends;   /**< Number of zerocopy sends of current record. */
+    salt_io_zc_pending_t    pending[SALT_IO_ZC_MAX_PENDING];
+    uint32_t                pending_first;  /**< Index of oldest pending record. */
+    uint32_t                pending_count;  /**< Number of pending records. */
+    salt_io_release_cb      release;        /**< Release callback, may be NULL. */
+    void                    *p_owner;       /**< Context passed to release callback. */
+} salt_io_zc_t;
+
 salt_ret_t my_write(salt_io_channel_t *p_wchannel);
 salt_ret_t my_read(salt_io_channel_t *p_rchannel);
 
-salt_time_t my_time;
+/**
+ * @brief Write and read implementations for non-blocking sockets.
+ *
+ * Same as \ref my_write and \ref my_read but returns SALT_PENDING if the
+ * socket would block.
+ */
+salt_ret_t my_write_nonblock(salt_io_channel_t *p_wchannel);
+salt_ret_t my_read_nonblock(salt_io_channel_t *p_rchannel);
+
+/**
+ * @brief Datagram write and read implementations for connected UDP sockets.
+ *
+ * Used with \ref salt_dgram_init, the context is a pointer to the socket.
+ * Both returns SALT_PENDING if the socket would block.
+ */
+salt_ret_t my_udp_write(salt_io_channel_t *p_wchannel);
+salt_ret_t my_udp_read(salt_io_channel_t *p_rchannel);
+
+/**
+ * @brief Initiates zerocopy write context.
+ *
+ * Usage:
+ *      salt_io_zc_t zc;
+ *      salt_io_zc_init(&zc, sock, SALT_IO_ZC_DEFAULT_THRESHOLD, NULL, NULL);
+ *      salt_create(&channel, SALT_SERVER, my_write_zerocopy, my_read, &my_time);
+ *      salt_set_context(&channel, &zc, &sock);
+ *
+ * @param p_zc          Pointer to zerocopy context.
+ * @param sock          Connected TCP socket.
+ * @param threshold     Minimum record size to send with zerocopy, always
+ *                      larger than SALT_HNDSHK_BUFFER_SIZE.
+ * @param release       Called when a record buffer may be reused, may be NULL.
+ * @param p_owner       Context passed to release.
+ *
+ * @return SALT_SUCCESS Zerocopy is enabled on the socket.
+ * @return SALT_ERROR   Zerocopy is not supported, all records will be copied.
+ */
+salt_ret_t salt_io_zc_init(salt_io_zc_t *p_zc,
+                           int sock,
+                           uint32_t threshold,
+                           salt_io_release_cb release,
+                           void *p_owner);
+
+/**
+ * @brief Write implementation using MSG_ZEROCOPY for large records.
+ *
+ * The write context must be a pointer to a \ref salt_io_zc_t structure.
+ */
+salt_ret_t my_write_zerocopy(salt_io_channel_t *p_wchannel);
+
+/**
+ * @brief Reads completion notifications without blocking.
+ *
+ * @param p_zc  Pointer to zerocopy context.
+ *
+ * @return Number of records still waiting for completion.
+ */
+uint32_t salt_io_zc_poll(salt_io_zc_t *p_zc);
+
+/**
+ * @brief Waits until all records are released.
+ *
+ * @param p_zc          Pointer to zerocopy context.
+ * @param timeout_ms    Maximum time to wait, < 0 waits forever.
+ *
+ * @return SALT_SUCCESS All records were released.
+ * @return SALT_ERROR   Timeout or socket error.
+ */
+salt_ret_t salt_io_zc_flush(salt_io_zc_t *p_zc, int timeout_ms);
+
+/**
+ * @brief TCP Fast Open helpers.
+ *
+ * Without Fast Open, the client sends M1 after the TCP handshake, one round
+ * trip after connect. With Fast Open, a client that has a cookie from an
+ * earlier connection to the host sends M1 in the SYN, and the host reads it
+ * before the TCP handshake is completed. The first connection gets the cookie,
+ * and if the host or a middlebox doesn't support Fast Open, the kernel falls
+ * back to a normal TCP handshake. No change to the salt handshake is needed.
+ *
+ * On Linux, the host needs bit 2 and the client bit 1 in the sysctl
+ * net.ipv4.tcp_fastopen, e.g. "sysctl -w net.ipv4.tcp_fastopen=3" for both
+ * over loopback.
+ *
+ * Usage, host:
+ *      bind(listener, ...);
+ *      salt_io_fastopen_listen(listener, SALT_IO_FASTOPEN_QUEUE);
+ *      listen(listener, ...);
+ *
+ * Usage, client:
+ *      sock = socket(AF_INET, SOCK_STREAM, 0);
+ *      salt_io_fastopen_connect(sock);
+ *      connect(sock, ...);     Returns at once, M1 is sent in the SYN.
+ *
+ * A non-blocking client socket without a cookie returns EINPROGRESS on the
+ * first write, \ref my_write_nonblock then returns SALT_PENDING.
+ */
+#define SALT_IO_FASTOPEN_QUEUE          (256)       /**< Pending Fast Open requests on a listener. */
+
+/**
+ * @brief Enables TCP Fast Open on a listening socket.
+ *
+ * @param sock          TCP socket, before listen.
+ * @param queue_len     Maximum number of connections waiting for the TCP
+ *                      handshake with data received in the SYN.
+ *
+ * @return SALT_SUCCESS Fast Open is enabled.
+ * @return SALT_ERROR   Not supported, connections use a normal TCP handshake.
+ */
+salt_ret_t salt_io_fastopen_listen(int sock, int queue_len);
+
+/**
+ * @brief Sends the first write of a client socket in the SYN.
+ *
+ * @param sock          TCP socket, before connect.
+ *
+ * @return SALT_SUCCESS Fast Open is enabled.
+ * @return SALT_ERROR   Not supported, connect uses a normal TCP handshake.
+ */
+salt_ret_t salt_io_fastopen_connect(int sock);
+
+/**
+ * @brief Hot restart helpers.
+ *
+ * The old process exports each session with \ref salt_export_session into a
+ * shared memory segment, and sends the sockets to the new process over a
+ * UNIX domain socket using SCM_RIGHTS. The new process opens the segment,
+ * receives the sockets in the same order and imports the sessions with
+ * \ref salt_import_session. The segment contains session keys, it is created
+ * with mode 0600 and unlinked when opened.
+ *
+ * The new process wipes the segment once it has imported the sessions, and
+ * then acknowledges the handover. The old process only unmaps the segment
+ * after the acknowledgement. If the new process dies before it acknowledged,
+ * none of the sessions have been used, and the old process may import them
+ * again from its own mapping to resume them. This fails for the sessions that
+ * were already wiped.
+ *
+ * Usage, old process:
+ *      p_segment = salt_io_shm_create("/host_echo", size);
+ *      for each session: salt_export_session(&channel[i], &p_segment[offset], ...);
+ *      salt_io_send_fds(unix_sock, socks, count);
+ *      if (salt_io_handover_wait(unix_sock) != SALT_SUCCESS) {
+ *          for each session: salt_create, salt_set_context and salt_import_session.
+ *          salt_io_shm_wipe(p_segment, size);
+ *      }
+ *      salt_io_shm_close(p_segment, size);
+ *
+ * Usage, new process:
+ *      p_segment = salt_io_shm_open("/host_echo", &size);
+ *      salt_io_recv_fds(unix_sock, socks, SALT_IO_HANDOVER_MAX_FDS, &count);
+ *      for each socket: salt_create, salt_set_context and salt_import_session.
+ *      salt_io_shm_wipe(p_segment, size);
+ *      salt_io_shm_close(p_segment, size);
+ *      salt_io_handover_ack(unix_sock);
+ *      Only now use the sessions.
+ */
+
+/**
+ * @brief Creates and maps a new shared memory segment.
+ *
+ * @param name      Name of segment, see shm_open.
+ * @param size      Size of segment.
+ *
+ * @return Pointer to the mapped segment, NULL if the segment already existed
+ *         or could not be created.
+ */
+uint8_t *salt_io_shm_create(const char *name, uint32_t size);
+
+/**
+ * @brief Maps and unlinks an existing shared memory segment.
+ *
+ * @param name      Name of segment.
+ * @param p_size    Size of segment is returned here.
+ *
+ * @return Pointer to the mapped segment, NULL if it could not be opened.
+ */
+uint8_t *salt_io_shm_open(const char *name, uint32_t *p_size);
+
+/**
+ * @brief Wipes a shared memory segment.
+ *
+ * The segment is shared, the mapping of the other process is wiped too.
+ *
+ * @param p_segment Pointer to mapped segment.
+ * @param size      Size of segment.
+ */
+void salt_io_shm_wipe(uint8_t *p_segment, uint32_t size);
+
+/**
+ * @brief Unmaps a shared memory segment without wiping it.
+ *
+ * @param p_segment Pointer to mapped segment.
+ * @param size      Size of segment.
+ */
+void salt_io_shm_close(uint8_t *p_segment, uint32_t size);
+
+/**
+ * @brief Sends file descriptors over a connected UNIX domain socket.
+ *
+ * @param unix_sock Connected UNIX domain socket.
+ * @param p_fds     File descriptors to send.
+ * @param count     Number of file descriptors, at most SALT_IO_HANDOVER_MAX_FDS.
+ *
+ * @return SALT_SUCCESS The file descriptors were sent.
+ * @return SALT_ERROR   Too many file descriptors or sendmsg failed.
+ */
+salt_ret_t salt_io_send_fds(int unix_sock, const int *p_fds, uint32_t count);
+
+/**
+ * @brief Receives file descriptors sent by \ref salt_io_send_fds.
+ *
+ * @param unix_sock Connected UNIX domain socket.
+ * @param p_fds     Received file descriptors are returned here.
+ * @param max_count Size of p_fds.
+ * @param p_count   Number of received file descriptors is returned here.
+ *
+ * @return SALT_SUCCESS The file descriptors were received.
+ * @return SALT_ERROR   recvmsg failed or the message was invalid.
+ */
+salt_ret_t salt_io_recv_fds(int unix_sock, int *p_fds, uint32_t max_count, uint32_t *p_count);
+
+/**
+ * @brief Acknowledges the handover to the old process.
+ *
+ * Called by the new process when it has imported and wiped all sessions.
+ *
+ * @param unix_sock Connected UNIX domain socket.
+ *
+ * @return SALT_SUCCESS The acknowledgement was sent.
+ * @return SALT_ERROR   write failed.
+ */
+salt_ret_t salt_io_handover_ack(int unix_sock);
+
+/**
+ * @brief Waits for the acknowledgement sent by \ref salt_io_handover_ack.
+ *
+ * @param unix_sock Connected UNIX domain socket.
+ *
+ * @return SALT_SUCCESS The new process took over the sessions.
+ * @return SALT_ERROR   The socket was closed or read failed, the sessions
+ *                      were not used by the new process.
+ */
+salt_ret_t salt_io_handover_wait(int unix_sock);
+
+/**
+ * @brief Handshake worker using one POSIX thread per task.
+ *
+ * Usage:
+ *      salt_io_worker_t thread;
+ *      salt_worker_t worker;
+ *      salt_worker_init(&channel, &worker, salt_io_worker_start,
+ *                       salt_io_worker_poll, &thread);
+ */
+typedef struct salt_io_worker_s {
+    pthread_t           thread;
+    pthread_mutex_t     lock;
+    salt_worker_task_t  task;
+    void                *p_arg;
+    bool                done;
+} salt_io_worker_t;
+
+/**
+ * @brief Starts a task on a new thread, see \ref salt_worker_start_t.
+ *
+ * The worker context must be a pointer to a \ref salt_io_worker_t structure.
+ */
+salt_ret_t salt_io_worker_start(salt_worker_t *p_worker,
+                                salt_worker_task_t task,
+                                void *p_arg);
+
+/**
+ * @brief Joins the thread if the task is done, see \ref salt_worker_poll_t.
+ */
+salt_ret_t salt_io_worker_poll(salt_worker_t *p_worker);
+
+/**
+ * @brief Channel read by \ref salt_io_poll_read.
+ */
+typedef struct salt_io_poll_entry_s {
+    salt_channel_t  *p_channel;                 /**< Channel using my_read_nonblock. */
+    int             sock;                       /**< Non-blocking socket of channel. */
+    uint8_t         *p_buffer;                  /**< Read buffer of channel. */
+    uint32_t        buffer_size;                /**< Size of read buffer. */
+} salt_io_poll_entry_t;
+
+/**
+ * @brief Hybrid busy poll and epoll read loop.
+ *
+ * Blocking in epoll_wait adds a wakeup of some microseconds to each received
+ * record, while spinning on SALT_PENDING burns a core also when the channels
+ * are idle. \ref salt_io_poll_read first spins with non-blocking reads over
+ * all channels for at most spin_ns, and then blocks in epoll_wait.
+ *
+ * The spin budget adapts to the traffic, bounded by max_spin_ns:
+ *  - A record is read while spinning: the budget grows by 1/8, spinning pays off.
+ *  - A record arrives within max_spin_ns after epoll_wait was entered: the budget
+ *    is set to twice the wait, a slightly longer spin would have caught it.
+ *  - Otherwise the channels are idle and the budget is halved.
+ *
+ * A budget of 0 always blocks in epoll_wait.
+ */
+typedef struct salt_io_poll_s {
+    salt_io_poll_entry_t    *p_entries;         /**< Channels to read. */
+    uint32_t                count;              /**< Number of channels. */
+    uint32_t                next;               /**< Channel to try first, for fairness. */
+    int                     epoll_fd;           /**< epoll instance with all sockets. */
+    uint64_t                max_spin_ns;        /**< Upper bound of the spin budget. */
+    uint64_t                spin_ns;            /**< Current spin budget. */
+    uint64_t                spin_reads;         /**< Records read while spinning. */
+    uint64_t                epoll_reads;        /**< Records read after epoll_wait. */
+} salt_io_poll_t;
+
+/**
+ * @brief Initiates a hybrid poll loop.
+ *
+ * Usage:
+ *      salt_io_poll_entry_t entries[2] = {
+ *          { &channel[0], sock[0], rx_buffer[0], sizeof(rx_buffer[0]) },
+ *          { &channel[1], sock[1], rx_buffer[1], sizeof(rx_buffer[1]) }
+ *      };
+ *      salt_io_poll_init(&poll, entries, 2, 50);
+ *      while (salt_io_poll_read(&poll, &msg, &index, -1) == SALT_SUCCESS) {
+ *          ... handle msg from entries[index].p_channel ...
+ *      }
+ *      salt_io_poll_close(&poll);
+ *
+ * @param p_poll        Pointer to poll structure.
+ * @param p_entries     Channels, established and using non-blocking I/O.
+ * @param count         Number of channels.
+ * @param max_spin_us   Upper bound of the spin budget in microseconds.
+ *
+ * @return SALT_SUCCESS The poll loop was initiated.
+ * @return SALT_ERROR   The epoll instance could not be created.
+ */
+salt_ret_t salt_io_poll_init(salt_io_poll_t *p_poll,
+                             salt_io_poll_entry_t *p_entries,
+                             uint32_t count,
+                             uint32_t max_spin_us);
+
+/**
+ * @brief Reads the next record from any channel.
+ *
+ * @param p_poll        Pointer to poll structure.
+ * @param p_msg         Message structure, see \ref salt_read_begin.
+ * @param p_index       Index of the channel the record was read from, also
+ *                      set on error.
+ * @param timeout_ms    Longest time to block in total, also when only parts
+ *                      of a record arrive, -1 blocks until a record is read.
+ *
+ * @return SALT_SUCCESS A record was read.
+ * @return SALT_PENDING The timeout expired.
+ * @return SALT_ERROR   A channel failed, or epoll_wait failed.
+ */
+salt_ret_t salt_io_poll_read(salt_io_poll_t *p_poll,
+                             salt_msg_t *p_msg,
+                             uint32_t *p_index,
+                             int timeout_ms);
+
+/**
+ * @brief Closes the epoll instance. The sockets are not closed.
+ */
+void salt_io_poll_close(salt_io_poll_t *p_poll);
+
+extern salt_time_t my_time;
 
 #endif /* SALT_IO_H */
@@ -0,0 +1,710 @@
+/**
+ * @file salt_proxy.c
+ *
+ * Salt channel terminating reverse proxy.
+ *
+ * Accepts salt channel sessions and forwards the decrypted application
+ * messages to a local TCP or Unix socket backend. Data from the backend is
+ * encrypted and sent back to the salt channel client. The backend sees a
+ * plain byte stream, application message boundaries are not preserved.
+ *
+ * Each worker thread is pinned to one core and runs its own epoll loop with
+ * a listening socket bound using SO_REUSEPORT. All sessions of a worker are
+ * taken from a fixed pool allocated at start, so no buffers are allocated
+ * per connection. Plain text is never copied within the proxy:
+ *      - Decrypted messages are written to the backend directly from the
+ *        receive buffer.
+ *      - Backend data is read directly into the payload area of the next
+ *        record and encrypted in place.
+ * splice() can not be used since the plain text must pass the encryption in
+ * user space in both directions.
+ *
+ * Usage:
+ *      salt_proxy [-p port] [-w workers] [-n sessions] [-k keyfile] backend
+ *
+ *      backend     host:port or unix:/path/to/socket
+ *      -p port     Port to listen on, default 2033.
+ *      -w workers  Number of worker threads, default 1.
+ *      -n sessions Maximum number of sessions per worker, default 256.
+ *      -k keyfile  File with the 64 bytes secret signature key of the host.
+ *                  If not given, a new key is generated.
+ */
+
+/*======= Includes ============================================================*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "salt.h"
+#include "salt_io.h"
+
+/*======= Local Macro Definitions =============================================*/
+
+#define PROXY_DEFAULT_PORT          (2033U)
+#define PROXY_DEFAULT_SESSIONS      (256U)
+#define PROXY_BUFFER_SIZE           (65536U + SALT_WRITE_OVERHEAD_SIZE)
+#define PROXY_MIN_RECORD_SIZE       (1400U)
+#define PROXY_IDLE_THRESHOLD        (1000U)
+#define PROXY_MAX_EVENTS            (64U)
+#define PROXY_MAX_BATCH             (16U)       /**< Records processed per session and wakeup. */
+#define PROXY_LISTENER              (UINT64_MAX)
+
+/* epoll user data, session index and which side of the session */
+#define PROXY_EVENT_DATA(index, side)   (((uint64_t) (index) << 1U) | (side))
+#define PROXY_SIDE_CLIENT           (0U)
+#define PROXY_SIDE_BACKEND          (1U)
+
+/*======= Type Definitions ====================================================*/
+
+typedef enum proxy_state_e {
+    PROXY_FREE,
+    PROXY_HANDSHAKE,
+    PROXY_CONNECTING,
+    PROXY_ESTABLISHED
+} proxy_state_t;
+
+typedef struct proxy_session_s {
+    proxy_state_t           state;
+    uint32_t                index;
+    int                     client_fd;
+    int                     backend_fd;
+    uint32_t                client_events;      /**< Registered epoll events, client socket. */
+    uint32_t                backend_events;     /**< Registered epoll events, backend socket. */
+    bool                    client_registered;
+    bool                    backend_registered;
+    salt_channel_t          channel;
+    salt_record_size_t      record_size;
+    uint8_t                 hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
+
+    /* Client to backend */
+    uint8_t                 rx_buffer[PROXY_BUFFER_SIZE];
+    salt_msg_t              rx_msg;
+    bool                    rx_pending;         /**< Decrypted data not yet written to backend. */
+    uint32_t                rx_offset;          /**< Bytes of current message written to backend. */
+
+    /* Backend to client */
+    uint8_t                 tx_buffer[PROXY_BUFFER_SIZE];
+    salt_msg_t              tx_msg;
+    bool                    tx_pending;         /**< Record not yet written to client. */
+
+    struct proxy_session_s  *p_next_free;
+} proxy_session_t;
+
+typedef struct proxy_worker_s {
+    uint32_t                id;
+    int                     epoll_fd;
+    int                     listen_fd;
+    proxy_session_t         *sessions;
+    proxy_session_t         *p_free;
+    pthread_t               thread;
+} proxy_worker_t;
+
+typedef struct proxy_config_s {
+    uint16_t                port;
+    uint32_t                workers;
+    uint32_t                sessions;
+    struct sockaddr_storage backend;
+    socklen_t               backend_len;
+    uint8_t                 host_sk_sec[api_crypto_sign_SECRETKEYBYTES];
+} proxy_config_t;
+
+/*======= Local variable declarations =========================================*/
+
+static proxy_config_t config;
+
+/*======= Local function prototypes ===========================================*/
+
+static int parse_backend(const char *p_backend);
+static int load_signature(const char *p_keyfile);
+static int create_listener(uint16_t port);
+static void *worker_loop(void *context);
+static void accept_clients(proxy_worker_t *p_worker);
+static void session_process(proxy_worker_t *p_worker, proxy_session_t *p_session);
+static bool session_handshake(proxy_session_t *p_session);
+static bool session_connect(proxy_session_t *p_session);
+static bool session_connected(proxy_session_t *p_session);
+static bool session_client_to_backend(proxy_session_t *p_session);
+static bool session_backend_to_client(proxy_session_t *p_session);
+static void session_update_events(proxy_worker_t *p_worker, proxy_session_t *p_session);
+static void session_close(proxy_worker_t *p_worker, proxy_session_t *p_session);
+static void update_events(proxy_worker_t *p_worker, int fd, bool *p_registered,
+                          uint32_t *p_current, uint32_t wanted, uint64_t data);
+
+/*======= Global function implementations =====================================*/
+
+int main(int argc, char *argv[])
+{
+    int opt;
+    const char *p_keyfile = NULL;
+    proxy_worker_t *workers;
+
+    setbuf(stdout, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    config.port = PROXY_DEFAULT_PORT;
+    config.workers = 1;
+    config.sessions = PROXY_DEFAULT_SESSIONS;
+
+    while ((opt = getopt(argc, argv, "p:w:n:k:")) != -1) {
+        switch (opt) {
+            case 'p':
+                config.port = (uint16_t) strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                config.workers = (uint32_t) strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                config.sessions = (uint32_t) strtoul(optarg, NULL, 0);
+                break;
+            case 'k':
+                p_keyfile = optarg;
+                break;
+            default:
+                printf("Usage: %s [-p port] [-w workers] [-n sessions] [-k keyfile] backend\r\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if ((optind >= argc) || (config.workers == 0) || (config.sessions == 0)) {
+        printf("Usage: %s [-p port] [-w workers] [-n sessions] [-k keyfile] backend\r\n", argv[0]);
+        return 1;
+    }
+
+    if (parse_backend(argv[optind]) != 0) {
+        printf("Invalid backend: %s\r\n", argv[optind]);
+        return 1;
+    }
+
+    if (load_signature(p_keyfile) != 0) {
+        return 1;
+    }
+
+    printf("Host public signature key: ");
+    for (uint32_t i = 32; i < sizeof(config.host_sk_sec); i++) {
+        printf("%02x", config.host_sk_sec[i]);
+    }
+    printf("\r\n");
+
+    workers = calloc(config.workers, sizeof(proxy_worker_t));
+    if (workers == NULL) {
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < config.workers; i++) {
+        workers[i].id = i;
+        if (pthread_create(&workers[i].thread, NULL, worker_loop, &workers[i]) != 0) {
+            printf("Could not create worker %u.\r\n", i);
+            return 1;
+        }
+    }
+
+    printf("Proxying port %u with %u worker(s).\r\n", config.port, config.workers);
+
+    for (uint32_t i = 0; i < config.workers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    free(workers);
+
+    return 0;
+}
+
+/*======= Local function implementations ======================================*/
+
+static int parse_backend(const char *p_backend)
+{
+    if (strncmp(p_backend, "unix:", 5) == 0) {
+        struct sockaddr_un *p_addr = (struct sockaddr_un *) &config.backend;
+        if (strlen(&p_backend[5]) >= sizeof(p_addr->sun_path)) {
+            return -1;
+        }
+        p_addr->sun_family = AF_UNIX;
+        strcpy(p_addr->sun_path, &p_backend[5]);
+        config.backend_len = sizeof(struct sockaddr_un);
+        return 0;
+    }
+
+    char host[256];
+    const char *p_port = strrchr(p_backend, ':');
+    struct addrinfo hints;
+    struct addrinfo *p_res;
+
+    if ((p_port == NULL) || ((size_t) (p_port - p_backend) >= sizeof(host))) {
+        return -1;
+    }
+
+    memcpy(host, p_backend, p_port - p_backend);
+    host[p_port - p_backend] = '\0';
+
+    memset(&hints, 0x00, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(host, &p_port[1], &hints, &p_res) != 0) {
+        return -1;
+    }
+
+    memcpy(&config.backend, p_res->ai_addr, p_res->ai_addrlen);
+    config.backend_len = p_res->ai_addrlen;
+    freeaddrinfo(p_res);
+
+    return 0;
+}
+
+static int load_signature(const char *p_keyfile)
+{
+    if (p_keyfile == NULL) {
+        uint8_t pub[api_crypto_sign_PUBLICKEYBYTES];
+        return api_crypto_sign_keypair(pub, config.host_sk_sec);
+    }
+
+    FILE *f = fopen(p_keyfile, "rb");
+    if (f == NULL) {
+        printf("Could not open %s.\r\n", p_keyfile);
+        return -1;
+    }
+
+    size_t n = fread(config.host_sk_sec, 1, sizeof(config.host_sk_sec), f);
+    fclose(f);
+
+    if (n != sizeof(config.host_sk_sec)) {
+        printf("Key file must contain %u bytes.\r\n", (uint32_t) sizeof(config.host_sk_sec));
+        return -1;
+    }
+
+    return 0;
+}
+
+static int create_listener(uint16_t port)
+{
+    struct sockaddr_in server;
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    /* Every worker has its own listener, the kernel balances connections. */
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    memset(&server, 0x00, sizeof(server));
+    server.sin_family = AF_INET;
+    server.sin_addr.s_addr = INADDR_ANY;
+    server.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr *) &server, sizeof(server)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    /* Optional, M1 may then arrive in the SYN. */
+    (void) salt_io_fastopen_listen(fd, SALT_IO_FASTOPEN_QUEUE);
+
+    if (listen(fd, 128) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void *worker_loop(void *context)
+{
+    proxy_worker_t *p_worker = (proxy_worker_t *) context;
+    struct epoll_event events[PROXY_MAX_EVENTS];
+    struct epoll_event ev;
+    cpu_set_t cpus;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    /* Keep the crypto work of this worker on one core. */
+    if (ncpu > 0) {
+        CPU_ZERO(&cpus);
+        CPU_SET(p_worker->id % ncpu, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+
+    p_worker->sessions = calloc(config.sessions, sizeof(proxy_session_t));
+    p_worker->listen_fd = create_listener(config.port);
+    p_worker->epoll_fd = epoll_create1(0);
+
+    if ((p_worker->sessions == NULL) ||
+        (p_worker->listen_fd < 0) ||
+        (p_worker->epoll_fd < 0)) {
+        printf("Worker %u could not start.\r\n", p_worker->id);
+        return NULL;
+    }
+
+    p_worker->p_free = NULL;
+    for (uint32_t i = config.sessions; i > 0; i--) {
+        proxy_session_t *p_session = &p_worker->sessions[i - 1];
+        p_session->index = i - 1;
+        p_session->state = PROXY_FREE;
+        p_session->p_next_free = p_worker->p_free;
+        p_worker->p_free = p_session;
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.u64 = PROXY_LISTENER;
+    epoll_ctl(p_worker->epoll_fd, EPOLL_CTL_ADD, p_worker->listen_fd, &ev);
+
+    while (1) {
+
+        int n = epoll_wait(p_worker->epoll_fd, events, PROXY_MAX_EVENTS, -1);
+
+        for (int i = 0; i < n; i++) {
+
+            if (events[i].data.u64 == PROXY_LISTENER) {
+                accept_clients(p_worker);
+                continue;
+            }
+
+            proxy_session_t *p_session = &p_worker->sessions[events[i].data.u64 >> 1U];
+
+            if (p_session->state == PROXY_FREE) {
+                /* Closed by an earlier event in this batch. */
+                continue;
+            }
+
+            session_process(p_worker, p_session);
+
+            if ((p_session->state != PROXY_FREE) &&
+                ((events[i].events & EPOLLERR) ||
+                 ((events[i].events & EPOLLHUP) && !(events[i].events & EPOLLIN)))) {
+                session_close(p_worker, p_session);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void accept_clients(proxy_worker_t *p_worker)
+{
+    int one = 1;
+
+    while (1) {
+
+        int fd = accept4(p_worker->listen_fd, NULL, NULL, SOCK_NONBLOCK);
+
+        if (fd < 0) {
+            return;
+        }
+
+        proxy_session_t *p_session = p_worker->p_free;
+
+        if (p_session == NULL) {
+            /* Session pool exhausted. */
+            close(fd);
+            continue;
+        }
+
+        p_worker->p_free = p_session->p_next_free;
+
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        p_session->client_fd = fd;
+        p_session->backend_fd = -1;
+        p_session->client_events = 0;
+        p_session->backend_events = 0;
+        p_session->client_registered = false;
+        p_session->backend_registered = false;
+        p_session->rx_pending = false;
+        p_session->tx_pending = false;
+        p_session->state = PROXY_HANDSHAKE;
+
+        if ((salt_create(&p_session->channel, SALT_SERVER,
+                         my_write_nonblock, my_read_nonblock, &my_time) != SALT_SUCCESS) ||
+            (salt_set_signature(&p_session->channel, config.host_sk_sec) != SALT_SUCCESS) ||
+            (salt_init_session(&p_session->channel, p_session->hndsk_buffer,
+                               sizeof(p_session->hndsk_buffer)) != SALT_SUCCESS) ||
+            (salt_set_context(&p_session->channel, &p_session->client_fd,
+                              &p_session->client_fd) != SALT_SUCCESS) ||
+            (salt_record_size_init(&p_session->channel, &p_session->record_size,
+                                   PROXY_MIN_RECORD_SIZE, sizeof(p_session->tx_buffer),
+                                   PROXY_IDLE_THRESHOLD) != SALT_SUCCESS)) {
+            session_close(p_worker, p_session);
+            continue;
+        }
+
+        session_update_events(p_worker, p_session);
+    }
+}
+
+static void session_process(proxy_worker_t *p_worker, proxy_session_t *p_session)
+{
+    bool ok = true;
+
+    switch (p_session->state) {
+        case PROXY_HANDSHAKE:
+            ok = session_handshake(p_session);
+            if (ok && (p_session->state == PROXY_CONNECTING)) {
+                ok = session_connect(p_session);
+            }
+            break;
+        case PROXY_CONNECTING:
+            ok = session_connected(p_session);
+            break;
+        default:
+            break;
+    }
+
+    if (ok && (p_session->state == PROXY_ESTABLISHED)) {
+        ok = session_client_to_backend(p_session) &&
+             session_backend_to_client(p_session);
+    }
+
+    if (!ok) {
+        session_close(p_worker, p_session);
+        return;
+    }
+
+    session_update_events(p_worker, p_session);
+}
+
+static bool session_handshake(proxy_session_t *p_session)
+{
+    salt_ret_t ret = salt_handshake(&p_session->channel, NULL);
+
+    if (ret == SALT_ERROR) {
+        return false;
+    }
+
+    if (ret == SALT_SUCCESS) {
+        p_session->state = PROXY_CONNECTING;
+    }
+
+    return true;
+}
+
+static bool session_connect(proxy_session_t *p_session)
+{
+    int fd = socket(config.backend.ss_family, SOCK_STREAM | SOCK_NONBLOCK, 0);
+
+    if (fd < 0) {
+        return false;
+    }
+
+    p_session->backend_fd = fd;
+
+    if (connect(fd, (struct sockaddr *) &config.backend, config.backend_len) == 0) {
+        p_session->state = PROXY_ESTABLISHED;
+        return true;
+    }
+
+    /* Connection is completed when the backend socket is writable. */
+    return (errno == EINPROGRESS);
+}
+
+static bool session_connected(proxy_session_t *p_session)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+
+    if (getsockopt(p_session->backend_fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0) {
+        return false;
+    }
+
+    if (err == EINPROGRESS) {
+        return true;
+    }
+
+    if (err != 0) {
+        return false;
+    }
+
+    p_session->state = PROXY_ESTABLISHED;
+
+    return true;
+}
+
+static bool session_client_to_backend(proxy_session_t *p_session)
+{
+    salt_msg_t *p_msg = &p_session->rx_msg;
+
+    for (uint32_t i = 0; i < PROXY_MAX_BATCH; i++) {
+
+        if (!p_session->rx_pending) {
+            salt_ret_t ret = salt_read_begin(&p_session->channel,
+                                             p_session->rx_buffer,
+                                             sizeof(p_session->rx_buffer),
+                                             p_msg);
+            if (ret == SALT_PENDING) {
+                return true;
+            }
+
+            if (ret == SALT_ERROR) {
+                return false;
+            }
+
+            p_session->rx_pending = true;
+            p_session->rx_offset = 0;
+        }
+
+        /* Write the decrypted messages directly from the receive buffer. */
+        do {
+            while (p_session->rx_offset < p_msg->read.message_size) {
+                ssize_t n = write(p_session->backend_fd,
+                                  &p_msg->read.p_payload[p_session->rx_offset],
+                                  p_msg->read.message_size - p_session->rx_offset);
+                if ((n < 0) && ((errno == EAGAIN) || (errno == EINTR))) {
+                    /* Backend is slow, stop reading from client. */
+                    return true;
+                }
+                if (n <= 0) {
+                    return false;
+                }
+                p_session->rx_offset += n;
+            }
+            p_session->rx_offset = 0;
+        } while (salt_read_next(p_msg) == SALT_SUCCESS);
+
+        p_session->rx_pending = false;
+    }
+
+    return true;
+}
+
+static bool session_backend_to_client(proxy_session_t *p_session)
+{
+    salt_msg_t *p_msg = &p_session->tx_msg;
+
+    for (uint32_t i = 0; i < PROXY_MAX_BATCH; i++) {
+
+        if (!p_session->tx_pending) {
+
+            uint32_t size = salt_record_size_next(&p_session->channel,
+                                                  sizeof(p_session->tx_buffer));
+            salt_write_begin(p_session->tx_buffer, size, p_msg);
+
+            /* Read the backend data directly into the record payload. */
+            ssize_t n = read(p_session->backend_fd,
+                             p_msg->write.p_payload,
+                             p_msg->write.buffer_available - 2U);
+
+            if ((n < 0) && ((errno == EAGAIN) || (errno == EINTR))) {
+                return true;
+            }
+
+            if (n <= 0) {
+                /* Backend closed the connection. */
+                return false;
+            }
+
+            salt_write_commit(p_msg, (uint32_t) n);
+            p_session->tx_pending = true;
+        }
+
+        salt_ret_t ret = salt_write_execute(&p_session->channel, p_msg, false);
+
+        if (ret == SALT_PENDING) {
+            /* Client is slow, stop reading from backend. */
+            return true;
+        }
+
+        if (ret == SALT_ERROR) {
+            return false;
+        }
+
+        p_session->tx_pending = false;
+    }
+
+    return true;
+}
+
+static void session_update_events(proxy_worker_t *p_worker, proxy_session_t *p_session)
+{
+    uint32_t client = 0;
+    uint32_t backend = 0;
+
+    switch (p_session->state) {
+        case PROXY_HANDSHAKE:
+            client = (p_session->channel.write_channel.state == SALT_IO_PENDING) ?
+                EPOLLOUT : EPOLLIN;
+            break;
+        case PROXY_CONNECTING:
+            backend = EPOLLOUT;
+            break;
+        case PROXY_ESTABLISHED:
+            /*
+             * Only read from one side if the other side can take the data,
+             * this way the receiving peer controls the rate.
+             */
+            client = (p_session->rx_pending ? 0 : EPOLLIN) |
+                     (p_session->tx_pending ? EPOLLOUT : 0);
+            backend = (p_session->tx_pending ? 0 : EPOLLIN) |
+                      (p_session->rx_pending ? EPOLLOUT : 0);
+            break;
+        default:
+            return;
+    }
+
+    update_events(p_worker, p_session->client_fd, &p_session->client_registered,
+                  &p_session->client_events, client,
+                  PROXY_EVENT_DATA(p_session->index, PROXY_SIDE_CLIENT));
+
+    if (p_session->backend_fd >= 0) {
+        update_events(p_worker, p_session->backend_fd, &p_session->backend_registered,
+                      &p_session->backend_events, backend,
+                      PROXY_EVENT_DATA(p_session->index, PROXY_SIDE_BACKEND));
+    }
+}
+
+static void update_events(proxy_worker_t *p_worker, int fd, bool *p_registered,
+                          uint32_t *p_current, uint32_t wanted, uint64_t data)
+{
+    struct epoll_event ev;
+
+    if (*p_registered && (*p_current == wanted)) {
+        return;
+    }
+
+    ev.events = wanted;
+    ev.data.u64 = data;
+
+    if (epoll_ctl(p_worker->epoll_fd,
+                  (*p_registered) ? EPOLL_CTL_MOD : EPOLL_CTL_ADD,
+                  fd, &ev) == 0) {
+        *p_registered = true;
+        *p_current = wanted;
+    }
+}
+
+static void session_close(proxy_worker_t *p_worker, proxy_session_t *p_session)
+{
+    if (p_session->client_fd >= 0) {
+        close(p_session->client_fd);
+    }
+
+    if (p_session->backend_fd >= 0) {
+        close(p_session->backend_fd);
+    }
+
+    /* Do not leave session keys in the pool. */
+    memset(&p_session->channel, 0x00, sizeof(p_session->channel));
+
+    p_session->client_fd = -1;
+    p_session->backend_fd = -1;
+    p_session->state = PROXY_FREE;
+    p_session->p_next_free = p_worker->p_free;
+    p_worker->p_free = p_session;
+}
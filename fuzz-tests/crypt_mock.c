@@ -135,6 +135,29 @@ int api_crypto_box_afternm(uint8_t *cipher,
     (void) symmetric_key;
     return 0;
 }
+/**
+ * @brief Encrypts and authenticates a message given in two parts.
+ *
+ * See salt_crypto_wrapper.h.
+ */
+int api_crypto_box_afternm_parts(uint8_t *cipher,
+                                 const uint8_t *head,
+                                 uint64_t head_length,
+                                 const uint8_t *body,
+                                 uint64_t body_length,
+                                 const uint8_t *nonce,
+                                 const uint8_t *symmetric_key)
+{
+    (void) cipher;
+    (void) head;
+    (void) head_length;
+    (void) body;
+    (void) body_length;
+    (void) nonce;
+    (void) symmetric_key;
+    return 0;
+}
+
 /**
  * @brief Decrypts and verifies an authenticated encrypted message.
  *        
@@ -450,6 +473,23 @@ int api_crypto_hash_sha512_final(uint8_t *hash_state,
     return 0;
 }
 
+/**
+ * @brief Generate random bytes.
+ *
+ * @param buffer    Pointer where to place random bytes.
+ * @param length    Number of bytes to generate.
+ *
+ * @return 0    The random bytes could be generated.
+ * @return != 0 The random bytes could not be generated.
+ */
+int api_crypto_randombytes(uint8_t *buffer,
+                           uint64_t length)
+{
+    (void) buffer;
+    (void) length;
+    return 0;
+}
+
 
 /*======= Local function implementations ====================================*/
 
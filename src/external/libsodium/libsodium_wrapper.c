@@ -7,6 +7,7 @@
 
 /*======= Includes ==========================================================*/
 
+#include <string.h>
 #include "salt_crypto_wrapper.h"
 #include <sodium.h>
 
@@ -16,6 +17,23 @@
 /*======= Local variable declarations =======================================*/
 /*======= Global function implementations ===================================*/
 
+/**
+ * @brief Sets a scratch workspace used by the calling thread.
+ *
+ * Not supported by libsodium, which keeps its temporaries on the stack.
+ *
+ * @param p_scratch Pointer to workspace or NULL.
+ * @param size      Size of workspace.
+ *
+ * @return 0    p_scratch was NULL.
+ * @return != 0 A workspace can not be used.
+ */
+int api_crypto_scratch_set(void *p_scratch, uint32_t size)
+{
+    (void) size;
+    return (p_scratch == NULL) ? 0 : -1;
+}
+
 /**
  * @brief Randomly generates a secret- and public key for encryption.
  * 
@@ -125,6 +143,41 @@ int api_crypto_box_afternm(uint8_t *cipher,
 {
     return crypto_box_afternm(cipher, clear_text, length, nonce, symmetric_key);
 }
+/**
+ * @brief Encrypts and authenticates a message given in two parts.
+ *
+ * See salt_crypto_wrapper.h.
+ */
+int api_crypto_box_afternm_parts(uint8_t *cipher,
+                                 const uint8_t *head,
+                                 uint64_t head_length,
+                                 const uint8_t *body,
+                                 uint64_t body_length,
+                                 const uint8_t *nonce,
+                                 const uint8_t *symmetric_key)
+{
+    uint64_t i;
+    uint64_t length = api_crypto_box_ZEROBYTES + head_length + body_length;
+
+    /* The key stream is xored with the parts, as crypto_secretbox does. */
+    if (crypto_stream_xsalsa20(cipher, length, nonce, symmetric_key) != 0) {
+        return -1;
+    }
+    for (i = 0; i < head_length; i++) {
+        cipher[api_crypto_box_ZEROBYTES + i] ^= head[i];
+    }
+    for (i = 0; i < body_length; i++) {
+        cipher[api_crypto_box_ZEROBYTES + head_length + i] ^= body[i];
+    }
+    crypto_onetimeauth_poly1305(&cipher[api_crypto_box_BOXZEROBYTES],
+                                &cipher[api_crypto_box_ZEROBYTES],
+                                head_length + body_length,
+                                cipher);
+    memset(cipher, 0x00, api_crypto_box_BOXZEROBYTES);
+
+    return 0;
+}
+
 /**
  * @brief Decrypts and verifies an authenticated encrypted message.
  *        
@@ -251,6 +304,48 @@ int api_crypto_sign(uint8_t *signed_message,
     return ret;
 }
 
+/**
+ * @brief Creates a commitment for signing a later message.
+ *
+ * Not supported by libsodium, which has no public Ed25519 scalar and point
+ * arithmetic in the bundled version. Signing falls back to api_crypto_sign.
+ *
+ * @param precomputed   Pointer where to store the commitment.
+ * @param secret_key    Pointer to signer's secret key.
+ *
+ * @return != 0 Always.
+ */
+int api_crypto_sign_precompute(uint8_t *precomputed,
+                               const uint8_t *secret_key)
+{
+    (void) precomputed;
+    (void) secret_key;
+    return -1;
+}
+
+/**
+ * @brief Creates a signed message using a precomputed commitment.
+ *
+ * Not supported by libsodium, see api_crypto_sign_precompute.
+ *
+ * @return != 0 Always.
+ */
+int api_crypto_sign_precomputed(uint8_t *signed_message,
+                                uint64_t *signed_length,
+                                const uint8_t *message,
+                                uint64_t message_length,
+                                const uint8_t *secret_key,
+                                uint8_t *precomputed)
+{
+    (void) signed_message;
+    (void) signed_length;
+    (void) message;
+    (void) message_length;
+    (void) secret_key;
+    (void) precomputed;
+    return -1;
+}
+
 /**
  * @brief Verifies a signed message using the signer's public key.
  * 
@@ -436,6 +531,22 @@ int api_crypto_hash_sha512_final(uint8_t *hash_state,
                                     out);
 }
 
+/**
+ * @brief Generate random bytes.
+ *
+ * @param buffer    Pointer where to place random bytes.
+ * @param length    Number of bytes to generate.
+ *
+ * @return 0    The random bytes could be generated.
+ * @return != 0 The random bytes could not be generated.
+ */
+int api_crypto_randombytes(uint8_t *buffer,
+                           uint64_t length)
+{
+    randombytes_buf(buffer, (size_t) length);
+    return 0;
+}
+
 
 /*======= Local function implementations ====================================*/
 
@@ -12,6 +12,11 @@ typedef unsigned long long u64;
 typedef long long i64;
 typedef i64 gf[16];
 extern void randombytes(u8 *,u64);
+static int sha512_update(crypto_hash_sha512_state *state,
+                         const unsigned char *in, unsigned long long inlen,
+                         uint64_t tmp64[80 + 8]);
+static int sha512_final(crypto_hash_sha512_state *state, unsigned char *out,
+                        uint64_t tmp64[80 + 8]);
 
 /* From libsodium */
 
@@ -436,11 +441,11 @@ sv pow2523(gf o,const gf i)
   FOR(a,16) o[a]=c[a];
 }
 
-int crypto_scalarmult(u8 *q,const u8 *n,const u8 *p)
+static int scalarmult_ladder(u8 *q,const u8 *n,const u8 *p,i64 x[80],gf t[6])
 {
   u8 z[32];
-  i64 x[80],r,i;
-  gf a,b,c,d,e,f;
+  i64 r,i;
+  i64 *a = t[0], *b = t[1], *c = t[2], *d = t[3], *e = t[4], *f = t[5];
   FOR(i,31) z[i]=n[i];
   z[31]=(n[31]&127)|64;
   z[0]&=248;
@@ -484,9 +489,24 @@ int crypto_scalarmult(u8 *q,const u8 *n,const u8 *p)
   inv25519(x+32,x+32);
   M(x+16,x+16,x+32);
   pack25519(q,x+16);
+  memset(z,0,sizeof z);
   return 0;
 }
 
+int crypto_scalarmult(u8 *q,const u8 *n,const u8 *p)
+{
+  i64 x[80];
+  gf t[6];
+  return scalarmult_ladder(q,n,p,x,t);
+}
+
+int crypto_scalarmult_ws(u8 *q,const u8 *n,const u8 *p,crypto_ws *ws)
+{
+  int ret = scalarmult_ladder(q,n,p,ws->u.ladder.x,ws->u.ladder.t);
+  memset(ws,0,sizeof *ws);
+  return ret;
+}
+
 int crypto_scalarmult_base(u8 *q,const u8 *n)
 { 
   return crypto_scalarmult(q,n,_9);
@@ -498,6 +518,12 @@ int crypto_box_keypair(u8 *y,u8 *x)
   return crypto_scalarmult_base(y,x);
 }
 
+int crypto_box_keypair_ws(u8 *y,u8 *x,crypto_ws *ws)
+{
+  randombytes(x,32);
+  return crypto_scalarmult_ws(y,x,_9,ws);
+}
+
 int crypto_box_beforenm(u8 *k,const u8 *y,const u8 *x)
 {
   u8 s[32];
@@ -505,6 +531,16 @@ int crypto_box_beforenm(u8 *k,const u8 *y,const u8 *x)
   return crypto_core_hsalsa20(k,_0,s,sigma);
 }
 
+int crypto_box_beforenm_ws(u8 *k,const u8 *y,const u8 *x,crypto_ws *ws)
+{
+  u8 s[32];
+  int ret;
+  crypto_scalarmult_ws(s,x,y,ws);
+  ret = crypto_core_hsalsa20(k,_0,s,sigma);
+  memset(s,0,sizeof s);
+  return ret;
+}
+
 int crypto_box_afternm(u8 *c,const u8 *m,u64 d,const u8 *n,const u8 *k)
 {
   return crypto_secretbox(c,m,d,n,k);
@@ -529,16 +565,21 @@ int crypto_box_open(u8 *m,const u8 *c,u64 d,const u8 *n,const u8 *y,const u8 *x)
   return crypto_box_open_afternm(m,c,d,n,k);
 }
 
-sv add(gf p[4],gf q[4])
+/*
+ * The point operations below takes their temporaries from the workspace,
+ * t must have room for 9 field elements.
+ */
+sv add(gf p[4],gf q[4],gf t[9])
 {
-  gf a,b,c,d,t,e,f,g,h;
+  i64 *a = t[0], *b = t[1], *c = t[2], *d = t[3], *tt = t[4];
+  i64 *e = t[5], *f = t[6], *g = t[7], *h = t[8];
   
   Z(a, p[1], p[0]);
-  Z(t, q[1], q[0]);
-  M(a, a, t);
+  Z(tt, q[1], q[0]);
+  M(a, a, tt);
   A(b, p[0], p[1]);
-  A(t, q[0], q[1]);
-  M(b, b, t);
+  A(tt, q[0], q[1]);
+  M(b, b, tt);
   M(c, p[3], q[3]);
   M(c, c, D2);
   M(d, p[2], q[2]);
@@ -561,9 +602,9 @@ sv cswap(gf p[4],gf q[4],u8 b)
     sel25519(p[i],q[i],b);
 }
 
-sv pack(u8 *r,gf p[4])
+sv pack(u8 *r,gf p[4],gf t[9])
 {
-  gf tx, ty, zi;
+  i64 *tx = t[0], *ty = t[1], *zi = t[2];
   inv25519(zi, p[2]); 
   M(tx, p[0], zi);
   M(ty, p[1], zi);
@@ -571,7 +612,7 @@ sv pack(u8 *r,gf p[4])
   r[31] ^= par25519(tx) << 7;
 }
 
-sv scalarmult(gf p[4],gf q[4],const u8 *s)
+sv scalarmult(gf p[4],gf q[4],const u8 *s,gf t[9])
 {
   int i;
   set25519(p[0],gf0);
@@ -581,41 +622,46 @@ sv scalarmult(gf p[4],gf q[4],const u8 *s)
   for (i = 255;i >= 0;--i) {
     u8 b = (s[i/8]>>(i&7))&1;
     cswap(p,q,b);
-    add(q,p);
-    add(p,p);
+    add(q,p,t);
+    add(p,p,t);
     cswap(p,q,b);
   }
 }
 
-sv scalarbase(gf p[4],const u8 *s)
+/* q is used as temporary for the base point. */
+sv scalarbase(gf p[4],gf q[4],const u8 *s,gf t[9])
 {
-  gf q[4];
   set25519(q[0],X);
   set25519(q[1],Y);
   set25519(q[2],gf1);
   M(q[3],X,Y);
-  scalarmult(p,q,s);
+  scalarmult(p,q,s,t);
 }
 
 int crypto_sign_keypair(u8 *pk, u8 *sk)
 {
-  u8 d[64];
-  gf p[4];
+  crypto_ws ws;
+  return crypto_sign_keypair_ws(pk,sk,&ws);
+}
+
+int crypto_sign_keypair_ws(u8 *pk, u8 *sk, crypto_ws *ws)
+{
+  u8 *d = ws->d;
   int i;
 
   randombytes(sk, 32);
-  crypto_hash_sha512_state hash_state;
-  crypto_hash_sha512_init(&hash_state);
-  crypto_hash_sha512_update(&hash_state, sk, 32);
-  crypto_hash_sha512_final(&hash_state, d);
+  crypto_hash_sha512_init(&ws->sha);
+  sha512_update(&ws->sha, sk, 32, ws->u.tmp64);
+  sha512_final(&ws->sha, d, ws->u.tmp64);
   d[0] &= 248;
   d[31] &= 127;
   d[31] |= 64;
 
-  scalarbase(p,d);
-  pack(pk,p);
+  scalarbase(ws->u.point.p,ws->u.point.q,d,ws->u.point.t);
+  pack(pk,ws->u.point.p,ws->u.point.t);
 
   FOR(i,32) sk[32 + i] = pk[i];
+  memset(ws,0,sizeof *ws);
   return 0;
 }
 
@@ -647,50 +693,91 @@ sv modL(u8 *r,i64 x[64])
   }
 }
 
-sv reduce(u8 *r)
+sv reduce(u8 *r,i64 x[64])
 {
-  i64 x[64],i;
+  i64 i;
   FOR(i,64) x[i] = (u64) r[i];
   FOR(i,64) r[i] = 0;
   modL(r,x);
 }
 
-int crypto_sign(u8 *sm,u64 *smlen,const u8 *m,u64 n,const u8 *sk)
+/*
+ * Hashes and clamps the secret scalar to ws->d, the prefix is put in ws->d + 32.
+ */
+static void sign_secret_ws(const u8 *sk,crypto_ws *ws)
 {
-  u8 d[64],h[64],r[64];
-  i64 j,x[64];
-  u64 i;
-  gf p[4];
-  crypto_hash_sha512_state hash_state;
+  u8 *d = ws->d;
 
-  crypto_hash_sha512_init(&hash_state);
-  crypto_hash_sha512_update(&hash_state, sk, 32);
-  crypto_hash_sha512_final(&hash_state, d);
+  crypto_hash_sha512_init(&ws->sha);
+  sha512_update(&ws->sha, sk, 32, ws->u.tmp64);
+  sha512_final(&ws->sha, d, ws->u.tmp64);
   d[0] &= 248;
   d[31] &= 127;
   d[31] |= 64;
+}
 
-  *smlen = n+64;
-  FOR(i,n) sm[64 + i] = m[i];
-  FOR(i,32) sm[32 + i] = d[32 + i];
-
-  crypto_hash_sha512_init(&hash_state);
-  crypto_hash_sha512_update(&hash_state, sm+32, n+32);
-  crypto_hash_sha512_final(&hash_state, r);
-  reduce(r);
-  scalarbase(p,r);
-  pack(sm,p);
+/*
+ * Completes the signature with S = r + H(R || pk || m) * d, where the
+ * commitment R is in sig[0:31], r in ws->r and d in ws->d.
+ */
+static void sign_finish_ws(u8 *sig,const u8 *m,u64 mlen,const u8 *sk,crypto_ws *ws)
+{
+  u8 *d = ws->d, *h = ws->h, *r = ws->r;
+  i64 *x;
+  i64 i,j;
 
-  FOR(i,32) sm[i+32] = sk[i+32];
-  crypto_hash_sha512_init(&hash_state);
-  crypto_hash_sha512_update(&hash_state, sm, n + 64);
-  crypto_hash_sha512_final(&hash_state, h);
-  reduce(h);
+  FOR(i,32) sig[i+32] = sk[i+32];
+  crypto_hash_sha512_init(&ws->sha);
+  sha512_update(&ws->sha, sig, 64, ws->u.tmp64);
+  sha512_update(&ws->sha, m, mlen, ws->u.tmp64);
+  sha512_final(&ws->sha, h, ws->u.tmp64);
+  reduce(h,ws->u.x);
 
+  x = ws->u.x;
   FOR(i,64) x[i] = 0;
   FOR(i,32) x[i] = (u64) r[i];
   FOR(i,32) FOR(j,32) x[i+j] += h[i] * (u64) d[j];
-  modL(sm + 32,x);
+  modL(sig + 32,x);
+
+  memset(ws,0,sizeof *ws);
+}
+
+/*
+ * Creates the signature { R[32] , S[32] } of { prefix[32] , m[mlen] }, where
+ * prefix is the upper half of the hashed secret key. The message is read
+ * from m, which may point into the signed message buffer.
+ */
+static void sign_ws(u8 *sig,const u8 *m,u64 mlen,const u8 *sk,crypto_ws *ws)
+{
+  u8 *d = ws->d, *r = ws->r;
+
+  sign_secret_ws(sk,ws);
+
+  crypto_hash_sha512_init(&ws->sha);
+  sha512_update(&ws->sha, d + 32, 32, ws->u.tmp64);
+  sha512_update(&ws->sha, m, mlen, ws->u.tmp64);
+  sha512_final(&ws->sha, r, ws->u.tmp64);
+
+  reduce(r,ws->u.x);
+  scalarbase(ws->u.point.p,ws->u.point.q,r,ws->u.point.t);
+  pack(sig,ws->u.point.p,ws->u.point.t);
+
+  sign_finish_ws(sig,m,mlen,sk,ws);
+}
+
+int crypto_sign(u8 *sm,u64 *smlen,const u8 *m,u64 n,const u8 *sk)
+{
+  crypto_ws ws;
+  return crypto_sign_ws(sm,smlen,m,n,sk,&ws);
+}
+
+int crypto_sign_ws(u8 *sm,u64 *smlen,const u8 *m,u64 n,const u8 *sk,crypto_ws *ws)
+{
+  u64 i;
+
+  *smlen = n+64;
+  FOR(i,n) sm[64 + i] = m[i];
+  sign_ws(sm,sm + 64,n,sk,ws);
 
   return 0;
 }
@@ -701,54 +788,89 @@ int crypto_sign_detached(unsigned char *sig,
                          unsigned long long mlen,
                          const unsigned char *sk)
 {
+  crypto_ws ws;
+  return crypto_sign_detached_ws(sig,siglen_p,m,mlen,sk,&ws);
+}
 
-  u8 d[64],h[64],r[64];
-  i64 j,x[64];
-  u64 i;
-  gf p[4];
-  crypto_hash_sha512_state hash_state;
+int crypto_sign_detached_ws(unsigned char *sig,
+                            unsigned long long *siglen_p,
+                            const unsigned char *m,
+                            unsigned long long mlen,
+                            const unsigned char *sk,
+                            crypto_ws *ws)
+{
+  sign_ws(sig,m,mlen,sk,ws);
 
-  crypto_hash_sha512_init(&hash_state);
-  crypto_hash_sha512_update(&hash_state, sk, 32);
-  crypto_hash_sha512_final(&hash_state, d);
-  d[0] &= 248;
-  d[31] &= 127;
-  d[31] |= 64;
+  if (siglen_p != NULL)
+  {
+    *siglen_p = 64;
+  }
 
-  FOR(i,32) sig[32 + i] = d[32 + i];
+  return 0;
+}
 
-  crypto_hash_sha512_init(&hash_state);
-  crypto_hash_sha512_update(&hash_state, d + 32, 32);
-  crypto_hash_sha512_update(&hash_state, m, mlen);
-  crypto_hash_sha512_final(&hash_state, r);
+int crypto_sign_precompute(u8 *rR,const u8 *sk)
+{
+  crypto_ws ws;
+  return crypto_sign_precompute_ws(rR,sk,&ws);
+}
 
-  reduce(r);
-  scalarbase(p,r);
-  pack(sig,p);
+/*
+ * The nonce r is derived from the prefix and 64 random bytes instead of from
+ * the message. A verifier can not tell the difference, and r stays secret even
+ * if the random bytes are weak.
+ */
+int crypto_sign_precompute_ws(u8 *rR,const u8 *sk,crypto_ws *ws)
+{
+  u8 *d = ws->d, *h = ws->h, *r = ws->r;
+  int i;
 
-  FOR(i,32) sig[i+32] = sk[i+32];
-  crypto_hash_sha512_init(&hash_state);
-  crypto_hash_sha512_update(&hash_state, sig, 64);
-  crypto_hash_sha512_update(&hash_state, m, mlen);
-  crypto_hash_sha512_final(&hash_state, h);
-  reduce(h);
+  sign_secret_ws(sk,ws);
+  randombytes(h, 64);
 
-  FOR(i,64) x[i] = 0;
-  FOR(i,32) x[i] = (u64) r[i];
-  FOR(i,32) FOR(j,32) x[i+j] += h[i] * (u64) d[j];
-  modL(sig + 32,x);
+  crypto_hash_sha512_init(&ws->sha);
+  sha512_update(&ws->sha, d + 32, 32, ws->u.tmp64);
+  sha512_update(&ws->sha, h, 64, ws->u.tmp64);
+  sha512_final(&ws->sha, r, ws->u.tmp64);
 
-  if (siglen_p != NULL)
-  {
-    *siglen_p = 64;
-  }
+  reduce(r,ws->u.x);
+  scalarbase(ws->u.point.p,ws->u.point.q,r,ws->u.point.t);
+  pack(rR + 32,ws->u.point.p,ws->u.point.t);
+  FOR(i,32) rR[i] = r[i];
+
+  memset(ws,0,sizeof *ws);
+  return 0;
+}
+
+int crypto_sign_precomputed(u8 *sm,u64 *smlen,const u8 *m,u64 n,const u8 *sk,u8 *rR)
+{
+  crypto_ws ws;
+  return crypto_sign_precomputed_ws(sm,smlen,m,n,sk,rR,&ws);
+}
+
+int crypto_sign_precomputed_ws(u8 *sm,u64 *smlen,const u8 *m,u64 n,const u8 *sk,u8 *rR,crypto_ws *ws)
+{
+  u64 i;
+
+  *smlen = n+64;
+  FOR(i,n) sm[64 + i] = m[i];
+
+  sign_secret_ws(sk,ws);
+  FOR(i,32) ws->r[i] = rR[i];
+  FOR(i,32) sm[i] = rR[32 + i];
+
+  /* The commitment must never be used twice. */
+  memset(rR,0,64);
+
+  sign_finish_ws(sm,sm + 64,n,sk,ws);
 
   return 0;
 }
 
-static int unpackneg(gf r[4],const u8 p[32])
+static int unpackneg(gf r[4],const u8 p[32],gf t[9])
 {
-  gf t, chk, num, den, den2, den4, den6;
+  i64 *tt = t[0], *chk = t[1], *num = t[2], *den = t[3];
+  i64 *den2 = t[4], *den4 = t[5], *den6 = t[6];
   set25519(r[2],gf1);
   unpack25519(r[1],p);
   S(num,r[1]);
@@ -759,14 +881,14 @@ static int unpackneg(gf r[4],const u8 p[32])
   S(den2,den);
   S(den4,den2);
   M(den6,den4,den2);
-  M(t,den6,num);
-  M(t,t,den);
+  M(tt,den6,num);
+  M(tt,tt,den);
 
-  pow2523(t,t);
-  M(t,t,num);
-  M(t,t,den);
-  M(t,t,den);
-  M(r[0],t,den);
+  pow2523(tt,tt);
+  M(tt,tt,num);
+  M(tt,tt,den);
+  M(tt,tt,den);
+  M(r[0],tt,den);
 
   S(chk,r[0]);
   M(chk,chk,den);
@@ -782,32 +904,49 @@ static int unpackneg(gf r[4],const u8 p[32])
   return 0;
 }
 
+/*
+ * Verifies the signature sig of m, h must be SHA512(R || pk || m).
+ */
+static int verify_ws(const u8 *sig,const u8 *pk,crypto_ws *ws)
+{
+  u8 t[32];
+  int ret = -1;
+
+  reduce(ws->h,ws->u.x);
+
+  if (unpackneg(ws->u.point.q,pk,ws->u.point.t) == 0) {
+    scalarmult(ws->u.point.p,ws->u.point.q,ws->h,ws->u.point.t);
+    scalarbase(ws->u.point.q,ws->u.point.b,sig + 32,ws->u.point.t);
+    add(ws->u.point.p,ws->u.point.q,ws->u.point.t);
+    pack(t,ws->u.point.p,ws->u.point.t);
+    ret = crypto_verify_32(sig, t);
+  }
+
+  memset(ws,0,sizeof *ws);
+  return ret;
+}
+
 int crypto_sign_open(u8 *m,u64 *mlen,const u8 *sm,u64 n,const u8 *pk)
+{
+  crypto_ws ws;
+  return crypto_sign_open_ws(m,mlen,sm,n,pk,&ws);
+}
+
+int crypto_sign_open_ws(u8 *m,u64 *mlen,const u8 *sm,u64 n,const u8 *pk,crypto_ws *ws)
 {
   u64 i;
-  u8 t[32],h[64];
-  gf p[4],q[4];
 
   *mlen = -1;
   if (n < 64) return -1;
 
-  if (unpackneg(q,pk)) return -1;
-
   FOR(i,n) m[i] = sm[i];
   FOR(i,32) m[i+32] = pk[i];
-  crypto_hash_sha512_state hash_state;
-  crypto_hash_sha512_init(&hash_state);
-  crypto_hash_sha512_update(&hash_state, m,n);
-  crypto_hash_sha512_final(&hash_state, h);
-  reduce(h);
-  scalarmult(p,q,h);
-
-  scalarbase(q,sm + 32);
-  add(p,q);
-  pack(t,p);
+  crypto_hash_sha512_init(&ws->sha);
+  sha512_update(&ws->sha, m, n, ws->u.tmp64);
+  sha512_final(&ws->sha, ws->h, ws->u.tmp64);
 
   n -= 64;
-  if (crypto_verify_32(sm, t)) {
+  if (verify_ws(sm,pk,ws)) {
     FOR(i,n) m[i] = 0;
     return -1;
   }
@@ -822,34 +961,27 @@ int crypto_sign_verify_detached(const unsigned char *sig,
                                 unsigned long long mlen,
                                 const unsigned char *pk)
 {
+    crypto_ws ws;
+    return crypto_sign_verify_detached_ws(sig,m,mlen,pk,&ws);
+}
 
-    crypto_hash_sha512_state hash_state;
+int crypto_sign_verify_detached_ws(const unsigned char *sig,
+                                   const unsigned char *m,
+                                   unsigned long long mlen,
+                                   const unsigned char *pk,
+                                   crypto_ws *ws)
+{
     unsigned long long i;
-    u8 t[32],h[64];
-    gf p[4],q[4];
-
-    if (unpackneg(q,pk)) return -1;
-
-    crypto_hash_sha512_init(&hash_state);
 
-    FOR(i,32) h[i] = sig[i];
-    FOR(i,32) h[i+32] = pk[i];
+    FOR(i,32) ws->h[i] = sig[i];
+    FOR(i,32) ws->h[i+32] = pk[i];
 
-    crypto_hash_sha512_update(&hash_state, h, 64);
-    crypto_hash_sha512_update(&hash_state, m, mlen);
-    crypto_hash_sha512_final(&hash_state, h);
+    crypto_hash_sha512_init(&ws->sha);
+    sha512_update(&ws->sha, ws->h, 64, ws->u.tmp64);
+    sha512_update(&ws->sha, m, mlen, ws->u.tmp64);
+    sha512_final(&ws->sha, ws->h, ws->u.tmp64);
 
-    reduce(h);
-    scalarmult(p,q,h);
-    scalarbase(q,sig + 32);
-    add(p,q);
-    pack(t,p);
-
-    if (crypto_verify_32(sig, t)) {
-        return -1;
-    }
-
-    return 0;
+    return verify_ws(sig,pk,ws);
 }
 
 static void
@@ -1016,6 +1148,14 @@ int crypto_hash(u8 *out,const u8 *m,u64 n)
     return 0;
 }
 
+int crypto_hash_ws(u8 *out,const u8 *m,u64 n,crypto_ws *ws)
+{
+    crypto_hash_sha512_init(&ws->sha);
+    sha512_update(&ws->sha, m, n, ws->u.tmp64);
+    sha512_final(&ws->sha, out, ws->u.tmp64);
+    return 0;
+}
+
 int
 crypto_hash_sha512_init(crypto_hash_sha512_state *state)
 {
@@ -1035,7 +1175,24 @@ int
 crypto_hash_sha512_update(crypto_hash_sha512_state *state,
                           const unsigned char *in, unsigned long long inlen)
 {
-    uint64_t           tmp64[80 + 8];
+    uint64_t tmp64[80 + 8];
+
+    return sha512_update(state, in, inlen, tmp64);
+}
+
+int
+crypto_hash_sha512_update_ws(crypto_hash_sha512_state *state,
+                             const unsigned char *in, unsigned long long inlen,
+                             crypto_ws *ws)
+{
+    return sha512_update(state, in, inlen, ws->u.tmp64);
+}
+
+static int
+sha512_update(crypto_hash_sha512_state *state,
+              const unsigned char *in, unsigned long long inlen,
+              uint64_t tmp64[80 + 8])
+{
     uint64_t           bitlen[2];
     unsigned long long i;
     unsigned long long r;
@@ -1075,7 +1232,7 @@ crypto_hash_sha512_update(crypto_hash_sha512_state *state,
     for (i = 0; i < inlen; i++) {
         state->buf[i] = in[i];
     }
-    memset((void *) tmp64,0x00, sizeof tmp64);
+    memset((void *) tmp64,0x00, (80 + 8) * sizeof(uint64_t));
 
     return 0;
 }
@@ -1085,9 +1242,23 @@ crypto_hash_sha512_final(crypto_hash_sha512_state *state, unsigned char *out)
 {
     uint64_t tmp64[80 + 8];
 
+    return sha512_final(state, out, tmp64);
+}
+
+int
+crypto_hash_sha512_final_ws(crypto_hash_sha512_state *state, unsigned char *out,
+                            crypto_ws *ws)
+{
+    return sha512_final(state, out, ws->u.tmp64);
+}
+
+static int
+sha512_final(crypto_hash_sha512_state *state, unsigned char *out,
+             uint64_t tmp64[80 + 8])
+{
     SHA512_Pad(state, tmp64);
     be64enc_vect(out, state->state, 64);
-    memset((void *) tmp64,0x00, sizeof tmp64);
+    memset((void *) tmp64,0x00, (80 + 8) * sizeof(uint64_t));
     memset((void *) state,0x00, sizeof *state);
 
     return 0;
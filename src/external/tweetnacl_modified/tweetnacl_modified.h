@@ -305,4 +305,125 @@ int crypto_sign_detached(unsigned char *sig,
                          unsigned long long mlen,
                          const unsigned char *sk);
 
+/*
+ * Signing with a precomputed commitment.
+ *
+ * crypto_sign_precompute creates the commitment rR = { r[32] , R[32] }, where
+ * R = rB is the expensive fixed base multiplication of a signature. It does not
+ * depend on the message and may be computed in advance. crypto_sign_precomputed
+ * then creates the same signed message as crypto_sign, except for the choice
+ * of r, and clears rR. A commitment must only be used once.
+ */
+int crypto_sign_precompute(unsigned char *rR,
+                           const unsigned char *sk);
+
+int crypto_sign_precomputed(unsigned char *sm,
+                            unsigned long long *smlen,
+                            const unsigned char *m,
+                            unsigned long long n,
+                            const unsigned char *sk,
+                            unsigned char *rR);
+
+/*
+ * Bounded stack variants.
+ *
+ * The *_ws functions keep all large temporaries (field elements, points,
+ * scalar reduction and SHA-512 message schedule) in a caller provided
+ * workspace instead of on the stack. The workspace is not used between calls
+ * and is cleared before returning, so one workspace can be shared by all
+ * sessions running on the same thread. The functions without _ws puts a
+ * workspace on the stack and calls the corresponding _ws function.
+ */
+typedef struct crypto_ws {
+    unsigned char d[64];
+    unsigned char h[64];
+    unsigned char r[64];
+    crypto_hash_sha512_state sha;
+    union {
+        uint64_t tmp64[80 + 8];
+        struct {
+            long long p[4][16];
+            long long q[4][16];
+            long long b[4][16];
+            long long t[9][16];
+        } point;
+        struct {
+            long long x[80];
+            long long t[6][16];
+        } ladder;
+        long long x[64];
+    } u;
+} crypto_ws;
+
+int crypto_scalarmult_ws(unsigned char *q,
+                         const unsigned char *n,
+                         const unsigned char *p,
+                         crypto_ws *ws);
+
+int crypto_box_keypair_ws(unsigned char *y,
+                          unsigned char *x,
+                          crypto_ws *ws);
+
+int crypto_box_beforenm_ws(unsigned char *k,
+                           const unsigned char *y,
+                           const unsigned char *x,
+                           crypto_ws *ws);
+
+int crypto_sign_keypair_ws(unsigned char *pk,
+                           unsigned char *sk,
+                           crypto_ws *ws);
+
+int crypto_sign_ws(unsigned char *sm,
+                   unsigned long long *smlen,
+                   const unsigned char *m,
+                   unsigned long long n,
+                   const unsigned char *sk,
+                   crypto_ws *ws);
+
+int crypto_sign_precompute_ws(unsigned char *rR,
+                              const unsigned char *sk,
+                              crypto_ws *ws);
+
+int crypto_sign_precomputed_ws(unsigned char *sm,
+                               unsigned long long *smlen,
+                               const unsigned char *m,
+                               unsigned long long n,
+                               const unsigned char *sk,
+                               unsigned char *rR,
+                               crypto_ws *ws);
+
+int crypto_sign_detached_ws(unsigned char *sig,
+                            unsigned long long *siglen_p,
+                            const unsigned char *m,
+                            unsigned long long mlen,
+                            const unsigned char *sk,
+                            crypto_ws *ws);
+
+int crypto_sign_open_ws(unsigned char *m,
+                        unsigned long long *mlen,
+                        const unsigned char *sm,
+                        unsigned long long n,
+                        const unsigned char *pk,
+                        crypto_ws *ws);
+
+int crypto_sign_verify_detached_ws(const unsigned char *sig,
+                                   const unsigned char *m,
+                                   unsigned long long mlen,
+                                   const unsigned char *pk,
+                                   crypto_ws *ws);
+
+int crypto_hash_ws(unsigned char *out,
+                   const unsigned char *m,
+                   unsigned long long n,
+                   crypto_ws *ws);
+
+int crypto_hash_sha512_update_ws(crypto_hash_sha512_state *state,
+                                 const unsigned char *in,
+                                 unsigned long long inlen,
+                                 crypto_ws *ws);
+
+int crypto_hash_sha512_final_ws(crypto_hash_sha512_state *state,
+                                unsigned char *out,
+                                crypto_ws *ws);
+
 #endif
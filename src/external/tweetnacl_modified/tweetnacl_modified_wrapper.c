@@ -8,15 +8,61 @@
 /*======= Includes ==========================================================*/
 
 #include <stddef.h>
+#include <string.h>
 #include "salt_crypto_wrapper.h"
 #include "tweetnacl_modified.h"
 
 /*======= Local Macro Definitions ===========================================*/
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SALT_CRYPTO_THREAD_LOCAL __thread
+#else
+#define SALT_CRYPTO_THREAD_LOCAL
+#endif
+
 /*======= Type Definitions ==================================================*/
+
+/* Fails to compile if api_crypto_scratch_BYTES is too small. */
+typedef char api_crypto_scratch_size_check[
+    (sizeof(crypto_ws) <= api_crypto_scratch_BYTES) ? 1 : -1];
+
 /*======= Local function prototypes =========================================*/
+
+/* Provided by the application, see tweetnacl_modified.c. */
+extern void randombytes(unsigned char *p_bytes, unsigned long long length);
+
 /*======= Local variable declarations =======================================*/
+
+static SALT_CRYPTO_THREAD_LOCAL crypto_ws *p_scratch_ws = NULL;
+
 /*======= Global function implementations ===================================*/
 
+/**
+ * @brief Sets a scratch workspace used by the calling thread.
+ *
+ * See salt_crypto_wrapper.h.
+ *
+ * @param p_scratch Pointer to workspace, 8 byte aligned, or NULL.
+ * @param size      Size of workspace.
+ *
+ * @return 0    The workspace was set.
+ * @return != 0 The workspace is too small or not aligned.
+ */
+int api_crypto_scratch_set(void *p_scratch, uint32_t size)
+{
+    if (p_scratch == NULL) {
+        p_scratch_ws = NULL;
+        return 0;
+    }
+
+    if (size < sizeof(crypto_ws) || ((uintptr_t) p_scratch & 7U) != 0) {
+        return -1;
+    }
+
+    p_scratch_ws = (crypto_ws *) p_scratch;
+    return 0;
+}
+
 /**
  * @brief Randomly generates a secret- and public key for encryption.
  * 
@@ -35,6 +81,9 @@
 int api_crypto_box_keypair(uint8_t *public_key,
                            uint8_t *secret_key)
 {
+    if (p_scratch_ws != NULL) {
+        return crypto_box_keypair_ws(public_key, secret_key, p_scratch_ws);
+    }
     return crypto_box_keypair(public_key, secret_key);
 }
 
@@ -65,6 +114,12 @@ int api_crypto_box_beforenm(uint8_t *symmetric_key,
                             const uint8_t *public_key,
                             const uint8_t *secret_key)
 {
+    if (p_scratch_ws != NULL) {
+        return crypto_box_beforenm_ws(symmetric_key,
+                                      public_key,
+                                      secret_key,
+                                      p_scratch_ws);
+    }
     return crypto_box_beforenm(symmetric_key, public_key, secret_key);
 }
 
@@ -126,6 +181,39 @@ int api_crypto_box_afternm(uint8_t *cipher,
 {
     return crypto_box_afternm(cipher, clear_text, length, nonce, symmetric_key);
 }
+/**
+ * @brief Encrypts and authenticates a message given in two parts.
+ *
+ * See salt_crypto_wrapper.h.
+ */
+int api_crypto_box_afternm_parts(uint8_t *cipher,
+                                 const uint8_t *head,
+                                 uint64_t head_length,
+                                 const uint8_t *body,
+                                 uint64_t body_length,
+                                 const uint8_t *nonce,
+                                 const uint8_t *symmetric_key)
+{
+    uint64_t i;
+    uint64_t length = api_crypto_box_ZEROBYTES + head_length + body_length;
+
+    /* The key stream is xored with the parts, as crypto_secretbox does. */
+    crypto_stream(cipher, length, nonce, symmetric_key);
+    for (i = 0; i < head_length; i++) {
+        cipher[api_crypto_box_ZEROBYTES + i] ^= head[i];
+    }
+    for (i = 0; i < body_length; i++) {
+        cipher[api_crypto_box_ZEROBYTES + head_length + i] ^= body[i];
+    }
+    crypto_onetimeauth(&cipher[api_crypto_box_BOXZEROBYTES],
+                       &cipher[api_crypto_box_ZEROBYTES],
+                       head_length + body_length,
+                       cipher);
+    memset(cipher, 0x00, api_crypto_box_BOXZEROBYTES);
+
+    return 0;
+}
+
 /**
  * @brief Decrypts and verifies an authenticated encrypted message.
  *        
@@ -198,6 +286,9 @@ int api_crypto_box_open_afternm(uint8_t *clear_text,
 int api_crypto_sign_keypair(uint8_t *public_key,
                             uint8_t *secret_key)
 {
+    if (p_scratch_ws != NULL) {
+        return crypto_sign_keypair_ws(public_key, secret_key, p_scratch_ws);
+    }
     return crypto_sign_keypair(public_key, secret_key);
 }
 
@@ -241,11 +332,87 @@ int api_crypto_sign(uint8_t *signed_message,
                     const uint8_t *secret_key)
 {
     unsigned long long smlen;
-    int ret = crypto_sign(signed_message,
+    int ret;
+    if (p_scratch_ws != NULL) {
+        ret = crypto_sign_ws(signed_message,
+                             &smlen,
+                             message,
+                             message_length,
+                             secret_key,
+                             p_scratch_ws);
+    } else {
+        ret = crypto_sign(signed_message,
                           &smlen,
                           message,
                           message_length,
                           secret_key);
+    }
+    if (signed_length != NULL) {
+        *signed_length = (uint64_t) smlen;
+    }
+    return ret;
+}
+
+/**
+ * @brief Creates a commitment for signing a later message.
+ *
+ * See salt_crypto_wrapper.h.
+ *
+ * @param precomputed   Pointer where to store the commitment.
+ * @param secret_key    Pointer to signer's secret key.
+ *
+ * @return 0    The commitment was created.
+ * @return != 0 The commitment could not be created.
+ */
+int api_crypto_sign_precompute(uint8_t *precomputed,
+                               const uint8_t *secret_key)
+{
+    if (p_scratch_ws != NULL) {
+        return crypto_sign_precompute_ws(precomputed, secret_key, p_scratch_ws);
+    }
+    return crypto_sign_precompute(precomputed, secret_key);
+}
+
+/**
+ * @brief Creates a signed message using a precomputed commitment.
+ *
+ * See salt_crypto_wrapper.h.
+ *
+ * @param signed_message    Pointer where to store signed message.
+ * @param signed_length     Signed message length, may be NULL.
+ * @param message           Pointer to message to sign.
+ * @param message_length    Length of message to sign.
+ * @param secret_key        Pointer to signer's secret key.
+ * @param precomputed       Pointer to commitment, cleared after use.
+ *
+ * @return 0    The message was successfully signed.
+ * @return != 0 The message could not be signed.
+ */
+int api_crypto_sign_precomputed(uint8_t *signed_message,
+                                uint64_t *signed_length,
+                                const uint8_t *message,
+                                uint64_t message_length,
+                                const uint8_t *secret_key,
+                                uint8_t *precomputed)
+{
+    unsigned long long smlen;
+    int ret;
+    if (p_scratch_ws != NULL) {
+        ret = crypto_sign_precomputed_ws(signed_message,
+                                         &smlen,
+                                         message,
+                                         message_length,
+                                         secret_key,
+                                         precomputed,
+                                         p_scratch_ws);
+    } else {
+        ret = crypto_sign_precomputed(signed_message,
+                                      &smlen,
+                                      message,
+                                      message_length,
+                                      secret_key,
+                                      precomputed);
+    }
     if (signed_length != NULL) {
         *signed_length = (uint64_t) smlen;
     }
@@ -286,11 +453,21 @@ int api_crypto_sign_open(uint8_t *message,
                          const uint8_t *public_key)
 {
     unsigned long long mlen;
-    int ret = crypto_sign_open(message,
+    int ret;
+    if (p_scratch_ws != NULL) {
+        ret = crypto_sign_open_ws(message,
+                                  &mlen,
+                                  signed_message,
+                                  signed_message_length,
+                                  public_key,
+                                  p_scratch_ws);
+    } else {
+        ret = crypto_sign_open(message,
                                &mlen,
                                signed_message,
                                signed_message_length,
                                public_key);
+    }
     if (message_length != NULL) {
         *message_length = (uint64_t) mlen;
     }
@@ -322,6 +499,13 @@ int api_crypto_sign_verify_detached(const uint8_t *signature,
                                     uint64_t message_length,
                                     const uint8_t *public_key)
 {
+    if (p_scratch_ws != NULL) {
+        return crypto_sign_verify_detached_ws(signature,
+                                              message,
+                                              message_length,
+                                              public_key,
+                                              p_scratch_ws);
+    }
     return crypto_sign_verify_detached(signature,
                                        message,
                                        message_length,
@@ -347,6 +531,9 @@ int api_crypto_hash_sha512(uint8_t *hash,
                            const uint8_t *message,
                            uint64_t length)
 {
+    if (p_scratch_ws != NULL) {
+        return crypto_hash_ws(hash, message, length, p_scratch_ws);
+    }
     return crypto_hash_sha512(hash, message, length);
 }
 
@@ -402,6 +589,12 @@ int api_crypto_hash_sha512_update(uint8_t *hash_state,
                                   const uint8_t *in,
                                   uint64_t inlen)
 {
+    if (p_scratch_ws != NULL) {
+        return crypto_hash_sha512_update_ws((crypto_hash_sha512_state *) hash_state,
+                                            in,
+                                            inlen,
+                                            p_scratch_ws);
+    }
     return crypto_hash_sha512_update((crypto_hash_sha512_state *) hash_state,
                                      in,
                                      inlen);
@@ -433,10 +626,31 @@ int api_crypto_hash_sha512_update(uint8_t *hash_state,
 int api_crypto_hash_sha512_final(uint8_t *hash_state,
                                  uint8_t *out)
 {
+    if (p_scratch_ws != NULL) {
+        return crypto_hash_sha512_final_ws((crypto_hash_sha512_state *) hash_state,
+                                           out,
+                                           p_scratch_ws);
+    }
     return crypto_hash_sha512_final((crypto_hash_sha512_state *) hash_state,
                                     out);
 }
 
+/**
+ * @brief Generate random bytes.
+ *
+ * @param buffer    Pointer where to place random bytes.
+ * @param length    Number of bytes to generate.
+ *
+ * @return 0    The random bytes could be generated.
+ * @return != 0 The random bytes could not be generated.
+ */
+int api_crypto_randombytes(uint8_t *buffer,
+                           uint64_t length)
+{
+    randombytes(buffer, length);
+    return 0;
+}
+
 
 /*======= Local function implementations ====================================*/
 
@@ -24,6 +24,30 @@
 #define SALT_READ_NONCE_INIT_SERVER             (1U)
 #define SALT_READ_NONCE_INIT_CLIENT             (2U)
 
+/* Number of filled records before the adaptive record size is doubled */
+#define SALT_RECORD_SIZE_GROW_RECORDS           (4U)
+
+/* Exported session, see salt_export_session */
+#define SALT_EXPORT_VERSION                     (0x01U)
+#define SALT_EXPORT_DGRAM_FLAG                  (0x01U)
+#define SALT_EXPORT_VERSION_OFFSET              (0U)
+#define SALT_EXPORT_MODE_OFFSET                 (1U)
+#define SALT_EXPORT_FLAGS_OFFSET                (2U)
+#define SALT_EXPORT_READ_STATE_OFFSET           (3U)
+#define SALT_EXPORT_EK_COMMON_OFFSET            (4U)
+#define SALT_EXPORT_PEER_SK_PUB_OFFSET          (36U)
+#define SALT_EXPORT_WRITE_NONCE_OFFSET          (68U)
+#define SALT_EXPORT_READ_NONCE_OFFSET           (92U)
+#define SALT_EXPORT_MY_EPOCH_OFFSET             (116U)
+#define SALT_EXPORT_PEER_EPOCH_OFFSET           (120U)
+#define SALT_EXPORT_TIME_SUPPORTED_OFFSET       (124U)
+#define SALT_EXPORT_DELAY_THRESHOLD_OFFSET      (128U)
+#define SALT_EXPORT_WRITE_RECORD_OFFSET         (132U)
+#define SALT_EXPORT_READ_TOP_OFFSET             (140U)
+#define SALT_EXPORT_READ_WINDOW_OFFSET          (148U)
+#define SALT_EXPORT_READ_EXPECTED_OFFSET        (156U)
+#define SALT_EXPORT_READ_SIZE_OFFSET            (160U)
+
 /*======= Type Definitions ====================================================*/
 
 /*======= Local variable declarations =========================================*/
@@ -33,6 +57,18 @@ static uint8_t sc2protocol[10] = "SCv2------";
 
 /*======= Local function prototypes ===========================================*/
 
+static void salt_record_size_update(salt_channel_t *p_channel,
+                                    salt_msg_t *p_msg);
+static void salt_dgram_reset(salt_dgram_t *p_dgram);
+static void salt_u64_to_bytes(uint8_t *dest, uint64_t value);
+static uint64_t salt_bytes_to_u64(const uint8_t *src);
+static void salt_sign_pool_lock(salt_sign_pool_t *p_pool);
+static void salt_sign_pool_unlock(salt_sign_pool_t *p_pool);
+static void salt_handshake_buffer_release(salt_channel_t *p_channel);
+static void salt_record_hook_call(salt_channel_t *p_channel,
+                                  uint32_t size,
+                                  bool write);
+
 /*======= Global function implementations =====================================*/
 
 salt_ret_t salt_create(salt_channel_t *p_channel,
@@ -63,6 +99,19 @@ salt_ret_t salt_create(salt_channel_t *p_channel,
     p_channel->err_code = SALT_ERR_NONE;
     p_channel->my_sk_pub = &p_channel->my_sk_sec[32];
     p_channel->p_protocols = NULL;
+    p_channel->p_record_size = NULL;
+    p_channel->p_dgram = NULL;
+    p_channel->p_sign_pool = NULL;
+    p_channel->p_worker = NULL;
+    p_channel->session_hook = NULL;
+    p_channel->p_session_context = NULL;
+    p_channel->peer_check = NULL;
+    p_channel->p_peer_check_context = NULL;
+    p_channel->ek_source = NULL;
+    p_channel->p_ek_source_context = NULL;
+    p_channel->ek_pending = false;
+    p_channel->record_hook = NULL;
+    p_channel->p_record_hook_context = NULL;
     p_channel->delay_threshold = 0;
 
     return SALT_SUCCESS;
@@ -189,6 +238,7 @@ salt_ret_t salt_a1a2(salt_channel_t *p_channel,
     salt_ret_t ret_code = SALT_PENDING;
     uint8_t proceed = 1;
     uint32_t a1_size = 0;
+    salt_state_t old_state;
 
     if (NULL == p_channel) return SALT_ERROR;
     SALT_VERIFY_NOT_NULL(p_buffer);
@@ -198,6 +248,7 @@ salt_ret_t salt_a1a2(salt_channel_t *p_channel,
 
     while (proceed) {
         proceed = 0;
+        old_state = p_channel->state;
         switch (p_channel->state) {
             case SALT_CREATED:
             case SALT_SIGNATURE_SET:
@@ -266,6 +317,7 @@ salt_ret_t salt_a1a2(salt_channel_t *p_channel,
             default:
                 return SALT_ERROR;
         }
+        SALT_PROBE_STATE(p_channel, old_state);
     }
 
     return ret_code;
@@ -355,8 +407,19 @@ salt_ret_t salt_init_session_using_key(salt_channel_t *p_channel,
     p_channel->write_channel.state = SALT_IO_READY;
     p_channel->read_channel.state = SALT_IO_READY;
 
+    if (NULL != p_channel->p_dgram) {
+        salt_dgram_reset(p_channel->p_dgram);
+    }
+
 
-    if ((ek_pub == NULL) || (ek_sec == NULL)) {
+    p_channel->ek_pending = false;
+
+    if (((ek_pub == NULL) || (ek_sec == NULL)) &&
+        (SALT_SERVER == p_channel->mode) && (NULL != p_channel->ek_source)) {
+        /* Created by the source when a valid M1 is received. */
+        p_channel->ek_pending = true;
+    }
+    else if ((ek_pub == NULL) || (ek_sec == NULL)) {
         /*
          * Create ephemeral keypair used for only this session.
          * hdshk_buffer[0:31]:  Public key
@@ -364,7 +427,9 @@ salt_ret_t salt_init_session_using_key(salt_channel_t *p_channel,
          * The ephemeral keypair is kept where the signature later will be
          * until the common key is calculated.
          */
+        SALT_PROBE2(crypto__start, p_channel, SALT_PROBE_CRYPTO_BOX_KEYPAIR);
         int ret = api_crypto_box_keypair(hdshk_buffer, &hdshk_buffer[32]);
+        SALT_PROBE3(crypto__end, p_channel, SALT_PROBE_CRYPTO_BOX_KEYPAIR, ret);
         SALT_VERIFY(0 == ret, SALT_ERR_CRYPTO_API);
     }
     else {
@@ -380,6 +445,29 @@ salt_ret_t salt_init_session_using_key(salt_channel_t *p_channel,
 
 }
 
+salt_ret_t salt_init_session_in_buffer(salt_channel_t *p_channel,
+                                       uint8_t *p_record_buffer,
+                                       uint32_t record_buffer_size)
+{
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY_NOT_NULL(p_record_buffer);
+    SALT_VERIFY(record_buffer_size >= SALT_HNDSHK_BUFFER_SIZE,
+                SALT_ERR_BUFF_TO_SMALL);
+
+    /*
+     * Only the first SALT_HNDSHK_BUFFER_SIZE bytes are used, and later
+     * cleared, so that the rest of the record buffer is left untouched.
+     */
+    return salt_init_session_using_key(p_channel,
+                                       p_record_buffer,
+                                       SALT_HNDSHK_BUFFER_SIZE,
+                                       NULL,
+                                       NULL);
+}
+
 salt_ret_t salt_set_delay_threshold(salt_channel_t *p_channel, uint32_t delay_threshold)
 {
 
@@ -414,8 +502,7 @@ salt_ret_t salt_handshake(salt_channel_t *p_channel, const uint8_t *p_with)
     }
 
     if (SALT_PENDING != ret) {
-        /* If handshake succeeded or failed, clear the handshake buffer. */
-        memset(p_channel->hdshk_buffer, 0x00U, p_channel->hdshk_buffer_size);
+        salt_handshake_buffer_release(p_channel);
     }
 
     return ret;
@@ -438,8 +525,7 @@ salt_ret_t salt_handshake_server(salt_channel_t *p_channel, const uint8_t *p_wit
     ret = salti_handshake_server(p_channel, p_with);
 
     if (SALT_PENDING != ret) {
-        /* If handshake succeeded or failed, clear the handshake buffer. */
-        memset(p_channel->hdshk_buffer, 0x00U, p_channel->hdshk_buffer_size);
+        salt_handshake_buffer_release(p_channel);
     }
 
     return ret;
@@ -462,8 +548,7 @@ salt_ret_t salt_handshake_client(salt_channel_t *p_channel, const uint8_t *p_wit
     ret = salti_handshake_client(p_channel, p_with);
 
     if (SALT_PENDING != ret) {
-        /* If handshake succeeded or failed, clear the handshake buffer. */
-        memset(p_channel->hdshk_buffer, 0x00U, p_channel->hdshk_buffer_size);
+        salt_handshake_buffer_release(p_channel);
     }
 
     return ret;
@@ -476,8 +561,7 @@ salt_ret_t salt_read_begin(salt_channel_t *p_channel,
                            salt_msg_t *p_msg)
 {
     salt_ret_t ret;
-    uint32_t size = buffer_size - 14U;
-    uint8_t *header;
+    uint32_t size = buffer_size - SALT_READ_RECORD_OFFSET;
 
     if (NULL == p_channel) {
         return SALT_ERROR;
@@ -489,33 +573,59 @@ salt_ret_t salt_read_begin(salt_channel_t *p_channel,
     SALT_VERIFY(buffer_size >= SALT_OVERHEAD_SIZE, SALT_ERR_BUFF_TO_SMALL);
     SALT_VERIFY(NULL != p_msg, SALT_ERR_NULL_PTR);
 
-    ret = salti_io_read(p_channel, &p_buffer[14], &size);
+    ret = salti_io_read(p_channel, &p_buffer[SALT_READ_RECORD_OFFSET], &size);
 
     if (SALT_SUCCESS == ret) {
+        ret = salt_read_unwrap(p_channel, p_buffer, size, p_msg);
+    }
 
-        /*
-         * salti_unwrap returns pointer to clear text message to
-         * p_buffer and the length of the clear text message to
-         * size.
-         */
-        ret = salti_unwrap(p_channel,
-                           p_buffer,
-                           size,
-                           &header,
-                           &p_buffer,
-                           &size);
-
-        SALT_VERIFY(SALT_SUCCESS == ret, p_channel->err_code);
+    return ret;
+}
 
-        SALT_VERIFY(((SALT_APP_PKG_MSG_HEADER_VALUE == header[0]) ||
-                     (SALT_MULTI_APP_PKG_MSG_HEADER_VALUE == header[0])) &&
-                    (header[1] == 0x00U), SALT_ERR_BAD_PROTOCOL);
+salt_ret_t salt_read_unwrap(salt_channel_t *p_channel,
+                            uint8_t *p_buffer,
+                            uint32_t size,
+                            salt_msg_t *p_msg)
+{
+    salt_ret_t ret;
+    uint8_t *header;
+    uint32_t record_size = SALT_LENGTH_SIZE + size;
 
-        salt_err_t err_code = salt_read_init(header[0], p_buffer, size, p_msg);
-        SALT_VERIFY(err_code == SALT_ERR_NONE, err_code);
+    if (NULL == p_channel) {
+        return SALT_ERROR;
     }
 
-    return ret;
+    SALT_VERIFY(SALT_SESSION_ESTABLISHED == p_channel->state,
+                SALT_ERR_INVALID_STATE);
+
+    SALT_VERIFY_NOT_NULL(p_buffer);
+    SALT_VERIFY(NULL != p_msg, SALT_ERR_NULL_PTR);
+    SALT_VERIFY(size >= SALT_WRAP_OVERHEAD_IO_SIZE, SALT_ERR_BAD_PROTOCOL);
+
+    /*
+     * salti_unwrap returns pointer to clear text message to
+     * p_buffer and the length of the clear text message to
+     * size.
+     */
+    ret = salti_unwrap(p_channel,
+                       p_buffer,
+                       size,
+                       &header,
+                       &p_buffer,
+                       &size);
+
+    SALT_VERIFY(SALT_SUCCESS == ret, p_channel->err_code);
+
+    SALT_VERIFY(((SALT_APP_PKG_MSG_HEADER_VALUE == header[0]) ||
+                 (SALT_MULTI_APP_PKG_MSG_HEADER_VALUE == header[0])) &&
+                (header[1] == 0x00U), SALT_ERR_BAD_PROTOCOL);
+
+    salt_err_t err_code = salt_read_init(header[0], p_buffer, size, p_msg);
+    SALT_VERIFY(err_code == SALT_ERR_NONE, err_code);
+
+    salt_record_hook_call(p_channel, record_size, false);
+
+    return SALT_SUCCESS;
 }
 
 salt_ret_t salt_read_next(salt_msg_t *p_msg)
@@ -668,17 +778,10 @@ salt_ret_t salt_write_execute(salt_channel_t *p_channel,
                 SALT_ERR_INVALID_STATE);
 
     if (p_msg->write.state < SALT_WRITE_STATE_ERROR) {
-        uint8_t type = salt_write_create(p_msg);
-        p_msg->write.state = SALT_WRITE_STATE_ERROR;
-        ret = salti_wrap(p_channel,
-                         p_msg->write.p_buffer,
-                         p_msg->write.buffer_size,
-                         type,
-                         &p_msg->write.p_buffer,
-                         &p_msg->write.buffer_size,
-                         last_msg);
-        SALT_VERIFY(SALT_SUCCESS == ret, p_channel->err_code);
-        p_msg->write.state = SALT_WRITE_STATE_WRAPPED;
+        ret = salt_write_wrap(p_channel, p_msg, last_msg);
+        if (SALT_SUCCESS != ret) {
+            return ret;
+        }
     }
     else if (SALT_WRITE_STATE_ERROR == p_msg->write.state) {
         return SALT_ERROR;
@@ -691,4 +794,823 @@ salt_ret_t salt_write_execute(salt_channel_t *p_channel,
     return ret;
 }
 
+salt_ret_t salt_write_wrap(salt_channel_t *p_channel,
+                           salt_msg_t *p_msg,
+                           bool last_msg)
+{
+    salt_ret_t ret;
+
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY(SALT_SESSION_ESTABLISHED == p_channel->state,
+                SALT_ERR_INVALID_STATE);
+    SALT_VERIFY_NOT_NULL(p_msg);
+
+    SALT_VERIFY(p_msg->write.state < SALT_WRITE_STATE_ERROR,
+                SALT_ERR_INVALID_STATE);
+
+    salt_record_size_update(p_channel, p_msg);
+    uint8_t type = salt_write_create(p_msg);
+    p_msg->write.state = SALT_WRITE_STATE_ERROR;
+    ret = salti_wrap(p_channel,
+                     p_msg->write.p_buffer,
+                     p_msg->write.buffer_size,
+                     type,
+                     &p_msg->write.p_buffer,
+                     &p_msg->write.buffer_size,
+                     last_msg);
+    SALT_VERIFY(SALT_SUCCESS == ret, p_channel->err_code);
+    p_msg->write.state = SALT_WRITE_STATE_WRAPPED;
+
+    salt_record_hook_call(p_channel, p_msg->write.buffer_size, true);
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_write_broadcast(salt_msg_t *p_msg,
+                                salt_channel_t **pp_channels,
+                                salt_msg_t *p_records,
+                                uint32_t count,
+                                uint8_t *p_pool,
+                                uint32_t pool_size,
+                                bool last_msg)
+{
+    uint8_t *p_clear;
+    uint32_t clear_size;
+    uint32_t record_size;
+    uint8_t type;
+
+    if ((NULL == p_msg) || (NULL == pp_channels) || (NULL == p_records) ||
+        (NULL == p_pool) || (0U == count)) {
+        return SALT_ERROR;
+    }
+
+    if ((p_msg->write.state >= SALT_WRITE_STATE_ERROR) ||
+        (0U == p_msg->write.message_count)) {
+        return SALT_ERROR;
+    }
+
+    record_size = p_msg->write.buffer_size - p_msg->write.buffer_available;
+    if (((uint64_t) record_size * count) > pool_size) {
+        return SALT_ERROR;
+    }
+
+    /* The framing is the same for all sessions, see salt_write_create. */
+    if (1U == p_msg->write.message_count) {
+        type = SALT_APP_PKG_MSG_HEADER_VALUE;
+        p_clear = &p_msg->write.p_buffer[SALT_OVERHEAD_SIZE + 4U];
+        clear_size = record_size - SALT_OVERHEAD_SIZE - 4U;
+    }
+    else {
+        type = SALT_MULTI_APP_PKG_MSG_HEADER_VALUE;
+        p_clear = &p_msg->write.p_buffer[SALT_OVERHEAD_SIZE];
+        clear_size = record_size - SALT_OVERHEAD_SIZE;
+        salti_u16_to_bytes(p_clear, p_msg->write.message_count);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        salt_channel_t *p_channel = pp_channels[i];
+        salt_msg_t *p_record = &p_records[i];
+
+        p_record->write.state = SALT_WRITE_STATE_ERROR;
+        p_record->write.p_buffer = NULL;
+        p_record->write.buffer_size = 0;
+        p_record->write.buffer_available = 0;
+        p_record->write.message_count = p_msg->write.message_count;
+
+        if ((NULL == p_channel) || (SALT_SESSION_ESTABLISHED != p_channel->state)) {
+            continue;
+        }
+
+        salt_record_size_update(p_channel, p_msg);
+        if (salti_wrap_to(p_channel,
+                          &p_pool[(uint64_t) record_size * i],
+                          p_clear,
+                          clear_size,
+                          type,
+                          &p_record->write.p_buffer,
+                          &p_record->write.buffer_size,
+                          last_msg) == SALT_SUCCESS) {
+            p_record->write.p_payload = p_record->write.p_buffer;
+            p_record->write.state = SALT_WRITE_STATE_WRAPPED;
+            salt_record_hook_call(p_channel, p_record->write.buffer_size, true);
+        }
+    }
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_record_size_init(salt_channel_t *p_channel,
+                                 salt_record_size_t *p_record_size,
+                                 uint32_t min_size,
+                                 uint32_t max_size,
+                                 uint32_t idle_threshold)
+{
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY_NOT_NULL(p_record_size);
+    SALT_VERIFY(min_size > SALT_WRITE_OVERHEAD_SIZE, SALT_ERR_BUFF_TO_SMALL);
+    SALT_VERIFY(max_size >= min_size, SALT_ERR_BUFF_TO_SMALL);
+
+    p_record_size->min_size = min_size;
+    p_record_size->max_size = max_size;
+    p_record_size->idle_threshold = idle_threshold;
+    salt_record_size_reset(p_record_size);
+
+    p_channel->p_record_size = p_record_size;
+
+    return SALT_SUCCESS;
+}
+
+uint32_t salt_record_size_next(salt_channel_t *p_channel, uint32_t buffer_size)
+{
+    salt_record_size_t *p_record_size;
+    uint32_t now;
+
+    if ((NULL == p_channel) || (NULL == p_channel->p_record_size)) {
+        return buffer_size;
+    }
+
+    p_record_size = p_channel->p_record_size;
+
+    /*
+     * If the stream has been idle, the congestion window of the transport is
+     * likely reduced. Start over with small records.
+     */
+    if ((p_record_size->size > p_record_size->min_size) &&
+        (salti_get_time(p_channel, &now) == SALT_SUCCESS) &&
+        ((now - p_record_size->last_write) > p_record_size->idle_threshold)) {
+        salt_record_size_reset(p_record_size);
+    }
+
+    return (p_record_size->size < buffer_size) ? p_record_size->size : buffer_size;
+}
+
+void salt_record_size_reset(salt_record_size_t *p_record_size)
+{
+    if (NULL == p_record_size) {
+        return;
+    }
+
+    p_record_size->size = p_record_size->min_size;
+    p_record_size->full_records = 0;
+}
+
+salt_ret_t salt_dgram_init(salt_channel_t *p_channel,
+                           salt_dgram_t *p_dgram,
+                           salt_io_impl write_impl,
+                           salt_io_impl read_impl,
+                           void *p_write_context,
+                           void *p_read_context)
+{
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY_NOT_NULL(p_dgram);
+    SALT_VERIFY_NOT_NULL(write_impl);
+    SALT_VERIFY_NOT_NULL(read_impl);
+    SALT_VERIFY(p_channel->state <= SALT_SESSION_INITIATED,
+                SALT_ERR_INVALID_STATE);
+
+    memset(p_dgram, 0x00U, sizeof(salt_dgram_t));
+    p_dgram->write_impl = write_impl;
+    p_dgram->read_impl = read_impl;
+    p_dgram->write_channel.p_context = p_write_context;
+    p_dgram->read_channel.p_context = p_read_context;
+    salt_dgram_reset(p_dgram);
+
+    p_channel->p_dgram = p_dgram;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_dgram_write(salt_channel_t *p_channel,
+                            uint8_t *p_buffer,
+                            uint32_t size)
+{
+    salt_io_channel_t *channel;
+    salt_ret_t ret;
+
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY(SALT_SESSION_ESTABLISHED == p_channel->state,
+                SALT_ERR_INVALID_STATE);
+    SALT_VERIFY((NULL != p_channel->p_dgram) && p_channel->p_dgram->negotiated,
+                SALT_ERR_NOT_SUPPORTED);
+    SALT_VERIFY_NOT_NULL(p_buffer);
+
+    channel = &p_channel->p_dgram->write_channel;
+
+    /* A pending record is already encrypted, only send it again. */
+    if (SALT_IO_READY == channel->state) {
+        ret = salti_dgram_wrap(p_channel,
+                               p_buffer,
+                               size,
+                               &channel->p_data,
+                               &channel->size_expected);
+        SALT_VERIFY(SALT_SUCCESS == ret, p_channel->err_code);
+        channel->size = 0;
+        channel->state = SALT_IO_PENDING;
+        salt_record_hook_call(p_channel, channel->size_expected, true);
+    }
+
+    ret = p_channel->p_dgram->write_impl(channel);
+
+    if (SALT_PENDING != ret) {
+        channel->state = SALT_IO_READY;
+    }
+
+    if (SALT_ERROR == ret) {
+        p_channel->err_code = channel->err_code;
+    }
+
+    return ret;
+}
+
+salt_ret_t salt_dgram_read(salt_channel_t *p_channel,
+                           uint8_t *p_buffer,
+                           uint32_t buffer_size,
+                           uint8_t **pp_message,
+                           uint32_t *p_size)
+{
+    salt_io_channel_t *channel;
+    salt_ret_t ret;
+
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY(SALT_SESSION_ESTABLISHED == p_channel->state,
+                SALT_ERR_INVALID_STATE);
+    SALT_VERIFY((NULL != p_channel->p_dgram) && p_channel->p_dgram->negotiated,
+                SALT_ERR_NOT_SUPPORTED);
+    SALT_VERIFY_NOT_NULL(p_buffer);
+    SALT_VERIFY_NOT_NULL(pp_message);
+    SALT_VERIFY_NOT_NULL(p_size);
+    SALT_VERIFY(buffer_size > SALT_DGRAM_OVERHEAD_SIZE, SALT_ERR_BUFF_TO_SMALL);
+
+    channel = &p_channel->p_dgram->read_channel;
+
+    for (;;) {
+        channel->p_data = &p_buffer[SALT_DGRAM_WIRE_OFFSET];
+        channel->max_size = buffer_size - SALT_DGRAM_WIRE_OFFSET;
+        channel->size_expected = channel->max_size;
+        channel->size = 0;
+
+        ret = p_channel->p_dgram->read_impl(channel);
+
+        if (SALT_ERROR == ret) {
+            p_channel->err_code = channel->err_code;
+        }
+
+        if (SALT_SUCCESS != ret) {
+            return ret;
+        }
+
+        if ((channel->size <= channel->max_size) &&
+            (salti_dgram_unwrap(p_channel,
+                                p_buffer,
+                                channel->size,
+                                pp_message,
+                                p_size) == SALT_SUCCESS)) {
+            salt_record_hook_call(p_channel, channel->size, false);
+            return SALT_SUCCESS;
+        }
+
+        p_channel->p_dgram->dropped++;
+    }
+}
+
+salt_ret_t salt_export_session(salt_channel_t *p_channel,
+                               uint8_t *p_buffer,
+                               uint32_t buffer_size,
+                               uint32_t *p_size)
+{
+    salt_io_channel_t *p_read = NULL;
+    salt_dgram_t *p_dgram;
+    uint32_t partial_size = 0;
+    bool partial;
+
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY(SALT_SESSION_ESTABLISHED == p_channel->state,
+                SALT_ERR_INVALID_STATE);
+    SALT_VERIFY_NOT_NULL(p_buffer);
+    SALT_VERIFY_NOT_NULL(p_size);
+
+    /* The rest of a pending record is in the user buffer, not in the channel. */
+    if (SALT_IO_READY != p_channel->write_channel.state) {
+        return SALT_PENDING;
+    }
+
+    /*
+     * In SALT_IO_SIZE the bytes read are a part of the size, in
+     * SALT_IO_PENDING the size is known and the bytes read are a part of
+     * the record.
+     */
+    p_read = &p_channel->read_channel;
+    partial = (SALT_IO_PENDING == p_read->state) ||
+              ((SALT_IO_SIZE == p_read->state) && (p_read->size > 0));
+    if (partial) {
+        partial_size = p_read->size;
+    }
+
+    SALT_VERIFY(buffer_size >= SALT_EXPORT_SIZE + partial_size,
+                SALT_ERR_BUFF_TO_SMALL);
+
+    memset(p_buffer, 0x00U, SALT_EXPORT_SIZE);
+    p_buffer[SALT_EXPORT_VERSION_OFFSET] = SALT_EXPORT_VERSION;
+    p_buffer[SALT_EXPORT_MODE_OFFSET] = (uint8_t) p_channel->mode;
+    p_buffer[SALT_EXPORT_READ_STATE_OFFSET] = (uint8_t) p_read->state;
+    memcpy(&p_buffer[SALT_EXPORT_EK_COMMON_OFFSET],
+           p_channel->ek_common, api_crypto_box_BEFORENMBYTES);
+    memcpy(&p_buffer[SALT_EXPORT_PEER_SK_PUB_OFFSET],
+           p_channel->peer_sk_pub, api_crypto_sign_PUBLICKEYBYTES);
+    memcpy(&p_buffer[SALT_EXPORT_WRITE_NONCE_OFFSET],
+           p_channel->write_nonce, api_crypto_box_NONCEBYTES);
+    memcpy(&p_buffer[SALT_EXPORT_READ_NONCE_OFFSET],
+           p_channel->read_nonce, api_crypto_box_NONCEBYTES);
+    salti_u32_to_bytes(&p_buffer[SALT_EXPORT_MY_EPOCH_OFFSET], p_channel->my_epoch);
+    salti_u32_to_bytes(&p_buffer[SALT_EXPORT_PEER_EPOCH_OFFSET], p_channel->peer_epoch);
+    salti_u32_to_bytes(&p_buffer[SALT_EXPORT_TIME_SUPPORTED_OFFSET], p_channel->time_supported);
+    salti_u32_to_bytes(&p_buffer[SALT_EXPORT_DELAY_THRESHOLD_OFFSET], p_channel->delay_threshold);
+
+    p_dgram = p_channel->p_dgram;
+    if ((NULL != p_dgram) && p_dgram->negotiated) {
+        p_buffer[SALT_EXPORT_FLAGS_OFFSET] |= SALT_EXPORT_DGRAM_FLAG;
+        salt_u64_to_bytes(&p_buffer[SALT_EXPORT_WRITE_RECORD_OFFSET], p_dgram->write_record);
+        salt_u64_to_bytes(&p_buffer[SALT_EXPORT_READ_TOP_OFFSET], p_dgram->read_top);
+        salt_u64_to_bytes(&p_buffer[SALT_EXPORT_READ_WINDOW_OFFSET], p_dgram->read_window);
+    }
+
+    if (partial) {
+        salti_u32_to_bytes(&p_buffer[SALT_EXPORT_READ_EXPECTED_OFFSET], p_read->size_expected);
+        salti_u32_to_bytes(&p_buffer[SALT_EXPORT_READ_SIZE_OFFSET], partial_size);
+        memcpy(&p_buffer[SALT_EXPORT_SIZE], p_read->p_data, partial_size);
+    }
+    else {
+        /* Nothing of the next record is received, start with the size. */
+        p_buffer[SALT_EXPORT_READ_STATE_OFFSET] = (uint8_t) SALT_IO_READY;
+    }
+
+    *p_size = SALT_EXPORT_SIZE + partial_size;
+
+    /* The session now belongs to the importer. */
+    memset(p_channel->ek_common, 0x00U, sizeof(p_channel->ek_common));
+    salti_session_close(p_channel);
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_import_session(salt_channel_t *p_channel,
+                               const uint8_t *p_buffer,
+                               uint32_t size,
+                               uint8_t *p_read_buffer,
+                               uint32_t read_buffer_size)
+{
+    salt_io_channel_t *p_read;
+    salt_dgram_t *p_dgram;
+    salt_io_state_t read_state;
+    uint32_t size_expected;
+    uint32_t partial_size;
+
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY((SALT_CREATED == p_channel->state) ||
+                (SALT_SIGNATURE_SET == p_channel->state),
+                SALT_ERR_INVALID_STATE);
+    SALT_VERIFY_NOT_NULL(p_buffer);
+    SALT_VERIFY(size >= SALT_EXPORT_SIZE, SALT_ERR_BAD_PROTOCOL);
+    SALT_VERIFY((SALT_EXPORT_VERSION == p_buffer[SALT_EXPORT_VERSION_OFFSET]) &&
+                ((uint8_t) p_channel->mode == p_buffer[SALT_EXPORT_MODE_OFFSET]),
+                SALT_ERR_BAD_PROTOCOL);
+
+    read_state = (salt_io_state_t) p_buffer[SALT_EXPORT_READ_STATE_OFFSET];
+    size_expected = salti_bytes_to_u32((uint8_t *) &p_buffer[SALT_EXPORT_READ_EXPECTED_OFFSET]);
+    partial_size = salti_bytes_to_u32((uint8_t *) &p_buffer[SALT_EXPORT_READ_SIZE_OFFSET]);
+
+    SALT_VERIFY(size == SALT_EXPORT_SIZE + partial_size, SALT_ERR_BAD_PROTOCOL);
+    SALT_VERIFY((SALT_IO_READY == read_state) ||
+                (SALT_IO_SIZE == read_state) ||
+                (SALT_IO_PENDING == read_state), SALT_ERR_BAD_PROTOCOL);
+    SALT_VERIFY(partial_size <= size_expected, SALT_ERR_BAD_PROTOCOL);
+    SALT_VERIFY((SALT_IO_READY != read_state) || (0 == partial_size),
+                SALT_ERR_BAD_PROTOCOL);
+
+    p_read = &p_channel->read_channel;
+    if (SALT_IO_READY != read_state) {
+        /* Same layout as salt_read_begin, the record is read to p_read_buffer[14]. */
+        SALT_VERIFY_NOT_NULL(p_read_buffer);
+        SALT_VERIFY(read_buffer_size >= SALT_OVERHEAD_SIZE, SALT_ERR_BUFF_TO_SMALL);
+        SALT_VERIFY(size_expected <= read_buffer_size - 14U, SALT_ERR_BUFF_TO_SMALL);
+        p_read->p_data = &p_read_buffer[14];
+        p_read->max_size = read_buffer_size - 14U;
+        p_read->size_expected = size_expected;
+        p_read->size = partial_size;
+        memcpy(p_read->p_data, &p_buffer[SALT_EXPORT_SIZE], partial_size);
+    }
+    p_read->state = read_state;
+    p_channel->write_channel.state = SALT_IO_READY;
+
+    p_dgram = p_channel->p_dgram;
+    if (p_buffer[SALT_EXPORT_FLAGS_OFFSET] & SALT_EXPORT_DGRAM_FLAG) {
+        SALT_VERIFY_NOT_NULL(p_dgram);
+        salt_dgram_reset(p_dgram);
+        p_dgram->write_record = salt_bytes_to_u64(&p_buffer[SALT_EXPORT_WRITE_RECORD_OFFSET]);
+        p_dgram->read_top = salt_bytes_to_u64(&p_buffer[SALT_EXPORT_READ_TOP_OFFSET]);
+        p_dgram->read_window = salt_bytes_to_u64(&p_buffer[SALT_EXPORT_READ_WINDOW_OFFSET]);
+        p_dgram->negotiated = true;
+    }
+    else if (NULL != p_dgram) {
+        salt_dgram_reset(p_dgram);
+    }
+
+    memcpy(p_channel->ek_common,
+           &p_buffer[SALT_EXPORT_EK_COMMON_OFFSET], api_crypto_box_BEFORENMBYTES);
+    memcpy(p_channel->peer_sk_pub,
+           &p_buffer[SALT_EXPORT_PEER_SK_PUB_OFFSET], api_crypto_sign_PUBLICKEYBYTES);
+    memcpy(p_channel->write_nonce,
+           &p_buffer[SALT_EXPORT_WRITE_NONCE_OFFSET], api_crypto_box_NONCEBYTES);
+    memcpy(p_channel->read_nonce,
+           &p_buffer[SALT_EXPORT_READ_NONCE_OFFSET], api_crypto_box_NONCEBYTES);
+    p_channel->my_epoch = salti_bytes_to_u32((uint8_t *) &p_buffer[SALT_EXPORT_MY_EPOCH_OFFSET]);
+    p_channel->peer_epoch = salti_bytes_to_u32((uint8_t *) &p_buffer[SALT_EXPORT_PEER_EPOCH_OFFSET]);
+    p_channel->time_supported = salti_bytes_to_u32((uint8_t *) &p_buffer[SALT_EXPORT_TIME_SUPPORTED_OFFSET]);
+    p_channel->delay_threshold = salti_bytes_to_u32((uint8_t *) &p_buffer[SALT_EXPORT_DELAY_THRESHOLD_OFFSET]);
+
+    p_channel->hdshk_buffer = NULL;
+    p_channel->hdshk_buffer_size = 0;
+    p_channel->err_code = SALT_ERR_NONE;
+    salti_session_established(p_channel);
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_sign_pool_init(salt_sign_pool_t *p_pool,
+                               salt_sign_pool_entry_t *p_entries,
+                               uint32_t count,
+                               const uint8_t *p_sk_sec,
+                               salt_sign_pool_lock_t lock,
+                               salt_sign_pool_lock_t unlock,
+                               void *p_lock_context)
+{
+    if ((NULL == p_pool) || (NULL == p_entries) || (NULL == p_sk_sec) || (0 == count)) {
+        return SALT_ERROR;
+    }
+
+    if ((NULL == lock) != (NULL == unlock)) {
+        return SALT_ERROR;
+    }
+
+    memset(p_pool, 0x00U, sizeof(salt_sign_pool_t));
+    memset(p_entries, 0x00U, sizeof(salt_sign_pool_entry_t) * count);
+    p_pool->p_entries = p_entries;
+    p_pool->count = count;
+    p_pool->p_sk_sec = p_sk_sec;
+    p_pool->lock = lock;
+    p_pool->unlock = unlock;
+    p_pool->p_lock_context = p_lock_context;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_sign_pool_fill(salt_sign_pool_t *p_pool)
+{
+    salt_sign_pool_entry_t *p_entry = NULL;
+    int ret;
+
+    if (NULL == p_pool) {
+        return SALT_ERROR;
+    }
+
+    /* Reserve an entry so that no other thread fills or takes it. */
+    salt_sign_pool_lock(p_pool);
+    for (uint32_t i = 0; i < p_pool->count; i++) {
+        if (SALT_SIGN_POOL_EMPTY == p_pool->p_entries[i].state) {
+            p_entry = &p_pool->p_entries[i];
+            p_entry->state = SALT_SIGN_POOL_FILLING;
+            break;
+        }
+    }
+    salt_sign_pool_unlock(p_pool);
+
+    if (NULL == p_entry) {
+        return SALT_PENDING;
+    }
+
+    ret = api_crypto_sign_precompute(p_entry->precomputed, p_pool->p_sk_sec);
+
+    salt_sign_pool_lock(p_pool);
+    if (0 == ret) {
+        p_entry->state = SALT_SIGN_POOL_READY;
+    }
+    else {
+        memset(p_entry->precomputed, 0x00U, sizeof(p_entry->precomputed));
+        p_entry->state = SALT_SIGN_POOL_EMPTY;
+    }
+    salt_sign_pool_unlock(p_pool);
+
+    return (0 == ret) ? SALT_SUCCESS : SALT_ERROR;
+}
+
+salt_ret_t salt_sign_pool_take(salt_sign_pool_t *p_pool,
+                               const uint8_t *p_sk_pub,
+                               uint8_t *p_precomputed)
+{
+    salt_ret_t ret = SALT_PENDING;
+
+    if ((NULL == p_pool) || (NULL == p_sk_pub) || (NULL == p_precomputed)) {
+        return SALT_ERROR;
+    }
+
+    if (memcmp(&p_pool->p_sk_sec[32], p_sk_pub, api_crypto_sign_PUBLICKEYBYTES) != 0) {
+        return SALT_ERROR;
+    }
+
+    salt_sign_pool_lock(p_pool);
+    for (uint32_t i = 0; i < p_pool->count; i++) {
+        salt_sign_pool_entry_t *p_entry = &p_pool->p_entries[i];
+        if (SALT_SIGN_POOL_READY == p_entry->state) {
+            memcpy(p_precomputed, p_entry->precomputed, sizeof(p_entry->precomputed));
+            memset(p_entry->precomputed, 0x00U, sizeof(p_entry->precomputed));
+            p_entry->state = SALT_SIGN_POOL_EMPTY;
+            ret = SALT_SUCCESS;
+            break;
+        }
+    }
+
+    if (SALT_SUCCESS == ret) {
+        p_pool->taken++;
+    }
+    else {
+        p_pool->missed++;
+    }
+    salt_sign_pool_unlock(p_pool);
+
+    return ret;
+}
+
+uint32_t salt_sign_pool_available(salt_sign_pool_t *p_pool)
+{
+    uint32_t available = 0;
+
+    if (NULL == p_pool) {
+        return 0;
+    }
+
+    salt_sign_pool_lock(p_pool);
+    for (uint32_t i = 0; i < p_pool->count; i++) {
+        if (SALT_SIGN_POOL_READY == p_pool->p_entries[i].state) {
+            available++;
+        }
+    }
+    salt_sign_pool_unlock(p_pool);
+
+    return available;
+}
+
+salt_ret_t salt_set_sign_pool(salt_channel_t *p_channel,
+                              salt_sign_pool_t *p_pool)
+{
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY(p_channel->state <= SALT_SESSION_INITIATED,
+                SALT_ERR_INVALID_STATE);
+
+    p_channel->p_sign_pool = p_pool;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_set_peer_check(salt_channel_t *p_channel,
+                               salt_peer_check_t check,
+                               void *p_context)
+{
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY(p_channel->state <= SALT_SESSION_INITIATED,
+                SALT_ERR_INVALID_STATE);
+
+    p_channel->peer_check = check;
+    p_channel->p_peer_check_context = p_context;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_set_ephemeral_source(salt_channel_t *p_channel,
+                                     salt_ephemeral_source_t source,
+                                     void *p_context)
+{
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY(SALT_SERVER == p_channel->mode, SALT_ERR_NOT_SUPPORTED);
+    SALT_VERIFY(p_channel->state < SALT_SESSION_INITIATED,
+                SALT_ERR_INVALID_STATE);
+
+    p_channel->ek_source = source;
+    p_channel->p_ek_source_context = p_context;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_ephemeral_keypair(void *p_context,
+                                  uint8_t *p_ek_pub,
+                                  uint8_t *p_ek_sec)
+{
+    (void) p_context;
+
+    if ((NULL == p_ek_pub) || (NULL == p_ek_sec)) {
+        return SALT_ERROR;
+    }
+
+    return (0 == api_crypto_box_keypair(p_ek_pub, p_ek_sec)) ?
+           SALT_SUCCESS : SALT_ERROR;
+}
+
+salt_ret_t salt_set_record_hook(salt_channel_t *p_channel,
+                                salt_record_hook_t hook,
+                                void *p_context)
+{
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    p_channel->record_hook = hook;
+    p_channel->p_record_hook_context = p_context;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_worker_init(salt_channel_t *p_channel,
+                            salt_worker_t *p_worker,
+                            salt_worker_start_t start,
+                            salt_worker_poll_t poll,
+                            void *p_context)
+{
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY_NOT_NULL(p_worker);
+    SALT_VERIFY_NOT_NULL(start);
+    SALT_VERIFY_NOT_NULL(poll);
+    SALT_VERIFY(SALT_CLIENT == p_channel->mode, SALT_ERR_NOT_SUPPORTED);
+    SALT_VERIFY(p_channel->state <= SALT_SESSION_INITIATED,
+                SALT_ERR_INVALID_STATE);
+
+    memset(p_worker, 0x00U, sizeof(salt_worker_t));
+    p_worker->start = start;
+    p_worker->poll = poll;
+    p_worker->p_context = p_context;
+
+    p_channel->p_worker = p_worker;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_set_session_hook(salt_channel_t *p_channel,
+                                 salt_session_hook_t hook,
+                                 void *p_context)
+{
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY(p_channel->state <= SALT_SESSION_INITIATED,
+                SALT_ERR_INVALID_STATE);
+
+    p_channel->session_hook = hook;
+    p_channel->p_session_context = p_context;
+
+    return SALT_SUCCESS;
+}
+
 /*======= Local function implementations ======================================*/
+
+/**
+ * @brief Resets the record numbers and the replay window for a new session.
+ */
+static void salt_dgram_reset(salt_dgram_t *p_dgram)
+{
+    p_dgram->write_record = 0;
+    p_dgram->read_top = 0;
+    p_dgram->read_window = 0;
+    p_dgram->dropped = 0;
+    p_dgram->negotiated = false;
+    p_dgram->write_channel.state = SALT_IO_READY;
+    p_dgram->read_channel.state = SALT_IO_READY;
+}
+
+/**
+ * @brief Little endian serialization of the 64 bit datagram counters.
+ */
+static void salt_u64_to_bytes(uint8_t *dest, uint64_t value)
+{
+    salti_u32_to_bytes(dest, (uint32_t) value);
+    salti_u32_to_bytes(&dest[4], (uint32_t) (value >> 32));
+}
+
+static uint64_t salt_bytes_to_u64(const uint8_t *src)
+{
+    return ((uint64_t) salti_bytes_to_u32((uint8_t *) &src[4]) << 32) |
+           salti_bytes_to_u32((uint8_t *) src);
+}
+
+/**
+ * @brief Updates the adaptive record size when a record is about to be written.
+ *
+ * A record that uses at least half of the current record size indicates a busy
+ * stream. After SALT_RECORD_SIZE_GROW_RECORDS such records the size is doubled.
+ */
+static void salt_record_size_update(salt_channel_t *p_channel,
+                                    salt_msg_t *p_msg)
+{
+    salt_record_size_t *p_record_size = p_channel->p_record_size;
+    uint32_t used;
+
+    if (NULL == p_record_size) {
+        return;
+    }
+
+    salti_get_time(p_channel, &p_record_size->last_write);
+
+    used = p_msg->write.buffer_size - p_msg->write.buffer_available;
+    if ((used * 2U) < p_record_size->size) {
+        return;
+    }
+
+    p_record_size->full_records++;
+    if ((p_record_size->full_records >= SALT_RECORD_SIZE_GROW_RECORDS) &&
+        (p_record_size->size < p_record_size->max_size)) {
+        p_record_size->size = (p_record_size->size > (p_record_size->max_size / 2U)) ?
+            p_record_size->max_size : p_record_size->size * 2U;
+        p_record_size->full_records = 0;
+    }
+}
+
+/**
+ * @brief Locks the signature pool if a lock implementation is given.
+ */
+static void salt_sign_pool_lock(salt_sign_pool_t *p_pool)
+{
+    if (NULL != p_pool->lock) {
+        p_pool->lock(p_pool->p_lock_context);
+    }
+}
+
+/**
+ * @brief Unlocks the signature pool if a lock implementation is given.
+ */
+static void salt_sign_pool_unlock(salt_sign_pool_t *p_pool)
+{
+    if (NULL != p_pool->unlock) {
+        p_pool->unlock(p_pool->p_lock_context);
+    }
+}
+
+/**
+ * @brief Clears the handshake buffer and releases it from the channel.
+ *
+ * The buffer may be a part of a record buffer, see
+ * salt_init_session_in_buffer, and must not be touched after the handshake.
+ */
+static void salt_handshake_buffer_release(salt_channel_t *p_channel)
+{
+    if (NULL != p_channel->hdshk_buffer) {
+        memset(p_channel->hdshk_buffer, 0x00U, p_channel->hdshk_buffer_size);
+    }
+    p_channel->hdshk_buffer = NULL;
+    p_channel->hdshk_buffer_size = 0;
+}
+
+/**
+ * @brief Passes a wrapped or unwrapped record to the hook of the channel.
+ */
+static void salt_record_hook_call(salt_channel_t *p_channel,
+                                  uint32_t size,
+                                  bool write)
+{
+    if (NULL != p_channel->record_hook) {
+        p_channel->record_hook(p_channel->p_record_hook_context,
+                               p_channel->peer_sk_pub,
+                               size,
+                               write);
+    }
+}
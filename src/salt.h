@@ -33,8 +33,11 @@ extern "C" {
 
 #define SALT_READ_OVERHEAD_SIZE     (38U)       /**< Encryption buffer overhead size for read. */
 #define SALT_WRITE_OVERHEAD_SIZE    (42U)       /**< Encryption buffer overhead size for write. */
-#define SALT_HNDSHK_BUFFER_SIZE     (496U)       /**< Buffer used for handshake. */
+#define SALT_READ_RECORD_OFFSET     (14U)       /**< Offset of the record in the buffer of salt_read_unwrap. */
+#define SALT_HNDSHK_BUFFER_SIZE     (334U)       /**< Buffer used for handshake. */
 #define SALT_PROTOCOLS_MIN_BUF_SIZE (27U)
+#define SALT_DGRAM_OVERHEAD_SIZE    (36U)       /**< Buffer overhead size for datagram records. */
+#define SALT_EXPORT_SIZE            (164U)      /**< Size of exported session without partial record. */
 
 /*======= Type Definitions and declarations ===================================*/
 
@@ -207,6 +210,198 @@ typedef struct salt_protocols_s {
     salt_protocol_t *p_protocols;
 } salt_protocols_t;
 
+/**
+ * @brief Adaptive record size state.
+ *
+ * See \ref salt_record_size_init.
+ */
+typedef struct salt_record_size_s {
+    uint32_t    min_size;                               /**< Record buffer size used after idle. */
+    uint32_t    max_size;                               /**< Largest record buffer size. */
+    uint32_t    size;                                   /**< Current record buffer size. */
+    uint32_t    idle_threshold;                         /**< Idle time in ms before shrinking to min_size. */
+    uint32_t    full_records;                           /**< Number of filled records at current size. */
+    uint32_t    last_write;                             /**< Time of last written record. */
+} salt_record_size_t;
+
+/**
+ * @brief Datagram mode state.
+ *
+ * See \ref salt_dgram_init.
+ */
+typedef struct salt_dgram_s {
+    salt_io_channel_t   write_channel;                  /**< Datagram write channel structure. */
+    salt_io_impl        write_impl;                     /**< Function pointer to datagram write implementation. */
+    salt_io_channel_t   read_channel;                   /**< Datagram read channel structure. */
+    salt_io_impl        read_impl;                      /**< Function pointer to datagram read implementation. */
+    uint64_t            write_record;                   /**< Record number of next written record. */
+    uint64_t            read_top;                       /**< Highest accepted record number + 1, 0 if none. */
+    uint64_t            read_window;                    /**< Bit i is set if record read_top - 1 - i was accepted. */
+    uint32_t            dropped;                        /**< Number of dropped records. */
+    bool                negotiated;                     /**< Datagram mode was accepted by both peers. */
+} salt_dgram_t;
+
+/**
+ * @brief Lock function for a signature pool shared between threads.
+ *
+ * @param p_context Pointer to lock context, e.g. a mutex.
+ */
+typedef void (*salt_sign_pool_lock_t)(void *p_context);
+
+#define SALT_SIGN_POOL_EMPTY        (0U)    /**< Entry is unused. */
+#define SALT_SIGN_POOL_FILLING      (1U)    /**< Entry is being computed. */
+#define SALT_SIGN_POOL_READY        (2U)    /**< Entry can be taken. */
+
+/**
+ * @brief Precomputed signature commitment.
+ */
+typedef struct salt_sign_pool_entry_s {
+    uint8_t     precomputed[api_crypto_sign_PRECOMPUTEDBYTES];
+    uint8_t     state;                                  /**< SALT_SIGN_POOL_EMPTY/FILLING/READY. */
+} salt_sign_pool_entry_t;
+
+/**
+ * @brief Pool of precomputed signature commitments.
+ *
+ * See \ref salt_sign_pool_init.
+ */
+typedef struct salt_sign_pool_s {
+    salt_sign_pool_entry_t  *p_entries;                 /**< Pool entries. */
+    uint32_t                count;                      /**< Number of entries. */
+    const uint8_t           *p_sk_sec;                  /**< Signature key the commitments are made for. */
+    salt_sign_pool_lock_t   lock;                       /**< Lock implementation, may be NULL. */
+    salt_sign_pool_lock_t   unlock;                     /**< Unlock implementation, may be NULL. */
+    void                    *p_lock_context;            /**< Pointer to lock context. */
+    uint32_t                taken;                      /**< Number of commitments used for signing. */
+    uint32_t                missed;                     /**< Number of signatures made without a commitment. */
+} salt_sign_pool_t;
+
+/**
+ * @brief Function for dependency injection to authorize a peer by its key.
+ *
+ * Called during the handshake as soon as the public signature key of the peer
+ * is received in M3 or M4, before the signature is verified. Hence, a rejected
+ * peer costs no signature verification, but an accepted key is not yet
+ * authenticated. See \ref salt_set_peer_check.
+ *
+ * @param p_context     Pointer to check context.
+ * @param p_peer_pub    Public signature key of the peer, 32 bytes.
+ *
+ * @return SALT_SUCCESS The peer is accepted.
+ * @return SALT_ERROR   The peer is rejected.
+ */
+typedef salt_ret_t (*salt_peer_check_t)(void *p_context, const uint8_t *p_peer_pub);
+
+/**
+ * @brief Function for dependency injection to supply the ephemeral key pair of
+ *        a host.
+ *
+ * Called during the host handshake when a valid M1 has been received, see
+ * \ref salt_set_ephemeral_source. The default is \ref salt_ephemeral_keypair,
+ * another source may e.g. take precomputed key pairs from a pool. A key pair
+ * must never be used for more than one session.
+ *
+ * @param p_context     Pointer to source context.
+ * @param p_ek_pub      Public ephemeral encryption key, 32 bytes.
+ * @param p_ek_sec      Secret ephemeral encryption key, 32 bytes.
+ *
+ * @return SALT_SUCCESS The key pair was created.
+ * @return SALT_ERROR   No key pair could be created.
+ */
+typedef salt_ret_t (*salt_ephemeral_source_t)(void *p_context,
+                                              uint8_t *p_ek_pub,
+                                              uint8_t *p_ek_sec);
+
+/**
+ * @brief Function for dependency injection to observe the records of a session.
+ *
+ * Called for each application record that is encrypted or decrypted on the
+ * channel, see \ref salt_set_record_hook. The hook runs on the thread that
+ * wraps or unwraps the record and must not use the channel.
+ *
+ * @param p_context     Pointer to hook context.
+ * @param p_peer_pub    Public signature key of the peer, 32 bytes.
+ * @param size          Size of the record on the wire.
+ * @param write         True if the record is written, false if it was read.
+ */
+typedef void (*salt_record_hook_t)(void *p_context,
+                                   const uint8_t *p_peer_pub,
+                                   uint32_t size,
+                                   bool write);
+
+#define SALT_WORKER_SIGN_SIZE       (200U)  /**< Signed M4 message, signature and M1/M2 hashes. */
+
+typedef struct salt_worker_s salt_worker_t; /* Forward declaration */
+
+/**
+ * @brief Task run by a worker.
+ *
+ * @param p_arg Pointer to task argument.
+ */
+typedef void (*salt_worker_task_t)(void *p_arg);
+
+/**
+ * @brief Function for dependency injection to start a task on a helper thread.
+ *
+ * @param p_worker  Pointer to worker structure.
+ * @param task      Task to run.
+ * @param p_arg     Argument to task.
+ *
+ * @return SALT_SUCCESS The task was started.
+ * @return SALT_ERROR   The task could not be started, it is then run by the
+ *                      calling thread instead.
+ */
+typedef salt_ret_t (*salt_worker_start_t)(salt_worker_t *p_worker,
+                                          salt_worker_task_t task,
+                                          void *p_arg);
+
+/**
+ * @brief Function for dependency injection to check if a started task is done.
+ *
+ * Must make the memory written by the task visible to the calling thread
+ * before SALT_SUCCESS is returned, e.g., by joining the thread or taking a
+ * mutex. May block until the task is done.
+ *
+ * @param p_worker  Pointer to worker structure.
+ *
+ * @return SALT_SUCCESS The task is done.
+ * @return SALT_PENDING The task is still running.
+ */
+typedef salt_ret_t (*salt_worker_poll_t)(salt_worker_t *p_worker);
+
+struct salt_channel_s; /* Forward declaration */
+
+/**
+ * @brief Function for dependency injection called when a session is
+ *        established or closed.
+ *
+ * See \ref salt_set_session_hook.
+ *
+ * @param p_context     Pointer to hook context.
+ * @param p_channel     Pointer to salt channel.
+ * @param established   true when the session was established, false when it
+ *                      was closed.
+ */
+typedef void (*salt_session_hook_t)(void *p_context,
+                                    struct salt_channel_s *p_channel,
+                                    bool established);
+
+/**
+ * @brief Helper thread used in the client handshake.
+ *
+ * See \ref salt_worker_init.
+ */
+struct salt_worker_s {
+    salt_worker_start_t start;                          /**< Start implementation. */
+    salt_worker_poll_t  poll;                           /**< Poll implementation. */
+    void                *p_context;                     /**< Pointer to worker context. */
+    uint8_t             sign_buffer[SALT_WORKER_SIGN_SIZE]; /**< M4 signature is created here. */
+    uint8_t             precomputed[api_crypto_sign_PRECOMPUTEDBYTES]; /**< Commitment from a signature pool. */
+    bool                use_precomputed;                /**< A commitment was taken. */
+    bool                started;                        /**< The M4 signature task is started. */
+    int                 result;                         /**< Crypto API result of the task. */
+};
+
 /**
  * @brief Salt channel structure.
  *
@@ -238,6 +433,19 @@ typedef struct salt_channel_s {
 
     salt_time_t         *time_impl;                     /**< Function pointer to get time implementation. */
     salt_protocols_t    *p_protocols;                   /**< Function pointer to get supported protocols. */
+    salt_record_size_t  *p_record_size;                 /**< Adaptive record size state, may be NULL. */
+    salt_dgram_t        *p_dgram;                       /**< Datagram mode state, may be NULL. */
+    salt_sign_pool_t    *p_sign_pool;                   /**< Precomputed signature commitments, may be NULL. */
+    salt_worker_t       *p_worker;                      /**< Handshake helper thread, may be NULL. */
+    salt_session_hook_t session_hook;                   /**< Called when established or closed, may be NULL. */
+    void                *p_session_context;             /**< Pointer to session hook context. */
+    salt_peer_check_t   peer_check;                     /**< Peer authorization, may be NULL. */
+    void                *p_peer_check_context;          /**< Pointer to peer check context. */
+    salt_ephemeral_source_t ek_source;                  /**< Lazy host ephemeral key pair, may be NULL. */
+    void                *p_ek_source_context;           /**< Pointer to ephemeral source context. */
+    bool                ek_pending;                     /**< Ephemeral key pair not yet created. */
+    salt_record_hook_t  record_hook;                    /**< Record observer, may be NULL. */
+    void                *p_record_hook_context;         /**< Pointer to record hook context. */
 
     uint8_t     *hdshk_buffer;                          /**< Handshake buffer, used only during handshake. */
     uint32_t    hdshk_buffer_size;                      /**< Handshake buffer size >= SALT_HNDSHK_BUFFER_SIZE. */
@@ -454,7 +662,8 @@ salt_ret_t salt_create_signature(salt_channel_t *p_channel);
  * @brief Initiates a new salt session.
  *
  * A new ephemeral key pair is generated and the read and write nonce
- * is reseted.
+ * is reseted. For a host with an ephemeral source, the key pair is instead
+ * created when a valid M1 is received, see \ref salt_set_ephemeral_source.
  *
  * @param p_channel         Pointer to channel handle.
  * @param hdshk_buffer      Pointer to buffer used for handsize. Must be at least
@@ -493,6 +702,31 @@ salt_ret_t salt_init_session_using_key(salt_channel_t *p_channel,
                                        const uint8_t *ek_pub,
                                        const uint8_t *ek_sec);
 
+/**
+ * @brief Initiates a session using a part of a record buffer for the handshake.
+ *
+ * See \ref salt_init_session.
+ *
+ * The handshake and the record phase never overlap, so the first
+ * SALT_HNDSHK_BUFFER_SIZE bytes of the receive or transmit buffer that is
+ * later used with \ref salt_read_begin or \ref salt_write_begin can be used
+ * as handshake buffer. The region is cleared and released from the channel
+ * when the handshake is completed or has failed. The buffer must not be used
+ * for records until then.
+ *
+ * @param p_channel             Pointer to channel handle.
+ * @param p_record_buffer       Pointer to record buffer.
+ * @param record_buffer_size    Size of the record buffer, must be at least
+ *                              SALT_HNDSHK_BUFFER_SIZE bytes.
+ *
+ * @return SALT_SUCCESS The session was successfully initiated.
+ * @return SALT_ERROR   The channel handle or buffer was a NULL pointer, or
+ *                      the record buffer is to small.
+ */
+salt_ret_t salt_init_session_in_buffer(salt_channel_t *p_channel,
+                                       uint8_t *p_record_buffer,
+                                       uint32_t record_buffer_size);
+
 /**
  * @brief Set threshold for delay protection.
  *
@@ -562,6 +796,32 @@ salt_ret_t salt_read_begin(salt_channel_t *p_channel,
                            uint32_t buffer_size,
                            salt_msg_t *p_msg);
 
+/**
+ * @brief Decrypts a record that was read without the salt channel.
+ *
+ * Same as \ref salt_read_begin, but the record was already read, e.g., by
+ * another thread than the one that decrypts it. The record is read as for a
+ * read implementation, i.e., the size is given by the first four bytes, and
+ * the size bytes that follow are put at p_buffer[SALT_READ_RECORD_OFFSET]. The
+ * record is decrypted in place, and the messages are read with
+ * \ref salt_read_next.
+ *
+ * The records of a session must be decrypted in the order they were received.
+ *
+ * @param p_channel     Pointer to salt channel handle.
+ * @param p_buffer      Pointer to buffer with the record at offset
+ *                      SALT_READ_RECORD_OFFSET.
+ * @param size          Size of the record, without the four size bytes.
+ * @param p_msg         Pointer to message structure to use when reading the message.
+ *
+ * @return SALT_SUCCESS The record was decrypted.
+ * @return SALT_ERROR   If any error occured, as for \ref salt_read_begin.
+ */
+salt_ret_t salt_read_unwrap(salt_channel_t *p_channel,
+                            uint8_t *p_buffer,
+                            uint32_t size,
+                            salt_msg_t *p_msg);
+
 /**
  * @brief Used to read messages recevied.
  *
@@ -721,6 +981,571 @@ salt_ret_t salt_write_execute(salt_channel_t *p_channel,
                               salt_msg_t *p_msg,
                               bool last_msg);
 
+/**
+ * @brief Encrypts a prepared message without sending it.
+ *
+ * Same as the first part of \ref salt_write_execute. After this, the record
+ * to send is p_msg->write.buffer_size bytes at p_msg->write.p_buffer,
+ * including the four size bytes. It may be sent by another thread than the
+ * one that encrypts it, or with \ref salt_write_execute, which then only
+ * writes it.
+ *
+ * The records of a session must be sent in the order they were encrypted.
+ *
+ * @param p_channel     Pointer to salt channel handle.
+ * @param p_msg         Pointer to prepared message structure.
+ * @param last_msg      Set the last message flag in the record.
+ *
+ * @return SALT_SUCCESS The record was created.
+ * @return SALT_ERROR   If any error occured, as for \ref salt_write_execute.
+ */
+salt_ret_t salt_write_wrap(salt_channel_t *p_channel,
+                           salt_msg_t *p_msg,
+                           bool last_msg);
+
+/**
+ * @brief Encrypts one prepared message for several sessions.
+ *
+ * The message is prepared once using \ref salt_write_begin, \ref salt_write_next
+ * and \ref salt_write_commit. The multi app framing is then created once, and
+ * the clear text is encrypted directly from the buffer of p_msg into one record
+ * per session, without copying it for each session. The buffer of p_msg is not
+ * encrypted, so p_msg can be broadcasted again, e.g., to the next batch of
+ * sessions.
+ *
+ * The records are created in p_pool, one after another. Each record requires
+ * the number of bytes used in the buffer of p_msg, i.e.,
+ * p_msg->write.buffer_size - p_msg->write.buffer_available. The record of
+ * session i is put in p_records[i] and is sent using \ref salt_write_execute,
+ * which returns SALT_PENDING until the record is sent, as for any message. The
+ * pool must be kept until all records are sent. A session that is not
+ * established or fails to encrypt gets a record on which \ref salt_write_execute
+ * returns SALT_ERROR, the other sessions are not affected.
+ *
+ * Usage:
+ *
+ *      salt_write_begin(tx_buffer, sizeof(tx_buffer), &tx_msg);
+ *      salt_write_next(&tx_msg, notification, notification_size);
+ *      salt_write_broadcast(&tx_msg, channels, records, count, pool, sizeof(pool), false);
+ *      for (i = 0; i < count; i++) {
+ *          Queue records[i] to be written with salt_write_execute(channels[i], &records[i], false).
+ *      }
+ *
+ * @param p_msg         Pointer to prepared message structure.
+ * @param pp_channels   Pointer to count salt channel handles, without pending
+ *                      writes.
+ * @param p_records     Pointer to count message structures where the records
+ *                      are returned.
+ * @param count         Number of sessions.
+ * @param p_pool        Pointer to record pool.
+ * @param pool_size     Size of record pool.
+ * @param last_msg      Set the last message flag in all records.
+ *
+ * @return SALT_SUCCESS The records were created.
+ * @return SALT_ERROR   Any input was invalid, the message was empty or the pool
+ *                      was to small.
+ */
+salt_ret_t salt_write_broadcast(salt_msg_t *p_msg,
+                                salt_channel_t **pp_channels,
+                                salt_msg_t *p_records,
+                                uint32_t count,
+                                uint8_t *p_pool,
+                                uint32_t pool_size,
+                                bool last_msg);
+
+/**
+ * @brief Initiates adaptive record sizing for the write path.
+ *
+ * A large record can not be released by the peer until the whole record, including
+ * the MAC, has been received. Small records gives a low time to first byte but
+ * adds per record overhead. When adaptive record sizing is used the records starts
+ * at min_size bytes and doubles towards max_size for as long as the application
+ * fills the records. If no record was written for idle_threshold milliseconds,
+ * the record size falls back to min_size. The idle detection requires that a
+ * get time implementation was injected in \ref salt_create, otherwise
+ * \ref salt_record_size_reset can be used to shrink the records.
+ *
+ * The sizes are buffer sizes as used in \ref salt_write_begin, i.e., including
+ * SALT_WRITE_OVERHEAD_SIZE. A min_size that fits in one TCP segment, e.g. 1400
+ * bytes, is recommended.
+ *
+ *  Example usage:
+ *      uint8_t tx_buffer[16384];
+ *      salt_record_size_t record_size;
+ *      salt_record_size_init(&channel, &record_size, 1400, sizeof(tx_buffer), 1000);
+ *
+ *      while (more_data) {
+ *          uint32_t size = salt_record_size_next(&channel, sizeof(tx_buffer));
+ *          salt_write_begin(tx_buffer, size, &tx_msg);
+ *          ...
+ *          salt_write_execute(&channel, &tx_msg, false);
+ *      }
+ *
+ * @param p_channel         Pointer to channel handle.
+ * @param p_record_size     Pointer to record size structure.
+ * @param min_size          Initial record buffer size, > SALT_WRITE_OVERHEAD_SIZE.
+ * @param max_size          Maximum record buffer size, >= min_size.
+ * @param idle_threshold    Idle time in milliseconds before record size is reset.
+ *
+ * @return SALT_SUCCESS Adaptive record sizing was initiated.
+ * @return SALT_ERROR   Any input pointer was NULL or invalid sizes.
+ */
+salt_ret_t salt_record_size_init(salt_channel_t *p_channel,
+                                 salt_record_size_t *p_record_size,
+                                 uint32_t min_size,
+                                 uint32_t max_size,
+                                 uint32_t idle_threshold);
+
+/**
+ * @brief Get buffer size to use for the next record.
+ *
+ * Should be called before \ref salt_write_begin and the returned size used as the
+ * buffer size. If no adaptive record sizing is used, buffer_size is returned.
+ *
+ * @param p_channel     Pointer to channel handle.
+ * @param buffer_size   Size of available write buffer.
+ *
+ * @return Buffer size to use for next record, <= buffer_size.
+ */
+uint32_t salt_record_size_next(salt_channel_t *p_channel, uint32_t buffer_size);
+
+/**
+ * @brief Reset record size to minimum size.
+ *
+ * @param p_record_size Pointer to record size structure.
+ */
+void salt_record_size_reset(salt_record_size_t *p_record_size);
+
+/**
+ * @brief Requests datagram mode for a salt channel.
+ *
+ * The stream records of salt channel are read in order, and one lost or delayed
+ * TCP segment blocks all records behind it. In datagram mode, each record is sent
+ * in one datagram, e.g., over UDP, and carries an explicit record number from
+ * which the nonce is derived. The records may be lost, reordered or duplicated,
+ * and are delivered as they arrive. Records older than the 64 newest records, or
+ * already received records, are dropped. Datagram records are independent of the
+ * stream records, and the stream can still be used.
+ *
+ * The handshake is still done over the stream I/O. Datagram mode is requested by
+ * the client in M1 and accepted by the host in M2 if the host also has called
+ * salt_dgram_init. Since M1 and M2 are signed, the negotiation can not be modified
+ * by a man in the middle. After the handshake, p_dgram->negotiated tells if
+ * datagram mode is used.
+ *
+ * The datagram I/O implementations work as the stream I/O implementations with
+ * these differences:
+ *  - write_impl must send size_expected bytes in one datagram and set size to
+ *    size_expected. If no datagram can be sent right now, SALT_PENDING is returned
+ *    and nothing is sent.
+ *  - read_impl must read one datagram of at most size_expected bytes and set size
+ *    to the size of the datagram. If no datagram is available SALT_PENDING is
+ *    returned.
+ *
+ *  Example usage:
+ *      salt_dgram_t dgram;
+ *      salt_create(&channel, SALT_CLIENT, my_write, my_read, &my_time);
+ *      salt_dgram_init(&channel, &dgram, my_udp_write, my_udp_read, &udp_sock, &udp_sock);
+ *      ... handshake ...
+ *      if (dgram.negotiated) {
+ *          memcpy(&tx_buffer[SALT_DGRAM_OVERHEAD_SIZE], sample, sample_size);
+ *          salt_dgram_write(&channel, tx_buffer, sample_size);
+ *      }
+ *
+ * @param p_channel         Pointer to channel handle.
+ * @param p_dgram           Pointer to datagram mode structure.
+ * @param write_impl        Datagram write implementation.
+ * @param read_impl         Datagram read implementation.
+ * @param p_write_context   Pointer to datagram write context.
+ * @param p_read_context    Pointer to datagram read context.
+ *
+ * @return SALT_SUCCESS Datagram mode will be requested in the handshake.
+ * @return SALT_ERROR   Any input pointer was NULL or the handshake was already started.
+ */
+salt_ret_t salt_dgram_init(salt_channel_t *p_channel,
+                           salt_dgram_t *p_dgram,
+                           salt_io_impl write_impl,
+                           salt_io_impl read_impl,
+                           void *p_write_context,
+                           void *p_read_context);
+
+/**
+ * @brief Encrypts and writes one datagram record.
+ *
+ * The message must be put at p_buffer[SALT_DGRAM_OVERHEAD_SIZE], i.e., p_buffer
+ * must be size + SALT_DGRAM_OVERHEAD_SIZE bytes large. The datagram sent is
+ * size + SALT_DGRAM_OVERHEAD_SIZE - 6 bytes large.
+ *
+ * If SALT_PENDING is returned, the record is encrypted but not sent. The function
+ * must then be called again with the same buffer.
+ *
+ * @param p_channel     Pointer to channel handle.
+ * @param p_buffer      Buffer with message.
+ * @param size          Size of message.
+ *
+ * @return SALT_SUCCESS The record was sent.
+ * @return SALT_PENDING The record could not be sent yet.
+ * @return SALT_ERROR   Datagram mode was not negotiated, or any I/O error occured.
+ */
+salt_ret_t salt_dgram_write(salt_channel_t *p_channel,
+                            uint8_t *p_buffer,
+                            uint32_t size);
+
+/**
+ * @brief Reads and decrypts one datagram record.
+ *
+ * Datagrams that can not be authenticated, replayed or too old records, and
+ * delayed records if a delay threshold is set, are dropped and counted in
+ * p_dgram->dropped. The session is not closed by a dropped record, since anyone
+ * may send datagrams. The read continues with the next datagram.
+ *
+ * The largest message that can be received is buffer_size - SALT_DGRAM_OVERHEAD_SIZE.
+ *
+ * @param p_channel     Pointer to channel handle.
+ * @param p_buffer      Receive buffer.
+ * @param buffer_size   Size of receive buffer, > SALT_DGRAM_OVERHEAD_SIZE.
+ * @param pp_message    Pointer to the message in p_buffer is returned here.
+ * @param p_size        Size of message is returned here.
+ *
+ * @return SALT_SUCCESS A record was read.
+ * @return SALT_PENDING No record is available.
+ * @return SALT_ERROR   Datagram mode was not negotiated, or any I/O error occured.
+ */
+salt_ret_t salt_dgram_read(salt_channel_t *p_channel,
+                           uint8_t *p_buffer,
+                           uint32_t buffer_size,
+                           uint8_t **pp_message,
+                           uint32_t *p_size);
+
+/**
+ * @brief Exports an established session.
+ *
+ * Used to hand over a session to another process, e.g., when a host is
+ * restarted with a new binary. The exported state contains the session key,
+ * nonces, epochs, negotiated datagram state and the bytes read so far of a
+ * partially received record. The long term signature key is not exported. The
+ * socket itself is handed over by the user, e.g., using SCM_RIGHTS.
+ *
+ * The exported state contains the session key and must be kept private and
+ * wiped after \ref salt_import_session. The channel is closed after a
+ * successful export so that the nonces can never be reused by this process.
+ * The state must be imported exactly once, two channels importing the same
+ * state would reuse the nonces. Only if the importing process has not imported
+ * the state, or has not used the imported session, may the exporting process
+ * import it again to resume the session.
+ *
+ * A pending write can not be exported, it must be completed first.
+ *
+ * @param p_channel     Pointer to channel handle.
+ * @param p_buffer      Exported state is written here.
+ * @param buffer_size   Size of buffer, at least SALT_EXPORT_SIZE plus the
+ *                      size of the partially received record.
+ * @param p_size        Size of exported state is returned here.
+ *
+ * @return SALT_SUCCESS The session was exported and the channel closed.
+ * @return SALT_PENDING A write is pending, complete it and try again.
+ * @return SALT_ERROR   The session was not established or the buffer was too small.
+ */
+salt_ret_t salt_export_session(salt_channel_t *p_channel,
+                               uint8_t *p_buffer,
+                               uint32_t buffer_size,
+                               uint32_t *p_size);
+
+/**
+ * @brief Imports a session exported by \ref salt_export_session.
+ *
+ * The channel must be created using \ref salt_create, and the context set
+ * to the handed over socket. If datagram mode was negotiated in the exported
+ * session, \ref salt_dgram_init must be called before the import. After the
+ * import, the session is established and the record stream continues without
+ * a new handshake.
+ *
+ * A partially received record is restored to p_read_buffer, which must then
+ * be used in the next call to \ref salt_read_begin.
+ *
+ * If a delay threshold is used, the time implementation must use the same
+ * clock as in the exporting process.
+ *
+ * @param p_channel         Pointer to channel handle.
+ * @param p_buffer          Exported state.
+ * @param size              Size of exported state.
+ * @param p_read_buffer     Buffer for next read, may be NULL if no record
+ *                          was partially received.
+ * @param read_buffer_size  Size of read buffer.
+ *
+ * @return SALT_SUCCESS The session was imported.
+ * @return SALT_ERROR   The exported state was invalid, the channel was already
+ *                      used or the read buffer was too small.
+ */
+salt_ret_t salt_import_session(salt_channel_t *p_channel,
+                               const uint8_t *p_buffer,
+                               uint32_t size,
+                               uint8_t *p_read_buffer,
+                               uint32_t read_buffer_size);
+
+/**
+ * @brief Initiates a pool of precomputed signature commitments.
+ *
+ * Most of the time spent when signing M3 or M4 is the fixed base scalar
+ * multiplication R = rB of the Ed25519 commitment, which does not depend on the
+ * message. With a signature pool, the commitments are computed in advance by
+ * \ref salt_sign_pool_fill, e.g., in a background worker thread, and the
+ * handshake only has to hash and do scalar arithmetic. The signatures can not
+ * be distinguished from ordinary Ed25519 signatures.
+ *
+ * The commitments are as secret as the signature key. Each commitment is
+ * wiped when taken and is never used twice. If the pool is empty, or the crypto
+ * library does not support precomputed signing, the handshake signs as usual.
+ *
+ * The pool may be shared between channels and threads. The lock and unlock
+ * implementations are then used to protect the entries, the commitments are
+ * computed without holding the lock. If the pool is only used by one thread,
+ * lock and unlock may be NULL.
+ *
+ *  Example usage:
+ *      static salt_sign_pool_entry_t entries[64];
+ *      salt_sign_pool_t pool;
+ *      salt_sign_pool_init(&pool, entries, 64, host_sk_sec,
+ *                          my_mutex_lock, my_mutex_unlock, &mutex);
+ *
+ *      Worker thread:
+ *          while (salt_sign_pool_fill(&pool) != SALT_ERROR) {
+ *              ... wait until a commitment was taken ...
+ *          }
+ *
+ *      For each session:
+ *          salt_set_signature(&channel, host_sk_sec);
+ *          salt_set_sign_pool(&channel, &pool);
+ *
+ * @param p_pool            Pointer to pool structure.
+ * @param p_entries         Pointer to pool entries.
+ * @param count             Number of entries.
+ * @param p_sk_sec          Signature key used when signing, must stay valid
+ *                          while the pool is used.
+ * @param lock              Lock implementation, may be NULL.
+ * @param unlock            Unlock implementation, may be NULL.
+ * @param p_lock_context    Pointer to lock context.
+ *
+ * @return SALT_SUCCESS The pool was initiated with all entries empty.
+ * @return SALT_ERROR   Any input pointer was NULL, count was zero or only one
+ *                      of lock and unlock was given.
+ */
+salt_ret_t salt_sign_pool_init(salt_sign_pool_t *p_pool,
+                               salt_sign_pool_entry_t *p_entries,
+                               uint32_t count,
+                               const uint8_t *p_sk_sec,
+                               salt_sign_pool_lock_t lock,
+                               salt_sign_pool_lock_t unlock,
+                               void *p_lock_context);
+
+/**
+ * @brief Computes one commitment into an empty pool entry.
+ *
+ * @param p_pool    Pointer to pool structure.
+ *
+ * @return SALT_SUCCESS One commitment was added.
+ * @return SALT_PENDING The pool is full.
+ * @return SALT_ERROR   The crypto library does not support precomputed signing.
+ */
+salt_ret_t salt_sign_pool_fill(salt_sign_pool_t *p_pool);
+
+/**
+ * @brief Takes one commitment from the pool.
+ *
+ * The entry is wiped and can not be taken again. Used by the handshake, but
+ * may also be used with \ref api_crypto_sign_precomputed by the application.
+ *
+ * @param p_pool        Pointer to pool structure.
+ * @param p_sk_pub      Public signature key of the signer. No commitment is
+ *                      taken if the pool was made for another key.
+ * @param p_precomputed Commitment is copied here,
+ *                      api_crypto_sign_PRECOMPUTEDBYTES bytes long.
+ *
+ * @return SALT_SUCCESS A commitment was taken.
+ * @return SALT_PENDING The pool is empty.
+ * @return SALT_ERROR   The pool was made for another key.
+ */
+salt_ret_t salt_sign_pool_take(salt_sign_pool_t *p_pool,
+                               const uint8_t *p_sk_pub,
+                               uint8_t *p_precomputed);
+
+/**
+ * @brief Returns the number of commitments ready to be taken.
+ *
+ * @param p_pool    Pointer to pool structure.
+ *
+ * @return Number of ready commitments.
+ */
+uint32_t salt_sign_pool_available(salt_sign_pool_t *p_pool);
+
+/**
+ * @brief Uses a signature pool when signing M3 or M4.
+ *
+ * See \ref salt_sign_pool_init.
+ *
+ * @param p_channel Pointer to channel handle.
+ * @param p_pool    Pointer to pool structure, NULL to sign as usual.
+ *
+ * @return SALT_SUCCESS The pool will be used in the handshake.
+ * @return SALT_ERROR   The handshake was already started.
+ */
+salt_ret_t salt_set_sign_pool(salt_channel_t *p_channel,
+                              salt_sign_pool_t *p_pool);
+
+/**
+ * @brief Authorizes the peer during the handshake.
+ *
+ * The check is called with the public signature key of the peer as soon as it
+ * is received, i.e., in M4 for a host and in M3 for a client, and before the
+ * signature is verified. If the check rejects the peer, the handshake fails
+ * with SALT_ERR_BAD_PEER. The check is in addition to the expected key given
+ * to \ref salt_handshake, and is suitable for large allow or deny lists, see
+ * salt_keyset.h.
+ *
+ *  Example usage:
+ *      salt_set_peer_check(&channel, salt_keyset_deny, &revoked);
+ *
+ * @param p_channel Pointer to channel handle.
+ * @param check     Check implementation, NULL to accept any peer.
+ * @param p_context Pointer to check context.
+ *
+ * @return SALT_SUCCESS The check will be used in the handshake.
+ * @return SALT_ERROR   The handshake was already started.
+ */
+salt_ret_t salt_set_peer_check(salt_channel_t *p_channel,
+                               salt_peer_check_t check,
+                               void *p_context);
+
+/**
+ * @brief Defers the ephemeral key pair of a host until a valid M1 is received.
+ *
+ * By default, \ref salt_init_session creates the ephemeral key pair at once,
+ * so a host pays for it on every connection, also for connections that only
+ * send A1, send an invalid M1 or never send anything. With a source, the key
+ * pair is created by the source just before M2 is created, and only if the
+ * received M1 was valid and for this host. The handshake messages are the same
+ * in both modes.
+ *
+ * A key pair given to \ref salt_init_session_using_key is used as is.
+ *
+ *  Example usage:
+ *      salt_set_ephemeral_source(&channel, salt_ephemeral_keypair, NULL);
+ *
+ * @param p_channel Pointer to channel handle.
+ * @param source    Source implementation, NULL to create the key pair when
+ *                  the session is initiated.
+ * @param p_context Pointer to source context.
+ *
+ * @return SALT_SUCCESS The source will be used in the next session.
+ * @return SALT_ERROR   The channel is not a host or the session was already
+ *                      initiated.
+ */
+salt_ret_t salt_set_ephemeral_source(salt_channel_t *p_channel,
+                                     salt_ephemeral_source_t source,
+                                     void *p_context);
+
+/**
+ * @brief Ephemeral source that creates a new key pair,
+ *        see \ref salt_ephemeral_source_t.
+ *
+ * @param p_context     Not used.
+ * @param p_ek_pub      Public ephemeral encryption key, 32 bytes.
+ * @param p_ek_sec      Secret ephemeral encryption key, 32 bytes.
+ *
+ * @return SALT_SUCCESS The key pair was created.
+ * @return SALT_ERROR   The crypto API failed.
+ */
+salt_ret_t salt_ephemeral_keypair(void *p_context,
+                                  uint8_t *p_ek_pub,
+                                  uint8_t *p_ek_sec);
+
+/**
+ * @brief Sets a hook that is called for each record of the session.
+ *
+ * The hook is called when an application record has been decrypted by
+ * \ref salt_read_unwrap or \ref salt_dgram_read, and when a record has been
+ * encrypted by \ref salt_write_wrap, \ref salt_write_broadcast or
+ * \ref salt_dgram_write. Handshake messages are not passed to the hook. Since
+ * salt_read_begin and salt_write_execute use the same functions, this covers
+ * all record paths, also the staged pipeline, see salt_pipeline.h. The hook
+ * is not exported with the session.
+ *
+ *  Example usage:
+ *      salt_set_record_hook(&channel, salt_hitters_record_hook, &bytes);
+ *
+ * @param p_channel Pointer to channel handle.
+ * @param hook      Hook implementation, NULL to remove the hook.
+ * @param p_context Pointer to hook context.
+ *
+ * @return SALT_SUCCESS The hook was set.
+ * @return SALT_ERROR   p_channel was NULL.
+ */
+salt_ret_t salt_set_record_hook(salt_channel_t *p_channel,
+                                salt_record_hook_t hook,
+                                void *p_context);
+
+/**
+ * @brief Signs M4 on a helper thread during the client handshake.
+ *
+ * Without a worker, the client computes the session key and then the M4
+ * signature when M2 is received, before M3 is read and its signature verified.
+ * With a worker, the M4 signature is started on a helper thread as soon as the
+ * M2 hash is known, and runs while the session key is computed, M3 is read and
+ * the M3 signature is verified. The M4 signature is joined just before M4 is
+ * wrapped, during which \ref salt_handshake returns SALT_PENDING. The signature
+ * is created in p_worker->sign_buffer, so the task never touches the handshake
+ * buffer.
+ *
+ * The task only reads the signature key of the channel. If the handshake fails
+ * while the task is running, the worker must not be reused or released until
+ * poll has returned SALT_SUCCESS.
+ *
+ *  Example usage:
+ *      salt_worker_t worker;
+ *      salt_create(&channel, SALT_CLIENT, my_write, my_read, &my_time);
+ *      salt_worker_init(&channel, &worker, my_thread_start, my_thread_poll, &thread);
+ *
+ * @param p_channel Pointer to channel handle.
+ * @param p_worker  Pointer to worker structure.
+ * @param start     Start implementation.
+ * @param poll      Poll implementation.
+ * @param p_context Pointer to worker context.
+ *
+ * @return SALT_SUCCESS The worker will be used in the handshake.
+ * @return SALT_ERROR   Any input pointer was NULL, the channel is not a client
+ *                      or the handshake was already started.
+ */
+salt_ret_t salt_worker_init(salt_channel_t *p_channel,
+                            salt_worker_t *p_worker,
+                            salt_worker_start_t start,
+                            salt_worker_poll_t poll,
+                            void *p_context);
+
+/**
+ * @brief Sets a hook that is called when the session is established or closed.
+ *
+ * The hook is called with established true when \ref salt_handshake or
+ * \ref salt_import_session establishes the session. It is called with
+ * established false when an established session is closed, i.e., on an error,
+ * when the peer sent its last message or when the session is exported. The
+ * hook runs on the thread that uses the channel, e.g., to keep a session
+ * directory up to date, see salt_directory.h.
+ *
+ *  Example usage:
+ *      salt_create(&channel, SALT_SERVER, my_write, my_read, &my_time);
+ *      salt_set_session_hook(&channel, salt_directory_session_hook, &session);
+ *
+ * @param p_channel Pointer to channel handle.
+ * @param hook      Hook implementation, NULL to remove the hook.
+ * @param p_context Pointer to hook context.
+ *
+ * @return SALT_SUCCESS The hook was set.
+ * @return SALT_ERROR   The handshake was already started.
+ */
+salt_ret_t salt_set_session_hook(salt_channel_t *p_channel,
+                                 salt_session_hook_t hook,
+                                 void *p_context);
+
 
 #ifdef __cplusplus
 }
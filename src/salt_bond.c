@@ -0,0 +1,352 @@
+/**
+ * @file salt_bond.c
+ *
+ * Bonding of several salt channel sessions into one logical message stream.
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+/* C Library includes */
+#include <string.h> /* memcpy */
+
+/* Salt library includes */
+#include "salt_bond.h"
+#include "salti_util.h"
+
+/*======= Local Macro Definitions =============================================*/
+/*======= Type Definitions ====================================================*/
+/*======= Local variable declarations =========================================*/
+/*======= Local function prototypes ===========================================*/
+
+static salt_ret_t salt_bond_path_write(salt_bond_path_t *p_path,
+                                       uint8_t *p_payload,
+                                       uint32_t size);
+static salt_ret_t salt_bond_path_read(salt_bond_path_t *p_path);
+
+/*======= Global function implementations =====================================*/
+
+salt_ret_t salt_bond_init(salt_bond_t *p_bond,
+                          salt_bond_path_t *p_paths,
+                          uint8_t max_paths,
+                          const uint8_t *p_bond_id)
+{
+    if ((NULL == p_bond) || (NULL == p_paths) ||
+        (NULL == p_bond_id) || (0U == max_paths)) {
+        return SALT_ERROR;
+    }
+
+    memset(p_bond, 0x00U, sizeof(salt_bond_t));
+    memset(p_paths, 0x00U, sizeof(salt_bond_path_t) * max_paths);
+    p_bond->p_paths = p_paths;
+    p_bond->max_paths = max_paths;
+    memcpy(p_bond->bond_id, p_bond_id, SALT_BOND_ID_SIZE);
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_bond_add(salt_bond_t *p_bond,
+                         salt_channel_t *p_channel,
+                         uint8_t *p_rx_buffer,
+                         uint32_t rx_size,
+                         uint8_t *p_tx_buffer,
+                         uint32_t tx_size)
+{
+    salt_bond_path_t *p_path;
+
+    if ((NULL == p_bond) || (NULL == p_channel) ||
+        (NULL == p_rx_buffer) || (NULL == p_tx_buffer)) {
+        return SALT_ERROR;
+    }
+
+    if ((p_bond->path_count >= p_bond->max_paths) ||
+        (SALT_SESSION_ESTABLISHED != p_channel->state) ||
+        (rx_size < SALT_READ_OVERHEAD_SIZE + SALT_BOND_JOIN_SIZE + 4U) ||
+        (tx_size < SALT_WRITE_OVERHEAD_SIZE + SALT_BOND_JOIN_SIZE)) {
+        return SALT_ERROR;
+    }
+
+    p_path = &p_bond->p_paths[p_bond->path_count++];
+    memset(p_path, 0x00U, sizeof(salt_bond_path_t));
+    p_path->p_channel = p_channel;
+    p_path->p_rx_buffer = p_rx_buffer;
+    p_path->rx_size = rx_size;
+    p_path->p_tx_buffer = p_tx_buffer;
+    p_path->tx_size = tx_size;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_bond_join(salt_bond_t *p_bond)
+{
+    uint8_t join[SALT_BOND_JOIN_SIZE];
+    uint8_t i;
+
+    if (NULL == p_bond) {
+        return SALT_ERROR;
+    }
+
+    join[0] = SALT_BOND_JOIN;
+    memcpy(&join[1], p_bond->bond_id, SALT_BOND_ID_SIZE);
+    join[1 + SALT_BOND_ID_SIZE] = p_bond->path_count;
+
+    for (i = 0; i < p_bond->path_count; i++) {
+        salt_bond_path_t *p_path = &p_bond->p_paths[i];
+        if (!p_path->joined && !p_path->tx_pending) {
+            if (salt_bond_path_write(p_path, join, sizeof(join)) == SALT_ERROR) {
+                return SALT_ERROR;
+            }
+            p_path->joined = true;
+        }
+    }
+
+    return salt_bond_flush(p_bond);
+}
+
+salt_ret_t salt_bond_accept(salt_channel_t *p_channel,
+                            uint8_t *p_buffer,
+                            uint32_t size,
+                            uint8_t *p_bond_id,
+                            uint8_t *p_count)
+{
+    salt_ret_t ret;
+    salt_msg_t msg;
+
+    if (NULL == p_channel) {
+        return SALT_ERROR;
+    }
+
+    SALT_VERIFY_NOT_NULL(p_bond_id);
+    SALT_VERIFY_NOT_NULL(p_count);
+
+    ret = salt_read_begin(p_channel, p_buffer, size, &msg);
+
+    if (SALT_SUCCESS == ret) {
+        /* The join message is always alone in the first record. */
+        SALT_VERIFY((0U == msg.read.messages_left) &&
+                    (SALT_BOND_JOIN_SIZE == msg.read.message_size) &&
+                    (SALT_BOND_JOIN == msg.read.p_payload[0]) &&
+                    (msg.read.p_payload[1 + SALT_BOND_ID_SIZE] > 0U),
+                    SALT_ERR_BAD_PROTOCOL);
+        memcpy(p_bond_id, &msg.read.p_payload[1], SALT_BOND_ID_SIZE);
+        *p_count = msg.read.p_payload[1 + SALT_BOND_ID_SIZE];
+    }
+
+    return ret;
+}
+
+salt_ret_t salt_bond_write(salt_bond_t *p_bond,
+                           const uint8_t *p_data,
+                           uint32_t size)
+{
+    salt_bond_path_t *p_path = NULL;
+    uint8_t *p_payload;
+    uint8_t i;
+
+    if ((NULL == p_bond) || (NULL == p_data) || (0U == p_bond->path_count)) {
+        return SALT_ERROR;
+    }
+
+    if (salt_bond_flush(p_bond) == SALT_ERROR) {
+        return SALT_ERROR;
+    }
+
+    /* Round robin over the paths, skipping paths blocked by a pending write. */
+    for (i = 0; i < p_bond->path_count; i++) {
+        uint8_t index = (p_bond->next_path + i) % p_bond->path_count;
+        if (!p_bond->p_paths[index].tx_pending) {
+            p_path = &p_bond->p_paths[index];
+            p_bond->next_path = (index + 1U) % p_bond->path_count;
+            break;
+        }
+    }
+
+    if (NULL == p_path) {
+        return SALT_PENDING;
+    }
+
+    if (size > p_path->tx_size - SALT_WRITE_OVERHEAD_SIZE - SALT_BOND_OVERHEAD_SIZE) {
+        return SALT_ERROR;
+    }
+
+    /*
+     * The message is built in place in the write buffer:
+     * { SALT_BOND_DATA[1] , seq[4] , payload[size] }
+     */
+    if (salt_write_begin(p_path->p_tx_buffer, p_path->tx_size, &p_path->msg_out) != SALT_SUCCESS) {
+        return SALT_ERROR;
+    }
+    p_payload = p_path->msg_out.write.p_payload;
+    p_payload[0] = SALT_BOND_DATA;
+    salti_u32_to_bytes(&p_payload[1], p_bond->tx_seq);
+    memcpy(&p_payload[SALT_BOND_OVERHEAD_SIZE], p_data, size);
+    p_bond->tx_seq++;
+
+    return salt_bond_path_write(p_path, NULL, size + SALT_BOND_OVERHEAD_SIZE);
+}
+
+salt_ret_t salt_bond_flush(salt_bond_t *p_bond)
+{
+    salt_ret_t ret = SALT_SUCCESS;
+    uint8_t i;
+
+    if (NULL == p_bond) {
+        return SALT_ERROR;
+    }
+
+    for (i = 0; i < p_bond->path_count; i++) {
+        salt_bond_path_t *p_path = &p_bond->p_paths[i];
+        if (p_path->tx_pending) {
+            salt_ret_t path_ret = salt_write_execute(p_path->p_channel,
+                                                     &p_path->msg_out,
+                                                     false);
+            if (SALT_ERROR == path_ret) {
+                return SALT_ERROR;
+            }
+            p_path->tx_pending = (SALT_PENDING == path_ret);
+            if (p_path->tx_pending) {
+                ret = SALT_PENDING;
+            }
+        }
+    }
+
+    return ret;
+}
+
+salt_ret_t salt_bond_read(salt_bond_t *p_bond,
+                          uint8_t **pp_data,
+                          uint32_t *p_size)
+{
+    uint8_t heads = 0;
+    uint8_t i;
+
+    if ((NULL == p_bond) || (NULL == pp_data) ||
+        (NULL == p_size) || (0U == p_bond->path_count)) {
+        return SALT_ERROR;
+    }
+
+    /*
+     * Each path is received in order, so the next expected message is the
+     * first unread message of one of the paths. Paths without an unread
+     * message are read until the expected message is found.
+     */
+    for (i = 0; i < p_bond->path_count; i++) {
+        salt_bond_path_t *p_path = &p_bond->p_paths[i];
+
+        if (!p_path->rx_head) {
+            salt_ret_t ret = salt_bond_path_read(p_path);
+            if (SALT_ERROR == ret) {
+                return SALT_ERROR;
+            }
+            if (SALT_PENDING == ret) {
+                continue;
+            }
+        }
+
+        /* A message that was already delivered is a protocol violation. */
+        if ((int32_t) (p_path->head_seq - p_bond->rx_seq) < 0) {
+            p_path->p_channel->err_code = SALT_ERR_BAD_PROTOCOL;
+            return SALT_ERROR;
+        }
+
+        if (p_path->head_seq == p_bond->rx_seq) {
+            *pp_data = &p_path->msg_in.read.p_payload[SALT_BOND_OVERHEAD_SIZE];
+            *p_size = p_path->msg_in.read.message_size - SALT_BOND_OVERHEAD_SIZE;
+            p_path->rx_head = false;
+            p_bond->rx_seq++;
+            return SALT_SUCCESS;
+        }
+
+        heads++;
+    }
+
+    /*
+     * If all paths have an unread message, but none of them is the expected
+     * one, the peer skipped a sequence number and the bond would stall.
+     */
+    if (heads == p_bond->path_count) {
+        p_bond->p_paths[0].p_channel->err_code = SALT_ERR_BAD_PROTOCOL;
+        return SALT_ERROR;
+    }
+
+    return SALT_PENDING;
+}
+
+/*======= Local function implementations ======================================*/
+
+/**
+ * @brief Writes a single message record on a path.
+ *
+ * @param p_path    Pointer to path.
+ * @param p_payload Message to copy to the write buffer. If NULL, the message
+ *                  is already in place in p_path->msg_out.
+ * @param size      Size of message.
+ *
+ * @return SALT_SUCCESS The record was written or is pending.
+ * @return SALT_ERROR   The record could not be written.
+ */
+static salt_ret_t salt_bond_path_write(salt_bond_path_t *p_path,
+                                       uint8_t *p_payload,
+                                       uint32_t size)
+{
+    salt_ret_t ret;
+
+    if (NULL != p_payload) {
+        ret = salt_write_begin(p_path->p_tx_buffer, p_path->tx_size, &p_path->msg_out);
+        if (SALT_SUCCESS == ret) {
+            ret = salt_write_next(&p_path->msg_out, p_payload, size);
+        }
+    }
+    else {
+        ret = salt_write_commit(&p_path->msg_out, size);
+    }
+
+    if (SALT_SUCCESS != ret) {
+        return SALT_ERROR;
+    }
+
+    ret = salt_write_execute(p_path->p_channel, &p_path->msg_out, false);
+    p_path->tx_pending = (SALT_PENDING == ret);
+
+    return (SALT_ERROR == ret) ? SALT_ERROR : SALT_SUCCESS;
+}
+
+/**
+ * @brief Parses the next unread data message of a path.
+ *
+ * Reads a new record if all messages in the current record are read.
+ *
+ * @param p_path    Pointer to path.
+ *
+ * @return SALT_SUCCESS p_path->head_seq is the sequence number of the first
+ *                      unread message.
+ * @return SALT_PENDING No record is received.
+ * @return SALT_ERROR   The record could not be read or was not a data message.
+ */
+static salt_ret_t salt_bond_path_read(salt_bond_path_t *p_path)
+{
+    salt_channel_t *p_channel = p_path->p_channel;
+    salt_msg_t *p_msg = &p_path->msg_in;
+    salt_ret_t ret;
+
+    if (p_path->rx_record) {
+        SALT_VERIFY(salt_read_next(p_msg) == SALT_SUCCESS, SALT_ERR_BAD_PROTOCOL);
+    }
+    else {
+        /* The first message of the record is parsed by salt_read_begin. */
+        ret = salt_read_begin(p_channel, p_path->p_rx_buffer, p_path->rx_size, p_msg);
+        if (SALT_SUCCESS != ret) {
+            return ret;
+        }
+    }
+
+    SALT_VERIFY((p_msg->read.message_size >= SALT_BOND_OVERHEAD_SIZE) &&
+                (SALT_BOND_DATA == p_msg->read.p_payload[0]),
+                SALT_ERR_BAD_PROTOCOL);
+
+    p_path->rx_record = (p_msg->read.messages_left > 0U);
+    p_path->head_seq = salti_bytes_to_u32(&p_msg->read.p_payload[1]);
+    p_path->rx_head = true;
+
+    return SALT_SUCCESS;
+}
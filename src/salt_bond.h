@@ -0,0 +1,222 @@
+#ifndef _SALT_BOND_H_
+#define _SALT_BOND_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file salt_bond.h
+ *
+ * Bonding of several salt channel sessions into one logical message stream.
+ *
+ * One TCP connection with one salt session can not fill a link with a large
+ * bandwidth delay product. A bond stripes the messages of one stream over K
+ * established sessions to the same peer, each message is sent on the next path
+ * that is not blocked. Every message is prefixed with a sequence number and the
+ * receiver delivers the messages in order.
+ *
+ * Since each path is delivered in order and the sequence numbers are assigned
+ * in increasing order, the next expected message is always first in one of the
+ * paths. Hence, the receiver only needs the read buffer of each path, and the
+ * messages are delivered without copying.
+ *
+ * Bond messages:
+ *  join = { SALT_BOND_JOIN[1] , bondId[SALT_BOND_ID_SIZE] , pathCount[1] }
+ *  data = { SALT_BOND_DATA[1] , seq[4] , payload[n] }
+ *
+ * The join message is sent by the client as the first message on each path so
+ * that the host can group the sessions, see \ref salt_bond_accept.
+ *
+ * Usage, client:
+ *      salt_bond_init(&bond, paths, K, bond_id);
+ *      for each established channel:
+ *          salt_bond_add(&bond, &channel[i], rx[i], sizeof(rx[i]), tx[i], sizeof(tx[i]));
+ *      while ((ret = salt_bond_join(&bond)) == SALT_PENDING);
+ *
+ * Usage, host:
+ *      for each established channel:
+ *          while ((ret = salt_bond_accept(&channel[i], rx[i], sizeof(rx[i]), bond_id, &count)) == SALT_PENDING);
+ *          Find or create the bond matching bond_id and salt_bond_add it.
+ *
+ * The bond is not thread safe. The memory of each path is provided by the user.
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+#include "salt.h"
+
+/*======= Public macro definitions ==========================================*/
+
+#define SALT_BOND_ID_SIZE           (8U)        /**< Size of bond identifier. */
+#define SALT_BOND_JOIN              (0x01U)     /**< Join message type. */
+#define SALT_BOND_DATA              (0x02U)     /**< Data message type. */
+#define SALT_BOND_JOIN_SIZE         (10U)       /**< Size of join message. */
+#define SALT_BOND_OVERHEAD_SIZE     (5U)        /**< Overhead of data message. */
+
+/*======= Type Definitions and declarations ===================================*/
+
+/**
+ * @brief One path of a bond, i.e., one established salt session.
+ */
+typedef struct salt_bond_path_s {
+    salt_channel_t  *p_channel;     /**< Established salt channel. */
+    uint8_t         *p_rx_buffer;   /**< Read buffer of this path. */
+    uint32_t        rx_size;        /**< Size of read buffer. */
+    uint8_t         *p_tx_buffer;   /**< Write buffer of this path. */
+    uint32_t        tx_size;        /**< Size of write buffer. */
+    salt_msg_t      msg_in;         /**< Current read record. */
+    salt_msg_t      msg_out;        /**< Current write record. */
+    uint32_t        head_seq;       /**< Sequence number of first unread message. */
+    bool            rx_record;      /**< msg_in has messages left to read. */
+    bool            rx_head;        /**< First unread message is parsed. */
+    bool            tx_pending;     /**< msg_out is not yet written. */
+    bool            joined;         /**< Join message is sent or received. */
+} salt_bond_path_t;
+
+/**
+ * @brief Bond of several salt sessions.
+ */
+typedef struct salt_bond_s {
+    salt_bond_path_t    *p_paths;                       /**< User provided paths. */
+    uint8_t             max_paths;                      /**< Size of p_paths. */
+    uint8_t             path_count;                     /**< Number of added paths. */
+    uint8_t             next_path;                      /**< Next path to write to. */
+    uint32_t            tx_seq;                         /**< Sequence number of next written message. */
+    uint32_t            rx_seq;                         /**< Sequence number of next read message. */
+    uint8_t             bond_id[SALT_BOND_ID_SIZE];     /**< Bond identifier. */
+} salt_bond_t;
+
+/*======= Public function declarations ========================================*/
+
+/**
+ * @brief Initiates a bond.
+ *
+ * @param p_bond        Pointer to bond.
+ * @param p_paths       Pointer to max_paths path structures.
+ * @param max_paths     Maximum number of paths in bond.
+ * @param p_bond_id     Bond identifier, SALT_BOND_ID_SIZE bytes. Should be random
+ *                      on the client, on the host the identifier from
+ *                      \ref salt_bond_accept is used.
+ *
+ * @return SALT_SUCCESS The bond was initiated.
+ * @return SALT_ERROR   Any input pointer was NULL or max_paths was 0.
+ */
+salt_ret_t salt_bond_init(salt_bond_t *p_bond,
+                          salt_bond_path_t *p_paths,
+                          uint8_t max_paths,
+                          const uint8_t *p_bond_id);
+
+/**
+ * @brief Adds an established salt session to a bond.
+ *
+ * The read buffer is used for the records received on the path, and the
+ * write buffer for the records sent on the path. The largest message that can
+ * be written is tx_size - SALT_WRITE_OVERHEAD_SIZE - SALT_BOND_OVERHEAD_SIZE.
+ *
+ * @param p_bond        Pointer to bond.
+ * @param p_channel     Pointer to established salt channel.
+ * @param p_rx_buffer   Read buffer for this path.
+ * @param rx_size       Size of read buffer.
+ * @param p_tx_buffer   Write buffer for this path.
+ * @param tx_size       Size of write buffer.
+ *
+ * @return SALT_SUCCESS The path was added.
+ * @return SALT_ERROR   The session is not established, a buffer is too small
+ *                      or the bond is full.
+ */
+salt_ret_t salt_bond_add(salt_bond_t *p_bond,
+                         salt_channel_t *p_channel,
+                         uint8_t *p_rx_buffer,
+                         uint32_t rx_size,
+                         uint8_t *p_tx_buffer,
+                         uint32_t tx_size);
+
+/**
+ * @brief Sends the join message on all paths, used by the client.
+ *
+ * @param p_bond        Pointer to bond.
+ *
+ * @return SALT_SUCCESS The join message was sent on all paths.
+ * @return SALT_PENDING The join message is not yet sent on all paths.
+ * @return SALT_ERROR   Any path failed, see err_code of the channels.
+ */
+salt_ret_t salt_bond_join(salt_bond_t *p_bond);
+
+/**
+ * @brief Reads the join message on a new session, used by the host.
+ *
+ * The host uses the bond identifier to find the bond to add the session to,
+ * and the path count to know when all paths of the bond have joined.
+ *
+ * @param p_channel     Pointer to established salt channel.
+ * @param p_buffer      Read buffer.
+ * @param size          Size of read buffer.
+ * @param p_bond_id     Bond identifier is returned here, SALT_BOND_ID_SIZE bytes.
+ * @param p_count       Number of paths in the bond is returned here.
+ *
+ * @return SALT_SUCCESS The join message was read.
+ * @return SALT_PENDING The join message is not yet received.
+ * @return SALT_ERROR   The first message was not a join message.
+ */
+salt_ret_t salt_bond_accept(salt_channel_t *p_channel,
+                            uint8_t *p_buffer,
+                            uint32_t size,
+                            uint8_t *p_bond_id,
+                            uint8_t *p_count);
+
+/**
+ * @brief Writes a message to the bond.
+ *
+ * The message is copied to the write buffer of the next path that is not
+ * blocked by a pending write. If the write to the path does not complete, the
+ * message is still accepted and SALT_SUCCESS is returned. The pending writes
+ * are continued by the next call to salt_bond_write or \ref salt_bond_flush.
+ *
+ * @param p_bond        Pointer to bond.
+ * @param p_data        Message to write.
+ * @param size          Size of message.
+ *
+ * @return SALT_SUCCESS The message was accepted.
+ * @return SALT_PENDING All paths are blocked, try again with the same message.
+ * @return SALT_ERROR   The message was too large or any path failed.
+ */
+salt_ret_t salt_bond_write(salt_bond_t *p_bond,
+                           const uint8_t *p_data,
+                           uint32_t size);
+
+/**
+ * @brief Continues pending writes on all paths.
+ *
+ * @param p_bond        Pointer to bond.
+ *
+ * @return SALT_SUCCESS No writes are pending.
+ * @return SALT_PENDING A write on any path is still pending.
+ * @return SALT_ERROR   Any path failed.
+ */
+salt_ret_t salt_bond_flush(salt_bond_t *p_bond);
+
+/**
+ * @brief Reads the next message in order from the bond.
+ *
+ * The returned message points into the read buffer of a path, and is valid
+ * until the next call to salt_bond_read.
+ *
+ * @param p_bond        Pointer to bond.
+ * @param pp_data       Pointer to message is returned here.
+ * @param p_size        Size of message is returned here.
+ *
+ * @return SALT_SUCCESS A message was read.
+ * @return SALT_PENDING The next message is not yet received.
+ * @return SALT_ERROR   Any path failed or the peer violated the bond protocol.
+ */
+salt_ret_t salt_bond_read(salt_bond_t *p_bond,
+                          uint8_t **pp_data,
+                          uint32_t *p_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SALT_BOND_H_ */
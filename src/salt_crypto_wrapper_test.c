@@ -89,7 +89,9 @@ int salt_crypto_wrapper_test(void)
     VERIFY(test_api_crypto_box_beforenm() == 0);
     VERIFY(test_api_crypto_box_afternm() == 0);
     VERIFY(test_api_crypto_sign() == 0);
+    VERIFY(test_api_crypto_sign_precomputed() == 0);
     VERIFY(test_api_crypto_hash() == 0);
+    VERIFY(test_api_crypto_scratch() == 0);
 
     return 0;
 }
@@ -171,6 +173,20 @@ int test_api_crypto_box_afternm(void)
 
     VERIFY(memcmp(calculated_cipher, expected_cipher, 42) == 0);
 
+    /* Tests with the clear text given in two parts */
+    for (uint32_t split = 0; split <= 10; split += 5) {
+        memset(calculated_cipher, 0xFF, sizeof(calculated_cipher));
+        ret = api_crypto_box_afternm_parts(calculated_cipher,
+                                           &clear_text[32],
+                                           split,
+                                           &clear_text[32 + split],
+                                           10 - split,
+                                           nonce,
+                                           ek_common);
+        VERIFY(0 == ret);
+        VERIFY(memcmp(calculated_cipher, expected_cipher, 42) == 0);
+    }
+
     uint8_t calculated_clear_text[42];
     memset(calculated_clear_text, 0x00, api_crypto_box_BOXZEROBYTES);
 
@@ -379,6 +395,68 @@ int test_api_crypto_sign(void)
     return 0;
 }
 
+int test_api_crypto_sign_precomputed(void)
+{
+    const uint8_t message[4] = { 'a', 'b', 'c', 'd' };
+    const uint8_t zero[api_crypto_sign_PRECOMPUTEDBYTES] = { 0x00 };
+    uint8_t precomputed[2][api_crypto_sign_PRECOMPUTEDBYTES];
+    uint8_t signed_message[2][api_crypto_sign_BYTES + sizeof(message)];
+    uint8_t verified_message[api_crypto_sign_BYTES + sizeof(message)];
+    uint64_t signed_message_length;
+
+    /* Precomputed signing is optional for a crypto library. */
+    if (api_crypto_sign_precompute(precomputed[0], alice_sk_sec) != 0) {
+        return 0;
+    }
+    VERIFY(api_crypto_sign_precompute(precomputed[1], alice_sk_sec) == 0);
+
+    /* Each commitment is randomized. */
+    VERIFY(memcmp(precomputed[0], precomputed[1], api_crypto_sign_PRECOMPUTEDBYTES) != 0);
+
+    for (uint32_t i = 0; i < 2; i++) {
+        VERIFY(api_crypto_sign_precomputed(signed_message[i],
+                                           &signed_message_length,
+                                           message,
+                                           sizeof(message),
+                                           alice_sk_sec,
+                                           precomputed[i]) == 0);
+        VERIFY(signed_message_length == sizeof(signed_message[i]));
+
+        /* The commitment is cleared and can not be used again. */
+        VERIFY(memcmp(precomputed[i], zero, sizeof(zero)) == 0);
+
+        VERIFY(api_crypto_sign_open(verified_message,
+                                    NULL,
+                                    signed_message[i],
+                                    sizeof(signed_message[i]),
+                                    alice_sk_pub) == 0);
+        VERIFY(memcmp(verified_message, message, sizeof(message)) == 0);
+        VERIFY(api_crypto_sign_open(verified_message,
+                                    NULL,
+                                    signed_message[i],
+                                    sizeof(signed_message[i]),
+                                    bob_sk_pub) != 0);
+    }
+    VERIFY(memcmp(signed_message[0], signed_message[1], api_crypto_sign_BYTES) != 0);
+
+    /* In place operation. */
+    VERIFY(api_crypto_sign_precompute(precomputed[0], bob_sk_sec) == 0);
+    memset(signed_message[0], 0x00, api_crypto_sign_BYTES);
+    memcpy(&signed_message[0][api_crypto_sign_BYTES], message, sizeof(message));
+    VERIFY(api_crypto_sign_precomputed(signed_message[0],
+                                       NULL,
+                                       &signed_message[0][api_crypto_sign_BYTES],
+                                       sizeof(message),
+                                       bob_sk_sec,
+                                       precomputed[0]) == 0);
+    VERIFY(api_crypto_sign_verify_detached(signed_message[0],
+                                           message,
+                                           sizeof(message),
+                                           bob_sk_pub) == 0);
+
+    return 0;
+}
+
 int test_api_crypto_hash(void)
 {
 
@@ -419,4 +497,39 @@ int test_api_crypto_hash(void)
     return 0;
 }
 
+int test_api_crypto_scratch(void)
+{
+    static uint64_t scratch[api_crypto_scratch_BYTES / 8];
+    int ret;
+
+    /*
+     * A crypto library without scratch support must reject the workspace.
+     * The default mode is then already tested above.
+     */
+    if (api_crypto_scratch_set(scratch, sizeof(scratch)) != 0) {
+        VERIFY(api_crypto_scratch_set(NULL, 0) == 0);
+        return 0;
+    }
+
+    VERIFY(api_crypto_scratch_set(scratch, sizeof(scratch) - 1) != 0);
+    VERIFY(api_crypto_scratch_set(((uint8_t *) scratch) + 1, sizeof(scratch) - 8) != 0);
+    VERIFY(api_crypto_scratch_set(scratch, sizeof(scratch)) == 0);
+
+    ret = test_api_crypto_box_beforenm();
+    ret |= test_api_crypto_box_afternm();
+    ret |= test_api_crypto_sign();
+    ret |= test_api_crypto_sign_precomputed();
+    ret |= test_api_crypto_hash();
+
+    VERIFY(api_crypto_scratch_set(NULL, 0) == 0);
+    VERIFY(ret == 0);
+
+    /* No secrets are left in the workspace. */
+    for (uint32_t i = 0; i < sizeof(scratch) / 8; i++) {
+        VERIFY(scratch[i] == 0);
+    }
+
+    return 0;
+}
+
 /*======= Local function implementations ====================================*/
@@ -49,6 +49,27 @@ int test_api_crypto_box_afternm(void);
 int test_api_crypto_sign(void);
 int test_api_crypto_hash(void);
 
+/**
+ * @brief Tests signing with a precomputed commitment.
+ *
+ * Passes if the crypto library does not support precomputed signing.
+ *
+ * @return 0    Test passed
+ * @return != 0 Test failed
+ */
+int test_api_crypto_sign_precomputed(void);
+
+/**
+ * @brief Tests the crypto API using a scratch workspace.
+ *
+ * Reruns the test cases above with a scratch workspace set. Passes if the
+ * crypto library does not support a scratch workspace.
+ *
+ * @return 0    Test passed
+ * @return != 0 Test failed
+ */
+int test_api_crypto_scratch(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,457 @@
+/**
+ * @file salt_directory.c
+ *
+ * Directory of established salt sessions keyed by the public key of the peer.
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+/* C Library includes */
+#include <string.h> /* memcpy, memset */
+
+/* Salt library includes */
+#include "salt_directory.h"
+#include "salti_atomic.h"
+#include "salti_util.h"
+
+/*======= Local Macro Definitions =============================================*/
+
+/*
+ * The slots are read by other threads while they are changed. A slot is a
+ * pointer to an immutable entry, loaded and stored atomically. Without atomic
+ * builtins, lookups are done under the lock.
+ */
+
+#define SALT_DIRECTORY_KEY_WORDS                (api_crypto_sign_PUBLICKEYBYTES / 8U)
+
+/* A removed slot points here, so that the probes continue past it. */
+#define SALT_DIRECTORY_DELETED                  (&salt_directory_deleted)
+
+/*======= Type Definitions ====================================================*/
+/*======= Local variable declarations =========================================*/
+
+static salt_directory_entry_t salt_directory_deleted;
+
+/*======= Local function prototypes ===========================================*/
+
+static uint32_t salt_directory_hash(const salt_directory_t *p_dir,
+                                    const uint64_t *p_key);
+static salt_directory_entry_t **salt_directory_find(salt_directory_t *p_dir,
+                                                    const uint64_t *p_key,
+                                                    salt_directory_entry_t ***ppp_free);
+static salt_directory_entry_t *salt_directory_alloc(salt_directory_t *p_dir);
+static uint32_t salt_directory_retire(salt_directory_t *p_dir,
+                                      salt_directory_entry_t *p_entry);
+static void salt_directory_lock(salt_directory_t *p_dir);
+static void salt_directory_unlock(salt_directory_t *p_dir);
+
+/*======= Global function implementations =====================================*/
+
+salt_ret_t salt_directory_init(salt_directory_t *p_dir,
+                               salt_directory_entry_t **pp_slots,
+                               uint32_t count,
+                               salt_directory_entry_t *p_entries,
+                               uint32_t entry_count,
+                               uint32_t *p_readers,
+                               uint32_t reader_count,
+                               salt_directory_lock_t lock,
+                               salt_directory_lock_t unlock,
+                               void *p_lock_context)
+{
+    if ((NULL == p_dir) || (NULL == pp_slots) ||
+        (count < 2U) || ((count & (count - 1U)) != 0U) ||
+        (NULL == p_entries) || (0U == entry_count) ||
+        ((NULL == p_readers) && (reader_count > 0U)) ||
+        ((NULL == lock) != (NULL == unlock))) {
+        return SALT_ERROR;
+    }
+
+    memset(p_dir, 0x00U, sizeof(salt_directory_t));
+    memset(pp_slots, 0x00U, sizeof(salt_directory_entry_t *) * count);
+    memset(p_entries, 0x00U, sizeof(salt_directory_entry_t) * entry_count);
+    if (reader_count > 0U) {
+        memset(p_readers, 0x00U, sizeof(uint32_t) * reader_count);
+    }
+
+    /* The seed prevents a peer from choosing keys that collide. */
+    if (api_crypto_randombytes((uint8_t *) &p_dir->seed, sizeof(p_dir->seed)) != 0) {
+        return SALT_ERROR;
+    }
+
+    for (uint32_t i = 0; i < entry_count - 1U; i++) {
+        p_entries[i].p_next = &p_entries[i + 1U];
+    }
+
+    p_dir->pp_slots = pp_slots;
+    p_dir->mask = count - 1U;
+    p_dir->p_free = p_entries;
+    p_dir->p_readers = p_readers;
+    p_dir->reader_count = reader_count;
+    p_dir->epoch = 1U;
+    p_dir->lock = lock;
+    p_dir->unlock = unlock;
+    p_dir->p_lock_context = p_lock_context;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_directory_add(salt_directory_t *p_dir,
+                              salt_channel_t *p_channel,
+                              void *p_context)
+{
+    salt_directory_entry_t **pp_slot;
+    salt_directory_entry_t **pp_free;
+    salt_directory_entry_t *p_entry;
+    salt_directory_entry_t *p_old;
+    salt_ret_t ret = SALT_SUCCESS;
+
+    if ((NULL == p_dir) || (NULL == p_channel) ||
+        (SALT_SESSION_ESTABLISHED != p_channel->state)) {
+        return SALT_ERROR;
+    }
+
+    salt_directory_lock(p_dir);
+
+    p_entry = salt_directory_alloc(p_dir);
+    if (NULL == p_entry) {
+        salt_directory_unlock(p_dir);
+        return SALT_ERROR;
+    }
+
+    /* The entry is complete before a reader can find it. */
+    memcpy(p_entry->key, p_channel->peer_sk_pub, sizeof(p_entry->key));
+    p_entry->p_channel = p_channel;
+    p_entry->p_context = p_context;
+    p_entry->retired = 0U;
+    p_entry->p_next = NULL;
+
+    pp_slot = salt_directory_find(p_dir, p_entry->key, &pp_free);
+
+    if (NULL != pp_slot) {
+        /* A new session of the same peer replaces the old one. */
+        p_old = *pp_slot;
+        SALT_ATOMIC_STORE_RELEASE(pp_slot, p_entry);
+        (void) salt_directory_retire(p_dir, p_old);
+    }
+    else if ((NULL != pp_free) && (SALT_DIRECTORY_DELETED == *pp_free)) {
+        SALT_ATOMIC_STORE_RELEASE(pp_free, p_entry);
+        p_dir->count++;
+    }
+    else if ((NULL != pp_free) && ((p_dir->used + 1U) <= p_dir->mask)) {
+        /* One slot is always kept empty so that every probe ends. */
+        SALT_ATOMIC_STORE_RELEASE(pp_free, p_entry);
+        p_dir->used++;
+        p_dir->count++;
+    }
+    else {
+        /* Never published, may be used again at once. */
+        p_entry->p_next = p_dir->p_free;
+        p_dir->p_free = p_entry;
+        ret = SALT_ERROR;
+    }
+
+    salt_directory_unlock(p_dir);
+
+    return ret;
+}
+
+salt_ret_t salt_directory_remove(salt_directory_t *p_dir,
+                                 salt_channel_t *p_channel,
+                                 uint32_t *p_retired)
+{
+    salt_directory_entry_t **pp_slot;
+    salt_directory_entry_t *p_entry;
+    uint64_t key[SALT_DIRECTORY_KEY_WORDS];
+    uint32_t index;
+    uint32_t epoch;
+
+    if ((NULL == p_dir) || (NULL == p_channel)) {
+        return SALT_ERROR;
+    }
+
+    memcpy(key, p_channel->peer_sk_pub, sizeof(key));
+
+    salt_directory_lock(p_dir);
+
+    pp_slot = salt_directory_find(p_dir, key, NULL);
+    if ((NULL == pp_slot) || ((*pp_slot)->p_channel != p_channel)) {
+        salt_directory_unlock(p_dir);
+        return SALT_ERROR;
+    }
+
+    p_entry = *pp_slot;
+    SALT_ATOMIC_STORE_RELEASE(pp_slot, SALT_DIRECTORY_DELETED);
+    p_dir->count--;
+
+    /*
+     * If the next slot is empty, no probe continues past the removed slot.
+     * It is then emptied, and so are the removed slots before it.
+     */
+    index = (uint32_t) (pp_slot - p_dir->pp_slots);
+    while ((SALT_DIRECTORY_DELETED == p_dir->pp_slots[index]) &&
+           (NULL == p_dir->pp_slots[(index + 1U) & p_dir->mask])) {
+        SALT_ATOMIC_STORE_RELEASE(&p_dir->pp_slots[index], NULL);
+        p_dir->used--;
+        index = (index - 1U) & p_dir->mask;
+    }
+
+    epoch = salt_directory_retire(p_dir, p_entry);
+
+    salt_directory_unlock(p_dir);
+
+    if (NULL != p_retired) {
+        *p_retired = epoch;
+    }
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_directory_lookup(salt_directory_t *p_dir,
+                                 const uint8_t *p_peer_pub,
+                                 salt_channel_t **pp_channel,
+                                 void **pp_context)
+{
+    uint64_t key[SALT_DIRECTORY_KEY_WORDS];
+    salt_directory_entry_t *p_found = NULL;
+    uint32_t index;
+
+    if ((NULL == p_dir) || (NULL == p_peer_pub)) {
+        return SALT_ERROR;
+    }
+
+    memcpy(key, p_peer_pub, sizeof(key));
+    index = salt_directory_hash(p_dir, key);
+
+    if (!SALT_ATOMIC_LOCK_FREE) {
+        salt_directory_lock(p_dir);
+    }
+
+    /* One load per slot, an entry is never changed while it can be found. */
+    for (uint32_t i = 0; i <= p_dir->mask; i++) {
+        salt_directory_entry_t *p_entry = SALT_ATOMIC_LOAD_ACQUIRE(&p_dir->pp_slots[index]);
+
+        if (NULL == p_entry) {
+            break;
+        }
+
+        if ((SALT_DIRECTORY_DELETED != p_entry) &&
+            (memcmp(p_entry->key, key, sizeof(key)) == 0)) {
+            p_found = p_entry;
+            break;
+        }
+
+        index = (index + 1U) & p_dir->mask;
+    }
+
+    if (!SALT_ATOMIC_LOCK_FREE) {
+        salt_directory_unlock(p_dir);
+    }
+
+    if (NULL == p_found) {
+        return SALT_ERROR;
+    }
+
+    if (NULL != pp_channel) {
+        *pp_channel = p_found->p_channel;
+    }
+    if (NULL != pp_context) {
+        *pp_context = p_found->p_context;
+    }
+
+    return SALT_SUCCESS;
+}
+
+void salt_directory_enter(salt_directory_t *p_dir, uint32_t reader)
+{
+    if ((NULL == p_dir) || (reader >= p_dir->reader_count)) {
+        return;
+    }
+
+    SALT_ATOMIC_STORE_RELAXED(&p_dir->p_readers[reader],
+                              SALT_ATOMIC_LOAD_ACQUIRE(&p_dir->epoch));
+    /* The epoch must be visible to the writer before any slot is read. */
+    SALT_ATOMIC_FENCE();
+}
+
+void salt_directory_leave(salt_directory_t *p_dir, uint32_t reader)
+{
+    if ((NULL == p_dir) || (reader >= p_dir->reader_count)) {
+        return;
+    }
+
+    SALT_ATOMIC_STORE_RELEASE(&p_dir->p_readers[reader], 0U);
+}
+
+salt_ret_t salt_directory_reclaimable(salt_directory_t *p_dir, uint32_t retired)
+{
+    if (NULL == p_dir) {
+        return SALT_ERROR;
+    }
+
+    SALT_ATOMIC_FENCE();
+
+    for (uint32_t i = 0; i < p_dir->reader_count; i++) {
+        uint32_t epoch = SALT_ATOMIC_LOAD_ACQUIRE(&p_dir->p_readers[i]);
+        /* Entered before the removal, compared so that the epoch may wrap. */
+        if ((0U != epoch) && ((int32_t) (epoch - retired) < 0)) {
+            return SALT_PENDING;
+        }
+    }
+
+    return SALT_SUCCESS;
+}
+
+void salt_directory_session_hook(void *p_context,
+                                 salt_channel_t *p_channel,
+                                 bool established)
+{
+    salt_directory_session_t *p_session = (salt_directory_session_t *) p_context;
+
+    if (NULL == p_session) {
+        return;
+    }
+
+    if (established) {
+        /* A full directory only means that the session is not found. */
+        p_session->retired = 0U;
+        (void) salt_directory_add(p_session->p_dir, p_channel, p_session->p_context);
+    }
+    else {
+        (void) salt_directory_remove(p_session->p_dir, p_channel, &p_session->retired);
+    }
+}
+
+/*======= Local function implementations ======================================*/
+
+/**
+ * @brief Returns the first slot to probe for a key.
+ */
+static uint32_t salt_directory_hash(const salt_directory_t *p_dir,
+                                    const uint64_t *p_key)
+{
+    uint64_t hash = salti_key_hash(p_dir->seed, p_key, SALT_DIRECTORY_KEY_WORDS);
+
+    return (uint32_t) (hash >> 32) & p_dir->mask;
+}
+
+/**
+ * @brief Finds the slot of a key, used when the lock is held.
+ *
+ * If ppp_free is not NULL, the first removed slot on the probe path, or else
+ * the empty slot that ended the probe, is returned there.
+ */
+static salt_directory_entry_t **salt_directory_find(salt_directory_t *p_dir,
+                                                    const uint64_t *p_key,
+                                                    salt_directory_entry_t ***ppp_free)
+{
+    uint32_t index = salt_directory_hash(p_dir, p_key);
+    salt_directory_entry_t **pp_free = NULL;
+
+    for (uint32_t i = 0; i <= p_dir->mask; i++) {
+        salt_directory_entry_t **pp_slot = &p_dir->pp_slots[index];
+
+        if (NULL == *pp_slot) {
+            if (NULL == pp_free) {
+                pp_free = pp_slot;
+            }
+            break;
+        }
+
+        if (SALT_DIRECTORY_DELETED == *pp_slot) {
+            if (NULL == pp_free) {
+                pp_free = pp_slot;
+            }
+        }
+        else if (memcmp((*pp_slot)->key, p_key, sizeof((*pp_slot)->key)) == 0) {
+            return pp_slot;
+        }
+
+        index = (index + 1U) & p_dir->mask;
+    }
+
+    if (NULL != ppp_free) {
+        *ppp_free = pp_free;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Takes a free entry, used when the lock is held.
+ *
+ * The retired entries are freed in the order they were retired, as soon as
+ * no reader that entered before the retirement is left.
+ */
+static salt_directory_entry_t *salt_directory_alloc(salt_directory_t *p_dir)
+{
+    salt_directory_entry_t *p_entry;
+
+    while ((NULL != p_dir->p_retired) &&
+           (SALT_SUCCESS == salt_directory_reclaimable(p_dir, p_dir->p_retired->retired))) {
+        p_entry = p_dir->p_retired;
+        p_dir->p_retired = p_entry->p_next;
+        p_entry->p_next = p_dir->p_free;
+        p_dir->p_free = p_entry;
+    }
+
+    if (NULL == p_dir->p_retired) {
+        p_dir->p_retired_last = NULL;
+    }
+
+    p_entry = p_dir->p_free;
+    if (NULL != p_entry) {
+        p_dir->p_free = p_entry->p_next;
+    }
+
+    return p_entry;
+}
+
+/**
+ * @brief Retires an entry that no slot points to, used when the lock is held.
+ *
+ * Readers that enter after the new epoch can not find the entry.
+ */
+static uint32_t salt_directory_retire(salt_directory_t *p_dir,
+                                      salt_directory_entry_t *p_entry)
+{
+    uint32_t epoch = p_dir->epoch + 1U;
+
+    if (0U == epoch) {
+        epoch = 1U;
+    }
+    SALT_ATOMIC_STORE_RELEASE(&p_dir->epoch, epoch);
+    SALT_ATOMIC_FENCE();
+
+    p_entry->retired = epoch;
+    p_entry->p_next = NULL;
+    if (NULL == p_dir->p_retired_last) {
+        p_dir->p_retired = p_entry;
+    }
+    else {
+        p_dir->p_retired_last->p_next = p_entry;
+    }
+    p_dir->p_retired_last = p_entry;
+
+    return epoch;
+}
+
+/**
+ * @brief Locks the directory if a lock implementation is given.
+ */
+static void salt_directory_lock(salt_directory_t *p_dir)
+{
+    if (NULL != p_dir->lock) {
+        p_dir->lock(p_dir->p_lock_context);
+    }
+}
+
+/**
+ * @brief Unlocks the directory if a lock implementation is given.
+ */
+static void salt_directory_unlock(salt_directory_t *p_dir)
+{
+    if (NULL != p_dir->unlock) {
+        p_dir->unlock(p_dir->p_lock_context);
+    }
+}
@@ -0,0 +1,261 @@
+#ifndef _SALT_DIRECTORY_H_
+#define _SALT_DIRECTORY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file salt_directory.h
+ *
+ * Directory of established salt sessions keyed by the authenticated public
+ * signature key of the peer.
+ *
+ * After the handshake, peer_sk_pub identifies the peer. A host that serves many
+ * peers on several threads uses the directory to find the live session of a
+ * given peer, e.g., to push a message to a device. The directory is a fixed
+ * size open addressing hash table of slots in user provided memory.
+ *
+ * Lookups are wait free. Each session is held by an immutable entry, and a slot
+ * points to the entry. Adding, replacing and removing a session publishes a
+ * new pointer in a single atomic store, so a reader sees either the old or the
+ * new entry and never retries. Changes are serialized by an injected lock and
+ * are expected to be rare compared to lookups. Without GCC compatible atomic
+ * builtins, lookups also take the lock.
+ *
+ * A replaced or removed entry may still be read by a reader that found it just
+ * before the change. The directory reuses the entry only when every reader
+ * that could have found it has left, i.e., epoch based reclamation. Therefore,
+ * lookups that run concurrently with changes must be between
+ * \ref salt_directory_enter and \ref salt_directory_leave, and the entries
+ * should exceed the number of sessions by the number of changes that may occur
+ * while a reader is inside. The same grace period tells when the memory of a
+ * removed session may be reused, see \ref salt_directory_reclaimable.
+ *
+ * The sessions may be added and removed by the session owner, or by the salt
+ * channel itself through \ref salt_directory_session_hook.
+ *
+ * Usage, session owner:
+ *      salt_directory_session_t session = { &dir, &session_queue, 0 };
+ *      salt_set_session_hook(&channel, salt_directory_session_hook, &session);
+ *      The session is added when salt_handshake returns SALT_SUCCESS, and
+ *      removed when the session is closed. Then, reuse the session when
+ *      salt_directory_reclaimable(&dir, session.retired) == SALT_SUCCESS.
+ *
+ * Usage, any thread:
+ *      salt_directory_enter(&dir, reader);
+ *      if (salt_directory_lookup(&dir, peer_pub, &p_channel, &p_context) == SALT_SUCCESS) {
+ *          Queue the message to p_context, the channel is written by its owner.
+ *      }
+ *      salt_directory_leave(&dir, reader);
+ *
+ * The channels themselves are not thread safe, the directory only finds them.
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+#include "salt.h"
+
+/*======= Public macro definitions ==========================================*/
+/*======= Type Definitions and declarations ===================================*/
+
+/**
+ * @brief Lock implementation used when the directory is changed.
+ *
+ * @param p_context Pointer to lock context.
+ */
+typedef void (*salt_directory_lock_t)(void *p_context);
+
+/**
+ * @brief Session entry, not changed while a slot points to it.
+ */
+typedef struct salt_directory_entry_s {
+    uint64_t        key[api_crypto_sign_PUBLICKEYBYTES / 8U]; /**< Public signature key of the peer. */
+    salt_channel_t  *p_channel;                         /**< Established session. */
+    void            *p_context;                         /**< User context of the session. */
+    uint32_t        retired;                            /**< Epoch when the entry was replaced or removed. */
+    struct salt_directory_entry_s *p_next;              /**< Next free or retired entry. */
+} salt_directory_entry_t;
+
+/**
+ * @brief Session directory.
+ */
+typedef struct salt_directory_s {
+    salt_directory_entry_t  **pp_slots;                 /**< User provided slots. */
+    uint32_t                mask;                       /**< Number of slots - 1. */
+    uint32_t                used;                       /**< Slots that are not empty. */
+    uint32_t                count;                      /**< Slots that hold a session. */
+    uint64_t                seed;                       /**< Random hash seed. */
+    salt_directory_entry_t  *p_free;                    /**< Entries ready to be used. */
+    salt_directory_entry_t  *p_retired;                 /**< Oldest retired entry. */
+    salt_directory_entry_t  *p_retired_last;            /**< Latest retired entry. */
+    uint32_t                *p_readers;                 /**< Epoch of each reader, 0 when not reading. */
+    uint32_t                reader_count;               /**< Size of p_readers. */
+    uint32_t                epoch;                      /**< Current epoch, starts at 1. */
+    salt_directory_lock_t   lock;                       /**< Lock implementation, may be NULL. */
+    salt_directory_lock_t   unlock;                     /**< Unlock implementation, may be NULL. */
+    void                    *p_lock_context;            /**< Pointer to lock context. */
+} salt_directory_t;
+
+/**
+ * @brief Session hook context, see \ref salt_directory_session_hook.
+ */
+typedef struct salt_directory_session_s {
+    salt_directory_t    *p_dir;                         /**< Directory of the session. */
+    void                *p_context;                     /**< User context of the session, returned by lookups. */
+    uint32_t            retired;                        /**< Epoch of the removal, 0 if the session was not removed. */
+} salt_directory_session_t;
+
+/*======= Public function declarations ========================================*/
+
+/**
+ * @brief Initiates a session directory.
+ *
+ * The number of slots must be a power of two, and one slot is always kept
+ * empty. Hence, at most count - 1 sessions can be added. A removed slot is
+ * reused by a later session whose probe passes it, so with many removals the
+ * directory may be full earlier; about twice the number of sessions keeps the
+ * probes short. Each session and each replaced or removed session that a
+ * reader may still read uses an entry. The lock is required if sessions are
+ * added or removed from more than one thread.
+ *
+ * @param p_dir             Pointer to directory.
+ * @param pp_slots          Pointer to count slots.
+ * @param count             Number of slots, a power of two and at least 2.
+ * @param p_entries         Pointer to entry_count entries.
+ * @param entry_count       Number of entries, at least 1.
+ * @param p_readers         Pointer to reader_count reader epochs, may be NULL
+ *                          if lookups never run concurrently with changes.
+ * @param reader_count      Number of readers.
+ * @param lock              Lock implementation, may be NULL.
+ * @param unlock            Unlock implementation, must be NULL if lock is NULL.
+ * @param p_lock_context    Pointer to lock context.
+ *
+ * @return SALT_SUCCESS The directory was initiated.
+ * @return SALT_ERROR   Any input was invalid or no random seed could be
+ *                      generated.
+ */
+salt_ret_t salt_directory_init(salt_directory_t *p_dir,
+                               salt_directory_entry_t **pp_slots,
+                               uint32_t count,
+                               salt_directory_entry_t *p_entries,
+                               uint32_t entry_count,
+                               uint32_t *p_readers,
+                               uint32_t reader_count,
+                               salt_directory_lock_t lock,
+                               salt_directory_lock_t unlock,
+                               void *p_lock_context);
+
+/**
+ * @brief Adds an established session, keyed by the public key of the peer.
+ *
+ * If a session with the same peer is already in the directory, it is
+ * replaced, i.e., the latest session of a peer is found.
+ *
+ * @param p_dir         Pointer to directory.
+ * @param p_channel     Pointer to established salt channel.
+ * @param p_context     User context of the session, returned by lookups.
+ *
+ * @return SALT_SUCCESS The session was added.
+ * @return SALT_ERROR   The session is not established, the directory is full
+ *                      or no entry is free, i.e., a reader holds the retired
+ *                      entries.
+ */
+salt_ret_t salt_directory_add(salt_directory_t *p_dir,
+                              salt_channel_t *p_channel,
+                              void *p_context);
+
+/**
+ * @brief Removes a session.
+ *
+ * The entry is only removed if it still holds this session, so that a closed
+ * session does not remove a later session of the same peer.
+ *
+ * @param p_dir         Pointer to directory.
+ * @param p_channel     Pointer to salt channel.
+ * @param p_retired     Epoch of the removal is returned here, see
+ *                      \ref salt_directory_reclaimable. May be NULL.
+ *
+ * @return SALT_SUCCESS The session was removed.
+ * @return SALT_ERROR   The session was not in the directory.
+ */
+salt_ret_t salt_directory_remove(salt_directory_t *p_dir,
+                                 salt_channel_t *p_channel,
+                                 uint32_t *p_retired);
+
+/**
+ * @brief Finds the session of a peer.
+ *
+ * May be called from any thread, concurrently with adding and removing
+ * sessions. The lookup never waits for a writer, it reads at most one slot
+ * pointer per probed slot. If it runs concurrently with changes, the call and
+ * the use of the returned pointers must be between \ref salt_directory_enter
+ * and \ref salt_directory_leave.
+ *
+ * @param p_dir         Pointer to directory.
+ * @param p_peer_pub    Public signature key of the peer, 32 bytes.
+ * @param pp_channel    Pointer to the salt channel is returned here, may be NULL.
+ * @param pp_context    User context of the session is returned here, may be NULL.
+ *
+ * @return SALT_SUCCESS The session was found.
+ * @return SALT_ERROR   No session of the peer in the directory.
+ */
+salt_ret_t salt_directory_lookup(salt_directory_t *p_dir,
+                                 const uint8_t *p_peer_pub,
+                                 salt_channel_t **pp_channel,
+                                 void **pp_context);
+
+/**
+ * @brief Marks that a reader starts to use the directory.
+ *
+ * Each thread uses its own reader index.
+ *
+ * @param p_dir         Pointer to directory.
+ * @param reader        Reader index, less than reader_count.
+ */
+void salt_directory_enter(salt_directory_t *p_dir, uint32_t reader);
+
+/**
+ * @brief Marks that a reader no longer uses any pointer from the directory.
+ *
+ * @param p_dir         Pointer to directory.
+ * @param reader        Reader index, less than reader_count.
+ */
+void salt_directory_leave(salt_directory_t *p_dir, uint32_t reader);
+
+/**
+ * @brief Checks if the memory of a removed session may be reused.
+ *
+ * The memory may be reused when no reader that could have found the session
+ * is still using the directory. The directory uses the same check before it
+ * reuses a retired entry.
+ *
+ * @param p_dir         Pointer to directory.
+ * @param retired       Epoch returned by \ref salt_directory_remove.
+ *
+ * @return SALT_SUCCESS The memory may be reused.
+ * @return SALT_PENDING A reader may still use the session, try again later.
+ */
+salt_ret_t salt_directory_reclaimable(salt_directory_t *p_dir, uint32_t retired);
+
+/**
+ * @brief Session hook that keeps the directory in sync with a session.
+ *
+ * Set with \ref salt_set_session_hook and a salt_directory_session_t as
+ * context. The session is added when it is established and removed when it
+ * is closed, and the epoch of the removal is stored in the context.
+ *
+ * @param p_context     Pointer to salt_directory_session_t.
+ * @param p_channel     Pointer to salt channel.
+ * @param established   true when the session was established, false when closed.
+ */
+void salt_directory_session_hook(void *p_context,
+                                 salt_channel_t *p_channel,
+                                 bool established);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SALT_DIRECTORY_H_ */
@@ -0,0 +1,185 @@
+/**
+ * @file salt_dispatch.c
+ *
+ * Ordered dispatch of received salt records to application worker threads.
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+/* C Library includes */
+#include <string.h> /* memset */
+
+/* Salt library includes */
+#include "salt_dispatch.h"
+#include "salti_atomic.h"
+
+/*======= Local Macro Definitions =============================================*/
+/*======= Type Definitions ====================================================*/
+/*======= Local variable declarations =========================================*/
+/*======= Local function prototypes ===========================================*/
+
+static void salt_dispatch_queue_init(salt_dispatch_queue_t *p_queue,
+                                     salt_dispatch_slot_t *p_slots,
+                                     uint32_t count);
+static salt_ret_t salt_dispatch_push(salt_dispatch_queue_t *p_queue,
+                                     salt_dispatch_buffer_t *p_buffer);
+static salt_dispatch_buffer_t *salt_dispatch_pop(salt_dispatch_queue_t *p_queue);
+
+/*======= Global function implementations =====================================*/
+
+salt_ret_t salt_dispatch_init(salt_dispatch_t *p_dispatch,
+                              salt_dispatch_buffer_t *p_buffers,
+                              uint32_t buffer_count,
+                              uint8_t *p_memory,
+                              uint32_t buffer_size,
+                              salt_dispatch_queue_t *p_workers,
+                              uint32_t worker_count,
+                              salt_dispatch_slot_t *p_slots)
+{
+    if ((NULL == p_dispatch) || (NULL == p_buffers) || (NULL == p_memory) ||
+        (NULL == p_workers) || (NULL == p_slots) ||
+        (buffer_count < 2U) || ((buffer_count & (buffer_count - 1U)) != 0U) ||
+        (0U == buffer_size) || (0U == worker_count)) {
+        return SALT_ERROR;
+    }
+
+    memset(p_dispatch, 0x00U, sizeof(salt_dispatch_t));
+    p_dispatch->p_workers = p_workers;
+    p_dispatch->worker_count = worker_count;
+
+    salt_dispatch_queue_init(&p_dispatch->pool, p_slots, buffer_count);
+    for (uint32_t i = 0; i < worker_count; i++) {
+        salt_dispatch_queue_init(&p_workers[i],
+                                 &p_slots[(i + 1U) * buffer_count],
+                                 buffer_count);
+    }
+
+    for (uint32_t i = 0; i < buffer_count; i++) {
+        memset(&p_buffers[i], 0x00U, sizeof(salt_dispatch_buffer_t));
+        p_buffers[i].p_data = &p_memory[i * buffer_size];
+        p_buffers[i].size = buffer_size;
+        salt_dispatch_push(&p_dispatch->pool, &p_buffers[i]);
+    }
+
+    return SALT_SUCCESS;
+}
+
+salt_dispatch_buffer_t *salt_dispatch_acquire(salt_dispatch_t *p_dispatch)
+{
+    if (NULL == p_dispatch) {
+        return NULL;
+    }
+
+    return salt_dispatch_pop(&p_dispatch->pool);
+}
+
+salt_ret_t salt_dispatch_post(salt_dispatch_t *p_dispatch,
+                              salt_dispatch_buffer_t *p_buffer,
+                              uint32_t session)
+{
+    if ((NULL == p_dispatch) || (NULL == p_buffer)) {
+        return SALT_ERROR;
+    }
+
+    return salt_dispatch_push(&p_dispatch->p_workers[session % p_dispatch->worker_count],
+                              p_buffer);
+}
+
+salt_dispatch_buffer_t *salt_dispatch_take(salt_dispatch_t *p_dispatch,
+                                           uint32_t worker)
+{
+    if ((NULL == p_dispatch) || (worker >= p_dispatch->worker_count)) {
+        return NULL;
+    }
+
+    return salt_dispatch_pop(&p_dispatch->p_workers[worker]);
+}
+
+salt_ret_t salt_dispatch_release(salt_dispatch_t *p_dispatch,
+                                 salt_dispatch_buffer_t *p_buffer)
+{
+    if ((NULL == p_dispatch) || (NULL == p_buffer)) {
+        return SALT_ERROR;
+    }
+
+    return salt_dispatch_push(&p_dispatch->pool, p_buffer);
+}
+
+/*======= Local function implementations ======================================*/
+
+static void salt_dispatch_queue_init(salt_dispatch_queue_t *p_queue,
+                                     salt_dispatch_slot_t *p_slots,
+                                     uint32_t count)
+{
+    memset(p_queue, 0x00U, sizeof(salt_dispatch_queue_t));
+    p_queue->p_slots = p_slots;
+    p_queue->mask = count - 1U;
+    for (uint32_t i = 0; i < count; i++) {
+        p_slots[i].seq = i;
+        p_slots[i].p_buffer = NULL;
+    }
+}
+
+/*
+ * Bounded queue with a sequence number in each slot. The slot at position pos
+ * is free for posting when seq == pos, and holds a buffer when seq == pos + 1.
+ * A thread claims a position by moving tail (or head) with compare and swap,
+ * then owns the slot until it publishes the new sequence number. Hence, the
+ * threads only contend on the end of the queue they use.
+ */
+static salt_ret_t salt_dispatch_push(salt_dispatch_queue_t *p_queue,
+                                     salt_dispatch_buffer_t *p_buffer)
+{
+    salt_dispatch_slot_t *p_slot;
+    uint32_t pos = SALT_ATOMIC_LOAD_RELAXED(&p_queue->tail);
+    int32_t diff;
+
+    for (;;) {
+        p_slot = &p_queue->p_slots[pos & p_queue->mask];
+        diff = (int32_t) (SALT_ATOMIC_LOAD_ACQUIRE(&p_slot->seq) - pos);
+        if (0 == diff) {
+            if (SALT_ATOMIC_CAS_RELAXED(&p_queue->tail, &pos, pos + 1U)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* The slot still holds a buffer from the previous round. */
+            return SALT_ERROR;
+        } else {
+            pos = SALT_ATOMIC_LOAD_RELAXED(&p_queue->tail);
+        }
+    }
+
+    p_slot->p_buffer = p_buffer;
+    SALT_ATOMIC_STORE_RELEASE(&p_slot->seq, pos + 1U);
+
+    return SALT_SUCCESS;
+}
+
+static salt_dispatch_buffer_t *salt_dispatch_pop(salt_dispatch_queue_t *p_queue)
+{
+    salt_dispatch_slot_t *p_slot;
+    salt_dispatch_buffer_t *p_buffer;
+    uint32_t pos = SALT_ATOMIC_LOAD_RELAXED(&p_queue->head);
+    int32_t diff;
+
+    for (;;) {
+        p_slot = &p_queue->p_slots[pos & p_queue->mask];
+        diff = (int32_t) (SALT_ATOMIC_LOAD_ACQUIRE(&p_slot->seq) - (pos + 1U));
+        if (0 == diff) {
+            if (SALT_ATOMIC_CAS_RELAXED(&p_queue->head, &pos, pos + 1U)) {
+                break;
+            }
+        } else if (diff < 0) {
+            /* Nothing posted to the slot yet. */
+            return NULL;
+        } else {
+            pos = SALT_ATOMIC_LOAD_RELAXED(&p_queue->head);
+        }
+    }
+
+    p_buffer = p_slot->p_buffer;
+    SALT_ATOMIC_STORE_RELEASE(&p_slot->seq, pos + p_queue->mask + 1U);
+
+    return p_buffer;
+}
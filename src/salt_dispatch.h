@@ -0,0 +1,203 @@
+#ifndef _SALT_DISPATCH_H_
+#define _SALT_DISPATCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file salt_dispatch.h
+ *
+ * Ordered dispatch of received salt records to application worker threads.
+ *
+ * After salt_read_begin, the messages of a record are inside the rx buffer.
+ * Instead of copying the messages out, the dispatcher hands the whole buffer,
+ * together with its read state, to a worker. The worker reads the messages in
+ * place and releases the buffer back to the pool when done.
+ *
+ * The buffers and the queues are in user provided memory. Each worker has one
+ * bounded queue, and the free buffers are kept in one more queue. The queues
+ * are lock free and any thread may post to them. Since a queue can hold all
+ * buffers of the pool, posting never fails for a buffer from the pool.
+ *
+ * All records of a session are posted to the same worker, so they are
+ * processed in the order they were posted, while different sessions are
+ * processed in parallel. The records of one session must be posted from one
+ * thread at a time, which is the case when a session is read by one thread.
+ *
+ * Without GCC compatible atomic builtins, all calls must be made from the same
+ * thread.
+ *
+ * Usage, reader thread:
+ *      p_buffer = salt_dispatch_acquire(&dispatch);
+ *      if (p_buffer == NULL) {
+ *          All buffers are in use, stop reading until one is released.
+ *      }
+ *      ret = salt_read_begin(&channel, p_buffer->p_data, p_buffer->size, &p_buffer->msg);
+ *      if (ret == SALT_SUCCESS) {
+ *          p_buffer->p_context = &session;
+ *          salt_dispatch_post(&dispatch, p_buffer, session_index);
+ *      }
+ *      If ret == SALT_PENDING the buffer holds a partial record, keep it
+ *      for this session until salt_read_begin returns SALT_SUCCESS.
+ *
+ * Usage, worker thread:
+ *      while ((p_buffer = salt_dispatch_take(&dispatch, worker)) != NULL) {
+ *          do {
+ *              Process p_buffer->msg.read.p_payload, p_buffer->msg.read.message_size.
+ *          } while (salt_read_next(&p_buffer->msg) == SALT_SUCCESS);
+ *          salt_dispatch_release(&dispatch, p_buffer);
+ *      }
+ *
+ * The dispatcher does not block, a worker with an empty queue polls or waits
+ * for a signal from the reader thread.
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+#include "salt.h"
+
+/*======= Public macro definitions ==========================================*/
+
+/* Size of a cache line, the ends of a queue are kept on different lines. */
+#define SALT_DISPATCH_CACHE_LINE    (64U)
+
+/**
+ * Number of queue slots needed for a pool of buffer_count buffers and
+ * worker_count workers.
+ */
+#define SALT_DISPATCH_SLOTS(buffer_count, worker_count) \
+    (((worker_count) + 1U) * (buffer_count))
+
+/*======= Type Definitions and declarations ===================================*/
+
+/**
+ * @brief An rx buffer and the read state of the record in it.
+ */
+typedef struct salt_dispatch_buffer_s {
+    uint8_t         *p_data;                            /**< Rx buffer, given to salt_read_begin. */
+    uint32_t        size;                               /**< Size of the rx buffer. */
+    salt_msg_t      msg;                                /**< Read state, the messages point into p_data. */
+    void            *p_context;                         /**< User context, e.g., the session. */
+} salt_dispatch_buffer_t;
+
+/**
+ * @brief One slot of a queue.
+ */
+typedef struct salt_dispatch_slot_s {
+    uint32_t                seq;                        /**< Position the slot is ready for. */
+    salt_dispatch_buffer_t  *p_buffer;                  /**< Queued buffer. */
+} salt_dispatch_slot_t;
+
+/**
+ * @brief Bounded lock free queue of buffers.
+ */
+typedef struct salt_dispatch_queue_s {
+    salt_dispatch_slot_t    *p_slots;                   /**< Slots of the queue. */
+    uint32_t                mask;                       /**< Number of slots - 1. */
+    uint8_t                 pad0[SALT_DISPATCH_CACHE_LINE];
+    uint32_t                tail;                       /**< Next position to post to. */
+    uint8_t                 pad1[SALT_DISPATCH_CACHE_LINE];
+    uint32_t                head;                       /**< Next position to take from. */
+    uint8_t                 pad2[SALT_DISPATCH_CACHE_LINE];
+} salt_dispatch_queue_t;
+
+/**
+ * @brief Dispatcher.
+ */
+typedef struct salt_dispatch_s {
+    salt_dispatch_queue_t   pool;                       /**< Free buffers. */
+    salt_dispatch_queue_t   *p_workers;                 /**< One queue per worker. */
+    uint32_t                worker_count;               /**< Number of workers. */
+} salt_dispatch_t;
+
+/*======= Public function declarations ========================================*/
+
+/**
+ * @brief Initiates a dispatcher.
+ *
+ * The memory of buffer i is p_memory + i * buffer_size.
+ *
+ * @param p_dispatch        Pointer to dispatcher.
+ * @param p_buffers         Pointer to buffer_count buffers.
+ * @param buffer_count      Number of buffers, a power of two and at least 2.
+ * @param p_memory          Pointer to buffer_count * buffer_size bytes.
+ * @param buffer_size       Size of each rx buffer.
+ * @param p_workers         Pointer to worker_count queues.
+ * @param worker_count      Number of workers.
+ * @param p_slots           Pointer to SALT_DISPATCH_SLOTS(buffer_count, worker_count)
+ *                          slots.
+ *
+ * @return SALT_SUCCESS The dispatcher was initiated, all buffers are free.
+ * @return SALT_ERROR   Any input was invalid.
+ */
+salt_ret_t salt_dispatch_init(salt_dispatch_t *p_dispatch,
+                              salt_dispatch_buffer_t *p_buffers,
+                              uint32_t buffer_count,
+                              uint8_t *p_memory,
+                              uint32_t buffer_size,
+                              salt_dispatch_queue_t *p_workers,
+                              uint32_t worker_count,
+                              salt_dispatch_slot_t *p_slots);
+
+/**
+ * @brief Takes a free buffer from the pool.
+ *
+ * @param p_dispatch    Pointer to dispatcher.
+ *
+ * @return Pointer to buffer, owned by the caller.
+ * @return NULL if all buffers are in use.
+ */
+salt_dispatch_buffer_t *salt_dispatch_acquire(salt_dispatch_t *p_dispatch);
+
+/**
+ * @brief Hands a buffer with a read record to the worker of a session.
+ *
+ * The worker is session % worker_count, e.g., use the index of the session.
+ * The caller must not use the buffer after this call.
+ *
+ * @param p_dispatch    Pointer to dispatcher.
+ * @param p_buffer      Buffer from \ref salt_dispatch_acquire.
+ * @param session       Session identifier.
+ *
+ * @return SALT_SUCCESS The buffer was posted.
+ * @return SALT_ERROR   Any input was invalid or the queue was full, i.e.,
+ *                      the buffer is not from this pool or was posted twice.
+ */
+salt_ret_t salt_dispatch_post(salt_dispatch_t *p_dispatch,
+                              salt_dispatch_buffer_t *p_buffer,
+                              uint32_t session);
+
+/**
+ * @brief Takes the next buffer posted to a worker.
+ *
+ * Each worker takes from its own queue only.
+ *
+ * @param p_dispatch    Pointer to dispatcher.
+ * @param worker        Worker index, less than worker_count.
+ *
+ * @return Pointer to buffer, owned by the worker until released.
+ * @return NULL if the queue is empty.
+ */
+salt_dispatch_buffer_t *salt_dispatch_take(salt_dispatch_t *p_dispatch,
+                                           uint32_t worker);
+
+/**
+ * @brief Returns a buffer to the pool.
+ *
+ * @param p_dispatch    Pointer to dispatcher.
+ * @param p_buffer      Buffer from \ref salt_dispatch_take or
+ *                      \ref salt_dispatch_acquire.
+ *
+ * @return SALT_SUCCESS The buffer was released.
+ * @return SALT_ERROR   Any input was invalid or the pool was full.
+ */
+salt_ret_t salt_dispatch_release(salt_dispatch_t *p_dispatch,
+                                 salt_dispatch_buffer_t *p_buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SALT_DISPATCH_H_ */
@@ -0,0 +1,261 @@
+/**
+ * @file salt_egress.c
+ *
+ * Fair scheduling of outgoing records from sessions sharing one link.
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+/* C Library includes */
+#include <string.h> /* memset */
+
+/* Salt library includes */
+#include "salt_egress.h"
+#include "salti_util.h"
+
+/*======= Local Macro Definitions =============================================*/
+/*======= Type Definitions ====================================================*/
+/*======= Local variable declarations =========================================*/
+/*======= Local function prototypes ===========================================*/
+
+static uint32_t salt_egress_cost(const salt_msg_t *p_msg);
+static void salt_egress_rotate(salt_egress_t *p_egress);
+static void salt_egress_unlink(salt_egress_t *p_egress,
+                               salt_egress_session_t *p_session);
+
+/*======= Global function implementations =====================================*/
+
+salt_ret_t salt_egress_init(salt_egress_t *p_egress, uint32_t quantum)
+{
+    if ((NULL == p_egress) || (0U == quantum)) {
+        return SALT_ERROR;
+    }
+
+    memset(p_egress, 0x00U, sizeof(salt_egress_t));
+    p_egress->quantum = quantum;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_egress_session_init(salt_egress_session_t *p_session,
+                                    salt_channel_t *p_channel,
+                                    salt_egress_record_t *p_records,
+                                    uint32_t count,
+                                    uint32_t weight)
+{
+    if ((NULL == p_session) || (NULL == p_channel) || (NULL == p_records) ||
+        (0U == count) || ((count & (count - 1U)) != 0U) || (0U == weight)) {
+        return SALT_ERROR;
+    }
+
+    memset(p_session, 0x00U, sizeof(salt_egress_session_t));
+    p_session->p_channel = p_channel;
+    p_session->p_records = p_records;
+    p_session->mask = count - 1U;
+    p_session->weight = weight;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_egress_queue(salt_egress_t *p_egress,
+                             salt_egress_session_t *p_session,
+                             salt_msg_t *p_msg,
+                             bool last_msg)
+{
+    salt_egress_record_t *p_record;
+
+    if ((NULL == p_egress) || (NULL == p_session) || (NULL == p_msg) ||
+        (p_session->count > p_session->mask)) {
+        return SALT_ERROR;
+    }
+
+    p_record = &p_session->p_records[(p_session->head + p_session->count) & p_session->mask];
+    p_record->p_msg = p_msg;
+    p_record->cost = salt_egress_cost(p_msg);
+    p_record->last_msg = last_msg;
+    p_session->count++;
+    p_egress->queued++;
+
+    /* A session is in the turn order while it has queued records. */
+    if (1U == p_session->count) {
+        p_session->deficit = 0U;
+        p_session->p_next = NULL;
+        if (NULL == p_egress->p_tail) {
+            p_egress->p_head = p_session;
+        } else {
+            p_egress->p_tail->p_next = p_session;
+        }
+        p_egress->p_tail = p_session;
+    }
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_egress_execute(salt_egress_t *p_egress,
+                               salt_egress_session_t **pp_session)
+{
+    salt_egress_session_t *p_blocked = NULL;
+    salt_egress_session_t *p_session;
+    salt_egress_record_t *p_record;
+    salt_ret_t ret;
+
+    if (NULL != pp_session) {
+        *pp_session = NULL;
+    }
+
+    if ((NULL == p_egress) || (NULL == pp_session)) {
+        return SALT_ERROR;
+    }
+
+    for (;;) {
+        /*
+         * Find the first session whose next record fits in its credit. The
+         * head session keeps the turn while its records fit. Each passed
+         * session gets more credit, so this ends.
+         */
+        for (;;) {
+            p_session = p_egress->p_head;
+            if (NULL == p_session) {
+                return SALT_PENDING;
+            }
+
+            if (p_session == p_blocked) {
+                /* Every session with queued records waits for its link. */
+                *pp_session = p_blocked;
+                return SALT_PENDING;
+            }
+
+            if (!p_egress->in_turn) {
+                p_session->deficit += p_session->weight * p_egress->quantum;
+                p_egress->in_turn = true;
+            }
+
+            p_record = &p_session->p_records[p_session->head];
+            if (p_record->cost <= p_session->deficit) {
+                break;
+            }
+
+            salt_egress_rotate(p_egress);
+        }
+
+        *pp_session = p_session;
+
+        ret = salt_write_execute(p_session->p_channel, p_record->p_msg, p_record->last_msg);
+        if (SALT_PENDING != ret) {
+            break;
+        }
+
+        /*
+         * The link of the session is full. The partly written record keeps its
+         * state in its salt_msg_t and is continued in a later turn, meanwhile
+         * the other sessions are served. The session keeps only the credit of
+         * the pending record, so that waiting does not add up to a burst.
+         */
+        if (NULL == p_blocked) {
+            p_blocked = p_session;
+        }
+        if (p_session->deficit > p_record->cost) {
+            p_session->deficit = p_record->cost;
+        }
+        salt_egress_rotate(p_egress);
+    }
+
+    if (SALT_ERROR == ret) {
+        salt_egress_remove(p_egress, p_session);
+        return SALT_ERROR;
+    }
+
+    p_session->deficit -= p_record->cost;
+    p_session->head = (p_session->head + 1U) & p_session->mask;
+    p_session->count--;
+    p_egress->queued--;
+
+    if (0U == p_session->count) {
+        salt_egress_unlink(p_egress, p_session);
+    }
+
+    return SALT_SUCCESS;
+}
+
+void salt_egress_remove(salt_egress_t *p_egress,
+                        salt_egress_session_t *p_session)
+{
+    if ((NULL == p_egress) || (NULL == p_session) || (0U == p_session->count)) {
+        return;
+    }
+
+    p_egress->queued -= p_session->count;
+    p_session->count = 0U;
+    salt_egress_unlink(p_egress, p_session);
+}
+
+/*======= Local function implementations ======================================*/
+
+/*
+ * Size of a record on the link. A prepared record is not yet wrapped, the
+ * used buffer size is then charged, which differs from the wrapped size by a
+ * constant. The cost is fixed when queued, so that a partly written record
+ * still fits in the credit.
+ */
+static uint32_t salt_egress_cost(const salt_msg_t *p_msg)
+{
+    if (SALT_WRITE_STATE_WRAPPED == p_msg->write.state) {
+        return p_msg->write.buffer_size;
+    }
+
+    if (p_msg->write.state < SALT_WRITE_STATE_ERROR) {
+        return p_msg->write.buffer_size - p_msg->write.buffer_available;
+    }
+
+    /* Fails without writing anything. */
+    return 0U;
+}
+
+/* Ends the turn of the head session, it gets its next turn last. */
+static void salt_egress_rotate(salt_egress_t *p_egress)
+{
+    salt_egress_session_t *p_session = p_egress->p_head;
+
+    p_egress->in_turn = false;
+    if (NULL == p_session->p_next) {
+        return;
+    }
+
+    p_egress->p_head = p_session->p_next;
+    p_session->p_next = NULL;
+    p_egress->p_tail->p_next = p_session;
+    p_egress->p_tail = p_session;
+}
+
+/* Removes a session without queued records from the turn order. */
+static void salt_egress_unlink(salt_egress_t *p_egress,
+                               salt_egress_session_t *p_session)
+{
+    salt_egress_session_t *p_prev = NULL;
+    salt_egress_session_t *p_it = p_egress->p_head;
+
+    p_session->deficit = 0U;
+
+    while ((NULL != p_it) && (p_it != p_session)) {
+        p_prev = p_it;
+        p_it = p_it->p_next;
+    }
+
+    if (NULL == p_it) {
+        return;
+    }
+
+    if (NULL == p_prev) {
+        p_egress->p_head = p_session->p_next;
+        p_egress->in_turn = false;
+    } else {
+        p_prev->p_next = p_session->p_next;
+    }
+
+    if (p_egress->p_tail == p_session) {
+        p_egress->p_tail = p_prev;
+    }
+
+    p_session->p_next = NULL;
+}
@@ -0,0 +1,191 @@
+#ifndef _SALT_EGRESS_H_
+#define _SALT_EGRESS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file salt_egress.h
+ *
+ * Fair scheduling of outgoing records from sessions sharing one link.
+ *
+ * If each session calls salt_write_execute when it has data, the session that
+ * writes first gets the bandwidth, and one bulk transfer can delay the records
+ * of many interactive sessions. Instead, the records are queued per session
+ * and the scheduler decides which record is written next, using deficit round
+ * robin (DRR).
+ *
+ * Sessions with queued records take turns. At the start of its turn, a session
+ * gets weight * quantum bytes of credit (deficit) and sends records for as
+ * long as the next record fits in the credit. Unused credit is kept to the
+ * next turn, but is cleared when the session has nothing queued. Hence, a
+ * session gets a share of the link proportional to its weight when the link is
+ * busy, and a small interactive record waits for at most one turn of each
+ * other session instead of for a whole bulk transfer. Spare capacity is used
+ * by whichever session has records queued.
+ *
+ * The quantum should be at least the largest record size, then each turn sends
+ * at least one record.
+ *
+ * A record of a session is written completely before the next record of the
+ * same session is started, as required by the salt channel. If the write of a
+ * session is pending, e.g., because its peer reads slowly, the partly written
+ * record keeps its state and is continued in a later turn of the session,
+ * while the other sessions are served. Like the rest of the library the
+ * scheduler is not thread safe, it is used by the thread that owns the link.
+ *
+ * Usage:
+ *      salt_egress_init(&egress, 1500);
+ *      salt_egress_session_init(&session, &channel, records, 16, 1);
+ *
+ *      Queue a record, the record memory is kept until sent:
+ *          salt_egress_queue(&egress, &session, &msg, false);
+ *
+ *      When the link is writable:
+ *          while ((ret = salt_egress_execute(&egress, &p_session)) == SALT_SUCCESS) {
+ *              A record of p_session was sent.
+ *          }
+ *          if (ret == SALT_ERROR) {
+ *              The channel of p_session failed and its records were removed.
+ *          }
+ *          Else the writes of all sessions with queued records are pending,
+ *          or nothing is queued when p_session is NULL.
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+#include "salt.h"
+
+/*======= Public macro definitions ==========================================*/
+/*======= Type Definitions and declarations ===================================*/
+
+/**
+ * @brief A queued record.
+ */
+typedef struct salt_egress_record_s {
+    salt_msg_t      *p_msg;                             /**< Prepared or wrapped record. */
+    uint32_t        cost;                               /**< Size of the record when queued. */
+    bool            last_msg;                           /**< Passed to salt_write_execute. */
+} salt_egress_record_t;
+
+/**
+ * @brief Egress state of one session.
+ */
+typedef struct salt_egress_session_s {
+    salt_channel_t                  *p_channel;         /**< Channel the records are written to. */
+    salt_egress_record_t            *p_records;         /**< Ring of queued records. */
+    uint32_t                        mask;               /**< Ring size - 1. */
+    uint32_t                        head;               /**< Index of the next record to send. */
+    uint32_t                        count;              /**< Number of queued records. */
+    uint32_t                        weight;             /**< Share of the link. */
+    uint32_t                        deficit;            /**< Bytes the session may send. */
+    struct salt_egress_session_s    *p_next;            /**< Next session with queued records. */
+} salt_egress_session_t;
+
+/**
+ * @brief Egress scheduler.
+ */
+typedef struct salt_egress_s {
+    uint32_t                quantum;                    /**< Credit per turn and weight, in bytes. */
+    uint32_t                queued;                     /**< Queued records of all sessions. */
+    salt_egress_session_t   *p_head;                    /**< Session in turn. */
+    salt_egress_session_t   *p_tail;                    /**< Last session in turn order. */
+    bool                    in_turn;                    /**< The head session got its credit. */
+} salt_egress_t;
+
+/*======= Public function declarations ========================================*/
+
+/**
+ * @brief Initiates an egress scheduler.
+ *
+ * @param p_egress      Pointer to scheduler.
+ * @param quantum       Credit in bytes given to a session with weight 1 each turn.
+ *
+ * @return SALT_SUCCESS The scheduler was initiated.
+ * @return SALT_ERROR   p_egress was NULL or quantum was 0.
+ */
+salt_ret_t salt_egress_init(salt_egress_t *p_egress, uint32_t quantum);
+
+/**
+ * @brief Initiates the egress state of a session.
+ *
+ * @param p_session     Pointer to session egress state.
+ * @param p_channel     Pointer to salt channel handle.
+ * @param p_records     Pointer to count records, used as a ring.
+ * @param count         Number of records that can be queued, a power of two.
+ * @param weight        Share of the link, e.g., 1 for bulk and 4 for
+ *                      interactive sessions.
+ *
+ * @return SALT_SUCCESS The session was initiated.
+ * @return SALT_ERROR   Any input was invalid.
+ */
+salt_ret_t salt_egress_session_init(salt_egress_session_t *p_session,
+                                    salt_channel_t *p_channel,
+                                    salt_egress_record_t *p_records,
+                                    uint32_t count,
+                                    uint32_t weight);
+
+/**
+ * @brief Queues a record to be sent on the channel of a session.
+ *
+ * The record is prepared using \ref salt_write_begin, \ref salt_write_next or
+ * \ref salt_write_commit, or already wrapped, e.g., by \ref salt_write_broadcast.
+ * The records of a session are sent in the order they are queued, and must be
+ * kept until sent.
+ *
+ * @param p_egress      Pointer to scheduler.
+ * @param p_session     Pointer to session egress state.
+ * @param p_msg         Pointer to record.
+ * @param last_msg      Passed to \ref salt_write_execute.
+ *
+ * @return SALT_SUCCESS The record was queued.
+ * @return SALT_ERROR   Any input was invalid or the queue of the session is full.
+ */
+salt_ret_t salt_egress_queue(salt_egress_t *p_egress,
+                             salt_egress_session_t *p_session,
+                             salt_msg_t *p_msg,
+                             bool last_msg);
+
+/**
+ * @brief Writes the next record according to the schedule.
+ *
+ * Continues a partly written record of the session in turn, otherwise starts
+ * its next record. If the write is pending, the turn passes to the next
+ * session, so one slow session does not hold back the others. Call again while
+ * SALT_SUCCESS is returned to use the capacity of the link.
+ *
+ * @param p_egress      Pointer to scheduler.
+ * @param pp_session    The session of the record is returned here, NULL if no
+ *                      record is queued. If all writes are pending, the first
+ *                      session whose write was pending.
+ *
+ * @return SALT_SUCCESS A record was sent.
+ * @return SALT_PENDING The writes of all sessions with queued records are
+ *                      pending, try again when a link is writable, or no
+ *                      record is queued.
+ * @return SALT_ERROR   The write failed. The session is considered closed
+ *                      and its queued records were removed. Also returned,
+ *                      with *pp_session NULL, if any input was invalid.
+ */
+salt_ret_t salt_egress_execute(salt_egress_t *p_egress,
+                               salt_egress_session_t **pp_session);
+
+/**
+ * @brief Removes all queued records of a session, e.g., when it is closed.
+ *
+ * If a record of the session is partly written, the rest of it is not sent,
+ * so the session must not be used further.
+ *
+ * @param p_egress      Pointer to scheduler.
+ * @param p_session     Pointer to session egress state.
+ */
+void salt_egress_remove(salt_egress_t *p_egress,
+                        salt_egress_session_t *p_session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SALT_EGRESS_H_ */
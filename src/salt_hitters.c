@@ -0,0 +1,292 @@
+/**
+ * @file salt_hitters.c
+ *
+ * Heavy hitter tracking of peers in constant memory.
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+/* C Library includes */
+#include <string.h> /* memcpy, memcmp, memset */
+
+/* Salt library includes */
+#include "salt_hitters.h"
+#include "salti_util.h"
+
+/*======= Local Macro Definitions =============================================*/
+
+#define SALT_HITTERS_KEY_WORDS      (api_crypto_sign_PUBLICKEYBYTES / 8U)
+
+/*======= Type Definitions ====================================================*/
+/*======= Local variable declarations =========================================*/
+/*======= Local function prototypes ===========================================*/
+
+static uint32_t salt_hitters_hash(const salt_hitters_t *p_hitters,
+                                  const uint8_t *p_key);
+static uint32_t salt_hitters_find(const salt_hitters_t *p_hitters,
+                                  const uint8_t *p_key,
+                                  uint32_t hash);
+static void salt_hitters_index_put(salt_hitters_t *p_hitters, uint32_t pos);
+static void salt_hitters_index_remove(salt_hitters_t *p_hitters, uint32_t slot);
+static void salt_hitters_swap(salt_hitters_t *p_hitters, uint32_t a, uint32_t b);
+static void salt_hitters_sift_up(salt_hitters_t *p_hitters, uint32_t pos);
+static void salt_hitters_sift_down(salt_hitters_t *p_hitters, uint32_t pos);
+
+/*======= Global function implementations =====================================*/
+
+salt_ret_t salt_hitters_init(salt_hitters_t *p_hitters,
+                             salt_hitters_entry_t *p_entries,
+                             uint32_t capacity,
+                             uint32_t *p_index,
+                             uint32_t index_size)
+{
+    if ((NULL == p_hitters) || (NULL == p_entries) || (NULL == p_index) ||
+        (0U == capacity) || (index_size / 2U < capacity) ||
+        ((index_size & (index_size - 1U)) != 0U)) {
+        return SALT_ERROR;
+    }
+
+    memset(p_hitters, 0x00U, sizeof(salt_hitters_t));
+    memset(p_index, 0x00U, sizeof(uint32_t) * index_size);
+    p_hitters->p_entries = p_entries;
+    p_hitters->capacity = capacity;
+    p_hitters->p_index = p_index;
+    p_hitters->mask = index_size - 1U;
+
+    /* The seed prevents peers from choosing keys that collide in the index. */
+    if (api_crypto_randombytes((uint8_t *) &p_hitters->seed, sizeof(p_hitters->seed)) != 0) {
+        return SALT_ERROR;
+    }
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_hitters_add(salt_hitters_t *p_hitters,
+                            const uint8_t *p_key,
+                            uint64_t weight)
+{
+    salt_hitters_entry_t *p_entry;
+    uint32_t hash;
+    uint32_t pos;
+
+    if ((NULL == p_hitters) || (NULL == p_key)) {
+        return SALT_ERROR;
+    }
+
+    p_hitters->total += weight;
+    hash = salt_hitters_hash(p_hitters, p_key);
+    pos = salt_hitters_find(p_hitters, p_key, hash);
+
+    if (pos < p_hitters->size) {
+        p_hitters->p_entries[pos].count += weight;
+        salt_hitters_sift_down(p_hitters, pos);
+        return SALT_SUCCESS;
+    }
+
+    if (p_hitters->size < p_hitters->capacity) {
+        pos = p_hitters->size++;
+        p_entry = &p_hitters->p_entries[pos];
+        memcpy(p_entry->key, p_key, sizeof(p_entry->key));
+        p_entry->count = weight;
+        p_entry->error = 0U;
+        p_entry->hash = hash;
+        salt_hitters_index_put(p_hitters, pos);
+        salt_hitters_sift_up(p_hitters, pos);
+        return SALT_SUCCESS;
+    }
+
+    /* The peer takes over the smallest counter. */
+    p_entry = &p_hitters->p_entries[0];
+    salt_hitters_index_remove(p_hitters, p_entry->slot);
+    memcpy(p_entry->key, p_key, sizeof(p_entry->key));
+    p_entry->error = p_entry->count;
+    p_entry->count += weight;
+    p_entry->hash = hash;
+    salt_hitters_index_put(p_hitters, 0U);
+    salt_hitters_sift_down(p_hitters, 0U);
+
+    return SALT_SUCCESS;
+}
+
+void salt_hitters_record_hook(void *p_context,
+                              const uint8_t *p_peer_pub,
+                              uint32_t size,
+                              bool write)
+{
+    (void) write;
+
+    (void) salt_hitters_add((salt_hitters_t *) p_context, p_peer_pub, size);
+}
+
+void salt_hitters_decay(salt_hitters_t *p_hitters, uint32_t shift)
+{
+    if ((NULL == p_hitters) || (shift >= 64U)) {
+        return;
+    }
+
+    /* Halving keeps the order, so the heap is still valid. */
+    for (uint32_t i = 0; i < p_hitters->size; i++) {
+        p_hitters->p_entries[i].count >>= shift;
+        p_hitters->p_entries[i].error >>= shift;
+    }
+    p_hitters->total >>= shift;
+}
+
+uint32_t salt_hitters_report(const salt_hitters_t *p_hitters,
+                             salt_hitters_entry_t *p_top,
+                             uint32_t count)
+{
+    const salt_hitters_entry_t *p_entry;
+    uint32_t used = 0;
+    uint32_t i;
+
+    if ((NULL == p_hitters) || (NULL == p_top)) {
+        return 0U;
+    }
+
+    /* Insertion into the sorted top, the report is small and seldom made. */
+    for (uint32_t pos = 0; pos < p_hitters->size; pos++) {
+        p_entry = &p_hitters->p_entries[pos];
+        if ((used == count) &&
+            ((0U == count) || (p_entry->count <= p_top[count - 1U].count))) {
+            continue;
+        }
+
+        i = (used < count) ? used++ : (count - 1U);
+        while ((i > 0U) && (p_top[i - 1U].count < p_entry->count)) {
+            p_top[i] = p_top[i - 1U];
+            i--;
+        }
+        p_top[i] = *p_entry;
+    }
+
+    return used;
+}
+
+/*======= Local function implementations ======================================*/
+
+/* Seeded hash of the key, finished with half of the MurmurHash3 mixer. */
+static uint32_t salt_hitters_hash(const salt_hitters_t *p_hitters,
+                                  const uint8_t *p_key)
+{
+    uint64_t words[SALT_HITTERS_KEY_WORDS];
+    uint64_t hash;
+
+    memcpy(words, p_key, sizeof(words));
+    hash = salti_key_hash(p_hitters->seed, words, SALT_HITTERS_KEY_WORDS);
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+
+    return (uint32_t) hash;
+}
+
+/* Returns the heap position of the key, or size if it has no counter. */
+static uint32_t salt_hitters_find(const salt_hitters_t *p_hitters,
+                                  const uint8_t *p_key,
+                                  uint32_t hash)
+{
+    const salt_hitters_entry_t *p_entry;
+    uint32_t slot = hash & p_hitters->mask;
+    uint32_t pos;
+
+    /* The index is at most half full, so an empty slot is found. */
+    while (0U != (pos = p_hitters->p_index[slot])) {
+        p_entry = &p_hitters->p_entries[pos - 1U];
+        if ((p_entry->hash == hash) &&
+            (memcmp(p_entry->key, p_key, sizeof(p_entry->key)) == 0)) {
+            return pos - 1U;
+        }
+        slot = (slot + 1U) & p_hitters->mask;
+    }
+
+    return p_hitters->size;
+}
+
+static void salt_hitters_index_put(salt_hitters_t *p_hitters, uint32_t pos)
+{
+    salt_hitters_entry_t *p_entry = &p_hitters->p_entries[pos];
+    uint32_t slot = p_entry->hash & p_hitters->mask;
+
+    while (0U != p_hitters->p_index[slot]) {
+        slot = (slot + 1U) & p_hitters->mask;
+    }
+
+    p_hitters->p_index[slot] = pos + 1U;
+    p_entry->slot = slot;
+}
+
+/*
+ * Empties an index slot. The following slots are moved back if their home slot
+ * is not after the empty slot, so that lookups need no deleted markers.
+ */
+static void salt_hitters_index_remove(salt_hitters_t *p_hitters, uint32_t slot)
+{
+    salt_hitters_entry_t *p_entry;
+    uint32_t next = slot;
+    uint32_t home;
+
+    for (;;) {
+        p_hitters->p_index[slot] = 0U;
+
+        do {
+            next = (next + 1U) & p_hitters->mask;
+            if (0U == p_hitters->p_index[next]) {
+                return;
+            }
+            p_entry = &p_hitters->p_entries[p_hitters->p_index[next] - 1U];
+            home = p_entry->hash & p_hitters->mask;
+        } while (((next - home) & p_hitters->mask) < ((next - slot) & p_hitters->mask));
+
+        p_hitters->p_index[slot] = p_hitters->p_index[next];
+        p_entry->slot = slot;
+        slot = next;
+    }
+}
+
+static void salt_hitters_swap(salt_hitters_t *p_hitters, uint32_t a, uint32_t b)
+{
+    salt_hitters_entry_t tmp = p_hitters->p_entries[a];
+
+    p_hitters->p_entries[a] = p_hitters->p_entries[b];
+    p_hitters->p_entries[b] = tmp;
+    p_hitters->p_index[p_hitters->p_entries[a].slot] = a + 1U;
+    p_hitters->p_index[p_hitters->p_entries[b].slot] = b + 1U;
+}
+
+static void salt_hitters_sift_up(salt_hitters_t *p_hitters, uint32_t pos)
+{
+    uint32_t parent;
+
+    while (pos > 0U) {
+        parent = (pos - 1U) / 2U;
+        if (p_hitters->p_entries[parent].count <= p_hitters->p_entries[pos].count) {
+            break;
+        }
+        salt_hitters_swap(p_hitters, parent, pos);
+        pos = parent;
+    }
+}
+
+static void salt_hitters_sift_down(salt_hitters_t *p_hitters, uint32_t pos)
+{
+    uint32_t child;
+
+    for (;;) {
+        child = 2U * pos + 1U;
+        if (child >= p_hitters->size) {
+            break;
+        }
+        if ((child + 1U < p_hitters->size) &&
+            (p_hitters->p_entries[child + 1U].count < p_hitters->p_entries[child].count)) {
+            child++;
+        }
+        if (p_hitters->p_entries[pos].count <= p_hitters->p_entries[child].count) {
+            break;
+        }
+        salt_hitters_swap(p_hitters, pos, child);
+        pos = child;
+    }
+}
@@ -0,0 +1,154 @@
+#ifndef _SALT_HITTERS_H_
+#define _SALT_HITTERS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file salt_hitters.h
+ *
+ * Heavy hitters, the sessions that use the most of some resource, e.g., bytes,
+ * records or crypto time, tracked in constant memory.
+ *
+ * A host with many sessions may count per session, but then has to scan all
+ * sessions to find the heaviest. The tracker instead keeps a fixed number of
+ * counters, keyed by the public signature key of the peer, using the space
+ * saving algorithm: a peer without a counter takes over the smallest counter,
+ * and inherits its count as a possible error. Any peer with more than
+ * total / capacity of the total weight is guaranteed a counter, and for each
+ * counter count - error <= true weight <= count.
+ *
+ * The counters are kept in a min heap, with a hash index from peer key to
+ * counter. An update of a known peer is a hash lookup, and since heavy peers
+ * sit at the bottom of the heap, it seldom moves the counter. Both are in user
+ * provided memory, a capacity of 1024 uses about 64 KiB.
+ *
+ * A tracker is not thread safe. Use one per thread, or serialize the updates.
+ *
+ * The tracker is fed from the record path of each channel with
+ * \ref salt_set_record_hook and \ref salt_hitters_record_hook, or by calling
+ * \ref salt_hitters_add with another weight, e.g., the crypto time.
+ *
+ * Usage:
+ *      salt_hitters_init(&bytes, entries, 1024, index, 2048);
+ *      After the handshake of each session:
+ *          salt_set_record_hook(&channel, salt_hitters_record_hook, &bytes);
+ *      Periodically:
+ *          n = salt_hitters_report(&bytes, top, 10);
+ *          salt_hitters_decay(&bytes, 1);
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+#include "salt.h"
+
+/*======= Public macro definitions ==========================================*/
+/*======= Type Definitions and declarations ===================================*/
+
+/**
+ * @brief One counter, also used in reports.
+ */
+typedef struct salt_hitters_entry_s {
+    uint8_t         key[api_crypto_sign_PUBLICKEYBYTES];    /**< Public signature key of the peer. */
+    uint64_t        count;                              /**< Weight, at most error too large. */
+    uint64_t        error;                              /**< Weight inherited from an evicted peer. */
+    uint32_t        hash;                               /**< Internal, hash of the key. */
+    uint32_t        slot;                               /**< Internal, position in the index. */
+} salt_hitters_entry_t;
+
+/**
+ * @brief Heavy hitter tracker.
+ */
+typedef struct salt_hitters_s {
+    salt_hitters_entry_t    *p_entries;                 /**< User provided counters, a min heap. */
+    uint32_t                capacity;                   /**< Number of counters. */
+    uint32_t                size;                       /**< Counters in use. */
+    uint32_t                *p_index;                   /**< User provided index, heap position + 1, 0 if empty. */
+    uint32_t                mask;                       /**< Index size - 1. */
+    uint64_t                seed;                       /**< Random hash seed. */
+    uint64_t                total;                      /**< Total weight added. */
+} salt_hitters_t;
+
+/*======= Public function declarations ========================================*/
+
+/**
+ * @brief Initiates an empty tracker.
+ *
+ * @param p_hitters     Pointer to tracker.
+ * @param p_entries     Pointer to capacity counters.
+ * @param capacity      Number of counters, at least 1.
+ * @param p_index       Pointer to index_size index slots.
+ * @param index_size    Number of index slots, a power of two and at least
+ *                      2 * capacity.
+ *
+ * @return SALT_SUCCESS The tracker was initiated.
+ * @return SALT_ERROR   Any input was invalid or no random seed could be
+ *                      generated.
+ */
+salt_ret_t salt_hitters_init(salt_hitters_t *p_hitters,
+                             salt_hitters_entry_t *p_entries,
+                             uint32_t capacity,
+                             uint32_t *p_index,
+                             uint32_t index_size);
+
+/**
+ * @brief Adds weight to a peer.
+ *
+ * @param p_hitters     Pointer to tracker.
+ * @param p_key         Public signature key of the peer, 32 bytes.
+ * @param weight        Weight to add, e.g., the size of a record.
+ *
+ * @return SALT_SUCCESS The weight was added.
+ * @return SALT_ERROR   Any input was invalid.
+ */
+salt_ret_t salt_hitters_add(salt_hitters_t *p_hitters,
+                            const uint8_t *p_key,
+                            uint64_t weight);
+
+/**
+ * @brief Record hook that adds the size of each record, see
+ *        \ref salt_record_hook_t.
+ *
+ * @param p_context     Pointer to tracker.
+ * @param p_peer_pub    Public signature key of the peer, 32 bytes.
+ * @param size          Size of the record on the wire.
+ * @param write         Not used, read and written records are both counted.
+ */
+void salt_hitters_record_hook(void *p_context,
+                              const uint8_t *p_peer_pub,
+                              uint32_t size,
+                              bool write);
+
+/**
+ * @brief Divides all counts by 2^shift.
+ *
+ * Called periodically, the report then follows the recent weight rather than
+ * the weight since the tracker was initiated.
+ *
+ * @param p_hitters     Pointer to tracker.
+ * @param shift         Number of halvings, less than 64.
+ */
+void salt_hitters_decay(salt_hitters_t *p_hitters, uint32_t shift);
+
+/**
+ * @brief Copies the heaviest peers, heaviest first.
+ *
+ * The tracker is not changed.
+ *
+ * @param p_hitters     Pointer to tracker.
+ * @param p_top         Pointer to count entries.
+ * @param count         Maximum number of peers to report.
+ *
+ * @return Number of peers copied to p_top.
+ */
+uint32_t salt_hitters_report(const salt_hitters_t *p_hitters,
+                             salt_hitters_entry_t *p_top,
+                             uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SALT_HITTERS_H_ */
@@ -0,0 +1,251 @@
+/**
+ * @file salt_keyset.c
+ *
+ * Compact set of public signature keys, used as an allowlist or a denylist of
+ * peers during the handshake.
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+/* C Library includes */
+#include <string.h> /* memcpy, memset */
+
+/* Salt library includes */
+#include "salt_keyset.h"
+#include "salti_util.h"
+
+/*======= Local Macro Definitions =============================================*/
+
+#define SALT_KEYSET_KEY_WORDS       (api_crypto_sign_PUBLICKEYBYTES / 8U)
+
+/*======= Type Definitions ====================================================*/
+/*======= Local variable declarations =========================================*/
+/*======= Local function prototypes ===========================================*/
+
+static uint64_t salt_keyset_fingerprint(const salt_keyset_t *p_set,
+                                        const uint8_t *p_key);
+static uint32_t salt_keyset_alt(const salt_keyset_t *p_set,
+                                uint32_t bucket,
+                                uint64_t fp);
+static bool salt_keyset_find(const salt_keyset_t *p_set, uint64_t fp);
+static bool salt_keyset_put(salt_keyset_t *p_set, uint32_t bucket, uint64_t fp);
+static bool salt_keyset_insert(salt_keyset_t *p_set, uint64_t fp);
+
+/*======= Global function implementations =====================================*/
+
+salt_ret_t salt_keyset_init(salt_keyset_t *p_set,
+                            salt_keyset_bucket_t *p_buckets,
+                            uint32_t count)
+{
+    if ((NULL == p_set) || (NULL == p_buckets) ||
+        (count < 2U) || ((count & (count - 1U)) != 0U)) {
+        return SALT_ERROR;
+    }
+
+    memset(p_set, 0x00U, sizeof(salt_keyset_t));
+    memset(p_buckets, 0x00U, sizeof(salt_keyset_bucket_t) * count);
+    p_set->p_buckets = p_buckets;
+    p_set->mask = count - 1U;
+
+    /* The seed prevents a peer from choosing a key with a known fingerprint. */
+    if (api_crypto_randombytes((uint8_t *) &p_set->seed, sizeof(p_set->seed)) != 0) {
+        return SALT_ERROR;
+    }
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_keyset_add(salt_keyset_t *p_set, const uint8_t *p_key)
+{
+    uint64_t fp;
+
+    if ((NULL == p_set) || (NULL == p_key)) {
+        return SALT_ERROR;
+    }
+
+    fp = salt_keyset_fingerprint(p_set, p_key);
+    if (salt_keyset_find(p_set, fp)) {
+        return SALT_SUCCESS;
+    }
+
+    if (0U != p_set->victim) {
+        return SALT_ERROR;
+    }
+
+    /* The key is added even if another key is left as victim. */
+    (void) salt_keyset_insert(p_set, fp);
+    p_set->count++;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_keyset_remove(salt_keyset_t *p_set, const uint8_t *p_key)
+{
+    salt_keyset_bucket_t *p_bucket;
+    uint64_t victim;
+    uint64_t fp;
+    uint32_t bucket;
+
+    if ((NULL == p_set) || (NULL == p_key)) {
+        return SALT_ERROR;
+    }
+
+    fp = salt_keyset_fingerprint(p_set, p_key);
+
+    if (fp == p_set->victim) {
+        p_set->victim = 0U;
+        p_set->count--;
+        return SALT_SUCCESS;
+    }
+
+    bucket = (uint32_t) fp & p_set->mask;
+    for (uint32_t i = 0; i < 2U; i++) {
+        p_bucket = &p_set->p_buckets[bucket];
+        for (uint32_t slot = 0; slot < SALT_KEYSET_BUCKET_SLOTS; slot++) {
+            if (fp == p_bucket->fp[slot]) {
+                p_bucket->fp[slot] = 0U;
+                p_set->count--;
+
+                /* The victim may fit now. */
+                victim = p_set->victim;
+                if (0U != victim) {
+                    p_set->victim = 0U;
+                    (void) salt_keyset_insert(p_set, victim);
+                }
+
+                return SALT_SUCCESS;
+            }
+        }
+        bucket = salt_keyset_alt(p_set, bucket, fp);
+    }
+
+    return SALT_ERROR;
+}
+
+salt_ret_t salt_keyset_contains(const salt_keyset_t *p_set, const uint8_t *p_key)
+{
+    if ((NULL == p_set) || (NULL == p_key)) {
+        return SALT_ERROR;
+    }
+
+    return salt_keyset_find(p_set, salt_keyset_fingerprint(p_set, p_key)) ?
+           SALT_SUCCESS : SALT_ERROR;
+}
+
+salt_ret_t salt_keyset_allow(void *p_context, const uint8_t *p_peer_pub)
+{
+    return salt_keyset_contains((const salt_keyset_t *) p_context, p_peer_pub);
+}
+
+salt_ret_t salt_keyset_deny(void *p_context, const uint8_t *p_peer_pub)
+{
+    const salt_keyset_t *p_set = (const salt_keyset_t *) p_context;
+
+    /* Invalid input rejects the peer. */
+    if ((NULL == p_set) || (NULL == p_peer_pub)) {
+        return SALT_ERROR;
+    }
+
+    return salt_keyset_find(p_set, salt_keyset_fingerprint(p_set, p_peer_pub)) ?
+           SALT_ERROR : SALT_SUCCESS;
+}
+
+/*======= Local function implementations ======================================*/
+
+/*
+ * Seeded hash of the key, finished with the MurmurHash3 mixer so that all bits
+ * depend on the whole key. The low and high halves select the two buckets.
+ */
+static uint64_t salt_keyset_fingerprint(const salt_keyset_t *p_set,
+                                        const uint8_t *p_key)
+{
+    uint64_t words[SALT_KEYSET_KEY_WORDS];
+    uint64_t hash;
+
+    memcpy(words, p_key, sizeof(words));
+    hash = salti_key_hash(p_set->seed, words, SALT_KEYSET_KEY_WORDS);
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+
+    /* 0 marks an empty slot. */
+    return (0U == hash) ? 1U : hash;
+}
+
+static uint32_t salt_keyset_alt(const salt_keyset_t *p_set,
+                                uint32_t bucket,
+                                uint64_t fp)
+{
+    uint32_t first = (uint32_t) fp & p_set->mask;
+
+    return (bucket == first) ? ((uint32_t) (fp >> 32) & p_set->mask) : first;
+}
+
+static bool salt_keyset_find(const salt_keyset_t *p_set, uint64_t fp)
+{
+    const salt_keyset_bucket_t *p_first = &p_set->p_buckets[(uint32_t) fp & p_set->mask];
+    const salt_keyset_bucket_t *p_second = &p_set->p_buckets[(uint32_t) (fp >> 32) & p_set->mask];
+    bool found = (fp == p_set->victim);
+
+    /* No early exit, so that both buckets are fetched in parallel. */
+    for (uint32_t slot = 0; slot < SALT_KEYSET_BUCKET_SLOTS; slot++) {
+        found = found | (fp == p_first->fp[slot]) | (fp == p_second->fp[slot]);
+    }
+
+    return found;
+}
+
+static bool salt_keyset_put(salt_keyset_t *p_set, uint32_t bucket, uint64_t fp)
+{
+    salt_keyset_bucket_t *p_bucket = &p_set->p_buckets[bucket];
+
+    for (uint32_t slot = 0; slot < SALT_KEYSET_BUCKET_SLOTS; slot++) {
+        if (0U == p_bucket->fp[slot]) {
+            p_bucket->fp[slot] = fp;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Places a fingerprint in one of its buckets. If both are full, a fingerprint
+ * in the bucket is moved to its other bucket, and so on. If no place is found,
+ * the last moved fingerprint is kept as victim and false is returned.
+ */
+static bool salt_keyset_insert(salt_keyset_t *p_set, uint64_t fp)
+{
+    uint32_t bucket = (uint32_t) fp & p_set->mask;
+    uint64_t moved;
+
+    if (salt_keyset_put(p_set, bucket, fp)) {
+        return true;
+    }
+
+    bucket = salt_keyset_alt(p_set, bucket, fp);
+    if (salt_keyset_put(p_set, bucket, fp)) {
+        return true;
+    }
+
+    for (uint32_t kick = 0; kick < SALT_KEYSET_MAX_KICKS; kick++) {
+        uint32_t slot = kick % SALT_KEYSET_BUCKET_SLOTS;
+
+        moved = p_set->p_buckets[bucket].fp[slot];
+        p_set->p_buckets[bucket].fp[slot] = fp;
+        fp = moved;
+
+        bucket = salt_keyset_alt(p_set, bucket, fp);
+        if (salt_keyset_put(p_set, bucket, fp)) {
+            return true;
+        }
+    }
+
+    p_set->victim = fp;
+
+    return false;
+}
@@ -0,0 +1,146 @@
+#ifndef _SALT_KEYSET_H_
+#define _SALT_KEYSET_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file salt_keyset.h
+ *
+ * Compact set of public signature keys, used as an allowlist or a denylist of
+ * peers during the handshake, see \ref salt_set_peer_check.
+ *
+ * The set is a cuckoo hash table in user provided memory. A key is stored as
+ * a 64 bit fingerprint, computed with a random seed, in one of two buckets of
+ * four slots. A bucket is 32 bytes, so a lookup reads at most two cache lines
+ * and never follows a chain. A set of one million keys fits in 8 MiB, compared
+ * to 32 MiB for the keys themselves.
+ *
+ * Since only fingerprints are stored, a key that is not in the set is found
+ * with a probability of about 8 / 2^64 per lookup. The seed is secret, so a
+ * peer can not search for a key that matches a fingerprint in the set.
+ *
+ * Up to about 95 % of the slots can be used. If a key can not be placed after
+ * SALT_KEYSET_MAX_KICKS moves, it is kept aside and the set is full, adding
+ * more keys fails until a key is removed.
+ *
+ * The set is not changed by lookups, so an unchanged set may be used by many
+ * threads. To update a set that is in use, build a new set and replace it.
+ *
+ * Usage:
+ *      salt_keyset_init(&allowed, buckets, sizeof(buckets) / sizeof(buckets[0]));
+ *      for each key:
+ *          salt_keyset_add(&allowed, key);
+ *      salt_set_peer_check(&channel, salt_keyset_allow, &allowed);
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+#include "salt.h"
+
+/*======= Public macro definitions ==========================================*/
+
+#define SALT_KEYSET_BUCKET_SLOTS    (4U)        /**< Fingerprints per bucket. */
+#define SALT_KEYSET_MAX_KICKS       (500U)      /**< Moves before the set is full. */
+
+/*======= Type Definitions and declarations ===================================*/
+
+/**
+ * @brief One bucket, a fingerprint of 0 is an empty slot.
+ */
+typedef struct salt_keyset_bucket_s {
+    uint64_t        fp[SALT_KEYSET_BUCKET_SLOTS];       /**< Fingerprints. */
+} salt_keyset_bucket_t;
+
+/**
+ * @brief Key set.
+ */
+typedef struct salt_keyset_s {
+    salt_keyset_bucket_t    *p_buckets;                 /**< User provided buckets. */
+    uint32_t                mask;                       /**< Number of buckets - 1. */
+    uint32_t                count;                      /**< Keys in the set, including the victim. */
+    uint64_t                seed;                       /**< Random hash seed. */
+    uint64_t                victim;                     /**< Fingerprint that did not fit, 0 if none. */
+} salt_keyset_t;
+
+/*======= Public function declarations ========================================*/
+
+/**
+ * @brief Initiates an empty key set.
+ *
+ * @param p_set         Pointer to key set.
+ * @param p_buckets     Pointer to count buckets.
+ * @param count         Number of buckets, a power of two and at least 2.
+ *
+ * @return SALT_SUCCESS The set was initiated.
+ * @return SALT_ERROR   Any input was invalid or no random seed could be
+ *                      generated.
+ */
+salt_ret_t salt_keyset_init(salt_keyset_t *p_set,
+                            salt_keyset_bucket_t *p_buckets,
+                            uint32_t count);
+
+/**
+ * @brief Adds a key.
+ *
+ * Adding a key that is already in the set succeeds without changing it.
+ *
+ * @param p_set         Pointer to key set.
+ * @param p_key         Public signature key, 32 bytes.
+ *
+ * @return SALT_SUCCESS The key is in the set.
+ * @return SALT_ERROR   Any input was invalid or the set is full.
+ */
+salt_ret_t salt_keyset_add(salt_keyset_t *p_set, const uint8_t *p_key);
+
+/**
+ * @brief Removes a key.
+ *
+ * @param p_set         Pointer to key set.
+ * @param p_key         Public signature key, 32 bytes.
+ *
+ * @return SALT_SUCCESS The key was removed.
+ * @return SALT_ERROR   Any input was invalid or the key was not in the set.
+ */
+salt_ret_t salt_keyset_remove(salt_keyset_t *p_set, const uint8_t *p_key);
+
+/**
+ * @brief Checks if a key is in the set.
+ *
+ * @param p_set         Pointer to key set.
+ * @param p_key         Public signature key, 32 bytes.
+ *
+ * @return SALT_SUCCESS The key is in the set.
+ * @return SALT_ERROR   Any input was invalid or the key is not in the set.
+ */
+salt_ret_t salt_keyset_contains(const salt_keyset_t *p_set, const uint8_t *p_key);
+
+/**
+ * @brief Peer check that accepts the keys in a set, see \ref salt_peer_check_t.
+ *
+ * @param p_context     Pointer to key set.
+ * @param p_peer_pub    Public signature key of the peer, 32 bytes.
+ *
+ * @return SALT_SUCCESS The key is in the set.
+ * @return SALT_ERROR   The key is not in the set.
+ */
+salt_ret_t salt_keyset_allow(void *p_context, const uint8_t *p_peer_pub);
+
+/**
+ * @brief Peer check that rejects the keys in a set, see \ref salt_peer_check_t.
+ *
+ * @param p_context     Pointer to key set.
+ * @param p_peer_pub    Public signature key of the peer, 32 bytes.
+ *
+ * @return SALT_SUCCESS The key is not in the set.
+ * @return SALT_ERROR   The key is in the set.
+ */
+salt_ret_t salt_keyset_deny(void *p_context, const uint8_t *p_peer_pub);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SALT_KEYSET_H_ */
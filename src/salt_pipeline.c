@@ -0,0 +1,416 @@
+/**
+ * @file salt_pipeline.c
+ *
+ * Staged host, with the socket I/O and the record crypto on different threads.
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+/* C Library includes */
+#include <string.h> /* memset */
+
+/* Salt library includes */
+#include "salt_pipeline.h"
+#include "salti_atomic.h"
+#include "salti_util.h"
+
+/*======= Local Macro Definitions =============================================*/
+/*======= Type Definitions ====================================================*/
+/*======= Local variable declarations =========================================*/
+/*======= Local function prototypes ===========================================*/
+
+static void salt_pipeline_ring_init(salt_pipeline_ring_t *p_ring,
+                                    salt_pipeline_record_t **pp_slots,
+                                    uint32_t count);
+static salt_ret_t salt_pipeline_push(salt_pipeline_ring_t *p_ring,
+                                     salt_pipeline_record_t *p_record);
+static salt_pipeline_record_t *salt_pipeline_pop(salt_pipeline_ring_t *p_ring);
+static void salt_pipeline_handle(salt_pipeline_t *p_pipeline,
+                                 salt_pipeline_record_t *p_record);
+static uint32_t salt_pipeline_assign(salt_pipeline_t *p_pipeline,
+                                     uint32_t start);
+
+/*======= Global function implementations =====================================*/
+
+salt_ret_t salt_pipeline_init(salt_pipeline_t *p_pipeline,
+                              salt_pipeline_record_t *p_records,
+                              uint32_t record_count,
+                              uint8_t *p_memory,
+                              uint32_t record_size,
+                              uint32_t io_count,
+                              uint32_t crypto_count,
+                              salt_pipeline_ring_t *p_rings,
+                              salt_pipeline_record_t **pp_slots,
+                              salt_pipeline_handler_t handler,
+                              void *p_context)
+{
+    uint32_t rings = SALT_PIPELINE_RINGS(io_count, crypto_count);
+
+    if ((NULL == p_pipeline) || (NULL == p_records) || (NULL == p_memory) ||
+        (NULL == p_rings) || (NULL == pp_slots) || (NULL == handler) ||
+        (record_count < 2U) || ((record_count & (record_count - 1U)) != 0U) ||
+        (record_size < SALT_WRITE_OVERHEAD_SIZE) ||
+        (0U == io_count) || (0U == crypto_count)) {
+        return SALT_ERROR;
+    }
+
+    memset(p_pipeline, 0x00U, sizeof(salt_pipeline_t));
+    p_pipeline->p_free = p_rings;
+    p_pipeline->p_failed = &p_rings[io_count];
+    p_pipeline->p_rx = &p_rings[2U * io_count];
+    p_pipeline->p_tx = &p_rings[2U * io_count + io_count * crypto_count];
+    p_pipeline->io_count = io_count;
+    p_pipeline->crypto_count = crypto_count;
+    p_pipeline->handler = handler;
+    p_pipeline->p_handler_context = p_context;
+
+    /* Every ring can hold all records of an I/O thread. */
+    for (uint32_t i = 0; i < rings; i++) {
+        salt_pipeline_ring_init(&p_rings[i], &pp_slots[i * record_count], record_count);
+    }
+
+    for (uint32_t i = 0; i < io_count * record_count; i++) {
+        memset(&p_records[i], 0x00U, sizeof(salt_pipeline_record_t));
+        p_records[i].p_data = &p_memory[(size_t) i * record_size];
+        p_records[i].size = record_size;
+        p_records[i].io = i / record_count;
+        salt_pipeline_push(&p_pipeline->p_free[p_records[i].io], &p_records[i]);
+    }
+
+    return SALT_SUCCESS;
+}
+
+void salt_pipeline_session_init(salt_pipeline_session_t *p_session,
+                                uint32_t index)
+{
+    if (NULL == p_session) {
+        return;
+    }
+
+    p_session->index = index;
+    p_session->worker = SALT_PIPELINE_NO_WORKER;
+    p_session->posted = 0;
+    p_session->taken = 0;
+}
+
+salt_pipeline_record_t *salt_pipeline_acquire(salt_pipeline_t *p_pipeline,
+                                              uint32_t io)
+{
+    if ((NULL == p_pipeline) || (io >= p_pipeline->io_count)) {
+        return NULL;
+    }
+
+    return salt_pipeline_pop(&p_pipeline->p_free[io]);
+}
+
+salt_ret_t salt_pipeline_read(salt_io_channel_t *p_io,
+                              salt_io_impl read_impl,
+                              salt_pipeline_record_t *p_record)
+{
+    salt_ret_t ret = SALT_ERROR;
+
+    if ((NULL == p_io) || (NULL == read_impl) || (NULL == p_record)) {
+        return SALT_ERROR;
+    }
+
+    /* Same as salti_io_read, without the channel. */
+    switch (p_io->state) {
+        case SALT_IO_READY:
+            p_io->p_data = &p_record->p_data[SALT_READ_RECORD_OFFSET];
+            p_io->max_size = p_record->size - SALT_READ_RECORD_OFFSET;
+            p_io->size_expected = SALT_LENGTH_SIZE;
+            p_io->size = 0;
+            p_io->state = SALT_IO_SIZE;
+            /* Intentional fall-through */
+        case SALT_IO_SIZE:
+            ret = read_impl(p_io);
+            if (SALT_SUCCESS != ret) {
+                break;
+            }
+
+            p_io->size_expected = salti_bytes_to_u32(p_io->p_data);
+            if (p_io->size_expected > p_io->max_size) {
+                p_io->err_code = SALT_ERR_BUFF_TO_SMALL;
+                p_io->state = SALT_IO_READY;
+                ret = SALT_ERROR;
+                break;
+            }
+
+            p_io->state = SALT_IO_PENDING;
+            p_io->size = 0;
+            /* Intentional fall-through */
+        case SALT_IO_PENDING:
+            ret = read_impl(p_io);
+            if (SALT_SUCCESS == ret) {
+                p_record->length = p_io->size;
+                p_io->state = SALT_IO_READY;
+            }
+            break;
+        default:
+            p_io->err_code = SALT_ERR_INVALID_STATE;
+            break;
+    }
+
+    return ret;
+}
+
+salt_ret_t salt_pipeline_post(salt_pipeline_t *p_pipeline,
+                              salt_pipeline_record_t *p_record,
+                              salt_channel_t *p_channel,
+                              salt_pipeline_session_t *p_session)
+{
+    uint32_t worker;
+
+    if ((NULL == p_pipeline) || (NULL == p_record) || (NULL == p_channel) ||
+        (NULL == p_session) || (p_record->io >= p_pipeline->io_count)) {
+        return SALT_ERROR;
+    }
+
+    /*
+     * With no record of the session in the pipeline, the last worker is done
+     * with the channel. The acquire load pairs with the release store in
+     * salt_pipeline_take, which came after the worker handed the record back.
+     */
+    worker = p_session->worker;
+    if (p_session->posted == SALT_ATOMIC_LOAD_ACQUIRE(&p_session->taken)) {
+        if (worker >= p_pipeline->crypto_count) {
+            worker = p_session->index % p_pipeline->crypto_count;
+        }
+        worker = salt_pipeline_assign(p_pipeline, worker);
+    }
+
+    if (worker >= p_pipeline->crypto_count) {
+        return SALT_ERROR;
+    }
+
+    p_record->p_channel = p_channel;
+    p_record->p_session = p_session;
+    p_record->session = p_session->index;
+    p_record->status = SALT_PENDING;
+
+    if (SALT_SUCCESS != salt_pipeline_push(&p_pipeline->p_rx[p_record->io * p_pipeline->crypto_count + worker],
+                                           p_record)) {
+        return SALT_ERROR;
+    }
+
+    p_session->worker = worker;
+    p_session->posted++;
+
+    return SALT_SUCCESS;
+}
+
+salt_ret_t salt_pipeline_fail(salt_pipeline_t *p_pipeline,
+                              salt_pipeline_record_t *p_record,
+                              uint32_t session)
+{
+    if ((NULL == p_pipeline) || (NULL == p_record) ||
+        (p_record->io >= p_pipeline->io_count)) {
+        return SALT_ERROR;
+    }
+
+    p_record->p_channel = NULL;
+    p_record->p_session = NULL;
+    p_record->session = session;
+    p_record->status = SALT_ERROR;
+
+    return salt_pipeline_push(&p_pipeline->p_failed[p_record->io], p_record);
+}
+
+salt_ret_t salt_pipeline_execute(salt_pipeline_t *p_pipeline, uint32_t worker)
+{
+    salt_pipeline_record_t *p_record;
+    salt_ret_t ret = SALT_PENDING;
+
+    if ((NULL == p_pipeline) || (worker >= p_pipeline->crypto_count)) {
+        return SALT_ERROR;
+    }
+
+    for (uint32_t io = 0; io < p_pipeline->io_count; io++) {
+        p_record = salt_pipeline_pop(&p_pipeline->p_rx[io * p_pipeline->crypto_count + worker]);
+        if (NULL == p_record) {
+            continue;
+        }
+
+        salt_pipeline_handle(p_pipeline, p_record);
+
+        /* Can not fail, the ring can hold all records of the I/O thread. */
+        (void) salt_pipeline_push(&p_pipeline->p_tx[worker * p_pipeline->io_count + io],
+                                  p_record);
+        ret = SALT_SUCCESS;
+    }
+
+    return ret;
+}
+
+salt_pipeline_record_t *salt_pipeline_take(salt_pipeline_t *p_pipeline,
+                                           uint32_t io)
+{
+    salt_pipeline_record_t *p_record;
+    salt_pipeline_session_t *p_session;
+
+    if ((NULL == p_pipeline) || (io >= p_pipeline->io_count)) {
+        return NULL;
+    }
+
+    /*
+     * The records in the pipeline of a session are all on the same worker, so
+     * they come back in order.
+     */
+    for (uint32_t worker = 0; worker < p_pipeline->crypto_count; worker++) {
+        p_record = salt_pipeline_pop(&p_pipeline->p_tx[worker * p_pipeline->io_count + io]);
+        if (NULL != p_record) {
+            p_session = p_record->p_session;
+            SALT_ATOMIC_STORE_RELEASE(&p_session->taken,
+                                      SALT_ATOMIC_LOAD_RELAXED(&p_session->taken) + 1U);
+            return p_record;
+        }
+    }
+
+    return salt_pipeline_pop(&p_pipeline->p_failed[io]);
+}
+
+salt_ret_t salt_pipeline_write(salt_io_channel_t *p_io,
+                               salt_io_impl write_impl,
+                               salt_pipeline_record_t *p_record)
+{
+    salt_ret_t ret = SALT_ERROR;
+
+    if ((NULL == p_io) || (NULL == write_impl) || (NULL == p_record) ||
+        (SALT_SUCCESS != p_record->status)) {
+        return SALT_ERROR;
+    }
+
+    /* Same as salti_io_write, without the channel. */
+    switch (p_io->state) {
+        case SALT_IO_READY:
+            p_io->p_data = p_record->msg.write.p_buffer;
+            p_io->size = 0;
+            p_io->size_expected = p_record->msg.write.buffer_size;
+            p_io->state = SALT_IO_PENDING;
+            /* Intentional fall-through */
+        case SALT_IO_PENDING:
+            ret = write_impl(p_io);
+            if (SALT_SUCCESS == ret) {
+                p_io->state = SALT_IO_READY;
+            }
+            break;
+        default:
+            p_io->err_code = SALT_ERR_INVALID_STATE;
+            break;
+    }
+
+    return ret;
+}
+
+salt_ret_t salt_pipeline_release(salt_pipeline_t *p_pipeline,
+                                 salt_pipeline_record_t *p_record)
+{
+    if ((NULL == p_pipeline) || (NULL == p_record) ||
+        (p_record->io >= p_pipeline->io_count)) {
+        return SALT_ERROR;
+    }
+
+    return salt_pipeline_push(&p_pipeline->p_free[p_record->io], p_record);
+}
+
+/*======= Local function implementations ======================================*/
+
+static void salt_pipeline_ring_init(salt_pipeline_ring_t *p_ring,
+                                    salt_pipeline_record_t **pp_slots,
+                                    uint32_t count)
+{
+    memset(p_ring, 0x00U, sizeof(salt_pipeline_ring_t));
+    p_ring->pp_slots = pp_slots;
+    p_ring->mask = count - 1U;
+}
+
+/*
+ * Each position is only written by one side, the producer owns the tail and
+ * the consumer the head. The release store of a position publishes the slot
+ * to, or returns it from, the other side.
+ */
+static salt_ret_t salt_pipeline_push(salt_pipeline_ring_t *p_ring,
+                                     salt_pipeline_record_t *p_record)
+{
+    uint32_t tail = SALT_ATOMIC_LOAD_RELAXED(&p_ring->tail);
+
+    if ((tail - SALT_ATOMIC_LOAD_ACQUIRE(&p_ring->head)) > p_ring->mask) {
+        return SALT_ERROR;
+    }
+
+    p_ring->pp_slots[tail & p_ring->mask] = p_record;
+    SALT_ATOMIC_STORE_RELEASE(&p_ring->tail, tail + 1U);
+
+    return SALT_SUCCESS;
+}
+
+static salt_pipeline_record_t *salt_pipeline_pop(salt_pipeline_ring_t *p_ring)
+{
+    uint32_t head = SALT_ATOMIC_LOAD_RELAXED(&p_ring->head);
+    salt_pipeline_record_t *p_record;
+
+    if (head == SALT_ATOMIC_LOAD_ACQUIRE(&p_ring->tail)) {
+        return NULL;
+    }
+
+    p_record = p_ring->pp_slots[head & p_ring->mask];
+    SALT_ATOMIC_STORE_RELEASE(&p_ring->head, head + 1U);
+
+    return p_record;
+}
+
+/* Decrypts the record, calls the handler and encrypts the reply. */
+static void salt_pipeline_handle(salt_pipeline_t *p_pipeline,
+                                 salt_pipeline_record_t *p_record)
+{
+    salt_ret_t ret;
+
+    ret = salt_read_unwrap(p_record->p_channel,
+                           p_record->p_data,
+                           p_record->length,
+                           &p_record->msg);
+
+    if (SALT_SUCCESS == ret) {
+        ret = p_pipeline->handler(p_pipeline->p_handler_context, p_record);
+    }
+
+    if (SALT_SUCCESS == ret) {
+        ret = salt_write_wrap(p_record->p_channel, &p_record->msg, false);
+    }
+
+    p_record->status = ret;
+}
+
+/*
+ * Chooses the worker with the fewest queued records over all I/O threads. The
+ * rings of other threads are only read, a stale count just gives a worse
+ * choice. Ties go to the first worker from start, the current worker of the
+ * session or else index % crypto_count, so a session only moves to a worker
+ * with less load and idle workers get new sessions in turn.
+ */
+static uint32_t salt_pipeline_assign(salt_pipeline_t *p_pipeline,
+                                     uint32_t start)
+{
+    uint32_t best = start;
+    uint32_t best_load = UINT32_MAX;
+
+    for (uint32_t i = 0; i < p_pipeline->crypto_count; i++) {
+        uint32_t worker = (start + i) % p_pipeline->crypto_count;
+        uint32_t load = 0;
+
+        for (uint32_t io = 0; io < p_pipeline->io_count; io++) {
+            salt_pipeline_ring_t *p_ring = &p_pipeline->p_rx[io * p_pipeline->crypto_count + worker];
+            /* Head first, it never passes the tail read after it. */
+            uint32_t head = SALT_ATOMIC_LOAD_ACQUIRE(&p_ring->head);
+            load += SALT_ATOMIC_LOAD_RELAXED(&p_ring->tail) - head;
+        }
+
+        if (load < best_load) {
+            best_load = load;
+            best = worker;
+        }
+    }
+
+    return best;
+}
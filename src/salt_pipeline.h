@@ -0,0 +1,387 @@
+#ifndef _SALT_PIPELINE_H_
+#define _SALT_PIPELINE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file salt_pipeline.h
+ *
+ * Staged host, with the socket I/O and the record crypto on different threads.
+ *
+ * A host that reads, decrypts, handles, encrypts and writes each record on one
+ * thread leaves cores idle when a few sessions carry most of the traffic. In
+ * the pipeline, I/O threads read complete encrypted records and hand them to
+ * crypto workers. A crypto worker decrypts the record, calls the application
+ * handler, encrypts the reply and hands it back to the I/O thread, which
+ * writes it. The number of crypto workers is chosen independently of the
+ * number of I/O threads.
+ *
+ * Each session is read and written by one I/O thread. Its records are
+ * decrypted, handled and encrypted by one crypto worker at a time, so the
+ * nonces of the channel are never used by two threads at once. The worker is
+ * chosen when a record is posted while the session has no record in the
+ * pipeline, the one with the fewest queued records, preferring the worker the
+ * session had. A busy session thus stays on its worker, and an idle session
+ * moves to a less loaded one. Hence the records of a session are handled in
+ * order, and the salt channel is only used by one crypto worker at a time
+ * after the handshake. The I/O thread never touches the channel, it reads and
+ * writes with \ref salt_pipeline_read and \ref salt_pipeline_write.
+ *
+ * The records are owned by the I/O thread that acquired them, and always come
+ * back to it, with a reply, with nothing to send or with an error. Between each
+ * I/O thread and each crypto worker there is one single producer, single
+ * consumer ring in each direction, and each I/O thread has a ring of free
+ * records and a ring of records that failed to be read. The rings are lock
+ * free and in user provided memory. A ring holds all records of its I/O
+ * thread, so handing over a record never fails.
+ *
+ * The receive and send side of an I/O thread may be two threads. Records are
+ * then only acquired by the receive side, and only released by the send side,
+ * since the free ring has a single producer. A record that could not be read
+ * is handed to the send side with \ref salt_pipeline_fail.
+ *
+ * Without GCC compatible atomic builtins, all calls must be made from the same
+ * thread.
+ *
+ * Usage, I/O thread io:
+ *      salt_pipeline_session_init(&session->pipe, index), when the session
+ *      is added.
+ *
+ *      p_record = salt_pipeline_acquire(&pipeline, io);
+ *      ret = salt_pipeline_read(&session->rx, my_read, p_record);
+ *      if (ret == SALT_SUCCESS) {
+ *          salt_pipeline_post(&pipeline, p_record, &session->channel,
+ *                             &session->pipe);
+ *      }
+ *      else if (ret == SALT_ERROR) {
+ *          salt_pipeline_fail(&pipeline, p_record, session->pipe.index);
+ *      }
+ *      If ret == SALT_PENDING the record is partial, keep it for this session.
+ *
+ *      while ((p_record = salt_pipeline_take(&pipeline, io)) != NULL) {
+ *          if (p_record->status == SALT_SUCCESS) {
+ *              Write with salt_pipeline_write, in order per session.
+ *          }
+ *          else if (p_record->status == SALT_ERROR) {
+ *              Close the session, its later records must still be taken
+ *              and released before the session is removed.
+ *          }
+ *          salt_pipeline_release(&pipeline, p_record);
+ *      }
+ *
+ * Usage, crypto worker:
+ *      while (salt_pipeline_execute(&pipeline, worker) == SALT_SUCCESS) { }
+ *
+ * Usage, handler:
+ *      salt_ret_t my_handler(void *p_context, salt_pipeline_record_t *p_record)
+ *      {
+ *          Read p_record->msg with salt_read_next, the messages are in
+ *          p_record->p_data.
+ *          return SALT_PENDING to send nothing, or prepare the reply with
+ *          salt_write_begin(p_record->p_data, p_record->size, &p_record->msg)
+ *          and return SALT_SUCCESS.
+ *      }
+ *
+ * The pipeline does not block, an idle thread polls or waits for a signal.
+ *
+ */
+
+/*======= Includes ============================================================*/
+
+#include "salt.h"
+
+/*======= Public macro definitions ==========================================*/
+
+/* Size of a cache line, the ends of a ring are kept on different lines. */
+#define SALT_PIPELINE_CACHE_LINE    (64U)
+
+/** Number of rings needed for io_count I/O threads and crypto_count workers. */
+#define SALT_PIPELINE_RINGS(io_count, crypto_count) \
+    ((io_count) * (2U + 2U * (crypto_count)))
+
+/** Worker of a session before its first record is posted. */
+#define SALT_PIPELINE_NO_WORKER     (0xFFFFFFFFU)
+
+/** Number of ring slots needed with record_count records per I/O thread. */
+#define SALT_PIPELINE_SLOTS(record_count, io_count, crypto_count) \
+    ((record_count) * SALT_PIPELINE_RINGS(io_count, crypto_count))
+
+/*======= Type Definitions and declarations ===================================*/
+
+/**
+ * @brief Pipeline state of a session, kept by the I/O thread.
+ *
+ * posted is only written by the receive side and taken only by the send side.
+ * The worker may only change when they are equal, i.e., when no record of the
+ * session is queued or being handled.
+ */
+typedef struct salt_pipeline_session_s {
+    uint32_t        index;                              /**< Session identifier. */
+    uint32_t        worker;                             /**< Crypto worker of the session. */
+    uint32_t        posted;                             /**< Records posted. */
+    uint32_t        taken;                              /**< Records taken back. */
+} salt_pipeline_session_t;
+
+/**
+ * @brief A record buffer and the state of the record in it.
+ */
+typedef struct salt_pipeline_record_s {
+    uint8_t                 *p_data;                    /**< Record buffer. */
+    uint32_t                size;                       /**< Size of the record buffer. */
+    uint32_t                length;                     /**< Received record size, without size bytes. */
+    uint32_t                io;                         /**< Owning I/O thread. */
+    uint32_t                session;                    /**< Session identifier. */
+    salt_pipeline_session_t *p_session;                 /**< Posting session, NULL if failed. */
+    salt_channel_t          *p_channel;                 /**< Channel of the session. */
+    salt_msg_t              msg;                        /**< Read state, then the reply. */
+    salt_ret_t              status;                     /**< SUCCESS reply, PENDING none, ERROR failed. */
+    void                    *p_context;                 /**< User context, e.g., the session. */
+} salt_pipeline_record_t;
+
+/**
+ * @brief Single producer, single consumer ring of records.
+ */
+typedef struct salt_pipeline_ring_s {
+    salt_pipeline_record_t  **pp_slots;                 /**< Slots of the ring. */
+    uint32_t                mask;                       /**< Number of slots - 1. */
+    uint8_t                 pad0[SALT_PIPELINE_CACHE_LINE];
+    uint32_t                tail;                       /**< Next position to push to, producer only. */
+    uint8_t                 pad1[SALT_PIPELINE_CACHE_LINE];
+    uint32_t                head;                       /**< Next position to pop from, consumer only. */
+    uint8_t                 pad2[SALT_PIPELINE_CACHE_LINE];
+} salt_pipeline_ring_t;
+
+/**
+ * @brief Application handler, called by the crypto worker of the session.
+ *
+ * p_record->msg holds the decrypted messages, in p_record->p_data. To reply,
+ * the handler prepares a message in p_record->msg, in p_record->p_data or in a
+ * buffer of its own that is kept until the record is released. The messages
+ * must then be copied before they are overwritten.
+ *
+ * @param p_context     Pointer to handler context.
+ * @param p_record      Pointer to record.
+ *
+ * @return SALT_SUCCESS p_record->msg is prepared and is sent as reply.
+ * @return SALT_PENDING Nothing to send.
+ * @return SALT_ERROR   The session is closed.
+ */
+typedef salt_ret_t (*salt_pipeline_handler_t)(void *p_context,
+                                              salt_pipeline_record_t *p_record);
+
+/**
+ * @brief Pipeline.
+ */
+typedef struct salt_pipeline_s {
+    salt_pipeline_ring_t    *p_free;                    /**< Free records, one ring per I/O thread. */
+    salt_pipeline_ring_t    *p_failed;                  /**< Records failed to be read, one ring per I/O thread. */
+    salt_pipeline_ring_t    *p_rx;                      /**< Received, ring io * crypto_count + worker. */
+    salt_pipeline_ring_t    *p_tx;                      /**< Handled, ring worker * io_count + io. */
+    uint32_t                io_count;                   /**< Number of I/O threads. */
+    uint32_t                crypto_count;               /**< Number of crypto workers. */
+    salt_pipeline_handler_t handler;                    /**< Application handler. */
+    void                    *p_handler_context;         /**< Pointer to handler context. */
+} salt_pipeline_t;
+
+/*======= Public function declarations ========================================*/
+
+/**
+ * @brief Initiates a pipeline.
+ *
+ * Each I/O thread gets record_count records. The memory of record i is
+ * p_memory + i * record_size, and records io * record_count and on belong to
+ * I/O thread io.
+ *
+ * @param p_pipeline    Pointer to pipeline.
+ * @param p_records     Pointer to io_count * record_count records.
+ * @param record_count  Records per I/O thread, a power of two and at least 2.
+ * @param p_memory      Pointer to io_count * record_count * record_size bytes.
+ * @param record_size   Size of each record buffer, at least
+ *                      SALT_WRITE_OVERHEAD_SIZE since the reply is prepared
+ *                      in the same buffer.
+ * @param io_count      Number of I/O threads, at least 1.
+ * @param crypto_count  Number of crypto workers, at least 1.
+ * @param p_rings       Pointer to SALT_PIPELINE_RINGS(io_count, crypto_count)
+ *                      rings.
+ * @param pp_slots      Pointer to SALT_PIPELINE_SLOTS(record_count, io_count,
+ *                      crypto_count) slots.
+ * @param handler       Application handler.
+ * @param p_context     Pointer to handler context.
+ *
+ * @return SALT_SUCCESS The pipeline was initiated, all records are free.
+ * @return SALT_ERROR   Any input was invalid.
+ */
+salt_ret_t salt_pipeline_init(salt_pipeline_t *p_pipeline,
+                              salt_pipeline_record_t *p_records,
+                              uint32_t record_count,
+                              uint8_t *p_memory,
+                              uint32_t record_size,
+                              uint32_t io_count,
+                              uint32_t crypto_count,
+                              salt_pipeline_ring_t *p_rings,
+                              salt_pipeline_record_t **pp_slots,
+                              salt_pipeline_handler_t handler,
+                              void *p_context);
+
+/**
+ * @brief Initiates the pipeline state of a session.
+ *
+ * @param p_session     Pointer to session state.
+ * @param index         Session identifier.
+ */
+void salt_pipeline_session_init(salt_pipeline_session_t *p_session,
+                                uint32_t index);
+
+/**
+ * @brief Takes a free record of an I/O thread.
+ *
+ * @param p_pipeline    Pointer to pipeline.
+ * @param io            I/O thread index.
+ *
+ * @return Pointer to record, owned by the caller.
+ * @return NULL if all records of the I/O thread are in use.
+ */
+salt_pipeline_record_t *salt_pipeline_acquire(salt_pipeline_t *p_pipeline,
+                                              uint32_t io);
+
+/**
+ * @brief Reads one encrypted record without the salt channel.
+ *
+ * The I/O channel is used as by \ref salt_read_begin, but is kept by the
+ * caller, one per session, and its p_context must be set for read_impl. The
+ * record is put at p_record->p_data[SALT_READ_RECORD_OFFSET] and its size in
+ * p_record->length.
+ *
+ * @param p_io          Pointer to the read I/O channel of the session.
+ * @param read_impl     Read implementation.
+ * @param p_record      Pointer to record, the same until SALT_SUCCESS.
+ *
+ * @return SALT_SUCCESS A complete record was read.
+ * @return SALT_PENDING The record is partial.
+ * @return SALT_ERROR   The read failed or the record does not fit in the
+ *                      buffer, see p_io->err_code.
+ */
+salt_ret_t salt_pipeline_read(salt_io_channel_t *p_io,
+                              salt_io_impl read_impl,
+                              salt_pipeline_record_t *p_record);
+
+/**
+ * @brief Hands a read record to the crypto worker of its session.
+ *
+ * If all earlier records of the session have been taken back, the worker with
+ * the fewest queued records is chosen for it, the current worker of the
+ * session on a tie and else starting at index % crypto_count. Otherwise the
+ * record goes to the current worker, after the records of the session already
+ * there. The caller must not use the record until it is returned by
+ * \ref salt_pipeline_take, and must keep p_session until then.
+ *
+ * @param p_pipeline    Pointer to pipeline.
+ * @param p_record      Record from \ref salt_pipeline_acquire.
+ * @param p_channel     Established channel of the session.
+ * @param p_session     Pointer to session state, see
+ *                      \ref salt_pipeline_session_init.
+ *
+ * @return SALT_SUCCESS The record was posted.
+ * @return SALT_ERROR   Any input was invalid or the ring was full, e.g., a
+ *                      record was posted twice.
+ */
+salt_ret_t salt_pipeline_post(salt_pipeline_t *p_pipeline,
+                              salt_pipeline_record_t *p_record,
+                              salt_channel_t *p_channel,
+                              salt_pipeline_session_t *p_session);
+
+/**
+ * @brief Hands a record that could not be read to the send side.
+ *
+ * Used instead of \ref salt_pipeline_release on the receive side, so that the
+ * free ring is only filled by the send side. The record is returned by
+ * \ref salt_pipeline_take with status SALT_ERROR, after the records already
+ * handled by the crypto workers.
+ *
+ * @param p_pipeline    Pointer to pipeline.
+ * @param p_record      Record from \ref salt_pipeline_acquire.
+ * @param session       Session identifier.
+ *
+ * @return SALT_SUCCESS The record was handed over.
+ * @return SALT_ERROR   Any input was invalid or the ring was full.
+ */
+salt_ret_t salt_pipeline_fail(salt_pipeline_t *p_pipeline,
+                              salt_pipeline_record_t *p_record,
+                              uint32_t session);
+
+/**
+ * @brief Decrypts, handles and encrypts the next records of a crypto worker.
+ *
+ * One record is taken from each I/O thread that has posted one, so a busy I/O
+ * thread does not delay the others. Each record is returned to its I/O thread
+ * with status SALT_SUCCESS and the encrypted reply in p_record->msg,
+ * SALT_PENDING if there is nothing to send, or SALT_ERROR if the record or the
+ * reply failed, see p_record->p_channel->err_code.
+ *
+ * @param p_pipeline    Pointer to pipeline.
+ * @param worker        Crypto worker index, less than crypto_count.
+ *
+ * @return SALT_SUCCESS At least one record was handled.
+ * @return SALT_PENDING No record was waiting.
+ * @return SALT_ERROR   Any input was invalid.
+ */
+salt_ret_t salt_pipeline_execute(salt_pipeline_t *p_pipeline, uint32_t worker);
+
+/**
+ * @brief Takes the next handled record of an I/O thread.
+ *
+ * The records handled by the crypto workers are taken first, then the records
+ * handed over by \ref salt_pipeline_fail. A taken record no longer counts as
+ * in the pipeline for its session.
+ *
+ * @param p_pipeline    Pointer to pipeline.
+ * @param io            I/O thread index.
+ *
+ * @return Pointer to record, owned by the caller until released.
+ * @return NULL if no record was handled.
+ */
+salt_pipeline_record_t *salt_pipeline_take(salt_pipeline_t *p_pipeline,
+                                           uint32_t io);
+
+/**
+ * @brief Writes the encrypted reply of a record without the salt channel.
+ *
+ * The I/O channel is used as by \ref salt_write_execute, but is kept by the
+ * caller, one per session, and its p_context must be set for write_impl.
+ *
+ * @param p_io          Pointer to the write I/O channel of the session.
+ * @param write_impl    Write implementation.
+ * @param p_record      Pointer to record with status SALT_SUCCESS, the same
+ *                      until SALT_SUCCESS.
+ *
+ * @return SALT_SUCCESS The reply was written.
+ * @return SALT_PENDING The write is still pending.
+ * @return SALT_ERROR   The write failed, see p_io->err_code.
+ */
+salt_ret_t salt_pipeline_write(salt_io_channel_t *p_io,
+                               salt_io_impl write_impl,
+                               salt_pipeline_record_t *p_record);
+
+/**
+ * @brief Returns a record to the free ring of its I/O thread.
+ *
+ * The free ring has a single producer, only one thread of an I/O thread may
+ * release records, see \ref salt_pipeline_fail.
+ *
+ * @param p_pipeline    Pointer to pipeline.
+ * @param p_record      Record from \ref salt_pipeline_take or
+ *                      \ref salt_pipeline_acquire.
+ *
+ * @return SALT_SUCCESS The record was released.
+ * @return SALT_ERROR   Any input was invalid or the ring was full.
+ */
+salt_ret_t salt_pipeline_release(salt_pipeline_t *p_pipeline,
+                                 salt_pipeline_record_t *p_record);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SALT_PIPELINE_H_ */
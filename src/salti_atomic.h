@@ -0,0 +1,58 @@
+#ifndef _SALTI_ATOMIC_H_
+#define _SALTI_ATOMIC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file salti_atomic.h
+ *
+ * Atomic operations used by the modules shared between threads. Not intended
+ * to use directly.
+ *
+ * The library is C99, so the GCC compatible atomic builtins are used, which
+ * follow the C11 memory model. Without the builtins the operations are plain
+ * memory accesses and SALT_ATOMIC_LOCK_FREE is 0, the modules then document
+ * how they must be serialized.
+ *
+ */
+
+/*======= Includes ==========================================================*/
+/*======= Public macro definitions ==========================================*/
+
+#if defined(__GNUC__)
+#define SALT_ATOMIC_LOCK_FREE               (1)
+#define SALT_ATOMIC_LOAD_ACQUIRE(p)         __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define SALT_ATOMIC_LOAD_RELAXED(p)         __atomic_load_n((p), __ATOMIC_RELAXED)
+#define SALT_ATOMIC_STORE_RELEASE(p, v)     __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define SALT_ATOMIC_STORE_RELAXED(p, v)     __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#define SALT_ATOMIC_FENCE_ACQUIRE()         __atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define SALT_ATOMIC_FENCE_RELEASE()         __atomic_thread_fence(__ATOMIC_RELEASE)
+#define SALT_ATOMIC_FENCE()                 __atomic_thread_fence(__ATOMIC_SEQ_CST)
+/* Weak compare and swap, *p_expected is updated on failure. */
+#define SALT_ATOMIC_CAS_RELAXED(p, p_expected, v)                       \
+    __atomic_compare_exchange_n((p), (p_expected), (v), 1,              \
+                                __ATOMIC_RELAXED, __ATOMIC_RELAXED)
+#else
+#define SALT_ATOMIC_LOCK_FREE               (0)
+#define SALT_ATOMIC_LOAD_ACQUIRE(p)         (*(p))
+#define SALT_ATOMIC_LOAD_RELAXED(p)         (*(p))
+#define SALT_ATOMIC_STORE_RELEASE(p, v)     (*(p) = (v))
+#define SALT_ATOMIC_STORE_RELAXED(p, v)     (*(p) = (v))
+#define SALT_ATOMIC_FENCE_ACQUIRE()
+#define SALT_ATOMIC_FENCE_RELEASE()
+#define SALT_ATOMIC_FENCE()
+#define SALT_ATOMIC_CAS_RELAXED(p, p_expected, v)                       \
+    ((*(p) == *(p_expected)) ? ((*(p) = (v)), 1) : ((*(p_expected) = *(p)), 0))
+#endif
+
+/*======= Type Definitions and declarations =================================*/
+/*======= Public variable declarations ======================================*/
+/*======= Public function declarations ======================================*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SALTI_ATOMIC_H_ */
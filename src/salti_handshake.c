@@ -29,6 +29,7 @@
 #define SALT_M1_MAX_SIZE                        SALT_M1_SIZE_WITH_SIG
 #define SALT_M1_HEADER_VALUE                    (0x01U)
 #define SALT_M1_SIG_KEY_INCLUDED_FLAG           (0x01U)
+#define SALT_M1_DGRAM_FLAG                      (0x40U)
 
 /* M2 Message defines */
 #define SALT_M2_SIZE_OFFSET                     (0U)
@@ -38,41 +39,18 @@
 #define SALT_M2_HEADER_VALUE                    (0x02U)
 #define SALT_M2_ENC_KEY_INCLUDED_FLAG           (0x10U)
 #define SALT_M2_RESUME_SUPPORTED_FLAG           (0x20U)
+#define SALT_M2_DGRAM_FLAG                      (0x40U)
 #define SALT_M2_TIME_OFFSET                     (SALT_LENGTH_SIZE + 2U)
 #define SALT_M2_PUB_ENC_OFFSET                  (SALT_LENGTH_SIZE + 6U)
 
-#define SALT_M2_HOST_OFFSET                     (200U)
-#define SALT_HOST_TMP_PEER_EK_PUB_OFFSET        (242U)
-
 /* M3 Message defines */
-#define SALT_M3M4_WRAPPED_SIZE                  (120U)
-#define SALT_M3M4_CLEAR_SIZE                    (96U)
 #define SALT_M3_HEADER_VALUE                    (0x03U)
 #define SALT_M3_SIG_KEY_INCLUDED_FLAG           (0x10U)
 
 #define SALT_M3M4_MSG_TO_SIG_SIZE               (136U)
-#define SALT_M3M4_SIGNED_MSG_SIZE               (200U)
-
-#define SALT_M3_HOST_CLEAR_OFFSET               (238U)
-#define SALT_M3_HOST_WRAPPED_OFFSET             (SALT_M3_HOST_CLEAR_OFFSET - SALT_WRAP_OVERHEAD_SIZE)
-#define SALT_M3_CLIENT_IO_WRAPPED_OFFSET        (214U)
-#define SALT_M3_CLIENT_WRAPPED_OFFSET           (200U)
 
 /* M4 Message defines */
 #define SALT_M4_HEADER_VALUE                    (0x04U)
-#define SALT_M4_HOST_IO_WRAPPED_OFFSET          (214U)
-#define SALT_M4_HOST_WRAPPED_OFFSET             (200U)
-#define SALT_M4_CLIENT_CLEAR_OFFSET             (400U)
-#define SALT_M4_CLIENT_IO_WRAPPED_OFFSET        (SALT_M4_CLIENT_CLEAR_OFFSET - SALT_WRAP_OVERHEAD_SIZE)
-
-#define SALT_M3M4_SIG_VERIFY_OFFSET             (200U)
-
-#define SALT_PUB_ENC_OFFSET                     (0U)
-#define SALT_SEC_ENC_OFFSET                     (32U)
-#define SALT_SIG_PREFIX_OFFSET                  (64U)
-#define SALT_SIG_PREFIX_SIZE                    (8U)
-#define SALT_M1_HASH_OFFSET                     (72U)
-#define SALT_M2_HASH_OFFSET                     (136U)
 
 #define SALT_PROTOCOL_INDICATOR                 "SCv2"
 #define SALT_PROTOCOL_INDICATOR_SIZE            (4U)
@@ -86,6 +64,11 @@ static uint8_t sig1prefix[8] = { 0x53, 0x43, 0x2d, 0x53, 0x49, 0x47, 0x30, 0x31
 static uint8_t sig2prefix[8] = { 0x53, 0x43, 0x2d, 0x53, 0x49, 0x47, 0x30, 0x32 };
 
 /*======= Local function prototypes =========================================*/
+
+static void salti_start_m4_sig(salt_channel_t *p_channel);
+static void salti_m4_sig_task(void *p_arg);
+static salt_ret_t salti_join_m4_sig(salt_channel_t *p_channel);
+
 /*======= Global function implementations ===================================*/
 /*======= Local function implementations ====================================*/
 
@@ -96,9 +79,11 @@ salt_ret_t salti_handshake_server(salt_channel_t *p_channel, const uint8_t *p_wi
     salt_ret_t ret_code = SALT_ERROR;
     uint8_t proceed = 1;
     uint8_t *payload = NULL;
+    salt_state_t old_state;
 
     while (proceed) {
         proceed = 0;
+        old_state = p_channel->state;
         switch (p_channel->state) {
             case SALT_SESSION_INITIATED:
                 /*
@@ -207,7 +192,20 @@ salt_ret_t salti_handshake_server(salt_channel_t *p_channel, const uint8_t *p_wi
                  *  clientEkPub[32] || ...
                  * }
                  *
+                 * A lazy host creates the ephemeral key pair first, it is not
+                 * used in an M2 with NO_SUCH_SERVER.
+                 *
                  */
+                if ((SALT_M2_INIT == p_channel->state) && p_channel->ek_pending) {
+                    SALT_PROBE2(crypto__start, p_channel, SALT_PROBE_CRYPTO_BOX_KEYPAIR);
+                    salt_ret_t ek_ret = p_channel->ek_source(p_channel->p_ek_source_context,
+                                                             &p_channel->hdshk_buffer[SALT_PUB_ENC_OFFSET],
+                                                             &p_channel->hdshk_buffer[SALT_SEC_ENC_OFFSET]);
+                    SALT_PROBE3(crypto__end, p_channel, SALT_PROBE_CRYPTO_BOX_KEYPAIR,
+                                (SALT_SUCCESS == ek_ret) ? 0 : -1);
+                    SALT_VERIFY(SALT_SUCCESS == ek_ret, SALT_ERR_CRYPTO_API);
+                    p_channel->ek_pending = false;
+                }
                 p_channel->state = salti_create_m2(p_channel,
                                                    &p_channel->hdshk_buffer[SALT_M2_HOST_OFFSET],
                                                    &size,
@@ -242,9 +240,11 @@ salt_ret_t salti_handshake_server(salt_channel_t *p_channel, const uint8_t *p_wi
                      * }
                      *
                      */
+                    SALT_PROBE2(crypto__start, p_channel, SALT_PROBE_CRYPTO_BEFORENM);
                     int crypto_ret = api_crypto_box_beforenm(p_channel->ek_common,
                                                              &p_channel->hdshk_buffer[SALT_HOST_TMP_PEER_EK_PUB_OFFSET],
                                                              &p_channel->hdshk_buffer[SALT_SEC_ENC_OFFSET]);
+                    SALT_PROBE3(crypto__end, p_channel, SALT_PROBE_CRYPTO_BEFORENM, crypto_ret);
 
                     SALT_VERIFY(0 == crypto_ret, SALT_ERR_CRYPTO_API);
 
@@ -382,15 +382,15 @@ salt_ret_t salti_handshake_server(salt_channel_t *p_channel, const uint8_t *p_wi
                                                  p_channel->write_channel.p_data,
                                                  p_channel->write_channel.size);
 
-                 /*
+                /*
+                 * The signature is verified detached, i.e., the signature is
+                 * read from m4Clear and only the prefix is replaced:
+                 *
                  * buffer = {
-                 *  m4Signature[64] ||
+                 *  m3Signature[64] ||
                  *  sig2Prefix[8] ||
                  *  m1Hash[64] ||
-                 *  m2Hash[64] ||
-                 *  m1Hash[64] ||
-                 *  m2Hash[64] ||
-                 *  neededWhenVerifying[64] ||
+                 *  m2Hash[64] || ...
                  * }
                  */
 
@@ -404,7 +404,7 @@ salt_ret_t salti_handshake_server(salt_channel_t *p_channel, const uint8_t *p_wi
                                     SALT_ERR_BAD_PEER);
                     }
 
-                    p_channel->state = SALT_SESSION_ESTABLISHED;
+                    salti_session_established(p_channel);
                 }
 
                 break;
@@ -412,6 +412,7 @@ salt_ret_t salti_handshake_server(salt_channel_t *p_channel, const uint8_t *p_wi
             default:
                 return SALT_ERROR;
         }
+        SALT_PROBE_STATE(p_channel, old_state);
     }
 
     return ret_code;
@@ -422,9 +423,11 @@ salt_ret_t salti_handshake_client(salt_channel_t *p_channel, const uint8_t *p_wi
     uint32_t size = 0;
     salt_ret_t ret_code = SALT_ERROR;
     uint8_t proceed = 1;
+    salt_state_t old_state;
 
     while (proceed) {
         proceed = 0;
+        old_state = p_channel->state;
         switch (p_channel->state) {
             case SALT_SESSION_INITIATED:
                 /*
@@ -531,30 +534,28 @@ salt_ret_t salti_handshake_client(salt_channel_t *p_channel, const uint8_t *p_wi
                  *
                  * Further, the API for signing a msg
                  * will take a message m[n] and create a signed message sm[n+64].
-                 * Thus, we need a sligther larger buffer for creating the msg:
-                 * 1. M4 = { header[2] , timestamp[4] , pubSigKey[32] }
-                 * 2. Sign the hashes of M1 and M2 and put the signed message at
-                 *    the end of M4:
-                 *    M4[230] = { header[2] , timestamp[4] , pubSigKey[32] , signedMsg[192] }
-                 *    where signedMsg[192] = { sig[64] , M1Hash[64] , M2Hash[64] }.
-                 *    The peer however can will calculate these hashes so we
-                 *    don't send them. I.e.:
+                 * The signed message { sig[64] , sig2Prefix[8] , M1Hash[64] , M2Hash[64] }
+                 * is created in the beginning of the handshake buffer. The peer
+                 * will calculate the hashes so we don't send them. I.e.:
                  *    M4[102] = { header[2] , timestamp[4] , pubSigKey[32] , sig[64] }
+                 * The signature is kept until M3 is verified, M4 is then
+                 * created where M3 was received.
                  *
-                 *
+                 * If a worker is used, the signature is already being created
+                 * on the helper thread, see salti_handle_m2, and is joined
+                 * before M4 is wrapped.
                  */
-                salti_create_m3m4_sig(p_channel,
-                                      &p_channel->hdshk_buffer[SALT_M4_CLIENT_CLEAR_OFFSET],
-                                      &p_channel->write_channel.size);
+                if ((NULL == p_channel->p_worker) || !p_channel->p_worker->started) {
+                    ret_code = salti_sign_m3m4(p_channel);
+                    SALT_VERIFY(SALT_SUCCESS == ret_code, p_channel->err_code);
+                }
 
                 /*
                  * buffer = {
                  *  m4Signature[64] ||
                  *  sig2Prefix[8] ||
                  *  m1Hash[64] ||
-                 *  m2Hash[64] ||
-                 *  reservedForM4[200] ||
-                 *  m4Clear[96] || ...
+                 *  m2Hash[64] || ...
                  * }
                  */
 
@@ -574,15 +575,12 @@ salt_ret_t salti_handshake_client(salt_channel_t *p_channel, const uint8_t *p_wi
                     /*
                      *
                      * buffer = {
-                     *  m3Signature[64] ||
-                     *  sig1Prefix[8] ||
+                     *  m4Signature[64] ||
+                     *  sig2Prefix[8] ||
                      *  m1Hash[64] ||
                      *  m2Hash[64] ||
                      *  reservedForUnwrapping[14] ||
-                     *  m3EncryptedAndWrappedWithoutSize[120] ||
-                     *  notUsed[66] ||
-                     *  m4Clear[96] || ...
-                     *
+                     *  m3EncryptedAndWrappedWithoutSize[120]
                      * }
                      *
                      */
@@ -613,9 +611,7 @@ salt_ret_t salti_handshake_client(salt_channel_t *p_channel, const uint8_t *p_wi
                  *  zeroPadded[32] ||
                  *  header[2] ||
                  *  time[4] ||
-                 *  m3Clear[96] ||
-                 *  notUsed[66] ||
-                 *  m4Clear[96] || ...
+                 *  m3Clear[96]
                  * }
                  */
 
@@ -627,16 +623,14 @@ salt_ret_t salti_handshake_client(salt_channel_t *p_channel, const uint8_t *p_wi
                                                  p_channel->read_channel.size);
 
                 /*
+                 * The signature is verified detached, i.e., the signature is
+                 * read from m3Clear and only the prefix is replaced:
+                 *
                  * buffer = {
                  *  m4Signature[64] ||
-                 *  sig2Prefix[8] ||
-                 *  m1Hash[64] ||
-                 *  m2Hash[64] ||
-                 *  sig2Prefix[8] ||
+                 *  sig1Prefix[8] ||
                  *  m1Hash[64] ||
-                 *  m2Hash[64] ||
-                 *  neededWhenVerifying[64] ||
-                 *  m4Clear[96] || ...
+                 *  m2Hash[64] || ...
                  * }
                  */
 
@@ -651,11 +645,34 @@ salt_ret_t salti_handshake_client(salt_channel_t *p_channel, const uint8_t *p_wi
 
                 break;
             case SALT_M4_WRAP:
+                if ((NULL != p_channel->p_worker) && p_channel->p_worker->started) {
+                    ret_code = salti_join_m4_sig(p_channel);
+                    if (SALT_PENDING == ret_code) {
+                        break;
+                    }
+                    SALT_VERIFY(SALT_SUCCESS == ret_code, p_channel->err_code);
+                }
+
                 /*
-                 * Clear text M3 was previous created in p_channel->hdshk_buffer[406].
-                 * The wrapping requires 38 bytes overhead and the clear text buffer
-                 * must be placed in 38 bytes offset.
+                 * M3 is no longer needed, the clear text M4 is created where
+                 * the clear text M3 was. The wrapping requires 38 bytes overhead
+                 * and the clear text buffer must be placed in 38 bytes offset.
+                 *
+                 * buffer = {
+                 *  m4Signature[64] ||
+                 *  sig1Prefix[8] ||
+                 *  m1Hash[64] ||
+                 *  m2Hash[64] ||
+                 *  reservedForWrapping[38] ||
+                 *  m4Clear[96]
+                 * }
                  */
+                memcpy(&p_channel->hdshk_buffer[SALT_M4_CLIENT_CLEAR_OFFSET],
+                       p_channel->my_sk_pub, api_crypto_sign_PUBLICKEYBYTES);
+                memcpy(&p_channel->hdshk_buffer[SALT_M4_CLIENT_CLEAR_OFFSET + api_crypto_sign_PUBLICKEYBYTES],
+                       p_channel->hdshk_buffer, api_crypto_sign_BYTES);
+                p_channel->write_channel.size = SALT_M3M4_CLEAR_SIZE;
+
                 ret_code = salti_wrap(p_channel,
                                       &p_channel->hdshk_buffer[SALT_M4_CLIENT_IO_WRAPPED_OFFSET],
                                       p_channel->write_channel.size,
@@ -666,11 +683,11 @@ salt_ret_t salti_handshake_client(salt_channel_t *p_channel, const uint8_t *p_wi
                 /*
                  * buffer = {
                  *  m4Signature[64] ||
-                 *  sig2Prefix[8] ||
+                 *  sig1Prefix[8] ||
                  *  m1Hash[64] ||
                  *  m2Hash[64] ||
-                 *  unused[72] ||
-                 *  m4EncryptedAndWrappedWithSize[124] || ...
+                 *  zeroPadded[10] ||
+                 *  m4EncryptedAndWrappedWithSize[124]
                  * }
                  */
 
@@ -686,13 +703,14 @@ salt_ret_t salti_handshake_client(salt_channel_t *p_channel, const uint8_t *p_wi
                                           p_channel->write_channel.size);
 
                 if (SALT_SUCCESS == ret_code) {
-                    p_channel->state = SALT_SESSION_ESTABLISHED;
+                    salti_session_established(p_channel);
                 }
                 break;
             case SALT_ERROR_STATE:
             default:
                 return SALT_ERROR;
         }
+        SALT_PROBE_STATE(p_channel, old_state);
     }
 
     return ret_code;
@@ -812,6 +830,9 @@ salt_ret_t salti_handle_a1_create_a2(salt_channel_t *p_channel,
  * If time is supported, the time 1 (0x01, 0x00, 0x00, 0x00) is set in the
  * time data. Otherwise, it is set to 0x00 for all bytes.
  *
+ * If datagram mode is requested, see \ref salt_dgram_init, SALT_M1_DGRAM_FLAG
+ * is set in header[1]. This flag is an extension to the specification.
+ *
  * Further, we create the message with the size bytes included:
  *
  * M1WithSize = { size[4] , M1[n] }
@@ -848,6 +869,10 @@ salt_ret_t salti_create_m1(salt_channel_t *p_channel,
         p_data[SALT_LENGTH_SIZE + 5] = 0x00U; /* No tickets */
     }
 
+    if (NULL != p_channel->p_dgram) {
+        p_data[SALT_LENGTH_SIZE + 5] |= SALT_M1_DGRAM_FLAG;
+    }
+
     memset(&p_data[SALT_LENGTH_SIZE + 6], 0x00U, 4);
     if (p_channel->time_impl != NULL) {
         p_data[SALT_LENGTH_SIZE + 6] = 0x01U;
@@ -857,7 +882,9 @@ salt_ret_t salti_create_m1(salt_channel_t *p_channel,
            &p_channel->hdshk_buffer[SALT_PUB_ENC_OFFSET],
            api_crypto_box_PUBLICKEYBYTES);
 
+    SALT_PROBE2(crypto__start, p_channel, SALT_PROBE_CRYPTO_HASH);
     int ret = api_crypto_hash_sha512(p_hash, &p_data[SALT_LENGTH_SIZE], (*size));
+    SALT_PROBE3(crypto__end, p_channel, SALT_PROBE_CRYPTO_HASH, ret);
     SALT_VERIFY(0 == ret, SALT_ERR_CRYPTO_API);
 
     salti_u32_to_bytes(p_data, (*size));
@@ -877,6 +904,9 @@ salt_ret_t salti_create_m1(salt_channel_t *p_channel,
  * The the time field in M1 differs from 0x00 time is supported by the peer
  * and we set the peer_epoch time.
  *
+ * If the client requests datagram mode and we support it, datagram mode is
+ * negotiated and accepted in M2.
+ *
  */
 salt_state_t salti_handle_m1(salt_channel_t *p_channel,
                              uint8_t *p_data,
@@ -914,6 +944,10 @@ salt_state_t salti_handle_m1(salt_channel_t *p_channel,
         return SALT_ERROR_STATE;
     }
 
+    if (((p_data[5] & SALT_M1_DGRAM_FLAG) > 0U) && (NULL != p_channel->p_dgram)) {
+        p_channel->p_dgram->negotiated = true;
+    }
+
     if (((p_data[5] & SALT_M1_SIG_KEY_INCLUDED_FLAG) > 0U) && (size == 74U)) {
         /*
          * The client included a public signature key. I.e., the client
@@ -936,11 +970,10 @@ salt_state_t salti_handle_m1(salt_channel_t *p_channel,
     memcpy(&p_channel->hdshk_buffer[SALT_HOST_TMP_PEER_EK_PUB_OFFSET], &p_data[10], api_crypto_box_PUBLICKEYBYTES);
 
     /* Save the hash of M1 */
+    SALT_PROBE2(crypto__start, p_channel, SALT_PROBE_CRYPTO_HASH);
     int ret = api_crypto_hash_sha512(p_hash, p_data, size);
-    if (0 != ret) {
-        p_channel->err_code = SALT_ERR_CRYPTO_API;
-        return SALT_ERROR_STATE;
-    }
+    SALT_PROBE3(crypto__end, p_channel, SALT_PROBE_CRYPTO_HASH, ret);
+    SALT_VERIFY_STATE(0 == ret, SALT_ERR_CRYPTO_API);
 
     return SALT_M2_INIT;
 
@@ -972,6 +1005,8 @@ salt_state_t salti_handle_m1(salt_channel_t *p_channel,
  * If time is supported, the time 1 (0x01, 0x00, 0x00, 0x00) is set in the
  * time data. Otherwise, it is set to 0x00 for all bytes.
  *
+ * If datagram mode was negotiated, SALT_M2_DGRAM_FLAG is set in header[1].
+ *
  */
 salt_state_t salti_create_m2(salt_channel_t *p_channel,
                              uint8_t *p_data,
@@ -1000,17 +1035,20 @@ salt_state_t salti_create_m2(salt_channel_t *p_channel,
         next_state = SALT_M2_IO;
     }
     else {
+        if ((NULL != p_channel->p_dgram) && p_channel->p_dgram->negotiated) {
+            p_data[SALT_M2_HEADER1_OFFSET] |= SALT_M2_DGRAM_FLAG;
+        }
+
         /* Copy ephemeral public key to M2 */
         memcpy(&p_data[SALT_M2_PUB_ENC_OFFSET],
                &p_channel->hdshk_buffer[SALT_PUB_ENC_OFFSET],
                api_crypto_box_PUBLICKEYBYTES);
 
+        SALT_PROBE2(crypto__start, p_channel, SALT_PROBE_CRYPTO_HASH);
         int ret = api_crypto_hash_sha512(p_hash, &p_data[SALT_LENGTH_SIZE], (*size));
+        SALT_PROBE3(crypto__end, p_channel, SALT_PROBE_CRYPTO_HASH, ret);
+        SALT_VERIFY_STATE(0 == ret, SALT_ERR_CRYPTO_API);
         next_state = SALT_M2_IO_AND_SESSION_KEY;
-        if (0 != ret) {
-            next_state = SALT_ERROR_STATE;
-            p_channel->err_code = SALT_ERR_CRYPTO_API;
-        }
     }
 
     salti_u32_to_bytes(&p_data[SALT_M2_SIZE_OFFSET], (*size));
@@ -1058,6 +1096,15 @@ salt_state_t salti_handle_m2(salt_channel_t *p_channel,
         return SALT_ERROR_STATE;
     }
 
+    /* The host may only accept datagram mode if we requested it. */
+    if ((SALT_M2_DGRAM_FLAG & p_data[1]) > 0U) {
+        if (NULL == p_channel->p_dgram) {
+            p_channel->err_code = SALT_ERR_BAD_PROTOCOL;
+            return SALT_ERROR_STATE;
+        }
+        p_channel->p_dgram->negotiated = true;
+    }
+
     uint32_t time = salti_bytes_to_u32(&p_data[2]);
 
     if (1U == time) {
@@ -1077,20 +1124,27 @@ salt_state_t salti_handle_m2(salt_channel_t *p_channel,
         return SALT_ERROR_STATE;
     }
 
-    int ret = api_crypto_box_beforenm(p_channel->ek_common,
-                                  &p_data[6],
-                                  &p_channel->hdshk_buffer[SALT_SEC_ENC_OFFSET]);
-    if (0 != ret) {
-        p_channel->err_code = SALT_ERR_CRYPTO_API;
-        return SALT_ERROR_STATE;
-    }
+    /*
+     * The M2 hash is computed before the session key so that a worker can
+     * sign M4 meanwhile. The hash may overwrite M2, so the public ephemeral
+     * key of the host is kept.
+     */
+    uint8_t peer_ek_pub[api_crypto_box_PUBLICKEYBYTES];
+    memcpy(peer_ek_pub, &p_data[6], sizeof(peer_ek_pub));
+
+    SALT_PROBE2(crypto__start, p_channel, SALT_PROBE_CRYPTO_HASH);
+    int ret = api_crypto_hash_sha512(p_hash, p_data, size);
+    SALT_PROBE3(crypto__end, p_channel, SALT_PROBE_CRYPTO_HASH, ret);
+    SALT_VERIFY_STATE(0 == ret, SALT_ERR_CRYPTO_API);
 
-    ret = api_crypto_hash_sha512(p_hash, p_data, size);
+    salti_start_m4_sig(p_channel);
 
-    if (0 != ret) {
-        p_channel->err_code = SALT_ERR_CRYPTO_API;
-        return SALT_ERROR_STATE;
-    }
+    SALT_PROBE2(crypto__start, p_channel, SALT_PROBE_CRYPTO_BEFORENM);
+    ret = api_crypto_box_beforenm(p_channel->ek_common,
+                                  peer_ek_pub,
+                                  &p_channel->hdshk_buffer[SALT_SEC_ENC_OFFSET]);
+    SALT_PROBE3(crypto__end, p_channel, SALT_PROBE_CRYPTO_BEFORENM, ret);
+    SALT_VERIFY_STATE(0 == ret, SALT_ERR_CRYPTO_API);
 
     return SALT_M3_INIT;
 }
@@ -1122,35 +1176,68 @@ salt_state_t salti_handle_m2(salt_channel_t *p_channel,
  * }
  *
  */
-salt_ret_t salti_create_m3m4_sig(salt_channel_t *p_channel,
-                                 uint8_t *p_data,
-                                 uint32_t *size)
+salt_ret_t salti_sign_m3m4(salt_channel_t *p_channel)
 {
+    uint8_t precomputed[api_crypto_sign_PRECOMPUTEDBYTES];
     int ret;
 
-    memcpy(p_data, p_channel->my_sk_pub, 32);
-
     if (SALT_SERVER == p_channel->mode) {
-        memcpy(&p_channel->hdshk_buffer[64], sig1prefix, 8);
+        memcpy(&p_channel->hdshk_buffer[SALT_SIG_PREFIX_OFFSET], sig1prefix, SALT_SIG_PREFIX_SIZE);
     }
     else {
-        memcpy(&p_channel->hdshk_buffer[64], sig2prefix, 8);
+        memcpy(&p_channel->hdshk_buffer[SALT_SIG_PREFIX_OFFSET], sig2prefix, SALT_SIG_PREFIX_SIZE);
     }
 
     /*
      * api_crypto_sign will sign a message { m[n] } into a signed message
      * { sign[64] , m[n] }. api_crypto_sign always returns 0.
      *
+     * If a signature pool is used and has a commitment ready, only the
+     * message dependent part of the signature is computed here.
      */
-    ret = api_crypto_sign(p_channel->hdshk_buffer,
-                          NULL,
-                          &p_channel->hdshk_buffer[64],
-                          SALT_M3M4_MSG_TO_SIG_SIZE,
-                          p_channel->my_sk_sec);
+    SALT_PROBE2(crypto__start, p_channel, SALT_PROBE_CRYPTO_SIGN);
+    if ((NULL != p_channel->p_sign_pool) &&
+        (salt_sign_pool_take(p_channel->p_sign_pool,
+                             p_channel->my_sk_pub,
+                             precomputed) == SALT_SUCCESS)) {
+        ret = api_crypto_sign_precomputed(p_channel->hdshk_buffer,
+                                          NULL,
+                                          &p_channel->hdshk_buffer[SALT_SIG_PREFIX_OFFSET],
+                                          SALT_M3M4_MSG_TO_SIG_SIZE,
+                                          p_channel->my_sk_sec,
+                                          precomputed);
+        memset(precomputed, 0x00U, sizeof(precomputed));
+    }
+    else {
+        ret = api_crypto_sign(p_channel->hdshk_buffer,
+                              NULL,
+                              &p_channel->hdshk_buffer[SALT_SIG_PREFIX_OFFSET],
+                              SALT_M3M4_MSG_TO_SIG_SIZE,
+                              p_channel->my_sk_sec);
+    }
+    SALT_PROBE3(crypto__end, p_channel, SALT_PROBE_CRYPTO_SIGN, ret);
 
     SALT_VERIFY(0 == ret, SALT_ERR_CRYPTO_API);
 
-    memcpy(&p_data[32], p_channel->hdshk_buffer, 64);
+    return SALT_SUCCESS;
+}
+
+/**
+ * @brief Creates the clear text M3 or M4.
+ *
+ * The signature is created by salti_sign_m3m4 and the clear text message
+ * { pubSigKey[32] , sig[64] } is put in p_data.
+ */
+salt_ret_t salti_create_m3m4_sig(salt_channel_t *p_channel,
+                                 uint8_t *p_data,
+                                 uint32_t *size)
+{
+    salt_ret_t ret = salti_sign_m3m4(p_channel);
+
+    SALT_VERIFY(SALT_SUCCESS == ret, p_channel->err_code);
+
+    memcpy(p_data, p_channel->my_sk_pub, api_crypto_sign_PUBLICKEYBYTES);
+    memcpy(&p_data[api_crypto_sign_PUBLICKEYBYTES], p_channel->hdshk_buffer, api_crypto_sign_BYTES);
 
     (*size) = SALT_M3M4_CLEAR_SIZE;
 
@@ -1176,28 +1263,18 @@ salt_ret_t salti_create_m3m4_sig(salt_channel_t *p_channel,
  * The signature starts in p_data[32] and is 64 bytes.
  * The public signing key of the peer starts in p_data and is 32 bytes.
  *
- * The message can't be verified on itselfs buffer.
- *
- * Procedure:
- *  1. Copy signature to hdshk_buffer
- *  2. Add sig prefix
+ * The signature is verified detached. The prefix is put in front of the
+ * hashes, and the signed message { sigPrefix[8] , m1hash[64] , m2hash[64] }
+ * is hashed where it is. Neither the signature nor the message is copied,
+ * and dummy[64], e.g., the signature of our own M4, is left untouched:
  *
  *  hdshk_buffer = {
- *      sig[64] ,
+ *      dummy[64] ,
  *      sigPrefix[8] ,
  *      m1hash[64] ,
  *      m2hash[64]
  *  }
  *
- *  3. Verify signature (open it) to hdshk_buffer[200]
- *  hdshk_buffer = {
- *      sig[64] ,
- *      sigPrefix[8] ,
- *      m1hash[64] ,
- *      m2hash[64] ,
- *      verifid[8 + 64 + 64]
- *  }
- *
  */
 salt_ret_t salti_verify_m3m4_sig(salt_channel_t *p_channel,
                                  uint8_t *p_data,
@@ -1206,22 +1283,120 @@ salt_ret_t salti_verify_m3m4_sig(salt_channel_t *p_channel,
 
     SALT_VERIFY(size == SALT_M3M4_CLEAR_SIZE, SALT_ERR_BAD_PROTOCOL);
 
-    memcpy(p_channel->peer_sk_pub, p_data, 32);
-    memcpy(p_channel->hdshk_buffer, &p_data[32], 64);
+    memcpy(p_channel->peer_sk_pub, p_data, api_crypto_sign_PUBLICKEYBYTES);
+
+    /* A rejected peer is not worth the signature verification. */
+    if (NULL != p_channel->peer_check) {
+        SALT_VERIFY(SALT_SUCCESS == p_channel->peer_check(p_channel->p_peer_check_context,
+                                                          p_channel->peer_sk_pub),
+                    SALT_ERR_BAD_PEER);
+    }
 
     if (p_channel->mode == SALT_SERVER) {
-        memcpy(&p_channel->hdshk_buffer[64], sig2prefix, 8);
+        memcpy(&p_channel->hdshk_buffer[SALT_SIG_PREFIX_OFFSET], sig2prefix, SALT_SIG_PREFIX_SIZE);
     }
     else {
-        memcpy(&p_channel->hdshk_buffer[64], sig1prefix, 8);
+        memcpy(&p_channel->hdshk_buffer[SALT_SIG_PREFIX_OFFSET], sig1prefix, SALT_SIG_PREFIX_SIZE);
     }
 
-    int ret = api_crypto_sign_open(&p_channel->hdshk_buffer[SALT_M3M4_SIG_VERIFY_OFFSET],
-                                   NULL,
-                                   p_channel->hdshk_buffer,
-                                   SALT_M3M4_SIGNED_MSG_SIZE,
-                                   p_channel->peer_sk_pub);
+    SALT_PROBE2(crypto__start, p_channel, SALT_PROBE_CRYPTO_SIGN_OPEN);
+    int ret = api_crypto_sign_verify_detached(&p_data[api_crypto_sign_PUBLICKEYBYTES],
+                                              &p_channel->hdshk_buffer[SALT_SIG_PREFIX_OFFSET],
+                                              SALT_M3M4_MSG_TO_SIG_SIZE,
+                                              p_channel->peer_sk_pub);
+    SALT_PROBE3(crypto__end, p_channel, SALT_PROBE_CRYPTO_SIGN_OPEN, ret);
     SALT_VERIFY(ret == 0, SALT_ERR_BAD_PEER);
 
     return SALT_SUCCESS;
 }
+
+/**
+ * @brief Starts the M4 signature on the worker, if any.
+ *
+ * The message to sign is copied to the worker buffer, so the task never
+ * accesses the handshake buffer:
+ *
+ * sign_buffer = {
+ *  reservedForSignature[64] ,
+ *  sig2Prefix[8] ,
+ *  m1hash[64] ,
+ *  m2hash[64]
+ * }
+ *
+ * If the task can not be started, the signature is created as usual in
+ * SALT_M3_INIT.
+ */
+static void salti_start_m4_sig(salt_channel_t *p_channel)
+{
+    salt_worker_t *p_worker = p_channel->p_worker;
+
+    if (NULL == p_worker) {
+        return;
+    }
+
+    memcpy(&p_worker->sign_buffer[api_crypto_sign_BYTES], sig2prefix, 8);
+    memcpy(&p_worker->sign_buffer[api_crypto_sign_BYTES + 8],
+           &p_channel->hdshk_buffer[SALT_M1_HASH_OFFSET],
+           SALT_M3M4_MSG_TO_SIG_SIZE - 8);
+
+    p_worker->use_precomputed = (NULL != p_channel->p_sign_pool) &&
+        (salt_sign_pool_take(p_channel->p_sign_pool,
+                             p_channel->my_sk_pub,
+                             p_worker->precomputed) == SALT_SUCCESS);
+    p_worker->result = -1;
+    p_worker->started = (p_worker->start(p_worker, salti_m4_sig_task, p_channel) == SALT_SUCCESS);
+
+    if (!p_worker->started) {
+        memset(p_worker->precomputed, 0x00U, sizeof(p_worker->precomputed));
+    }
+}
+
+/**
+ * @brief Creates the M4 signature, run by the worker.
+ *
+ * Only reads the signature key of the channel and only writes to the worker.
+ */
+static void salti_m4_sig_task(void *p_arg)
+{
+    salt_channel_t *p_channel = (salt_channel_t *) p_arg;
+    salt_worker_t *p_worker = p_channel->p_worker;
+
+    if (p_worker->use_precomputed) {
+        p_worker->result = api_crypto_sign_precomputed(p_worker->sign_buffer,
+                                                       NULL,
+                                                       &p_worker->sign_buffer[api_crypto_sign_BYTES],
+                                                       SALT_M3M4_MSG_TO_SIG_SIZE,
+                                                       p_channel->my_sk_sec,
+                                                       p_worker->precomputed);
+    }
+    else {
+        p_worker->result = api_crypto_sign(p_worker->sign_buffer,
+                                           NULL,
+                                           &p_worker->sign_buffer[api_crypto_sign_BYTES],
+                                           SALT_M3M4_MSG_TO_SIG_SIZE,
+                                           p_channel->my_sk_sec);
+    }
+}
+
+/**
+ * @brief Waits for the M4 signature of the worker.
+ *
+ * The signature is put in hdshk_buffer[0:63], as done by salti_sign_m3m4.
+ */
+static salt_ret_t salti_join_m4_sig(salt_channel_t *p_channel)
+{
+    salt_worker_t *p_worker = p_channel->p_worker;
+
+    if (p_worker->poll(p_worker) != SALT_SUCCESS) {
+        return SALT_PENDING;
+    }
+
+    p_worker->started = false;
+    memset(p_worker->precomputed, 0x00U, sizeof(p_worker->precomputed));
+    SALT_VERIFY(0 == p_worker->result, SALT_ERR_CRYPTO_API);
+
+    memcpy(p_channel->hdshk_buffer, p_worker->sign_buffer, api_crypto_sign_BYTES);
+    memset(p_worker->sign_buffer, 0x00U, sizeof(p_worker->sign_buffer));
+
+    return SALT_SUCCESS;
+}
@@ -23,6 +23,33 @@ extern "C" {
 
 #define SALT_NO_SUCH_SERVER_FLAG             (0x01U)
 
+/*
+ * Layout of the handshake buffer, shared with the handshake phase benchmark.
+ * The hashes of M1 and M2 follow the ephemeral keypair and the signature
+ * prefix, and the messages are read, written and wrapped after them.
+ */
+#define SALT_PUB_ENC_OFFSET                     (0U)
+#define SALT_SEC_ENC_OFFSET                     (32U)
+#define SALT_SIG_PREFIX_OFFSET                  (64U)
+#define SALT_SIG_PREFIX_SIZE                    (8U)
+#define SALT_M1_HASH_OFFSET                     (72U)
+#define SALT_M2_HASH_OFFSET                     (136U)
+
+#define SALT_M2_HOST_OFFSET                     (200U)
+#define SALT_HOST_TMP_PEER_EK_PUB_OFFSET        (242U)
+
+#define SALT_M3M4_WRAPPED_SIZE                  (120U)
+#define SALT_M3M4_CLEAR_SIZE                    (96U)
+#define SALT_M3_HOST_CLEAR_OFFSET               (238U)
+#define SALT_M3_HOST_WRAPPED_OFFSET             (SALT_M3_HOST_CLEAR_OFFSET - SALT_WRAP_OVERHEAD_SIZE)
+#define SALT_M3_CLIENT_IO_WRAPPED_OFFSET        (214U)
+#define SALT_M3_CLIENT_WRAPPED_OFFSET           (200U)
+
+#define SALT_M4_HOST_IO_WRAPPED_OFFSET          (214U)
+#define SALT_M4_HOST_WRAPPED_OFFSET             (200U)
+#define SALT_M4_CLIENT_CLEAR_OFFSET             (238U)
+#define SALT_M4_CLIENT_IO_WRAPPED_OFFSET        (SALT_M4_CLIENT_CLEAR_OFFSET - SALT_WRAP_OVERHEAD_SIZE)
+
 /*======= Type Definitions and declarations =================================*/
 /*======= Public function declarations ======================================*/
 
@@ -55,6 +82,8 @@ salt_state_t salti_handle_m2(salt_channel_t *p_channel,
                              uint32_t size,
                              uint8_t *p_hash);
 
+salt_ret_t salti_sign_m3m4(salt_channel_t *p_channel);
+
 salt_ret_t salti_create_m3m4_sig(salt_channel_t *p_channel,
                                  uint8_t *p_data,
                                  uint32_t *size);
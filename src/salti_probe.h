@@ -0,0 +1,88 @@
+#ifndef _SALTI_PROBE_H_
+#define _SALTI_PROBE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file salti_probe.h
+ *
+ * USDT (user statically defined tracing) probes used by salt-channel. Not
+ * intended to use directly.
+ *
+ * The probes are compiled in if SALT_USDT is defined, see the SALT_USDT
+ * option in CMakeLists.txt. Each probe is then a single nop instruction and
+ * an ELF note, which the tracer replaces with a breakpoint when attached. The
+ * arguments are only values already at hand, so no extra work is done when no
+ * tracer is attached. Without SALT_USDT the probes are removed completely.
+ *
+ * All probes are in the provider "salt" and has the channel pointer as first
+ * argument:
+ *
+ *  handshake__state    (p_channel, old_state, new_state)
+ *  crypto__start       (p_channel, op)
+ *  crypto__end         (p_channel, op, ret)
+ *  record__wrap        (p_channel, clear_size, wrapped_size)
+ *  record__unwrap      (p_channel, wrapped_size, clear_size)
+ *  error               (p_channel, salt_err_t, line)
+ *
+ * handshake__state only fires when the state was changed.
+ *
+ * Example usage:
+ *  bpftrace -e 'usdt:./host_echo:salt:record__wrap { @[arg1] = count(); }'
+ *
+ */
+
+/*======= Includes ==========================================================*/
+
+#ifdef SALT_USDT
+#include <sys/sdt.h>
+#endif
+
+/*======= Public macro definitions ==========================================*/
+
+/* Crypto operations, argument op of crypto__start and crypto__end. */
+#define SALT_PROBE_CRYPTO_BOX_KEYPAIR           (1U)
+#define SALT_PROBE_CRYPTO_BEFORENM              (2U)
+#define SALT_PROBE_CRYPTO_SIGN                  (3U)
+#define SALT_PROBE_CRYPTO_SIGN_OPEN             (4U)
+#define SALT_PROBE_CRYPTO_HASH                  (5U)
+
+#ifdef SALT_USDT
+#define SALT_PROBE2(name, a, b)                                             \
+    DTRACE_PROBE2(salt, name, a, b)
+#define SALT_PROBE3(name, a, b, c)                                          \
+    DTRACE_PROBE3(salt, name, a, b, c)
+#define SALT_PROBE_STATE(p_channel, old_state)                              \
+    do {                                                                    \
+        if ((old_state) != (p_channel)->state) {                            \
+            DTRACE_PROBE3(salt, handshake__state, p_channel,                \
+                          old_state, (p_channel)->state);                   \
+        }                                                                   \
+    } while (0)
+#else
+/* The arguments are not evaluated, only referenced to avoid unused warnings. */
+#define SALT_PROBE2(name, a, b)                                             \
+    do {                                                                    \
+        (void) sizeof(a);                                                   \
+        (void) sizeof(b);                                                   \
+    } while (0)
+#define SALT_PROBE3(name, a, b, c)                                          \
+    do {                                                                    \
+        (void) sizeof(a);                                                   \
+        (void) sizeof(b);                                                   \
+        (void) sizeof(c);                                                   \
+    } while (0)
+#define SALT_PROBE_STATE(p_channel, old_state)                              \
+    SALT_PROBE2(handshake__state, p_channel, old_state)
+#endif
+
+/*======= Type Definitions and declarations =================================*/
+/*======= Public function declarations ======================================*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SALTI_PROBE_H_ */
@@ -18,8 +18,27 @@
 
 #define SALT_NONCE_INCR     (2U)
 
+/*
+ * Datagram nonces has the highest bit of the last nonce byte set. The stream
+ * nonces never reaches this bit, hence the nonces never collide.
+ */
+#define SALT_DGRAM_NONCE_FLAG       (0x80U)
+#define SALT_DGRAM_MAX_RECORD       ((UINT64_MAX / 2U) - 1U)
+
 /*======= Type Definitions ==================================================*/
 /*======= Local function prototypes =========================================*/
+
+static salt_ret_t salti_wrap_finish(salt_channel_t *p_channel,
+                                    uint8_t *p_data,
+                                    uint32_t size,
+                                    uint8_t **wrapped,
+                                    uint32_t *wrapped_length,
+                                    bool last_msg);
+static void salti_dgram_nonce(salt_channel_t *p_channel,
+                              uint8_t *p_nonce,
+                              uint64_t record,
+                              bool write);
+
 /*======= Local variable declarations =======================================*/
 /*======= Global function implementations ===================================*/
 
@@ -73,7 +92,7 @@ salt_ret_t salti_io_read(salt_channel_t *p_channel,
 
             if (channel->size_expected > channel->max_size) {
               p_channel->err_code = SALT_ERR_BUFF_TO_SMALL;
-              p_channel->state = SALT_SESSION_CLOSED;
+              salti_session_close(p_channel);
               ret_code = SALT_ERROR;
               *size = 0;
               break;
@@ -239,25 +258,60 @@ salt_ret_t salti_wrap(salt_channel_t *p_channel,
 
     SALT_VERIFY(0 == ret, SALT_ERR_ENCRYPTION);
 
-    SALT_VERIFY(salti_increase_nonce(p_channel->write_nonce) == SALT_SUCCESS,
-        SALT_ERR_NONCE_WRAPPED);
+    return salti_wrap_finish(p_channel, p_data, size, wrapped, wrapped_length, last_msg);
 
-    p_data[14] = SALT_ENCRYPTED_MSG_HEADER_VALUE;
-    p_data[15] = (last_msg) ? SALT_LAST_FLAG : 0x00U;
+}
 
-    /*
-     * size is of cleartext message, with time[4], header[2], MAC[16] and header[2] the size if 24 bytes larger.
-     */
-    salti_u32_to_bytes(&p_data[10], size + SALT_WRAP_OVERHEAD_IO_SIZE);
+/**
+ * @brief Encrypts and wraps clear text data to another buffer.
+ *
+ * Same as \ref salti_wrap, but the clear text is read from p_data and is not
+ * modified, and the record is created in p_out. Used when the same clear text
+ * is wrapped for several sessions.
+ *
+ * @param p_channel         Pointer to salt channel structure.
+ * @param p_out             Pointer to output buffer, SALT_OVERHEAD_SIZE + size bytes.
+ * @param p_data            Pointer to clear text message.
+ * @param size              Size of clear text message.
+ * @param header            Type of message.
+ * @param wrapped           Return pointer to where the raw message to send begins.
+ * @param wrapped_length    Return length of raw wrapped message.
+ * @param last_msg          Last message flag.
+ *
+ * @return SALT_SUCCESS Wrapping was successfull.
+ * @return SALT_ERROR   Wrapping failed.
+ */
+salt_ret_t salti_wrap_to(salt_channel_t *p_channel,
+                         uint8_t *p_out,
+                         const uint8_t *p_data,
+                         uint32_t size,
+                         uint8_t header,
+                         uint8_t **wrapped,
+                         uint32_t *wrapped_length,
+                         bool last_msg)
+{
+    uint8_t head[SALT_WRAP_OVERHEAD_SIZE - api_crypto_box_ZEROBYTES];
+    uint32_t time = 0;
+    int ret;
 
-    /*
-     * The 4 size bytes are serialized. The size to send is 4 bytes more.
-     */
-    *wrapped = &p_data[10];
-    *wrapped_length = size + SALT_WRAP_OVERHEAD_IO_SIZE + SALT_LENGTH_SIZE;
+    head[0] = header;
+    head[1] = 0x00;
 
-    return SALT_SUCCESS;
+    salti_get_time(p_channel, &time);
+    time -= p_channel->my_epoch;
+    salti_u32_to_bytes(&head[2], time);
+
+    ret = api_crypto_box_afternm_parts(p_out,
+                                       head,
+                                       sizeof(head),
+                                       p_data,
+                                       size,
+                                       p_channel->write_nonce,
+                                       p_channel->ek_common);
 
+    SALT_VERIFY(0 == ret, SALT_ERR_ENCRYPTION);
+
+    return salti_wrap_finish(p_channel, p_out, size, wrapped, wrapped_length, last_msg);
 }
 
 /**
@@ -302,7 +356,7 @@ salt_ret_t salti_unwrap(salt_channel_t *p_channel,
                 SALT_ERR_BAD_PROTOCOL);
 
     if ((p_data[15] & SALT_LAST_FLAG) > 0U) {
-        p_channel->state = SALT_SESSION_CLOSED;
+        salti_session_close(p_channel);
     }
 
     SALT_VERIFY(size >= SALT_WRAP_OVERHEAD_IO_SIZE, SALT_ERR_BAD_PROTOCOL);
@@ -362,10 +416,180 @@ salt_ret_t salti_unwrap(salt_channel_t *p_channel,
      */
     (*unwrapped_length) = size - SALT_WRAP_OVERHEAD_IO_SIZE;
 
+    SALT_PROBE3(record__unwrap, p_channel, size, *unwrapped_length);
+
     return SALT_SUCCESS;
 
 }
 
+/**
+ * @brief Encrypts and wraps a datagram record.
+ *
+ * The clear text message must start at p_data[SALT_DGRAM_OVERHEAD_SIZE]. The
+ * message is encrypted with a nonce derived from the record number:
+ *
+ * toEncrypt = {
+ *      zeroPadded[api_crypto_box_ZEROBYTES] ,
+ *      time[4] ,
+ *      msg[n]
+ * }
+ *
+ * After the encryption the header is put before the cipher text:
+ *
+ * wrapped = {
+ *      zeroPadded[6] ,
+ *      header[2] ,         // SALT_DGRAM_HEADER_VALUE, 0x00
+ *      record[8] ,
+ *      cipher[api_crypto_box_BOXZEROBYTES + 4 + n]
+ * }
+ *
+ * The datagram to send begins at p_data[SALT_DGRAM_WIRE_OFFSET] with the length
+ * n + SALT_DGRAM_OVERHEAD_SIZE - SALT_DGRAM_WIRE_OFFSET.
+ *
+ * @param p_channel         Pointer to salt channel structure.
+ * @param p_data            Pointer to buffer with clear text message.
+ * @param size              Size of clear text message.
+ * @param wrapped           Return pointer to where the datagram begins.
+ * @param wrapped_length    Return length of datagram.
+ *
+ * @return SALT_SUCCESS Wrapping was successfull.
+ * @return SALT_ERROR   Wrapping failed or the record number wrapped.
+ */
+salt_ret_t salti_dgram_wrap(salt_channel_t *p_channel,
+                            uint8_t *p_data,
+                            uint32_t size,
+                            uint8_t **wrapped,
+                            uint32_t *wrapped_length)
+{
+    uint8_t nonce[api_crypto_box_NONCEBYTES];
+    uint64_t record = p_channel->p_dgram->write_record;
+    uint32_t time = 0;
+    int ret;
+
+    SALT_VERIFY(record <= SALT_DGRAM_MAX_RECORD, SALT_ERR_NONCE_WRAPPED);
+
+    memset(p_data, 0x00, api_crypto_box_ZEROBYTES);
+    salti_get_time(p_channel, &time);
+    time -= p_channel->my_epoch;
+    salti_u32_to_bytes(&p_data[api_crypto_box_ZEROBYTES], time);
+
+    salti_dgram_nonce(p_channel, nonce, record, true);
+    ret = api_crypto_box_afternm(p_data,
+                                 p_data,
+                                 size + SALT_DGRAM_OVERHEAD_SIZE,
+                                 nonce,
+                                 p_channel->ek_common);
+
+    SALT_VERIFY(0 == ret, SALT_ERR_ENCRYPTION);
+
+    p_channel->p_dgram->write_record++;
+
+    p_data[SALT_DGRAM_WIRE_OFFSET] = SALT_DGRAM_HEADER_VALUE;
+    p_data[SALT_DGRAM_WIRE_OFFSET + 1U] = 0x00U;
+    salti_u32_to_bytes(&p_data[SALT_DGRAM_WIRE_OFFSET + 2U], (uint32_t) record);
+    salti_u32_to_bytes(&p_data[SALT_DGRAM_WIRE_OFFSET + 6U], (uint32_t) (record >> 32U));
+
+    *wrapped = &p_data[SALT_DGRAM_WIRE_OFFSET];
+    *wrapped_length = size + SALT_DGRAM_OVERHEAD_SIZE - SALT_DGRAM_WIRE_OFFSET;
+
+    SALT_PROBE3(record__wrap, p_channel, size, *wrapped_length);
+
+    return SALT_SUCCESS;
+}
+
+/**
+ * @brief Unwraps and decrypts a datagram record.
+ *
+ * The datagram must be read to p_data[SALT_DGRAM_WIRE_OFFSET], see
+ * \ref salti_dgram_wrap. The record number is checked against the replay window
+ * before the record is decrypted, and the window is updated only if the
+ * record was authenticated.
+ *
+ * A record that is not accepted must be dropped without closing the session,
+ * since anyone can send a datagram. Hence, this function never closes the
+ * session.
+ *
+ * @param p_channel         Pointer to salt channel structure.
+ * @param p_data            Pointer to buffer with datagram.
+ * @param size              Size of datagram.
+ * @param unwrapped         Return pointer to clear text message.
+ * @param unwrapped_length  Return length of clear text message.
+ *
+ * @return SALT_SUCCESS The record was accepted.
+ * @return SALT_ERROR   The record must be dropped.
+ */
+salt_ret_t salti_dgram_unwrap(salt_channel_t *p_channel,
+                              uint8_t *p_data,
+                              uint32_t size,
+                              uint8_t **unwrapped,
+                              uint32_t *unwrapped_length)
+{
+    salt_dgram_t *p_dgram = p_channel->p_dgram;
+    uint8_t nonce[api_crypto_box_NONCEBYTES];
+    uint64_t record;
+    uint64_t age = 0;
+
+    if ((size < (SALT_DGRAM_OVERHEAD_SIZE - SALT_DGRAM_WIRE_OFFSET)) ||
+        (SALT_DGRAM_HEADER_VALUE != p_data[SALT_DGRAM_WIRE_OFFSET]) ||
+        (0x00U != p_data[SALT_DGRAM_WIRE_OFFSET + 1U])) {
+        return SALT_ERROR;
+    }
+
+    record = (uint64_t) salti_bytes_to_u32(&p_data[SALT_DGRAM_WIRE_OFFSET + 6U]);
+    record = (record << 32U) | salti_bytes_to_u32(&p_data[SALT_DGRAM_WIRE_OFFSET + 2U]);
+
+    if (record > SALT_DGRAM_MAX_RECORD) {
+        return SALT_ERROR;
+    }
+
+    /* Replayed or too old record. */
+    if (record < p_dgram->read_top) {
+        age = p_dgram->read_top - 1U - record;
+        if ((age >= SALT_DGRAM_WINDOW_SIZE) ||
+            ((p_dgram->read_window & ((uint64_t) 1U << age)) > 0U)) {
+            return SALT_ERROR;
+        }
+    }
+
+    memset(p_data, 0x00U, api_crypto_box_BOXZEROBYTES);
+    salti_dgram_nonce(p_channel, nonce, record, false);
+    if (api_crypto_box_open_afternm(p_data,
+                                    p_data,
+                                    size + api_crypto_box_BOXZEROBYTES - SALT_DGRAM_HEADER_SIZE,
+                                    nonce,
+                                    p_channel->ek_common) != 0) {
+        return SALT_ERROR;
+    }
+
+    if ((p_channel->time_supported) && (p_channel->delay_threshold > 0)) {
+        uint32_t t_package = salti_bytes_to_u32(&p_data[api_crypto_box_ZEROBYTES]);
+        uint32_t t_arrival = 0;
+        if ((t_package > INT32_MAX) ||
+            (salti_get_time(p_channel, &t_arrival) != SALT_SUCCESS) ||
+            !time_check(p_channel->peer_epoch, t_arrival, t_package, p_channel->delay_threshold)) {
+            return SALT_ERROR;
+        }
+    }
+
+    /* The record is authenticated, update the window. */
+    if (record >= p_dgram->read_top) {
+        uint64_t shift = record + 1U - p_dgram->read_top;
+        p_dgram->read_window = (shift >= SALT_DGRAM_WINDOW_SIZE) ? 0U : p_dgram->read_window << shift;
+        p_dgram->read_window |= 1U;
+        p_dgram->read_top = record + 1U;
+    }
+    else {
+        p_dgram->read_window |= ((uint64_t) 1U << age);
+    }
+
+    (*unwrapped) = &p_data[SALT_DGRAM_OVERHEAD_SIZE];
+    (*unwrapped_length) = size + SALT_DGRAM_WIRE_OFFSET - SALT_DGRAM_OVERHEAD_SIZE;
+
+    SALT_PROBE3(record__unwrap, p_channel, size, *unwrapped_length);
+
+    return SALT_SUCCESS;
+}
+
 salt_ret_t salti_increase_nonce(uint8_t *p_nonce)
 {
     /* Thanks to Libsodium */
@@ -412,6 +636,39 @@ uint32_t salti_bytes_to_u32(uint8_t *src)
            );
 }
 
+uint64_t salti_key_hash(uint64_t seed, const uint64_t *p_words, uint32_t count)
+{
+    uint64_t hash = seed;
+
+    for (uint32_t i = 0; i < count; i++) {
+        hash ^= p_words[i];
+        hash *= 0x9E3779B97F4A7C15ULL;
+        hash ^= hash >> 29;
+    }
+
+    return hash;
+}
+
+void salti_session_established(salt_channel_t *p_channel)
+{
+    p_channel->state = SALT_SESSION_ESTABLISHED;
+
+    if (NULL != p_channel->session_hook) {
+        p_channel->session_hook(p_channel->p_session_context, p_channel, true);
+    }
+}
+
+void salti_session_close(salt_channel_t *p_channel)
+{
+    bool established = (SALT_SESSION_ESTABLISHED == p_channel->state);
+
+    p_channel->state = SALT_SESSION_CLOSED;
+
+    if (established && (NULL != p_channel->session_hook)) {
+        p_channel->session_hook(p_channel->p_session_context, p_channel, false);
+    }
+}
+
 salt_ret_t salti_get_time(salt_channel_t *p_channel, uint32_t *p_time)
 {
     salt_ret_t ret = SALT_ERROR;
@@ -630,3 +887,59 @@ char *salt_mode2str(salt_mode_t mode)
 }
 
 /*======= Local function implementations ====================================*/
+
+/**
+ * @brief Adds the record header and size to an encrypted record.
+ */
+static salt_ret_t salti_wrap_finish(salt_channel_t *p_channel,
+                                    uint8_t *p_data,
+                                    uint32_t size,
+                                    uint8_t **wrapped,
+                                    uint32_t *wrapped_length,
+                                    bool last_msg)
+{
+    SALT_VERIFY(salti_increase_nonce(p_channel->write_nonce) == SALT_SUCCESS,
+        SALT_ERR_NONCE_WRAPPED);
+
+    p_data[14] = SALT_ENCRYPTED_MSG_HEADER_VALUE;
+    p_data[15] = (last_msg) ? SALT_LAST_FLAG : 0x00U;
+
+    /*
+     * size is of cleartext message, with time[4], header[2], MAC[16] and header[2] the size if 24 bytes larger.
+     */
+    salti_u32_to_bytes(&p_data[10], size + SALT_WRAP_OVERHEAD_IO_SIZE);
+
+    /*
+     * The 4 size bytes are serialized. The size to send is 4 bytes more.
+     */
+    *wrapped = &p_data[10];
+    *wrapped_length = size + SALT_WRAP_OVERHEAD_IO_SIZE + SALT_LENGTH_SIZE;
+
+    SALT_PROBE3(record__wrap, p_channel, size, *wrapped_length);
+
+    return SALT_SUCCESS;
+}
+
+/**
+ * @brief Derives the nonce of a datagram record.
+ *
+ * As for the stream nonces, the client uses odd and the host even nonces:
+ *
+ * nonce = { le64(2 * record + first)[8] , zero[15] , SALT_DGRAM_NONCE_FLAG }
+ *
+ * Where first is 1 for records written by the client and 2 for records written
+ * by the host.
+ */
+static void salti_dgram_nonce(salt_channel_t *p_channel,
+                              uint8_t *p_nonce,
+                              uint64_t record,
+                              bool write)
+{
+    bool client = (SALT_CLIENT == p_channel->mode);
+    uint64_t value = (2U * record) + ((client == write) ? 1U : 2U);
+
+    memset(p_nonce, 0x00U, api_crypto_box_NONCEBYTES);
+    salti_u32_to_bytes(p_nonce, (uint32_t) value);
+    salti_u32_to_bytes(&p_nonce[4], (uint32_t) (value >> 32U));
+    p_nonce[api_crypto_box_NONCEBYTES - 1U] = SALT_DGRAM_NONCE_FLAG;
+}
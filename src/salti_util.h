@@ -17,6 +17,7 @@ extern "C" {
 
 /* Salt library includes */
 #include "salt.h"
+#include "salti_probe.h"
 
 /*======= Public macro definitions ==========================================*/
 
@@ -49,11 +50,20 @@ extern "C" {
 #define SALT_TIME_SIZE                          (4U)
 #define SALT_ENCRYPTED_MSG_HEADER_VALUE         (0x06U)
 
+/* Datagram record */
+#define SALT_DGRAM_HEADER_VALUE                 (0x0CU)
+#define SALT_DGRAM_HEADER_SIZE                  (10U)
+#define SALT_DGRAM_WIRE_OFFSET                  (6U)
+#define SALT_DGRAM_WINDOW_SIZE                  (64U)
+
 /**
  * SALT_VERIFY is only and MUST only used internal by the implementation.
  * x is a condition, if it is not true SALT_ERROR will be returned
  * by the function using the macro. The pointer to the channel structure,
  * p_channel must have exactly the name p_channel.
+ *
+ * SALT_VERIFY_STATE is the same for handshake functions that return the next
+ * state, SALT_ERROR_STATE is returned and the caller closes the session.
  */
 #ifdef SALT_DEBUG
 #include <stdio.h>
@@ -61,23 +71,45 @@ extern "C" {
         do {                                                                \
             if (!(x)) {                                                     \
                 p_channel->err_code = error_code;                           \
+                SALT_PROBE3(error, p_channel, p_channel->err_code, __LINE__);\
                 printf(                                                     \
                     "Runtime error (%s, %s): %s at %s:%d, %s.\r\n",         \
                     #error_code, salt_mode2str(p_channel->mode), #x,        \
                     __FILE__, __LINE__, __func__);                          \
-                p_channel->state = SALT_SESSION_CLOSED;                     \
+                salti_session_close(p_channel);                             \
                 return SALT_ERROR;                                          \
             }                                                               \
         } while (0)
+#define SALT_VERIFY_STATE(x, error_code)                                    \
+        do {                                                                \
+            if (!(x)) {                                                     \
+                p_channel->err_code = error_code;                           \
+                SALT_PROBE3(error, p_channel, p_channel->err_code, __LINE__);\
+                printf(                                                     \
+                    "Runtime error (%s, %s): %s at %s:%d, %s.\r\n",         \
+                    #error_code, salt_mode2str(p_channel->mode), #x,        \
+                    __FILE__, __LINE__, __func__);                          \
+                return SALT_ERROR_STATE;                                    \
+            }                                                               \
+        } while (0)
 #else
 #define SALT_VERIFY(x, error_code)                                          \
         do {                                                                \
             if (!(x)) {                                                     \
                 p_channel->err_code = error_code;                           \
-                p_channel->state = SALT_SESSION_CLOSED;                     \
+                SALT_PROBE3(error, p_channel, p_channel->err_code, __LINE__);\
+                salti_session_close(p_channel);                             \
                 return SALT_ERROR;                                          \
             }                                                               \
         } while (0)
+#define SALT_VERIFY_STATE(x, error_code)                                    \
+        do {                                                                \
+            if (!(x)) {                                                     \
+                p_channel->err_code = error_code;                           \
+                SALT_PROBE3(error, p_channel, p_channel->err_code, __LINE__);\
+                return SALT_ERROR_STATE;                                    \
+            }                                                               \
+        } while (0)
 #endif
 
 #define SALT_VERIFY_NOT_NULL(x)                                             \
@@ -123,6 +155,15 @@ salt_ret_t salti_wrap(salt_channel_t *p_channel,
                       uint32_t *wrapped_length,
                       bool last_msg);
 
+salt_ret_t salti_wrap_to(salt_channel_t *p_channel,
+                         uint8_t *p_out,
+                         const uint8_t *p_data,
+                         uint32_t size,
+                         uint8_t header,
+                         uint8_t **wrapped,
+                         uint32_t *wrapped_length,
+                         bool last_msg);
+
 salt_ret_t salti_unwrap(salt_channel_t *p_channel,
                         uint8_t *p_data,
                         uint32_t size,
@@ -130,6 +171,18 @@ salt_ret_t salti_unwrap(salt_channel_t *p_channel,
                         uint8_t **unwrapped,
                         uint32_t *unwrapped_length);
 
+salt_ret_t salti_dgram_wrap(salt_channel_t *p_channel,
+                            uint8_t *p_data,
+                            uint32_t size,
+                            uint8_t **wrapped,
+                            uint32_t *wrapped_length);
+
+salt_ret_t salti_dgram_unwrap(salt_channel_t *p_channel,
+                              uint8_t *p_data,
+                              uint32_t size,
+                              uint8_t **unwrapped,
+                              uint32_t *unwrapped_length);
+
 salt_ret_t salti_increase_nonce(uint8_t *p_nonce);
 
 void salti_u16_to_bytes(uint8_t *dest, uint16_t size);
@@ -140,8 +193,34 @@ void salti_u32_to_bytes(uint8_t *dest, uint32_t size);
 
 uint32_t salti_bytes_to_u32(uint8_t *src);
 
+/**
+ * @brief Seeded hash of a key, used by the session lookup tables.
+ *
+ * Each word is mixed into the hash, the caller finishes it as needed.
+ *
+ * @param seed      Random seed of the table.
+ * @param p_words   Key as 64-bit words.
+ * @param count     Number of words.
+ * @return The mixed hash.
+ */
+uint64_t salti_key_hash(uint64_t seed, const uint64_t *p_words, uint32_t count);
+
 salt_ret_t salti_get_time(salt_channel_t *p_channel, uint32_t *p_time);
 
+/**
+ * @brief Marks the session established and calls the session hook.
+ *
+ * @param p_channel Pointer to channel handle.
+ */
+void salti_session_established(salt_channel_t *p_channel);
+
+/**
+ * @brief Closes the session, the session hook is called if it was established.
+ *
+ * @param p_channel Pointer to channel handle.
+ */
+void salti_session_close(salt_channel_t *p_channel);
+
 salt_err_t salt_read_init(uint8_t type,
                           uint8_t *p_buffer,
                           uint32_t buffer_size,
@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "cfifo.h"
+#include "salt.h"
+#include "salt_bond.h"
+#include "salti_util.h"
+#include "salt_mock.h"
+#include "test_data.h"
+
+#define BOND_PATHS      (3U)
+#define BOND_BUF_SIZE   (512U)
+
+typedef struct bond_test_s {
+    salt_mock_t         *mocks[BOND_PATHS];
+    salt_bond_t         client_bond;
+    salt_bond_path_t    client_paths[BOND_PATHS];
+    uint8_t             client_rx[BOND_PATHS][BOND_BUF_SIZE];
+    uint8_t             client_tx[BOND_PATHS][BOND_BUF_SIZE];
+    salt_bond_t         host_bond;
+    salt_bond_path_t    host_paths[BOND_PATHS];
+    uint8_t             host_rx[BOND_PATHS][BOND_BUF_SIZE];
+    uint8_t             host_tx[BOND_PATHS][BOND_BUF_SIZE];
+} bond_test_t;
+
+static const uint8_t bond_id[SALT_BOND_ID_SIZE] = {
+    0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08
+};
+
+static int setup(void **state) {
+    bond_test_t *test = malloc(sizeof(bond_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    salt_mocks_create_established(test->mocks, BOND_PATHS);
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    bond_test_t *test = (bond_test_t *) *state;
+    salt_mocks_delete(test->mocks, BOND_PATHS);
+    free(test);
+    return 0;
+}
+
+static void bond_create(bond_test_t *test)
+{
+    uint8_t accepted_id[SALT_BOND_ID_SIZE];
+    uint8_t count;
+    salt_ret_t ret;
+
+    assert_true(salt_bond_init(&test->client_bond, test->client_paths, BOND_PATHS, bond_id) == SALT_SUCCESS);
+    for (uint32_t i = 0; i < BOND_PATHS; i++) {
+        assert_true(salt_bond_add(&test->client_bond,
+                                  test->mocks[i]->client_channel,
+                                  test->client_rx[i], BOND_BUF_SIZE,
+                                  test->client_tx[i], BOND_BUF_SIZE) == SALT_SUCCESS);
+    }
+    assert_true(salt_bond_join(&test->client_bond) == SALT_SUCCESS);
+
+    for (uint32_t i = 0; i < BOND_PATHS; i++) {
+        ret = salt_bond_accept(test->mocks[i]->host_channel,
+                               test->host_rx[i], BOND_BUF_SIZE,
+                               accepted_id, &count);
+        assert_true(ret == SALT_SUCCESS);
+        assert_memory_equal(accepted_id, bond_id, SALT_BOND_ID_SIZE);
+        assert_int_equal(count, BOND_PATHS);
+        if (0 == i) {
+            assert_true(salt_bond_init(&test->host_bond, test->host_paths, count, accepted_id) == SALT_SUCCESS);
+        }
+        assert_true(salt_bond_add(&test->host_bond,
+                                  test->mocks[i]->host_channel,
+                                  test->host_rx[i], BOND_BUF_SIZE,
+                                  test->host_tx[i], BOND_BUF_SIZE) == SALT_SUCCESS);
+    }
+}
+
+static uint32_t message_create(uint8_t *p_message, uint32_t index)
+{
+    uint32_t size = 4U + ((index * 37U) % 200U);
+    memset(p_message, (uint8_t) index, size);
+    salti_u32_to_bytes(p_message, index);
+    return size;
+}
+
+static void message_verify(uint8_t *p_message, uint32_t size, uint32_t index)
+{
+    uint8_t expected[BOND_BUF_SIZE];
+    assert_int_equal(size, message_create(expected, index));
+    assert_memory_equal(p_message, expected, size);
+}
+
+static void bond_in_order(void **state)
+{
+    bond_test_t *test = (bond_test_t *) *state;
+    uint8_t message[BOND_BUF_SIZE];
+    uint8_t *p_data;
+    uint32_t size;
+
+    bond_create(test);
+
+    /* Nothing is received yet. */
+    assert_true(salt_bond_read(&test->host_bond, &p_data, &size) == SALT_PENDING);
+
+    for (uint32_t i = 0; i < 12; i++) {
+        size = message_create(message, i);
+        assert_true(salt_bond_write(&test->client_bond, message, size) == SALT_SUCCESS);
+    }
+
+    for (uint32_t i = 0; i < 12; i++) {
+        assert_true(salt_bond_read(&test->host_bond, &p_data, &size) == SALT_SUCCESS);
+        message_verify(p_data, size, i);
+    }
+    assert_true(salt_bond_read(&test->host_bond, &p_data, &size) == SALT_PENDING);
+
+    /* The bond is bidirectional. */
+    size = message_create(message, 100);
+    assert_true(salt_bond_write(&test->host_bond, message, size) == SALT_SUCCESS);
+    assert_true(salt_bond_read(&test->client_bond, &p_data, &size) == SALT_SUCCESS);
+    message_verify(p_data, size, 100);
+}
+
+static void bond_backpressure(void **state)
+{
+    bond_test_t *test = (bond_test_t *) *state;
+    uint8_t message[BOND_BUF_SIZE];
+    uint8_t *p_data;
+    uint32_t size;
+    uint32_t written = 0;
+    uint32_t read = 0;
+    salt_ret_t ret;
+
+    bond_create(test);
+
+    /* Fill all paths until the bond is blocked. */
+    do {
+        size = message_create(message, written);
+        ret = salt_bond_write(&test->client_bond, message, size);
+        assert_true(ret != SALT_ERROR);
+        if (SALT_SUCCESS == ret) {
+            written++;
+        }
+    } while (SALT_SUCCESS == ret);
+    assert_true(written > BOND_PATHS);
+
+    /* Alternate reading and writing, messages are still delivered in order. */
+    while (read < 200) {
+        ret = salt_bond_read(&test->host_bond, &p_data, &size);
+        assert_true(ret != SALT_ERROR);
+        if (SALT_SUCCESS == ret) {
+            message_verify(p_data, size, read);
+            read++;
+        }
+        if (written < 200) {
+            size = message_create(message, written);
+            ret = salt_bond_write(&test->client_bond, message, size);
+            assert_true(ret != SALT_ERROR);
+            if (SALT_SUCCESS == ret) {
+                written++;
+            }
+        }
+        else {
+            assert_true(salt_bond_flush(&test->client_bond) != SALT_ERROR);
+        }
+    }
+    assert_true(salt_bond_flush(&test->client_bond) == SALT_SUCCESS);
+}
+
+static void bond_bad_sequence(void **state)
+{
+    bond_test_t *test = (bond_test_t *) *state;
+    uint8_t message[BOND_BUF_SIZE];
+    uint8_t *p_data;
+    uint32_t size;
+
+    bond_create(test);
+
+    size = message_create(message, 0);
+    assert_true(salt_bond_write(&test->client_bond, message, size) == SALT_SUCCESS);
+    assert_true(salt_bond_read(&test->host_bond, &p_data, &size) == SALT_SUCCESS);
+
+    /* A replayed sequence number is rejected. */
+    test->client_bond.tx_seq = 0;
+    size = message_create(message, 0);
+    assert_true(salt_bond_write(&test->client_bond, message, size) == SALT_SUCCESS);
+    assert_true(salt_bond_read(&test->host_bond, &p_data, &size) == SALT_ERROR);
+}
+
+static void bond_accept_not_join(void **state)
+{
+    bond_test_t *test = (bond_test_t *) *state;
+    salt_channel_t *p_client = test->mocks[0]->client_channel;
+    salt_channel_t *p_host = test->mocks[0]->host_channel;
+    uint8_t message[4] = { 0x01, 0x02, 0x03, 0x04 };
+    uint8_t accepted_id[SALT_BOND_ID_SIZE];
+    uint8_t count;
+    salt_msg_t msg;
+
+    assert_true(salt_write_begin(test->client_tx[0], BOND_BUF_SIZE, &msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&msg, message, sizeof(message)) == SALT_SUCCESS);
+    assert_true(salt_write_execute(p_client, &msg, false) == SALT_SUCCESS);
+
+    assert_true(salt_bond_accept(p_host, test->host_rx[0], BOND_BUF_SIZE,
+                                 accepted_id, &count) == SALT_ERROR);
+    assert_true(p_host->err_code == SALT_ERR_BAD_PROTOCOL);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(bond_in_order, setup, teardown),
+        cmocka_unit_test_setup_teardown(bond_backpressure, setup, teardown),
+        cmocka_unit_test_setup_teardown(bond_bad_sequence, setup, teardown),
+        cmocka_unit_test_setup_teardown(bond_accept_not_join, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
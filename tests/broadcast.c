@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "cfifo.h"
+#include "salt.h"
+#include "salti_util.h"
+#include "salt_mock.h"
+#include "test_data.h"
+
+#define BROADCAST_SESSIONS      (3U)
+#define BROADCAST_BUF_SIZE      (256U)
+
+typedef struct broadcast_test_s {
+    salt_mock_t     *mocks[BROADCAST_SESSIONS];
+    salt_channel_t  *channels[BROADCAST_SESSIONS];
+    salt_msg_t      records[BROADCAST_SESSIONS];
+    uint8_t         pool[BROADCAST_SESSIONS * BROADCAST_BUF_SIZE];
+    uint8_t         tx_buffer[BROADCAST_BUF_SIZE];
+    uint8_t         rx_buffers[BROADCAST_SESSIONS][BROADCAST_BUF_SIZE];
+} broadcast_test_t;
+
+static int setup(void **state) {
+    broadcast_test_t *test = malloc(sizeof(broadcast_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    salt_mocks_create_established(test->mocks, BROADCAST_SESSIONS);
+    for (uint32_t i = 0; i < BROADCAST_SESSIONS; i++) {
+        test->channels[i] = test->mocks[i]->host_channel;
+    }
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    broadcast_test_t *test = (broadcast_test_t *) *state;
+    salt_mocks_delete(test->mocks, BROADCAST_SESSIONS);
+    free(test);
+    return 0;
+}
+
+/* Sends the records and lets each client read the first message. */
+static void broadcast_send(broadcast_test_t *test, salt_msg_t *p_msgs, uint16_t messages_left)
+{
+    for (uint32_t i = 0; i < BROADCAST_SESSIONS; i++) {
+        assert_true(salt_write_execute(test->channels[i], &test->records[i], false) == SALT_SUCCESS);
+        assert_true(salt_read_begin(test->mocks[i]->client_channel, test->rx_buffers[i],
+                                    BROADCAST_BUF_SIZE, &p_msgs[i]) == SALT_SUCCESS);
+        assert_int_equal(p_msgs[i].read.messages_left, messages_left);
+    }
+}
+
+static void broadcast_single(void **state)
+{
+    broadcast_test_t *test = (broadcast_test_t *) *state;
+    uint8_t message[32];
+    uint8_t clear[BROADCAST_BUF_SIZE];
+    salt_msg_t tx_msg;
+    salt_msg_t rx_msg;
+
+    memset(message, 0x5A, sizeof(message));
+    assert_true(salt_write_begin(test->tx_buffer, sizeof(test->tx_buffer), &tx_msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&tx_msg, message, sizeof(message)) == SALT_SUCCESS);
+    memcpy(clear, test->tx_buffer, sizeof(clear));
+
+    /* The same prepared message is broadcasted twice, with new nonces. */
+    for (uint32_t round = 0; round < 2; round++) {
+        assert_true(salt_write_broadcast(&tx_msg, test->channels, test->records,
+                                         BROADCAST_SESSIONS, test->pool,
+                                         sizeof(test->pool), false) == SALT_SUCCESS);
+
+        /* The clear text is not modified. */
+        assert_memory_equal(test->tx_buffer, clear, sizeof(clear));
+
+        for (uint32_t i = 0; i < BROADCAST_SESSIONS; i++) {
+            assert_int_equal(test->records[i].write.buffer_size,
+                             sizeof(message) + SALT_WRAP_OVERHEAD_IO_SIZE + SALT_LENGTH_SIZE);
+            assert_true(salt_write_execute(test->channels[i], &test->records[i], false) == SALT_SUCCESS);
+            assert_true(salt_read_begin(test->mocks[i]->client_channel, test->rx_buffers[i],
+                                        BROADCAST_BUF_SIZE, &rx_msg) == SALT_SUCCESS);
+            assert_int_equal(rx_msg.read.message_size, sizeof(message));
+            assert_memory_equal(rx_msg.read.p_payload, message, sizeof(message));
+        }
+    }
+
+    /* The sessions still work with ordinary writes. */
+    assert_true(salt_write_execute(test->channels[0], &tx_msg, false) == SALT_SUCCESS);
+    assert_true(salt_read_begin(test->mocks[0]->client_channel, test->rx_buffers[0],
+                                BROADCAST_BUF_SIZE, &rx_msg) == SALT_SUCCESS);
+    assert_memory_equal(rx_msg.read.p_payload, message, sizeof(message));
+}
+
+static void broadcast_multi(void **state)
+{
+    broadcast_test_t *test = (broadcast_test_t *) *state;
+    salt_msg_t tx_msg;
+    salt_msg_t rx_msgs[BROADCAST_SESSIONS];
+
+    assert_true(salt_write_begin(test->tx_buffer, sizeof(test->tx_buffer), &tx_msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&tx_msg, "first", 5) == SALT_SUCCESS);
+    assert_true(salt_write_next(&tx_msg, "second message", 14) == SALT_SUCCESS);
+
+    assert_true(salt_write_broadcast(&tx_msg, test->channels, test->records,
+                                     BROADCAST_SESSIONS, test->pool,
+                                     sizeof(test->pool), true) == SALT_SUCCESS);
+
+    for (uint32_t i = 0; i < BROADCAST_SESSIONS; i++) {
+        assert_int_equal(test->records[i].write.p_buffer[5], SALT_LAST_FLAG);
+    }
+
+    broadcast_send(test, rx_msgs, 1);
+
+    for (uint32_t i = 0; i < BROADCAST_SESSIONS; i++) {
+        assert_int_equal(rx_msgs[i].read.message_size, 5);
+        assert_memory_equal(rx_msgs[i].read.p_payload, "first", 5);
+        assert_true(salt_read_next(&rx_msgs[i]) == SALT_SUCCESS);
+        assert_int_equal(rx_msgs[i].read.message_size, 14);
+        assert_memory_equal(rx_msgs[i].read.p_payload, "second message", 14);
+    }
+}
+
+static void broadcast_closed_session(void **state)
+{
+    broadcast_test_t *test = (broadcast_test_t *) *state;
+    salt_msg_t tx_msg;
+    salt_msg_t rx_msg;
+
+    test->channels[1]->state = SALT_SESSION_CLOSED;
+
+    assert_true(salt_write_begin(test->tx_buffer, sizeof(test->tx_buffer), &tx_msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&tx_msg, "hello", 5) == SALT_SUCCESS);
+    assert_true(salt_write_broadcast(&tx_msg, test->channels, test->records,
+                                     BROADCAST_SESSIONS, test->pool,
+                                     sizeof(test->pool), false) == SALT_SUCCESS);
+
+    /* Only the closed session fails. */
+    assert_true(salt_write_execute(test->channels[1], &test->records[1], false) == SALT_ERROR);
+    for (uint32_t i = 0; i < BROADCAST_SESSIONS; i += 2) {
+        assert_true(salt_write_execute(test->channels[i], &test->records[i], false) == SALT_SUCCESS);
+        assert_true(salt_read_begin(test->mocks[i]->client_channel, test->rx_buffers[i],
+                                    BROADCAST_BUF_SIZE, &rx_msg) == SALT_SUCCESS);
+        assert_memory_equal(rx_msg.read.p_payload, "hello", 5);
+    }
+}
+
+static void broadcast_invalid(void **state)
+{
+    broadcast_test_t *test = (broadcast_test_t *) *state;
+    salt_msg_t tx_msg;
+    uint32_t record_size;
+
+    assert_true(salt_write_begin(test->tx_buffer, sizeof(test->tx_buffer), &tx_msg) == SALT_SUCCESS);
+
+    /* No message. */
+    assert_true(salt_write_broadcast(&tx_msg, test->channels, test->records,
+                                     BROADCAST_SESSIONS, test->pool,
+                                     sizeof(test->pool), false) == SALT_ERROR);
+
+    assert_true(salt_write_next(&tx_msg, "hello", 5) == SALT_SUCCESS);
+    record_size = tx_msg.write.buffer_size - tx_msg.write.buffer_available;
+
+    /* Pool to small. */
+    assert_true(salt_write_broadcast(&tx_msg, test->channels, test->records,
+                                     BROADCAST_SESSIONS, test->pool,
+                                     BROADCAST_SESSIONS * record_size - 1U, false) == SALT_ERROR);
+    assert_true(salt_write_broadcast(&tx_msg, test->channels, test->records,
+                                     BROADCAST_SESSIONS, test->pool,
+                                     BROADCAST_SESSIONS * record_size, false) == SALT_SUCCESS);
+
+    assert_true(salt_write_broadcast(NULL, test->channels, test->records,
+                                     BROADCAST_SESSIONS, test->pool,
+                                     sizeof(test->pool), false) == SALT_ERROR);
+    assert_true(salt_write_broadcast(&tx_msg, test->channels, test->records,
+                                     0, test->pool,
+                                     sizeof(test->pool), false) == SALT_ERROR);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(broadcast_single, setup, teardown),
+        cmocka_unit_test_setup_teardown(broadcast_multi, setup, teardown),
+        cmocka_unit_test_setup_teardown(broadcast_closed_session, setup, teardown),
+        cmocka_unit_test_setup_teardown(broadcast_invalid, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
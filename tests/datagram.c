@@ -0,0 +1,316 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "salt.h"
+#include "salti_util.h"
+#include "salt_mock.h"
+#include "test_data.h"
+
+#define DGRAM_MAX_QUEUE     (128U)
+#define DGRAM_MAX_SIZE      (256U)
+
+/*
+ * Datagram link in one direction. Written datagrams are queued and
+ * delivered in the order given by deliver[], which lets the test drop,
+ * reorder and duplicate datagrams.
+ */
+typedef struct dgram_link_s {
+    uint8_t     data[DGRAM_MAX_QUEUE][DGRAM_MAX_SIZE];
+    uint32_t    size[DGRAM_MAX_QUEUE];
+    uint32_t    written;
+    uint32_t    deliver[DGRAM_MAX_QUEUE * 2U];
+    uint32_t    deliver_count;
+    uint32_t    delivered;
+    bool        block_write;
+} dgram_link_t;
+
+typedef struct dgram_test_s {
+    salt_mock_t     *mock;
+    salt_dgram_t    client_dgram;
+    salt_dgram_t    host_dgram;
+    dgram_link_t    client_to_host;
+    dgram_link_t    host_to_client;
+} dgram_test_t;
+
+static salt_ret_t dgram_link_write(salt_io_channel_t *p_wchannel)
+{
+    dgram_link_t *link = (dgram_link_t *) p_wchannel->p_context;
+
+    if (link->block_write) {
+        return SALT_PENDING;
+    }
+
+    assert_true(link->written < DGRAM_MAX_QUEUE);
+    assert_true(p_wchannel->size_expected <= DGRAM_MAX_SIZE);
+    memcpy(link->data[link->written], p_wchannel->p_data, p_wchannel->size_expected);
+    link->size[link->written] = p_wchannel->size_expected;
+    link->written++;
+    p_wchannel->size = p_wchannel->size_expected;
+
+    return SALT_SUCCESS;
+}
+
+static salt_ret_t dgram_link_read(salt_io_channel_t *p_rchannel)
+{
+    dgram_link_t *link = (dgram_link_t *) p_rchannel->p_context;
+    uint32_t index;
+    uint32_t size;
+
+    if (link->delivered >= link->deliver_count) {
+        return SALT_PENDING;
+    }
+
+    index = link->deliver[link->delivered++];
+    size = link->size[index];
+    if (size > p_rchannel->size_expected) {
+        size = p_rchannel->size_expected;
+    }
+    memcpy(p_rchannel->p_data, link->data[index], size);
+    p_rchannel->size = size;
+
+    return SALT_SUCCESS;
+}
+
+static void dgram_link_deliver(dgram_link_t *link, uint32_t index)
+{
+    assert_true(link->deliver_count < (DGRAM_MAX_QUEUE * 2U));
+    link->deliver[link->deliver_count++] = index;
+}
+
+static int setup(void **state) {
+    dgram_test_t *test = calloc(1, sizeof(dgram_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    test->mock = salt_mock_create();
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    dgram_test_t *test = (dgram_test_t *) *state;
+    salt_mock_delete(test->mock);
+    free(test);
+    return 0;
+}
+
+static void dgram_setup(dgram_test_t *test, bool client, bool host)
+{
+    if (client) {
+        assert_true(salt_dgram_init(test->mock->client_channel, &test->client_dgram,
+                                    dgram_link_write, dgram_link_read,
+                                    &test->client_to_host, &test->host_to_client) == SALT_SUCCESS);
+    }
+    if (host) {
+        assert_true(salt_dgram_init(test->mock->host_channel, &test->host_dgram,
+                                    dgram_link_write, dgram_link_read,
+                                    &test->host_to_client, &test->client_to_host) == SALT_SUCCESS);
+    }
+    salt_mock_handshake(test->mock);
+}
+
+static void dgram_send(salt_channel_t *p_channel, uint32_t index)
+{
+    uint8_t buffer[SALT_DGRAM_OVERHEAD_SIZE + 64U];
+    uint32_t size = 4U + (index % 60U);
+
+    memset(&buffer[SALT_DGRAM_OVERHEAD_SIZE], (uint8_t) index, size);
+    salti_u32_to_bytes(&buffer[SALT_DGRAM_OVERHEAD_SIZE], index);
+    assert_true(salt_dgram_write(p_channel, buffer, size) == SALT_SUCCESS);
+}
+
+static salt_ret_t dgram_receive(salt_channel_t *p_channel, uint32_t *p_index)
+{
+    uint8_t buffer[DGRAM_MAX_SIZE];
+    uint8_t expected[64];
+    uint8_t *p_message;
+    uint32_t size;
+    salt_ret_t ret;
+
+    ret = salt_dgram_read(p_channel, buffer, sizeof(buffer), &p_message, &size);
+    if (SALT_SUCCESS == ret) {
+        *p_index = salti_bytes_to_u32(p_message);
+        assert_int_equal(size, 4U + (*p_index % 60U));
+        memset(expected, (uint8_t) *p_index, size);
+        salti_u32_to_bytes(expected, *p_index);
+        assert_memory_equal(p_message, expected, size);
+    }
+
+    return ret;
+}
+
+static void dgram_negotiated(void **state)
+{
+    dgram_test_t *test = (dgram_test_t *) *state;
+    uint32_t index;
+
+    dgram_setup(test, true, true);
+    assert_true(test->client_dgram.negotiated);
+    assert_true(test->host_dgram.negotiated);
+
+    for (uint32_t i = 0; i < 10; i++) {
+        dgram_send(test->mock->client_channel, i);
+        dgram_link_deliver(&test->client_to_host, i);
+        dgram_send(test->mock->host_channel, 100 + i);
+        dgram_link_deliver(&test->host_to_client, i);
+    }
+
+    for (uint32_t i = 0; i < 10; i++) {
+        assert_true(dgram_receive(test->mock->host_channel, &index) == SALT_SUCCESS);
+        assert_int_equal(index, i);
+        assert_true(dgram_receive(test->mock->client_channel, &index) == SALT_SUCCESS);
+        assert_int_equal(index, 100 + i);
+    }
+    assert_true(dgram_receive(test->mock->host_channel, &index) == SALT_PENDING);
+    assert_int_equal(test->host_dgram.dropped, 0);
+}
+
+static void dgram_not_negotiated(void **state)
+{
+    dgram_test_t *test = (dgram_test_t *) *state;
+    uint8_t buffer[SALT_DGRAM_OVERHEAD_SIZE + 4U];
+
+    /* Only the client requests datagram mode, the stream session still works. */
+    dgram_setup(test, true, false);
+    assert_false(test->client_dgram.negotiated);
+    assert_true(test->mock->client_channel->state == SALT_SESSION_ESTABLISHED);
+
+    assert_true(salt_dgram_write(test->mock->client_channel, buffer, 4) == SALT_ERROR);
+    assert_true(test->mock->client_channel->err_code == SALT_ERR_NOT_SUPPORTED);
+}
+
+static void dgram_loss_and_reorder(void **state)
+{
+    dgram_test_t *test = (dgram_test_t *) *state;
+    bool received[DGRAM_MAX_QUEUE] = { false };
+    uint32_t count = 0;
+    uint32_t expected = 0;
+    uint32_t index;
+
+    dgram_setup(test, true, true);
+
+    for (uint32_t i = 0; i < 100; i++) {
+        dgram_send(test->mock->client_channel, i);
+    }
+
+    /* Drop every 7th datagram and reverse the order in blocks of 8. */
+    for (uint32_t block = 0; block < 100; block += 8) {
+        for (uint32_t i = 8; i > 0; i--) {
+            uint32_t n = block + i - 1;
+            if ((n < 100) && ((n % 7) != 3)) {
+                dgram_link_deliver(&test->client_to_host, n);
+                expected++;
+            }
+        }
+    }
+
+    while (dgram_receive(test->mock->host_channel, &index) == SALT_SUCCESS) {
+        assert_true(index < 100);
+        assert_false(received[index]);
+        assert_true((index % 7) != 3);
+        received[index] = true;
+        count++;
+    }
+
+    assert_int_equal(count, expected);
+    assert_int_equal(test->host_dgram.dropped, 0);
+}
+
+static void dgram_replay(void **state)
+{
+    dgram_test_t *test = (dgram_test_t *) *state;
+    uint32_t index;
+
+    dgram_setup(test, true, true);
+
+    for (uint32_t i = 0; i < 70; i++) {
+        dgram_send(test->mock->client_channel, i);
+    }
+
+    /* Record 0 twice, record 69 moves the window past record 1. */
+    dgram_link_deliver(&test->client_to_host, 0);
+    dgram_link_deliver(&test->client_to_host, 0);
+    dgram_link_deliver(&test->client_to_host, 69);
+    dgram_link_deliver(&test->client_to_host, 1);
+    dgram_link_deliver(&test->client_to_host, 69);
+    dgram_link_deliver(&test->client_to_host, 6);
+
+    assert_true(dgram_receive(test->mock->host_channel, &index) == SALT_SUCCESS);
+    assert_int_equal(index, 0);
+    assert_true(dgram_receive(test->mock->host_channel, &index) == SALT_SUCCESS);
+    assert_int_equal(index, 69);
+    assert_true(dgram_receive(test->mock->host_channel, &index) == SALT_SUCCESS);
+    assert_int_equal(index, 6);
+    assert_true(dgram_receive(test->mock->host_channel, &index) == SALT_PENDING);
+
+    assert_int_equal(test->host_dgram.dropped, 3);
+    assert_true(test->mock->host_channel->state == SALT_SESSION_ESTABLISHED);
+}
+
+static void dgram_forged(void **state)
+{
+    dgram_test_t *test = (dgram_test_t *) *state;
+    uint32_t index;
+
+    dgram_setup(test, true, true);
+
+    dgram_send(test->mock->client_channel, 0);
+    dgram_send(test->mock->client_channel, 1);
+    dgram_send(test->mock->host_channel, 2);
+
+    /* Modified cipher text, truncated datagram and record reflected back. */
+    memcpy(test->client_to_host.data[2], test->client_to_host.data[0], DGRAM_MAX_SIZE);
+    test->client_to_host.size[2] = test->client_to_host.size[0];
+    test->client_to_host.data[2][test->client_to_host.size[2] - 1U] ^= 0x01U;
+    test->client_to_host.size[3] = 20;
+    memcpy(test->client_to_host.data[4], test->host_to_client.data[0], DGRAM_MAX_SIZE);
+    test->client_to_host.size[4] = test->host_to_client.size[0];
+
+    dgram_link_deliver(&test->client_to_host, 2);
+    dgram_link_deliver(&test->client_to_host, 3);
+    dgram_link_deliver(&test->client_to_host, 4);
+    dgram_link_deliver(&test->client_to_host, 1);
+
+    assert_true(dgram_receive(test->mock->host_channel, &index) == SALT_SUCCESS);
+    assert_int_equal(index, 1);
+    assert_int_equal(test->host_dgram.dropped, 3);
+}
+
+static void dgram_write_pending(void **state)
+{
+    dgram_test_t *test = (dgram_test_t *) *state;
+    uint8_t buffer[SALT_DGRAM_OVERHEAD_SIZE + 8U];
+    uint32_t index;
+
+    dgram_setup(test, true, true);
+
+    test->client_to_host.block_write = true;
+    memset(&buffer[SALT_DGRAM_OVERHEAD_SIZE], 0x04, 8);
+    salti_u32_to_bytes(&buffer[SALT_DGRAM_OVERHEAD_SIZE], 4);
+    assert_true(salt_dgram_write(test->mock->client_channel, buffer, 8) == SALT_PENDING);
+    assert_true(salt_dgram_write(test->mock->client_channel, buffer, 8) == SALT_PENDING);
+    test->client_to_host.block_write = false;
+    assert_true(salt_dgram_write(test->mock->client_channel, buffer, 8) == SALT_SUCCESS);
+    assert_int_equal(test->client_dgram.write_record, 1);
+
+    dgram_link_deliver(&test->client_to_host, 0);
+    assert_true(dgram_receive(test->mock->host_channel, &index) == SALT_SUCCESS);
+    assert_int_equal(index, 4);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(dgram_negotiated, setup, teardown),
+        cmocka_unit_test_setup_teardown(dgram_not_negotiated, setup, teardown),
+        cmocka_unit_test_setup_teardown(dgram_loss_and_reorder, setup, teardown),
+        cmocka_unit_test_setup_teardown(dgram_replay, setup, teardown),
+        cmocka_unit_test_setup_teardown(dgram_forged, setup, teardown),
+        cmocka_unit_test_setup_teardown(dgram_write_pending, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,306 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "salt.h"
+#include "salt_directory.h"
+#include "salt_mock.h"
+
+#define DIR_SLOTS       (8U)
+#define DIR_ENTRIES     (DIR_SLOTS + 2U)
+#define DIR_READERS     (2U)
+
+typedef struct directory_test_s {
+    salt_directory_t        dir;
+    salt_directory_entry_t  *slots[DIR_SLOTS];
+    salt_directory_entry_t  entries[DIR_ENTRIES];
+    uint32_t                readers[DIR_READERS];
+    salt_channel_t          channels[DIR_SLOTS + 1U];
+    uint32_t                locks;
+} directory_test_t;
+
+static void test_lock(void *p_context)
+{
+    directory_test_t *test = (directory_test_t *) p_context;
+    assert_int_equal(test->locks, 0);
+    test->locks++;
+}
+
+static void test_unlock(void *p_context)
+{
+    directory_test_t *test = (directory_test_t *) p_context;
+    assert_int_equal(test->locks, 1);
+    test->locks--;
+}
+
+static int setup(void **state) {
+    directory_test_t *test = malloc(sizeof(directory_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    memset(test, 0x00, sizeof(directory_test_t));
+    for (uint32_t i = 0; i < DIR_SLOTS + 1U; i++) {
+        test->channels[i].state = SALT_SESSION_ESTABLISHED;
+        memset(test->channels[i].peer_sk_pub, (int) (i + 1U), api_crypto_sign_PUBLICKEYBYTES);
+    }
+    assert_true(salt_directory_init(&test->dir, test->slots, DIR_SLOTS,
+                                    test->entries, DIR_ENTRIES,
+                                    test->readers, DIR_READERS,
+                                    test_lock, test_unlock, test) == SALT_SUCCESS);
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    free(*state);
+    return 0;
+}
+
+static void directory_add_lookup(void **state)
+{
+    directory_test_t *test = (directory_test_t *) *state;
+    salt_channel_t *p_channel;
+    void *p_context;
+
+    for (uint32_t i = 0; i < 4U; i++) {
+        assert_true(salt_directory_add(&test->dir, &test->channels[i], &test->readers[i & 1U]) == SALT_SUCCESS);
+    }
+    assert_int_equal(test->dir.count, 4);
+
+    for (uint32_t i = 0; i < 4U; i++) {
+        assert_true(salt_directory_lookup(&test->dir, test->channels[i].peer_sk_pub,
+                                          &p_channel, &p_context) == SALT_SUCCESS);
+        assert_ptr_equal(p_channel, &test->channels[i]);
+        assert_ptr_equal(p_context, &test->readers[i & 1U]);
+    }
+
+    assert_true(salt_directory_lookup(&test->dir, test->channels[4].peer_sk_pub,
+                                      NULL, NULL) == SALT_ERROR);
+
+    /* Only established sessions are added. */
+    test->channels[4].state = SALT_SESSION_INITIATED;
+    assert_true(salt_directory_add(&test->dir, &test->channels[4], NULL) == SALT_ERROR);
+    assert_int_equal(test->locks, 0);
+}
+
+static void directory_replace(void **state)
+{
+    directory_test_t *test = (directory_test_t *) *state;
+    salt_channel_t *p_old = &test->channels[0];
+    salt_channel_t *p_new = &test->channels[1];
+    salt_channel_t *p_channel;
+
+    /* A new session of the same peer. */
+    memcpy(p_new->peer_sk_pub, p_old->peer_sk_pub, api_crypto_sign_PUBLICKEYBYTES);
+
+    assert_true(salt_directory_add(&test->dir, p_old, NULL) == SALT_SUCCESS);
+    assert_true(salt_directory_add(&test->dir, p_new, NULL) == SALT_SUCCESS);
+    assert_int_equal(test->dir.count, 1);
+
+    assert_true(salt_directory_lookup(&test->dir, p_old->peer_sk_pub, &p_channel, NULL) == SALT_SUCCESS);
+    assert_ptr_equal(p_channel, p_new);
+
+    /* Closing the old session does not remove the new one. */
+    assert_true(salt_directory_remove(&test->dir, p_old, NULL) == SALT_ERROR);
+    assert_true(salt_directory_lookup(&test->dir, p_old->peer_sk_pub, &p_channel, NULL) == SALT_SUCCESS);
+    assert_ptr_equal(p_channel, p_new);
+
+    assert_true(salt_directory_remove(&test->dir, p_new, NULL) == SALT_SUCCESS);
+    assert_true(salt_directory_lookup(&test->dir, p_old->peer_sk_pub, NULL, NULL) == SALT_ERROR);
+    assert_int_equal(test->dir.count, 0);
+}
+
+static void directory_full(void **state)
+{
+    directory_test_t *test = (directory_test_t *) *state;
+    salt_channel_t *p_channel;
+
+    for (uint32_t i = 0; i < DIR_SLOTS - 1U; i++) {
+        assert_true(salt_directory_add(&test->dir, &test->channels[i], NULL) == SALT_SUCCESS);
+    }
+    assert_true(salt_directory_add(&test->dir, &test->channels[DIR_SLOTS - 1U], NULL) == SALT_ERROR);
+
+    /* A removed slot is reused when the session is added again. */
+    for (uint32_t round = 0; round < 3U * DIR_SLOTS; round++) {
+        uint32_t out = round % (DIR_SLOTS - 1U);
+        assert_true(salt_directory_remove(&test->dir, &test->channels[out], NULL) == SALT_SUCCESS);
+        assert_true(salt_directory_lookup(&test->dir, test->channels[out].peer_sk_pub,
+                                          NULL, NULL) == SALT_ERROR);
+        assert_true(salt_directory_add(&test->dir, &test->channels[out], NULL) == SALT_SUCCESS);
+        assert_int_equal(test->dir.used, DIR_SLOTS - 1U);
+
+        for (uint32_t i = 0; i < DIR_SLOTS - 1U; i++) {
+            assert_true(salt_directory_lookup(&test->dir, test->channels[i].peer_sk_pub,
+                                              &p_channel, NULL) == SALT_SUCCESS);
+            assert_ptr_equal(p_channel, &test->channels[i]);
+        }
+    }
+
+    /* All removed, all slots are empty again. */
+    for (uint32_t i = 0; i < DIR_SLOTS - 1U; i++) {
+        assert_true(salt_directory_remove(&test->dir, &test->channels[i], NULL) == SALT_SUCCESS);
+        assert_true(salt_directory_remove(&test->dir, &test->channels[i], NULL) == SALT_ERROR);
+    }
+    assert_int_equal(test->dir.count, 0);
+    assert_int_equal(test->dir.used, 0);
+}
+
+static void directory_reclaim(void **state)
+{
+    directory_test_t *test = (directory_test_t *) *state;
+    salt_channel_t *p_channel;
+    uint32_t retired;
+
+    assert_true(salt_directory_add(&test->dir, &test->channels[0], NULL) == SALT_SUCCESS);
+
+    /* Reader 0 finds the session, then it is removed. */
+    salt_directory_enter(&test->dir, 0);
+    assert_true(salt_directory_lookup(&test->dir, test->channels[0].peer_sk_pub,
+                                      &p_channel, NULL) == SALT_SUCCESS);
+    assert_true(salt_directory_remove(&test->dir, &test->channels[0], &retired) == SALT_SUCCESS);
+
+    /* A reader entering after the removal does not delay the reuse. */
+    salt_directory_enter(&test->dir, 1);
+    assert_true(salt_directory_lookup(&test->dir, test->channels[0].peer_sk_pub,
+                                      NULL, NULL) == SALT_ERROR);
+
+    assert_true(salt_directory_reclaimable(&test->dir, retired) == SALT_PENDING);
+    salt_directory_leave(&test->dir, 0);
+    assert_true(salt_directory_reclaimable(&test->dir, retired) == SALT_SUCCESS);
+    salt_directory_leave(&test->dir, 1);
+    assert_true(salt_directory_reclaimable(&test->dir, retired) == SALT_SUCCESS);
+}
+
+static void directory_retired(void **state)
+{
+    directory_test_t *test = (directory_test_t *) *state;
+    salt_channel_t *p_first = &test->channels[0];
+    salt_channel_t *p_second = &test->channels[1];
+    salt_channel_t *p_third = &test->channels[2];
+    salt_channel_t *p_channel;
+
+    /* Two entries, the second session of the peer takes the last one. */
+    assert_true(salt_directory_init(&test->dir, test->slots, 4U, test->entries, 2U,
+                                    test->readers, DIR_READERS, NULL, NULL, NULL) == SALT_SUCCESS);
+    memcpy(p_second->peer_sk_pub, p_first->peer_sk_pub, api_crypto_sign_PUBLICKEYBYTES);
+    memcpy(p_third->peer_sk_pub, p_first->peer_sk_pub, api_crypto_sign_PUBLICKEYBYTES);
+
+    /* Reader 0 finds the first session, which is then replaced. */
+    salt_directory_enter(&test->dir, 0);
+    assert_true(salt_directory_add(&test->dir, p_first, NULL) == SALT_SUCCESS);
+    assert_true(salt_directory_lookup(&test->dir, p_first->peer_sk_pub,
+                                      &p_channel, NULL) == SALT_SUCCESS);
+    assert_ptr_equal(p_channel, p_first);
+    assert_true(salt_directory_add(&test->dir, p_second, NULL) == SALT_SUCCESS);
+
+    /* The replaced entry is not reused while reader 0 may read it. */
+    assert_ptr_equal(test->dir.p_retired->p_channel, p_first);
+    assert_true(salt_directory_add(&test->dir, p_third, NULL) == SALT_ERROR);
+    assert_true(salt_directory_lookup(&test->dir, p_first->peer_sk_pub,
+                                      &p_channel, NULL) == SALT_SUCCESS);
+    assert_ptr_equal(p_channel, p_second);
+
+    salt_directory_leave(&test->dir, 0);
+    assert_true(salt_directory_add(&test->dir, p_third, NULL) == SALT_SUCCESS);
+    assert_true(salt_directory_lookup(&test->dir, p_first->peer_sk_pub,
+                                      &p_channel, NULL) == SALT_SUCCESS);
+    assert_ptr_equal(p_channel, p_third);
+    assert_int_equal(test->dir.count, 1);
+}
+
+static void directory_session_hook(void **state)
+{
+    directory_test_t *test = (directory_test_t *) *state;
+    salt_mock_t *mock = salt_mock_create();
+    salt_directory_session_t host_session = { &test->dir, &test->readers[0], 0U };
+    salt_directory_session_t client_session = { &test->dir, &test->readers[1], 0U };
+    uint8_t exported[SALT_EXPORT_SIZE];
+    salt_channel_t new_host;
+    salt_channel_t *p_channel;
+    void *p_context;
+    uint32_t size;
+
+    assert_true(salt_set_session_hook(mock->host_channel, salt_directory_session_hook,
+                                      &host_session) == SALT_SUCCESS);
+    assert_true(salt_set_session_hook(mock->client_channel, salt_directory_session_hook,
+                                      &client_session) == SALT_SUCCESS);
+
+    /* Both sessions are added when the handshake succeeds. */
+    salt_mock_handshake(mock);
+    assert_int_equal(test->dir.count, 2);
+    assert_true(salt_directory_lookup(&test->dir, mock->client_channel->my_sk_pub,
+                                      &p_channel, &p_context) == SALT_SUCCESS);
+    assert_ptr_equal(p_channel, mock->host_channel);
+    assert_ptr_equal(p_context, &test->readers[0]);
+    assert_true(salt_directory_lookup(&test->dir, mock->host_channel->my_sk_pub,
+                                      &p_channel, &p_context) == SALT_SUCCESS);
+    assert_ptr_equal(p_channel, mock->client_channel);
+    assert_ptr_equal(p_context, &test->readers[1]);
+
+    /* Exporting closes the session, which removes it. */
+    assert_true(salt_export_session(mock->host_channel, exported,
+                                    sizeof(exported), &size) == SALT_SUCCESS);
+    assert_true(salt_directory_lookup(&test->dir, mock->client_channel->my_sk_pub,
+                                      NULL, NULL) == SALT_ERROR);
+    assert_int_not_equal(host_session.retired, 0);
+    assert_true(salt_directory_reclaimable(&test->dir, host_session.retired) == SALT_SUCCESS);
+
+    /* The importer adds the session again. */
+    assert_true(salt_create(&new_host, SALT_SERVER, salt_write_mock, salt_read_mock,
+                            NULL) == SALT_SUCCESS);
+    assert_true(salt_set_session_hook(&new_host, salt_directory_session_hook,
+                                      &host_session) == SALT_SUCCESS);
+    assert_true(salt_import_session(&new_host, exported, size, NULL, 0) == SALT_SUCCESS);
+    assert_int_equal(host_session.retired, 0);
+    assert_true(salt_directory_lookup(&test->dir, mock->client_channel->my_sk_pub,
+                                      &p_channel, NULL) == SALT_SUCCESS);
+    assert_ptr_equal(p_channel, &new_host);
+
+    salt_mock_delete(mock);
+}
+
+static void directory_invalid(void **state)
+{
+    directory_test_t *test = (directory_test_t *) *state;
+
+    assert_true(salt_directory_init(&test->dir, test->slots, 6U, test->entries, DIR_ENTRIES,
+                                    NULL, 0, NULL, NULL, NULL) == SALT_ERROR);
+    assert_true(salt_directory_init(&test->dir, test->slots, 1U, test->entries, DIR_ENTRIES,
+                                    NULL, 0, NULL, NULL, NULL) == SALT_ERROR);
+    assert_true(salt_directory_init(&test->dir, NULL, DIR_SLOTS, test->entries, DIR_ENTRIES,
+                                    NULL, 0, NULL, NULL, NULL) == SALT_ERROR);
+    assert_true(salt_directory_init(&test->dir, test->slots, DIR_SLOTS, NULL, DIR_ENTRIES,
+                                    NULL, 0, NULL, NULL, NULL) == SALT_ERROR);
+    assert_true(salt_directory_init(&test->dir, test->slots, DIR_SLOTS, test->entries, 0U,
+                                    NULL, 0, NULL, NULL, NULL) == SALT_ERROR);
+    assert_true(salt_directory_init(&test->dir, test->slots, DIR_SLOTS, test->entries, DIR_ENTRIES,
+                                    NULL, DIR_READERS, NULL, NULL, NULL) == SALT_ERROR);
+    assert_true(salt_directory_init(&test->dir, test->slots, DIR_SLOTS, test->entries, DIR_ENTRIES,
+                                    NULL, 0, test_lock, NULL, NULL) == SALT_ERROR);
+    assert_true(salt_directory_init(&test->dir, test->slots, 2U, test->entries, DIR_ENTRIES,
+                                    NULL, 0, NULL, NULL, NULL) == SALT_SUCCESS);
+
+    /* Two slots hold one session. */
+    assert_true(salt_directory_add(&test->dir, &test->channels[0], NULL) == SALT_SUCCESS);
+    assert_true(salt_directory_add(&test->dir, &test->channels[1], NULL) == SALT_ERROR);
+    assert_true(salt_directory_lookup(&test->dir, NULL, NULL, NULL) == SALT_ERROR);
+    assert_true(salt_directory_add(NULL, &test->channels[0], NULL) == SALT_ERROR);
+    assert_true(salt_directory_remove(&test->dir, NULL, NULL) == SALT_ERROR);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(directory_add_lookup, setup, teardown),
+        cmocka_unit_test_setup_teardown(directory_replace, setup, teardown),
+        cmocka_unit_test_setup_teardown(directory_full, setup, teardown),
+        cmocka_unit_test_setup_teardown(directory_reclaim, setup, teardown),
+        cmocka_unit_test_setup_teardown(directory_retired, setup, teardown),
+        cmocka_unit_test_setup_teardown(directory_session_hook, setup, teardown),
+        cmocka_unit_test_setup_teardown(directory_invalid, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
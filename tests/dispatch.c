@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "cfifo.h"
+#include "salt.h"
+#include "salt_dispatch.h"
+#include "salt_mock.h"
+#include "test_data.h"
+
+#define DISPATCH_BUFFERS        (4U)
+#define DISPATCH_WORKERS        (2U)
+#define DISPATCH_BUF_SIZE       (256U)
+
+typedef struct dispatch_test_s {
+    salt_dispatch_t         dispatch;
+    salt_dispatch_buffer_t  buffers[DISPATCH_BUFFERS];
+    salt_dispatch_queue_t   workers[DISPATCH_WORKERS];
+    salt_dispatch_slot_t    slots[SALT_DISPATCH_SLOTS(DISPATCH_BUFFERS, DISPATCH_WORKERS)];
+    uint8_t                 memory[DISPATCH_BUFFERS * DISPATCH_BUF_SIZE];
+} dispatch_test_t;
+
+static int setup(void **state) {
+    dispatch_test_t *test = malloc(sizeof(dispatch_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    assert_true(salt_dispatch_init(&test->dispatch, test->buffers, DISPATCH_BUFFERS,
+                                   test->memory, DISPATCH_BUF_SIZE,
+                                   test->workers, DISPATCH_WORKERS,
+                                   test->slots) == SALT_SUCCESS);
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    free(*state);
+    return 0;
+}
+
+static void dispatch_pool(void **state)
+{
+    dispatch_test_t *test = (dispatch_test_t *) *state;
+    salt_dispatch_buffer_t *p_buffers[DISPATCH_BUFFERS];
+
+    /* Many rounds, the positions wrap around the slots. */
+    for (uint32_t round = 0; round < 10U; round++) {
+        for (uint32_t i = 0; i < DISPATCH_BUFFERS; i++) {
+            p_buffers[i] = salt_dispatch_acquire(&test->dispatch);
+            assert_non_null(p_buffers[i]);
+            assert_int_equal(p_buffers[i]->size, DISPATCH_BUF_SIZE);
+        }
+        assert_null(salt_dispatch_acquire(&test->dispatch));
+
+        for (uint32_t i = 0; i < DISPATCH_BUFFERS; i++) {
+            for (uint32_t j = 0; j < i; j++) {
+                assert_true(p_buffers[i]->p_data != p_buffers[j]->p_data);
+            }
+            assert_true(salt_dispatch_release(&test->dispatch, p_buffers[i]) == SALT_SUCCESS);
+        }
+    }
+
+    /* The pool can not hold more than its buffers. */
+    assert_true(salt_dispatch_release(&test->dispatch, &test->buffers[0]) == SALT_ERROR);
+}
+
+/* Session s posts record r unless (r + s) % 3 == 0. */
+static bool order_posted(uint32_t session, uint32_t round)
+{
+    return ((round + session) % 3U) != 0U;
+}
+
+/* Takes all posted buffers and checks that each session is in order. */
+static uint32_t order_drain(dispatch_test_t *test, uint32_t *p_next)
+{
+    salt_dispatch_buffer_t *p_buffer;
+    uint32_t taken = 0;
+
+    for (uint32_t worker = 0; worker < DISPATCH_WORKERS; worker++) {
+        while ((p_buffer = salt_dispatch_take(&test->dispatch, worker)) != NULL) {
+            uint32_t session = p_buffer->p_data[0];
+            assert_int_equal(session % DISPATCH_WORKERS, worker);
+            while (!order_posted(session, p_next[session])) {
+                p_next[session]++;
+            }
+            assert_int_equal(p_buffer->p_data[1], p_next[session]);
+            p_next[session]++;
+            taken++;
+            assert_true(salt_dispatch_release(&test->dispatch, p_buffer) == SALT_SUCCESS);
+        }
+    }
+
+    return taken;
+}
+
+static void dispatch_order(void **state)
+{
+    dispatch_test_t *test = (dispatch_test_t *) *state;
+    salt_dispatch_buffer_t *p_buffer;
+    uint32_t next[4] = { 0 };
+    uint32_t taken = 0;
+
+    /*
+     * Four sessions post numbered records. Sessions 0 and 2 share worker 0,
+     * 1 and 3 share worker 1.
+     */
+    for (uint32_t round = 0; round < 6U; round++) {
+        for (uint32_t session = 0; session < 4U; session++) {
+            if (!order_posted(session, round)) {
+                continue;
+            }
+            p_buffer = salt_dispatch_acquire(&test->dispatch);
+            if (NULL == p_buffer) {
+                /* All buffers posted, let the workers catch up. */
+                taken += order_drain(test, next);
+                p_buffer = salt_dispatch_acquire(&test->dispatch);
+                assert_non_null(p_buffer);
+            }
+            p_buffer->p_data[0] = (uint8_t) session;
+            p_buffer->p_data[1] = (uint8_t) round;
+            assert_true(salt_dispatch_post(&test->dispatch, p_buffer, session) == SALT_SUCCESS);
+        }
+    }
+
+    taken += order_drain(test, next);
+    assert_int_equal(taken, 16);
+}
+
+static void dispatch_record(void **state)
+{
+    dispatch_test_t *test = (dispatch_test_t *) *state;
+    salt_mock_t *mock = salt_mock_create();
+    salt_dispatch_buffer_t *p_buffer;
+    salt_ret_t host_ret = SALT_PENDING;
+    salt_ret_t client_ret = SALT_PENDING;
+    uint8_t host_buffer[SALT_HNDSHK_BUFFER_SIZE];
+    uint8_t client_buffer[SALT_HNDSHK_BUFFER_SIZE];
+    uint8_t tx_buffer[DISPATCH_BUF_SIZE];
+    salt_msg_t tx_msg;
+
+    assert_true(salt_create_signature(mock->host_channel) == SALT_SUCCESS);
+    assert_true(salt_init_session(mock->host_channel, host_buffer, sizeof(host_buffer)) == SALT_SUCCESS);
+    assert_true(salt_create_signature(mock->client_channel) == SALT_SUCCESS);
+    assert_true(salt_init_session(mock->client_channel, client_buffer, sizeof(client_buffer)) == SALT_SUCCESS);
+    while ((host_ret | client_ret) != SALT_SUCCESS) {
+        client_ret = salt_handshake(mock->client_channel, NULL);
+        assert_true(client_ret != SALT_ERROR);
+        host_ret = salt_handshake(mock->host_channel, NULL);
+        assert_true(host_ret != SALT_ERROR);
+    }
+
+    assert_true(salt_write_begin(tx_buffer, sizeof(tx_buffer), &tx_msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&tx_msg, "first", 5) == SALT_SUCCESS);
+    assert_true(salt_write_next(&tx_msg, "second", 6) == SALT_SUCCESS);
+    assert_true(salt_write_execute(mock->client_channel, &tx_msg, false) == SALT_SUCCESS);
+
+    /* The record is read into a pool buffer and handed over in place. */
+    p_buffer = salt_dispatch_acquire(&test->dispatch);
+    assert_non_null(p_buffer);
+    assert_true(salt_read_begin(mock->host_channel, p_buffer->p_data, p_buffer->size,
+                                &p_buffer->msg) == SALT_SUCCESS);
+    p_buffer->p_context = mock;
+    assert_true(salt_dispatch_post(&test->dispatch, p_buffer, 3U) == SALT_SUCCESS);
+
+    assert_null(salt_dispatch_take(&test->dispatch, 0));
+    p_buffer = salt_dispatch_take(&test->dispatch, 1);
+    assert_non_null(p_buffer);
+    assert_ptr_equal(p_buffer->p_context, mock);
+    assert_int_equal(p_buffer->msg.read.message_size, 5);
+    assert_memory_equal(p_buffer->msg.read.p_payload, "first", 5);
+    assert_true(salt_read_next(&p_buffer->msg) == SALT_SUCCESS);
+    assert_int_equal(p_buffer->msg.read.message_size, 6);
+    assert_memory_equal(p_buffer->msg.read.p_payload, "second", 6);
+    assert_true(salt_dispatch_release(&test->dispatch, p_buffer) == SALT_SUCCESS);
+
+    salt_mock_delete(mock);
+}
+
+static void dispatch_invalid(void **state)
+{
+    dispatch_test_t *test = (dispatch_test_t *) *state;
+
+    assert_true(salt_dispatch_init(&test->dispatch, test->buffers, 3U,
+                                   test->memory, DISPATCH_BUF_SIZE,
+                                   test->workers, DISPATCH_WORKERS,
+                                   test->slots) == SALT_ERROR);
+    assert_true(salt_dispatch_init(&test->dispatch, test->buffers, 1U,
+                                   test->memory, DISPATCH_BUF_SIZE,
+                                   test->workers, DISPATCH_WORKERS,
+                                   test->slots) == SALT_ERROR);
+    assert_true(salt_dispatch_init(&test->dispatch, test->buffers, DISPATCH_BUFFERS,
+                                   test->memory, DISPATCH_BUF_SIZE,
+                                   test->workers, 0,
+                                   test->slots) == SALT_ERROR);
+    assert_true(salt_dispatch_init(&test->dispatch, test->buffers, DISPATCH_BUFFERS,
+                                   NULL, DISPATCH_BUF_SIZE,
+                                   test->workers, DISPATCH_WORKERS,
+                                   test->slots) == SALT_ERROR);
+    assert_true(salt_dispatch_init(&test->dispatch, test->buffers, DISPATCH_BUFFERS,
+                                   test->memory, DISPATCH_BUF_SIZE,
+                                   test->workers, DISPATCH_WORKERS,
+                                   NULL) == SALT_ERROR);
+
+    assert_null(salt_dispatch_acquire(NULL));
+    assert_null(salt_dispatch_take(&test->dispatch, DISPATCH_WORKERS));
+    assert_true(salt_dispatch_post(&test->dispatch, NULL, 0) == SALT_ERROR);
+    assert_true(salt_dispatch_release(NULL, &test->buffers[0]) == SALT_ERROR);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(dispatch_pool, setup, teardown),
+        cmocka_unit_test_setup_teardown(dispatch_order, setup, teardown),
+        cmocka_unit_test_setup_teardown(dispatch_record, setup, teardown),
+        cmocka_unit_test_setup_teardown(dispatch_invalid, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
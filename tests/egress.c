@@ -0,0 +1,264 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "cfifo.h"
+#include "salt.h"
+#include "salt_egress.h"
+#include "salt_mock.h"
+#include "test_data.h"
+
+#define EGRESS_SESSIONS     (3U)
+#define EGRESS_RECORDS      (8U)
+#define EGRESS_BUF_SIZE     (1024U)
+
+typedef struct egress_test_s {
+    salt_mock_t             *mocks[EGRESS_SESSIONS];
+    salt_egress_t           egress;
+    salt_egress_session_t   sessions[EGRESS_SESSIONS];
+    salt_egress_record_t    queues[EGRESS_SESSIONS][EGRESS_RECORDS];
+    salt_msg_t              msgs[EGRESS_SESSIONS][EGRESS_RECORDS];
+    uint8_t                 buffers[EGRESS_SESSIONS][EGRESS_RECORDS][EGRESS_BUF_SIZE];
+    uint8_t                 rx_buffer[EGRESS_BUF_SIZE];
+} egress_test_t;
+
+static int setup(void **state) {
+    egress_test_t *test = malloc(sizeof(egress_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    salt_mocks_create_established(test->mocks, EGRESS_SESSIONS);
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    egress_test_t *test = (egress_test_t *) *state;
+    salt_mocks_delete(test->mocks, EGRESS_SESSIONS);
+    free(test);
+    return 0;
+}
+
+static void egress_init(egress_test_t *test, uint32_t quantum, uint32_t weight0, uint32_t weight1)
+{
+    uint32_t weights[EGRESS_SESSIONS] = { weight0, weight1, 1U };
+
+    assert_true(salt_egress_init(&test->egress, quantum) == SALT_SUCCESS);
+    for (uint32_t i = 0; i < EGRESS_SESSIONS; i++) {
+        assert_true(salt_egress_session_init(&test->sessions[i], test->mocks[i]->host_channel,
+                                             test->queues[i], EGRESS_RECORDS,
+                                             weights[i]) == SALT_SUCCESS);
+    }
+}
+
+/* Prepares record n of a session with size bytes of payload. */
+static salt_msg_t *egress_prepare(egress_test_t *test, uint32_t session, uint32_t n, uint32_t size)
+{
+    salt_msg_t *p_msg = &test->msgs[session][n];
+    uint8_t payload[EGRESS_BUF_SIZE];
+
+    memset(payload, (int) n, size);
+    assert_true(salt_write_begin(test->buffers[session][n], EGRESS_BUF_SIZE, p_msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(p_msg, payload, size) == SALT_SUCCESS);
+
+    return p_msg;
+}
+
+/* Prepares and queues a record, returns the cost charged for it. */
+static uint32_t egress_queue(egress_test_t *test, uint32_t session, uint32_t n, uint32_t size)
+{
+    salt_msg_t *p_msg = egress_prepare(test, session, n, size);
+
+    assert_true(salt_egress_queue(&test->egress, &test->sessions[session], p_msg, false) == SALT_SUCCESS);
+
+    return p_msg->write.buffer_size - p_msg->write.buffer_available;
+}
+
+/* Runs the scheduler and checks which session each record was sent for. */
+static void egress_expect(egress_test_t *test, const uint32_t *p_order, uint32_t count)
+{
+    salt_egress_session_t *p_session;
+
+    for (uint32_t i = 0; i < count; i++) {
+        assert_true(salt_egress_execute(&test->egress, &p_session) == SALT_SUCCESS);
+        assert_ptr_equal(p_session, &test->sessions[p_order[i]]);
+    }
+    assert_true(salt_egress_execute(&test->egress, &p_session) == SALT_PENDING);
+    assert_null(p_session);
+    assert_int_equal(test->egress.queued, 0);
+}
+
+/* Reads the next record of a session on the client side. */
+static void egress_receive(egress_test_t *test, uint32_t session, uint32_t n, uint32_t size)
+{
+    salt_msg_t rx_msg;
+    uint8_t payload[EGRESS_BUF_SIZE];
+
+    memset(payload, (int) n, size);
+    assert_true(salt_read_begin(test->mocks[session]->client_channel, test->rx_buffer,
+                                sizeof(test->rx_buffer), &rx_msg) == SALT_SUCCESS);
+    assert_int_equal(rx_msg.read.message_size, size);
+    assert_memory_equal(rx_msg.read.p_payload, payload, size);
+}
+
+static void egress_interactive(void **state)
+{
+    egress_test_t *test = (egress_test_t *) *state;
+    /* The small records are sent after one bulk record, not after all. */
+    const uint32_t order[] = { 0, 1, 1, 0, 0, 0 };
+    uint32_t cost = 0;
+
+    egress_init(test, 600U, 1U, 1U);
+    for (uint32_t n = 0; n < 4U; n++) {
+        cost = egress_queue(test, 0, n, 400U);
+    }
+    egress_queue(test, 1, 0, 10U);
+    egress_queue(test, 1, 1, 10U);
+    assert_int_equal(test->egress.queued, 6);
+
+    /* One bulk record per turn fits in the credit, two do not. */
+    assert_true((cost <= 600U) && (2U * cost > 600U));
+
+    egress_expect(test, order, sizeof(order) / sizeof(order[0]));
+
+    for (uint32_t n = 0; n < 4U; n++) {
+        egress_receive(test, 0, n, 400U);
+    }
+    egress_receive(test, 1, 0, 10U);
+    egress_receive(test, 1, 1, 10U);
+}
+
+static void egress_weight(void **state)
+{
+    egress_test_t *test = (egress_test_t *) *state;
+    const uint32_t order[] = { 0, 1, 1, 1, 0, 1, 1, 1, 0, 0 };
+    salt_msg_t *p_msg;
+    uint32_t cost;
+
+    /* Equal records, the quantum is one record. */
+    p_msg = egress_prepare(test, 0, 0, 100U);
+    cost = p_msg->write.buffer_size - p_msg->write.buffer_available;
+    egress_init(test, cost, 1U, 3U);
+    for (uint32_t n = 0; n < 4U; n++) {
+        egress_queue(test, 0, n, 100U);
+        egress_queue(test, 1, n, 100U);
+    }
+    for (uint32_t n = 4U; n < 6U; n++) {
+        egress_queue(test, 1, n, 100U);
+    }
+
+    egress_expect(test, order, sizeof(order) / sizeof(order[0]));
+
+    for (uint32_t n = 0; n < 4U; n++) {
+        egress_receive(test, 0, n, 100U);
+    }
+    for (uint32_t n = 0; n < 6U; n++) {
+        egress_receive(test, 1, n, 100U);
+    }
+}
+
+static void egress_pending(void **state)
+{
+    egress_test_t *test = (egress_test_t *) *state;
+    salt_egress_session_t *p_session;
+    uint32_t sent[EGRESS_SESSIONS] = { 0U, 0U, 0U };
+
+    egress_init(test, EGRESS_BUF_SIZE, 1U, 1U);
+
+    /* The link of session 0 holds two of its records, the others drain. */
+    for (uint32_t n = 0; n < 3U; n++) {
+        egress_queue(test, 0, n, 900U);
+        egress_queue(test, 1, n, 10U);
+        egress_queue(test, 2, n, 10U);
+    }
+    while (salt_egress_execute(&test->egress, &p_session) == SALT_SUCCESS) {
+        sent[p_session - test->sessions]++;
+        assert_true((sent[0] + sent[1] + sent[2]) < 9U);
+    }
+    assert_ptr_equal(p_session, &test->sessions[0]);
+    assert_int_equal(sent[0], 2);
+    assert_int_equal(sent[1], 3);
+    assert_int_equal(sent[2], 3);
+    assert_int_equal(test->egress.queued, 1);
+
+    /* The write of session 0 stays pending, a new record of session 1 is sent. */
+    egress_queue(test, 1, 3, 10U);
+    assert_true(salt_egress_execute(&test->egress, &p_session) == SALT_SUCCESS);
+    assert_ptr_equal(p_session, &test->sessions[1]);
+    assert_true(salt_egress_execute(&test->egress, &p_session) == SALT_PENDING);
+    assert_ptr_equal(p_session, &test->sessions[0]);
+
+    /* The partly written record is completed when the peer reads. */
+    egress_receive(test, 0, 0, 900U);
+    assert_true(salt_egress_execute(&test->egress, &p_session) == SALT_SUCCESS);
+    assert_ptr_equal(p_session, &test->sessions[0]);
+    assert_int_equal(test->egress.queued, 0);
+
+    for (uint32_t n = 1; n < 3U; n++) {
+        egress_receive(test, 0, n, 900U);
+    }
+    for (uint32_t n = 0; n < 4U; n++) {
+        egress_receive(test, 1, n, 10U);
+    }
+    for (uint32_t n = 0; n < 3U; n++) {
+        egress_receive(test, 2, n, 10U);
+    }
+}
+
+static void egress_error(void **state)
+{
+    egress_test_t *test = (egress_test_t *) *state;
+    salt_egress_session_t *p_session;
+
+    egress_init(test, EGRESS_BUF_SIZE, 1U, 1U);
+    for (uint32_t n = 0; n < 3U; n++) {
+        egress_queue(test, 0, n, 10U);
+    }
+    egress_queue(test, 1, 0, 10U);
+
+    /* The records of the failed session are removed, the other is sent. */
+    test->mocks[0]->host_channel->state = SALT_SESSION_CLOSED;
+    assert_true(salt_egress_execute(&test->egress, &p_session) == SALT_ERROR);
+    assert_ptr_equal(p_session, &test->sessions[0]);
+    assert_int_equal(test->egress.queued, 1);
+    assert_true(salt_egress_execute(&test->egress, &p_session) == SALT_SUCCESS);
+    assert_ptr_equal(p_session, &test->sessions[1]);
+    egress_receive(test, 1, 0, 10U);
+
+    /* Removed by the application. */
+    egress_queue(test, 1, 1, 10U);
+    salt_egress_remove(&test->egress, &test->sessions[1]);
+    assert_int_equal(test->egress.queued, 0);
+    assert_true(salt_egress_execute(&test->egress, &p_session) == SALT_PENDING);
+    assert_null(p_session);
+
+    /* Full queue. */
+    for (uint32_t n = 0; n < EGRESS_RECORDS; n++) {
+        egress_queue(test, 1, n, 10U);
+    }
+    assert_true(salt_egress_queue(&test->egress, &test->sessions[1],
+                                  &test->msgs[1][0], false) == SALT_ERROR);
+
+    assert_true(salt_egress_init(&test->egress, 0) == SALT_ERROR);
+    assert_true(salt_egress_session_init(&test->sessions[0], test->mocks[0]->host_channel,
+                                         test->queues[0], 3U, 1U) == SALT_ERROR);
+    assert_true(salt_egress_session_init(&test->sessions[0], test->mocks[0]->host_channel,
+                                         test->queues[0], EGRESS_RECORDS, 0U) == SALT_ERROR);
+    assert_true(salt_egress_queue(&test->egress, &test->sessions[0], NULL, false) == SALT_ERROR);
+    assert_true(salt_egress_execute(NULL, &p_session) == SALT_ERROR);
+    assert_null(p_session);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(egress_interactive, setup, teardown),
+        cmocka_unit_test_setup_teardown(egress_weight, setup, teardown),
+        cmocka_unit_test_setup_teardown(egress_pending, setup, teardown),
+        cmocka_unit_test_setup_teardown(egress_error, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,194 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "cfifo.h"
+#include "salt.h"
+#include "salti_util.h"
+#include "salt_mock.h"
+#include "test_data.h"
+
+#define HANDOVER_BUF_SIZE   (512U)
+
+typedef struct handover_test_s {
+    salt_mock_t     *mock;
+    salt_channel_t  new_host;
+    uint8_t         state[SALT_EXPORT_SIZE + HANDOVER_BUF_SIZE];
+    uint8_t         rx_buffer[HANDOVER_BUF_SIZE];
+    uint8_t         tx_buffer[HANDOVER_BUF_SIZE];
+} handover_test_t;
+
+static int setup(void **state) {
+    handover_test_t *test = malloc(sizeof(handover_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    test->mock = salt_mock_create();
+    salt_mock_handshake(test->mock);
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    handover_test_t *test = (handover_test_t *) *state;
+    salt_mock_delete(test->mock);
+    free(test);
+    return 0;
+}
+
+/* Creates the channel of the new process on the same I/O as the old host. */
+static void new_host_create(handover_test_t *test)
+{
+    salt_channel_t *p_old = test->mock->host_channel;
+
+    assert_true(salt_create(&test->new_host, SALT_SERVER,
+                            p_old->write_impl, p_old->read_impl,
+                            p_old->time_impl) == SALT_SUCCESS);
+    assert_true(salt_set_context(&test->new_host,
+                                 p_old->write_channel.p_context,
+                                 p_old->read_channel.p_context) == SALT_SUCCESS);
+}
+
+static void send_message(salt_channel_t *p_channel, uint8_t *p_buffer, uint8_t value)
+{
+    uint8_t message[16];
+    salt_msg_t msg;
+
+    memset(message, value, sizeof(message));
+    assert_true(salt_write_begin(p_buffer, HANDOVER_BUF_SIZE, &msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&msg, message, sizeof(message)) == SALT_SUCCESS);
+    assert_true(salt_write_execute(p_channel, &msg, false) == SALT_SUCCESS);
+}
+
+static void receive_message(salt_channel_t *p_channel, uint8_t *p_buffer, uint8_t value)
+{
+    uint8_t expected[16];
+    salt_msg_t msg;
+
+    memset(expected, value, sizeof(expected));
+    assert_true(salt_read_begin(p_channel, p_buffer, HANDOVER_BUF_SIZE, &msg) == SALT_SUCCESS);
+    assert_int_equal(msg.read.message_size, sizeof(expected));
+    assert_memory_equal(msg.read.p_payload, expected, sizeof(expected));
+}
+
+static void handover_continue(void **state)
+{
+    handover_test_t *test = (handover_test_t *) *state;
+    salt_channel_t *p_client = test->mock->client_channel;
+    salt_channel_t *p_host = test->mock->host_channel;
+    salt_msg_t msg;
+    uint32_t size;
+
+    send_message(p_client, test->tx_buffer, 0x01);
+    receive_message(p_host, test->rx_buffer, 0x01);
+
+    assert_true(salt_export_session(p_host, test->state, sizeof(test->state), &size) == SALT_SUCCESS);
+    assert_int_equal(size, SALT_EXPORT_SIZE);
+
+    /* The old process can not use the session after the export. */
+    assert_int_equal(p_host->state, SALT_SESSION_CLOSED);
+    assert_true(salt_write_begin(test->tx_buffer, HANDOVER_BUF_SIZE, &msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&msg, test->state, 1) == SALT_SUCCESS);
+    assert_true(salt_write_execute(p_host, &msg, false) == SALT_ERROR);
+
+    new_host_create(test);
+    assert_true(salt_import_session(&test->new_host, test->state, size, NULL, 0) == SALT_SUCCESS);
+    assert_int_equal(test->new_host.state, SALT_SESSION_ESTABLISHED);
+
+    /* Both directions continue without a new handshake. */
+    send_message(p_client, test->tx_buffer, 0x02);
+    receive_message(&test->new_host, test->rx_buffer, 0x02);
+    send_message(&test->new_host, test->tx_buffer, 0x03);
+    receive_message(p_client, test->rx_buffer, 0x03);
+}
+
+static void handover_partial_record(void **state)
+{
+    handover_test_t *test = (handover_test_t *) *state;
+    salt_channel_t *p_client = test->mock->client_channel;
+    salt_channel_t *p_host = test->mock->host_channel;
+    uint8_t record[HANDOVER_BUF_SIZE];
+    salt_msg_t msg;
+    size_t record_size = sizeof(record);
+    size_t first_size = 10;
+    size_t rest_size;
+    uint32_t size;
+
+    send_message(p_client, test->tx_buffer, 0x04);
+
+    /* Only the size and a part of the record has arrived to the old host. */
+    assert_true(cfifo_read(test->mock->client_to_host, record, &record_size) == CFIFO_SUCCESS);
+    assert_true(cfifo_write(test->mock->client_to_host, record, &first_size) == CFIFO_SUCCESS);
+    assert_true(salt_read_begin(p_host, test->rx_buffer, HANDOVER_BUF_SIZE, &msg) == SALT_PENDING);
+
+    assert_true(salt_export_session(p_host, test->state, sizeof(test->state), &size) == SALT_SUCCESS);
+    assert_int_equal(size, SALT_EXPORT_SIZE + first_size - 4U);
+
+    new_host_create(test);
+    memset(test->rx_buffer, 0x00, sizeof(test->rx_buffer));
+    assert_true(salt_import_session(&test->new_host, test->state, size,
+                                    test->rx_buffer, HANDOVER_BUF_SIZE) == SALT_SUCCESS);
+
+    rest_size = record_size - first_size;
+    assert_true(cfifo_write(test->mock->client_to_host, &record[first_size], &rest_size) == CFIFO_SUCCESS);
+    receive_message(&test->new_host, test->rx_buffer, 0x04);
+}
+
+static void handover_pending_write(void **state)
+{
+    handover_test_t *test = (handover_test_t *) *state;
+    salt_channel_t *p_host = test->mock->host_channel;
+    uint8_t fill[2048];
+    size_t fill_size;
+    salt_msg_t msg;
+    uint32_t size;
+
+    /* Leave room for only a part of the next record. */
+    fill_size = cfifo_available(test->mock->host_to_client) - 8U;
+    memset(fill, 0x00, sizeof(fill));
+    assert_true(cfifo_write(test->mock->host_to_client, fill, &fill_size) == CFIFO_SUCCESS);
+
+    assert_true(salt_write_begin(test->tx_buffer, HANDOVER_BUF_SIZE, &msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&msg, fill, 16) == SALT_SUCCESS);
+    assert_true(salt_write_execute(p_host, &msg, false) == SALT_PENDING);
+
+    assert_true(salt_export_session(p_host, test->state, sizeof(test->state), &size) == SALT_PENDING);
+    assert_int_equal(p_host->state, SALT_SESSION_ESTABLISHED);
+}
+
+static void handover_invalid(void **state)
+{
+    handover_test_t *test = (handover_test_t *) *state;
+    salt_channel_t *p_host = test->mock->host_channel;
+    salt_channel_t client;
+    uint32_t size;
+
+    assert_true(salt_export_session(p_host, test->state, SALT_EXPORT_SIZE - 1U, &size) == SALT_ERROR);
+    assert_int_equal(p_host->err_code, SALT_ERR_BUFF_TO_SMALL);
+
+    assert_true(salt_export_session(test->mock->client_channel, test->state,
+                                    sizeof(test->state), &size) == SALT_SUCCESS);
+
+    /* The exported session must be imported with the same mode. */
+    new_host_create(test);
+    assert_true(salt_import_session(&test->new_host, test->state, size, NULL, 0) == SALT_ERROR);
+    assert_int_equal(test->new_host.err_code, SALT_ERR_BAD_PROTOCOL);
+
+    assert_true(salt_create(&client, SALT_CLIENT,
+                            p_host->write_impl, p_host->read_impl, NULL) == SALT_SUCCESS);
+    assert_true(salt_import_session(&client, test->state, size - 1U, NULL, 0) == SALT_ERROR);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(handover_continue, setup, teardown),
+        cmocka_unit_test_setup_teardown(handover_partial_record, setup, teardown),
+        cmocka_unit_test_setup_teardown(handover_pending_write, setup, teardown),
+        cmocka_unit_test_setup_teardown(handover_invalid, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,272 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "salt.h"
+#include "salt_io.h"
+
+#define HANDOVER_IO_SEGMENT     "/salt_test_handover_io"
+#define HANDOVER_IO_BUF_SIZE    (256U)
+
+typedef struct handover_io_test_s {
+    int             socks[2];       /**< Client and host end of the session. */
+    int             unix_socks[2];  /**< Old and new process end of the handover. */
+    salt_channel_t  client;
+    salt_channel_t  host;
+    uint8_t         *p_segment;
+    uint8_t         buffer[HANDOVER_IO_BUF_SIZE];
+    uint8_t         client_hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
+    uint8_t         host_hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
+} handover_io_test_t;
+
+static void set_blocking(int sock, bool blocking)
+{
+    int flags = fcntl(sock, F_GETFL, 0);
+
+    assert_true(flags >= 0);
+    flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+    assert_true(fcntl(sock, F_SETFL, flags) == 0);
+}
+
+static void handshake(handover_io_test_t *test)
+{
+    salt_ret_t host_ret = SALT_PENDING;
+    salt_ret_t client_ret = SALT_PENDING;
+
+    assert_true(salt_create(&test->client, SALT_CLIENT, my_write_nonblock, my_read_nonblock, NULL) == SALT_SUCCESS);
+    assert_true(salt_set_context(&test->client, &test->socks[0], &test->socks[0]) == SALT_SUCCESS);
+    assert_true(salt_create_signature(&test->client) == SALT_SUCCESS);
+    assert_true(salt_init_session(&test->client, test->client_hndsk_buffer,
+                                  sizeof(test->client_hndsk_buffer)) == SALT_SUCCESS);
+
+    assert_true(salt_create(&test->host, SALT_SERVER, my_write_nonblock, my_read_nonblock, NULL) == SALT_SUCCESS);
+    assert_true(salt_set_context(&test->host, &test->socks[1], &test->socks[1]) == SALT_SUCCESS);
+    assert_true(salt_create_signature(&test->host) == SALT_SUCCESS);
+    assert_true(salt_init_session(&test->host, test->host_hndsk_buffer,
+                                  sizeof(test->host_hndsk_buffer)) == SALT_SUCCESS);
+
+    /* Both ends run in this process, the sockets must not block. */
+    set_blocking(test->socks[0], false);
+    set_blocking(test->socks[1], false);
+
+    while ((host_ret | client_ret) != SALT_SUCCESS) {
+        client_ret = salt_handshake(&test->client, NULL);
+        assert_true(client_ret != SALT_ERROR);
+        host_ret = salt_handshake(&test->host, NULL);
+        assert_true(host_ret != SALT_ERROR);
+    }
+
+    /* The new process blocks on its end of the session. */
+    set_blocking(test->socks[0], true);
+    set_blocking(test->socks[1], true);
+}
+
+static int setup(void **state) {
+    handover_io_test_t *test = malloc(sizeof(handover_io_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    if ((socketpair(AF_UNIX, SOCK_STREAM, 0, test->socks) < 0) ||
+        (socketpair(AF_UNIX, SOCK_STREAM, 0, test->unix_socks) < 0)) {
+        free(test);
+        return -1;
+    }
+    test->p_segment = NULL;
+    /* Left by an earlier run that failed. */
+    shm_unlink(HANDOVER_IO_SEGMENT);
+    handshake(test);
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    handover_io_test_t *test = (handover_io_test_t *) *state;
+    salt_io_shm_close(test->p_segment, SALT_EXPORT_SIZE);
+    close(test->socks[0]);
+    close(test->socks[1]);
+    close(test->unix_socks[0]);
+    close(test->unix_socks[1]);
+    free(test);
+    return 0;
+}
+
+static void send_message(salt_channel_t *p_channel, uint8_t *p_buffer, uint8_t value)
+{
+    uint8_t message[16];
+    salt_msg_t msg;
+
+    memset(message, value, sizeof(message));
+    assert_true(salt_write_begin(p_buffer, HANDOVER_IO_BUF_SIZE, &msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&msg, message, sizeof(message)) == SALT_SUCCESS);
+    assert_true(salt_write_execute(p_channel, &msg, false) == SALT_SUCCESS);
+}
+
+static void receive_message(salt_channel_t *p_channel, uint8_t *p_buffer, uint8_t value)
+{
+    uint8_t expected[16];
+    salt_msg_t msg;
+
+    memset(expected, value, sizeof(expected));
+    assert_true(salt_read_begin(p_channel, p_buffer, HANDOVER_IO_BUF_SIZE, &msg) == SALT_SUCCESS);
+    assert_int_equal(msg.read.message_size, sizeof(expected));
+    assert_memory_equal(msg.read.p_payload, expected, sizeof(expected));
+}
+
+/*
+ * The new process, cmocka can not be used after fork. Takes over the host
+ * session and echoes one message.
+ */
+static int new_process(int unix_sock)
+{
+    salt_channel_t channel;
+    uint8_t rx_buffer[HANDOVER_IO_BUF_SIZE];
+    uint8_t tx_buffer[HANDOVER_IO_BUF_SIZE];
+    salt_msg_t rx_msg;
+    salt_msg_t tx_msg;
+    uint8_t *p_segment;
+    uint32_t size;
+    uint32_t count;
+    int sock;
+
+    if ((salt_io_recv_fds(unix_sock, &sock, 1, &count) != SALT_SUCCESS) || (1 != count)) {
+        return 1;
+    }
+
+    p_segment = salt_io_shm_open(HANDOVER_IO_SEGMENT, &size);
+    if (NULL == p_segment) {
+        return 2;
+    }
+
+    if ((salt_create(&channel, SALT_SERVER, my_write_nonblock, my_read_nonblock, NULL) != SALT_SUCCESS) ||
+        (salt_set_context(&channel, &sock, &sock) != SALT_SUCCESS) ||
+        (salt_import_session(&channel, p_segment, size, NULL, 0) != SALT_SUCCESS)) {
+        return 3;
+    }
+
+    salt_io_shm_wipe(p_segment, size);
+    salt_io_shm_close(p_segment, size);
+    if (salt_io_handover_ack(unix_sock) != SALT_SUCCESS) {
+        return 4;
+    }
+
+    if ((salt_read_begin(&channel, rx_buffer, sizeof(rx_buffer), &rx_msg) != SALT_SUCCESS) ||
+        (salt_write_begin(tx_buffer, sizeof(tx_buffer), &tx_msg) != SALT_SUCCESS) ||
+        (salt_write_next(&tx_msg, rx_msg.read.p_payload, rx_msg.read.message_size) != SALT_SUCCESS) ||
+        (salt_write_execute(&channel, &tx_msg, false) != SALT_SUCCESS)) {
+        return 5;
+    }
+
+    close(sock);
+
+    return 0;
+}
+
+/* The new process opens the segment and then dies before it acknowledged. */
+static int failing_process(int unix_sock)
+{
+    uint8_t *p_segment;
+    uint32_t size;
+    uint32_t count;
+    int sock;
+
+    if (salt_io_recv_fds(unix_sock, &sock, 1, &count) == SALT_SUCCESS) {
+        close(sock);
+    }
+
+    p_segment = salt_io_shm_open(HANDOVER_IO_SEGMENT, &size);
+    salt_io_shm_close(p_segment, size);
+
+    return 0;
+}
+
+static pid_t handover_start(handover_io_test_t *test, int (*p_process)(int))
+{
+    uint32_t size;
+    pid_t pid;
+
+    pid = fork();
+    assert_true(pid >= 0);
+    if (0 == pid) {
+        close(test->socks[1]);
+        close(test->unix_socks[0]);
+        _exit(p_process(test->unix_socks[1]));
+    }
+    close(test->unix_socks[1]);
+    test->unix_socks[1] = -1;
+
+    test->p_segment = salt_io_shm_create(HANDOVER_IO_SEGMENT, SALT_EXPORT_SIZE);
+    assert_non_null(test->p_segment);
+    assert_true(salt_export_session(&test->host, test->p_segment, SALT_EXPORT_SIZE, &size) == SALT_SUCCESS);
+    assert_int_equal(size, SALT_EXPORT_SIZE);
+    assert_true(salt_io_send_fds(test->unix_socks[0], &test->socks[1], 1) == SALT_SUCCESS);
+
+    return pid;
+}
+
+static void handover_io_takeover(void **state)
+{
+    handover_io_test_t *test = (handover_io_test_t *) *state;
+    uint8_t wiped[SALT_EXPORT_SIZE];
+    int status;
+    pid_t pid;
+
+    pid = handover_start(test, new_process);
+    assert_true(salt_io_handover_wait(test->unix_socks[0]) == SALT_SUCCESS);
+
+    /* The new process wiped the state in the segment of the old process. */
+    memset(wiped, 0x00, sizeof(wiped));
+    assert_memory_equal(test->p_segment, wiped, sizeof(wiped));
+    salt_io_shm_close(test->p_segment, SALT_EXPORT_SIZE);
+    test->p_segment = NULL;
+
+    /* The session continues in the new process without a new handshake. */
+    send_message(&test->client, test->buffer, 0x5A);
+    receive_message(&test->client, test->buffer, 0x5A);
+
+    assert_true(waitpid(pid, &status, 0) == pid);
+    assert_true(WIFEXITED(status));
+    assert_int_equal(WEXITSTATUS(status), 0);
+}
+
+static void handover_io_resume(void **state)
+{
+    handover_io_test_t *test = (handover_io_test_t *) *state;
+    salt_channel_t resumed;
+    int status;
+    pid_t pid;
+
+    pid = handover_start(test, failing_process);
+    assert_true(salt_io_handover_wait(test->unix_socks[0]) == SALT_ERROR);
+    assert_true(waitpid(pid, &status, 0) == pid);
+
+    /* The state is still in the segment, the old process resumes the session. */
+    assert_true(salt_create(&resumed, SALT_SERVER, my_write_nonblock, my_read_nonblock, NULL) == SALT_SUCCESS);
+    assert_true(salt_set_context(&resumed, &test->socks[1], &test->socks[1]) == SALT_SUCCESS);
+    assert_true(salt_import_session(&resumed, test->p_segment, SALT_EXPORT_SIZE, NULL, 0) == SALT_SUCCESS);
+    salt_io_shm_wipe(test->p_segment, SALT_EXPORT_SIZE);
+
+    send_message(&test->client, test->buffer, 0x01);
+    receive_message(&resumed, test->buffer, 0x01);
+    send_message(&resumed, test->buffer, 0x02);
+    receive_message(&test->client, test->buffer, 0x02);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(handover_io_takeover, setup, teardown),
+        cmocka_unit_test_setup_teardown(handover_io_resume, setup, teardown),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,258 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "cfifo.h"
+#include "salt.h"
+#include "salt_hitters.h"
+#include "salt_mock.h"
+#include "test_data.h"
+
+#define HITTERS_CAPACITY    (16U)
+#define HITTERS_INDEX       (32U)
+#define HITTERS_LIGHT       (5000U)
+#define HITTERS_BUF_SIZE    (256U)
+
+typedef struct hitters_test_s {
+    salt_hitters_t          hitters;
+    salt_hitters_entry_t    entries[HITTERS_CAPACITY];
+    uint32_t                index[HITTERS_INDEX];
+    salt_hitters_entry_t    top[HITTERS_CAPACITY];
+} hitters_test_t;
+
+static void test_key(uint8_t *p_key, uint32_t n)
+{
+    memset(p_key, 0x5A, api_crypto_sign_PUBLICKEYBYTES);
+    memcpy(p_key, &n, sizeof(n));
+}
+
+static int setup(void **state) {
+    hitters_test_t *test = malloc(sizeof(hitters_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    assert_true(salt_hitters_init(&test->hitters, test->entries, HITTERS_CAPACITY,
+                                  test->index, HITTERS_INDEX) == SALT_SUCCESS);
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    free(*state);
+    return 0;
+}
+
+/* Checks the heap order and that the index points at every counter. */
+static void hitters_check(const salt_hitters_t *p_hitters)
+{
+    uint32_t used = 0;
+
+    for (uint32_t pos = 1; pos < p_hitters->size; pos++) {
+        assert_true(p_hitters->p_entries[(pos - 1U) / 2U].count <= p_hitters->p_entries[pos].count);
+    }
+    for (uint32_t pos = 0; pos < p_hitters->size; pos++) {
+        assert_int_equal(p_hitters->p_index[p_hitters->p_entries[pos].slot], pos + 1U);
+    }
+    for (uint32_t slot = 0; slot <= p_hitters->mask; slot++) {
+        used += (0U != p_hitters->p_index[slot]) ? 1U : 0U;
+    }
+    assert_int_equal(used, p_hitters->size);
+}
+
+static void hitters_exact(void **state)
+{
+    hitters_test_t *test = (hitters_test_t *) *state;
+    uint8_t key[api_crypto_sign_PUBLICKEYBYTES];
+    uint32_t n;
+
+    /* Fewer peers than counters are counted exactly. */
+    for (uint32_t round = 0; round < 10U; round++) {
+        for (uint32_t i = 0; i < 8U; i++) {
+            test_key(key, i);
+            assert_true(salt_hitters_add(&test->hitters, key, i + 1U) == SALT_SUCCESS);
+        }
+    }
+    hitters_check(&test->hitters);
+    assert_int_equal(test->hitters.size, 8);
+    assert_int_equal(test->hitters.total, 360);
+
+    n = salt_hitters_report(&test->hitters, test->top, 3U);
+    assert_int_equal(n, 3);
+    for (uint32_t i = 0; i < n; i++) {
+        test_key(key, 7U - i);
+        assert_memory_equal(test->top[i].key, key, sizeof(key));
+        assert_int_equal(test->top[i].count, 10U * (8U - i));
+        assert_int_equal(test->top[i].error, 0);
+    }
+
+    n = salt_hitters_report(&test->hitters, test->top, HITTERS_CAPACITY);
+    assert_int_equal(n, 8);
+    for (uint32_t i = 1; i < n; i++) {
+        assert_true(test->top[i - 1U].count > test->top[i].count);
+    }
+
+    assert_int_equal(salt_hitters_report(&test->hitters, test->top, 0U), 0);
+}
+
+static void hitters_skewed(void **state)
+{
+    hitters_test_t *test = (hitters_test_t *) *state;
+    uint8_t key[api_crypto_sign_PUBLICKEYBYTES];
+    uint32_t n;
+
+    /*
+     * Four heavy peers have 1250 each, among 5000 peers with 1 each. Each heavy
+     * peer has more than total / capacity and keeps its counter.
+     */
+    for (uint32_t i = 0; i < HITTERS_LIGHT; i++) {
+        test_key(key, 1000U + i);
+        assert_true(salt_hitters_add(&test->hitters, key, 1U) == SALT_SUCCESS);
+        test_key(key, i % 4U);
+        assert_true(salt_hitters_add(&test->hitters, key, 1U) == SALT_SUCCESS);
+    }
+    hitters_check(&test->hitters);
+    assert_int_equal(test->hitters.size, HITTERS_CAPACITY);
+    assert_int_equal(test->hitters.total, 2U * HITTERS_LIGHT);
+
+    n = salt_hitters_report(&test->hitters, test->top, HITTERS_CAPACITY);
+    assert_int_equal(n, HITTERS_CAPACITY);
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t id;
+        memcpy(&id, test->top[i].key, sizeof(id));
+        if (i < 4U) {
+            assert_true(id < 4U);
+            assert_true(test->top[i].count - test->top[i].error <= 1250U);
+            assert_true(test->top[i].count >= 1250U);
+        } else {
+            assert_true(id >= 1000U);
+            assert_true(test->top[i].count - test->top[i].error <= 1U);
+        }
+        if (i > 0U) {
+            assert_true(test->top[i - 1U].count >= test->top[i].count);
+        }
+    }
+}
+
+static void hitters_decay(void **state)
+{
+    hitters_test_t *test = (hitters_test_t *) *state;
+    uint8_t key[api_crypto_sign_PUBLICKEYBYTES];
+
+    for (uint32_t i = 0; i < 4U; i++) {
+        test_key(key, i);
+        assert_true(salt_hitters_add(&test->hitters, key, 1000U * (i + 1U)) == SALT_SUCCESS);
+    }
+
+    /* A peer that was heavy long ago is passed by a peer that is heavy now. */
+    salt_hitters_decay(&test->hitters, 3U);
+    hitters_check(&test->hitters);
+    assert_int_equal(test->hitters.total, 10000U >> 3);
+    test_key(key, 0);
+    assert_true(salt_hitters_add(&test->hitters, key, 600U) == SALT_SUCCESS);
+    hitters_check(&test->hitters);
+
+    assert_int_equal(salt_hitters_report(&test->hitters, test->top, 1U), 1);
+    assert_memory_equal(test->top[0].key, key, sizeof(key));
+    assert_int_equal(test->top[0].count, 725U);
+
+    salt_hitters_decay(&test->hitters, 63U);
+    assert_int_equal(salt_hitters_report(&test->hitters, test->top, 1U), 1);
+    assert_int_equal(test->top[0].count, 0);
+}
+
+/* Writes a record, reads it on the peer and returns the size on the wire. */
+static uint32_t hitters_exchange(salt_channel_t *p_writer, salt_channel_t *p_reader,
+                                 uint32_t size)
+{
+    uint8_t tx_buffer[HITTERS_BUF_SIZE];
+    uint8_t rx_buffer[HITTERS_BUF_SIZE];
+    uint8_t message[HITTERS_BUF_SIZE / 2U];
+    salt_msg_t tx_msg;
+    salt_msg_t rx_msg;
+
+    memset(message, 0x5A, size);
+    assert_true(salt_write_begin(tx_buffer, sizeof(tx_buffer), &tx_msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&tx_msg, message, size) == SALT_SUCCESS);
+    assert_true(salt_write_execute(p_writer, &tx_msg, false) == SALT_SUCCESS);
+    assert_true(salt_read_begin(p_reader, rx_buffer, sizeof(rx_buffer), &rx_msg) == SALT_SUCCESS);
+    assert_int_equal(rx_msg.read.message_size, size);
+
+    return tx_msg.write.buffer_size;
+}
+
+static void hitters_record_hook(void **state)
+{
+    hitters_test_t *test = (hitters_test_t *) *state;
+    salt_mock_t *mock = salt_mock_create();
+    salt_channel_t *p_host = mock->host_channel;
+    salt_channel_t *p_client = mock->client_channel;
+    uint64_t weight = 0;
+
+    salt_mock_handshake(mock);
+    assert_true(salt_set_record_hook(p_host, salt_hitters_record_hook,
+                                     &test->hitters) == SALT_SUCCESS);
+
+    /* Records read and written by the host are both counted for the client. */
+    for (uint32_t i = 1; i <= 4U; i++) {
+        weight += hitters_exchange(p_client, p_host, 8U * i);
+        weight += hitters_exchange(p_host, p_client, 16U * i);
+    }
+    hitters_check(&test->hitters);
+    assert_int_equal(test->hitters.total, weight);
+    assert_int_equal(salt_hitters_report(&test->hitters, test->top, 4U), 1);
+    assert_memory_equal(test->top[0].key, p_client->my_sk_pub, api_crypto_sign_PUBLICKEYBYTES);
+    assert_int_equal(test->top[0].count, weight);
+
+    /* Without the hook nothing is counted. */
+    assert_true(salt_set_record_hook(p_host, NULL, NULL) == SALT_SUCCESS);
+    (void) hitters_exchange(p_client, p_host, 8U);
+    assert_int_equal(test->hitters.total, weight);
+    assert_true(salt_set_record_hook(NULL, NULL, NULL) == SALT_ERROR);
+
+    salt_mock_delete(mock);
+}
+
+static void hitters_invalid(void **state)
+{
+    hitters_test_t *test = (hitters_test_t *) *state;
+    uint8_t key[api_crypto_sign_PUBLICKEYBYTES];
+
+    test_key(key, 0);
+    assert_true(salt_hitters_init(&test->hitters, test->entries, HITTERS_CAPACITY,
+                                  test->index, HITTERS_INDEX / 2U) == SALT_ERROR);
+    assert_true(salt_hitters_init(&test->hitters, test->entries, HITTERS_CAPACITY,
+                                  test->index, HITTERS_INDEX - 1U) == SALT_ERROR);
+    assert_true(salt_hitters_init(&test->hitters, test->entries, 0U,
+                                  test->index, HITTERS_INDEX) == SALT_ERROR);
+    assert_true(salt_hitters_init(&test->hitters, NULL, HITTERS_CAPACITY,
+                                  test->index, HITTERS_INDEX) == SALT_ERROR);
+    assert_true(salt_hitters_add(NULL, key, 1U) == SALT_ERROR);
+    assert_int_equal(salt_hitters_report(NULL, test->top, 1U), 0);
+
+    /* A single counter follows the latest peer. */
+    assert_true(salt_hitters_init(&test->hitters, test->entries, 1U,
+                                  test->index, 2U) == SALT_SUCCESS);
+    assert_true(salt_hitters_add(&test->hitters, key, 5U) == SALT_SUCCESS);
+    test_key(key, 1);
+    assert_true(salt_hitters_add(&test->hitters, key, 1U) == SALT_SUCCESS);
+    hitters_check(&test->hitters);
+    assert_int_equal(salt_hitters_report(&test->hitters, test->top, 4U), 1);
+    assert_memory_equal(test->top[0].key, key, sizeof(key));
+    assert_int_equal(test->top[0].count, 6);
+    assert_int_equal(test->top[0].error, 5);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(hitters_exact, setup, teardown),
+        cmocka_unit_test_setup_teardown(hitters_skewed, setup, teardown),
+        cmocka_unit_test_setup_teardown(hitters_decay, setup, teardown),
+        cmocka_unit_test_setup_teardown(hitters_record_hook, setup, teardown),
+        cmocka_unit_test_setup_teardown(hitters_invalid, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
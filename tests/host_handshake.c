@@ -120,6 +120,70 @@ static void host_handshake(void **state) {
 
 }
 
+static uint32_t ephemeral_calls;
+
+static salt_ret_t ephemeral_example(void *p_context, uint8_t *p_ek_pub, uint8_t *p_ek_sec)
+{
+    assert_ptr_equal(p_context, &ephemeral_calls);
+    ephemeral_calls++;
+    memcpy(p_ek_pub, salt_example_session_1_data.host_ek_pub, 32);
+    memcpy(p_ek_sec, salt_example_session_1_data.host_ek_sec, 32);
+    return SALT_SUCCESS;
+}
+
+static void host_handshake_lazy(void **state) {
+
+    salt_channel_t channel;
+    salt_ret_t ret;
+    salt_mock_t *mock = (salt_mock_t *) *state;
+    uint8_t hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
+    memset(hndsk_buffer, 0xcc, SALT_HNDSHK_BUFFER_SIZE);
+    ephemeral_calls = 0;
+
+    ret = salt_create(&channel, SALT_CLIENT, salt_write_mock, salt_read_mock, NULL);
+    assert_true(ret == SALT_SUCCESS);
+    ret = salt_set_ephemeral_source(&channel, ephemeral_example, &ephemeral_calls);
+    assert_true(ret == SALT_ERROR);
+
+    ret = salt_create(&channel, SALT_SERVER, salt_write_mock, salt_read_mock, NULL);
+    assert_true(ret == SALT_SUCCESS);
+    ret = salt_set_signature(&channel, salt_example_session_1_data.host_sk_sec);
+    assert_true(ret == SALT_SUCCESS);
+    ret = salt_set_context(&channel, mock->io->expected_write, mock->io->next_read);
+    assert_true(ret == SALT_SUCCESS);
+    ret = salt_set_ephemeral_source(&channel, ephemeral_example, &ephemeral_calls);
+    assert_true(ret == SALT_SUCCESS);
+
+    /* An invalid M1 costs no key pair. */
+    ret = salt_init_session(&channel, hndsk_buffer, SALT_HNDSHK_BUFFER_SIZE);
+    assert_true(ret == SALT_SUCCESS);
+    assert_true(channel.ek_pending);
+    salt_io_mock_set_next_read(mock->io, &salt_example_session_1_data.m1[4], sizeof(salt_example_session_1_data.m1) - 5, true);
+    ret = salt_handshake_server(&channel, NULL);
+    assert_true(ret == SALT_ERROR);
+    assert_true(SALT_ERR_BAD_PROTOCOL == channel.err_code);
+    assert_int_equal(ephemeral_calls, 0);
+
+    /* Same messages as with the key pair given at once. */
+    ret = salt_init_session(&channel, hndsk_buffer, SALT_HNDSHK_BUFFER_SIZE);
+    assert_true(ret == SALT_SUCCESS);
+    salt_io_mock_set_next_read(mock->io, salt_example_session_1_data.m1, sizeof(salt_example_session_1_data.m1), false);
+    salt_io_mock_set_next_read(mock->io, salt_example_session_1_data.m4, sizeof(salt_example_session_1_data.m4), false);
+
+    salt_io_mock_expect_next_write(mock->io, salt_example_session_1_data.m2, sizeof(salt_example_session_1_data.m2), false);
+    salt_io_mock_expect_next_write(mock->io, salt_example_session_1_data.m3, sizeof(salt_example_session_1_data.m3), false);
+
+    ret = salt_handshake_server(&channel, NULL);
+    assert_true(ret == SALT_SUCCESS);
+    assert_int_equal(ephemeral_calls, 1);
+    assert_false(channel.ek_pending);
+
+    /* The source can not be changed for an initiated session. */
+    ret = salt_set_ephemeral_source(&channel, NULL, NULL);
+    assert_true(ret == SALT_ERROR);
+
+}
+
 static void host_handshake_single_echo(void **state) {
 
     salt_channel_t channel;
@@ -273,6 +337,7 @@ int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test_setup_teardown(host_handshake, setup, teardown),
         cmocka_unit_test_setup_teardown(host_handshake_m1, setup, teardown),
+        cmocka_unit_test_setup_teardown(host_handshake_lazy, setup, teardown),
         cmocka_unit_test_setup_teardown(host_handshake_single_echo, setup, teardown),
         cmocka_unit_test_setup_teardown(host_handshake_multi_echo, setup, teardown)
     };
@@ -0,0 +1,214 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "cfifo.h"
+#include "salt.h"
+#include "salt_keyset.h"
+#include "salt_mock.h"
+#include "test_data.h"
+
+#define KEYSET_BUCKETS      (512U)
+#define KEYSET_KEYS         (1800U)
+
+typedef struct keyset_test_s {
+    salt_keyset_t           set;
+    salt_keyset_bucket_t    buckets[KEYSET_BUCKETS];
+} keyset_test_t;
+
+static void test_key(uint8_t *p_key, uint32_t n)
+{
+    memset(p_key, 0xA5, api_crypto_sign_PUBLICKEYBYTES);
+    memcpy(p_key, &n, sizeof(n));
+}
+
+static int setup(void **state) {
+    keyset_test_t *test = malloc(sizeof(keyset_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    assert_true(salt_keyset_init(&test->set, test->buckets, KEYSET_BUCKETS) == SALT_SUCCESS);
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    free(*state);
+    return 0;
+}
+
+static void keyset_add_remove(void **state)
+{
+    keyset_test_t *test = (keyset_test_t *) *state;
+    uint8_t key[api_crypto_sign_PUBLICKEYBYTES];
+
+    /* About 88 % of the slots. */
+    for (uint32_t n = 0; n < KEYSET_KEYS; n++) {
+        test_key(key, n);
+        assert_true(salt_keyset_add(&test->set, key) == SALT_SUCCESS);
+    }
+    assert_int_equal(test->set.count, KEYSET_KEYS);
+
+    /* Adding again does not change the set. */
+    test_key(key, 0);
+    assert_true(salt_keyset_add(&test->set, key) == SALT_SUCCESS);
+    assert_int_equal(test->set.count, KEYSET_KEYS);
+
+    for (uint32_t n = 0; n < 2U * KEYSET_KEYS; n++) {
+        test_key(key, n);
+        assert_true(salt_keyset_contains(&test->set, key) ==
+                    ((n < KEYSET_KEYS) ? SALT_SUCCESS : SALT_ERROR));
+    }
+
+    for (uint32_t n = 0; n < KEYSET_KEYS; n += 2U) {
+        test_key(key, n);
+        assert_true(salt_keyset_remove(&test->set, key) == SALT_SUCCESS);
+        assert_true(salt_keyset_remove(&test->set, key) == SALT_ERROR);
+    }
+    assert_int_equal(test->set.count, KEYSET_KEYS / 2U);
+
+    for (uint32_t n = 0; n < KEYSET_KEYS; n++) {
+        test_key(key, n);
+        assert_true(salt_keyset_contains(&test->set, key) ==
+                    (((n & 1U) != 0U) ? SALT_SUCCESS : SALT_ERROR));
+        assert_true(salt_keyset_allow(&test->set, key) ==
+                    (((n & 1U) != 0U) ? SALT_SUCCESS : SALT_ERROR));
+        assert_true(salt_keyset_deny(&test->set, key) ==
+                    (((n & 1U) != 0U) ? SALT_ERROR : SALT_SUCCESS));
+    }
+}
+
+static void keyset_full(void **state)
+{
+    keyset_test_t *test = (keyset_test_t *) *state;
+    uint8_t key[api_crypto_sign_PUBLICKEYBYTES];
+    uint32_t added = 0;
+
+    /* Two buckets hold at most eight keys, and one more as victim. */
+    assert_true(salt_keyset_init(&test->set, test->buckets, 2U) == SALT_SUCCESS);
+    for (;;) {
+        test_key(key, added);
+        if (salt_keyset_add(&test->set, key) != SALT_SUCCESS) {
+            break;
+        }
+        added++;
+    }
+    assert_true(added <= 2U * SALT_KEYSET_BUCKET_SLOTS + 1U);
+    assert_int_equal(test->set.count, added);
+    assert_true(0U != test->set.victim);
+
+    for (uint32_t n = 0; n < added; n++) {
+        test_key(key, n);
+        assert_true(salt_keyset_contains(&test->set, key) == SALT_SUCCESS);
+    }
+
+    /* Removing a key does not lose the victim. */
+    test_key(key, 0);
+    assert_true(salt_keyset_remove(&test->set, key) == SALT_SUCCESS);
+    assert_true(salt_keyset_contains(&test->set, key) == SALT_ERROR);
+    assert_int_equal(test->set.count, added - 1U);
+    for (uint32_t n = 1; n < added; n++) {
+        test_key(key, n);
+        assert_true(salt_keyset_contains(&test->set, key) == SALT_SUCCESS);
+    }
+}
+
+static salt_ret_t handshake(salt_mock_t *mock)
+{
+    salt_ret_t host_ret = SALT_PENDING;
+    salt_ret_t client_ret = SALT_PENDING;
+    uint8_t host_buffer[SALT_HNDSHK_BUFFER_SIZE];
+    uint8_t client_buffer[SALT_HNDSHK_BUFFER_SIZE];
+
+    assert_true(salt_init_session(mock->host_channel, host_buffer, sizeof(host_buffer)) == SALT_SUCCESS);
+    assert_true(salt_init_session(mock->client_channel, client_buffer, sizeof(client_buffer)) == SALT_SUCCESS);
+
+    while ((host_ret | client_ret) != SALT_SUCCESS) {
+        client_ret = salt_handshake(mock->client_channel, NULL);
+        assert_true(client_ret != SALT_ERROR);
+        host_ret = salt_handshake(mock->host_channel, NULL);
+        if (SALT_ERROR == host_ret) {
+            return SALT_ERROR;
+        }
+    }
+
+    return SALT_SUCCESS;
+}
+
+static void keyset_handshake(void **state)
+{
+    keyset_test_t *test = (keyset_test_t *) *state;
+    salt_mock_t *mock = salt_mock_create();
+    uint8_t key[api_crypto_sign_PUBLICKEYBYTES];
+
+    assert_true(salt_create_signature(mock->host_channel) == SALT_SUCCESS);
+    assert_true(salt_create_signature(mock->client_channel) == SALT_SUCCESS);
+
+    for (uint32_t n = 0; n < 100U; n++) {
+        test_key(key, n);
+        assert_true(salt_keyset_add(&test->set, key) == SALT_SUCCESS);
+    }
+
+    /* The client is not in the allowlist. */
+    assert_true(salt_set_peer_check(mock->host_channel, salt_keyset_allow, &test->set) == SALT_SUCCESS);
+    assert_true(handshake(mock) == SALT_ERROR);
+    assert_int_equal(mock->host_channel->err_code, SALT_ERR_BAD_PEER);
+    salt_mock_delete(mock);
+
+    /* The client is in the allowlist. */
+    mock = salt_mock_create();
+    assert_true(salt_create_signature(mock->host_channel) == SALT_SUCCESS);
+    assert_true(salt_create_signature(mock->client_channel) == SALT_SUCCESS);
+    assert_true(salt_keyset_add(&test->set, mock->client_channel->my_sk_pub) == SALT_SUCCESS);
+    assert_true(salt_set_peer_check(mock->host_channel, salt_keyset_allow, &test->set) == SALT_SUCCESS);
+    assert_true(handshake(mock) == SALT_SUCCESS);
+    assert_memory_equal(mock->host_channel->peer_sk_pub, mock->client_channel->my_sk_pub,
+                        api_crypto_sign_PUBLICKEYBYTES);
+
+    /* The check can not be changed after the handshake. */
+    assert_true(salt_set_peer_check(mock->host_channel, NULL, NULL) == SALT_ERROR);
+    salt_mock_delete(mock);
+
+    /* The client is revoked. */
+    mock = salt_mock_create();
+    assert_true(salt_create_signature(mock->host_channel) == SALT_SUCCESS);
+    assert_true(salt_create_signature(mock->client_channel) == SALT_SUCCESS);
+    assert_true(salt_keyset_add(&test->set, mock->client_channel->my_sk_pub) == SALT_SUCCESS);
+    assert_true(salt_set_peer_check(mock->host_channel, salt_keyset_deny, &test->set) == SALT_SUCCESS);
+    assert_true(handshake(mock) == SALT_ERROR);
+    assert_int_equal(mock->host_channel->err_code, SALT_ERR_BAD_PEER);
+    salt_mock_delete(mock);
+}
+
+static void keyset_invalid(void **state)
+{
+    keyset_test_t *test = (keyset_test_t *) *state;
+    uint8_t key[api_crypto_sign_PUBLICKEYBYTES];
+
+    test_key(key, 0);
+    assert_true(salt_keyset_init(&test->set, test->buckets, 3U) == SALT_ERROR);
+    assert_true(salt_keyset_init(&test->set, test->buckets, 1U) == SALT_ERROR);
+    assert_true(salt_keyset_init(&test->set, NULL, KEYSET_BUCKETS) == SALT_ERROR);
+    assert_true(salt_keyset_add(NULL, key) == SALT_ERROR);
+    assert_true(salt_keyset_add(&test->set, NULL) == SALT_ERROR);
+    assert_true(salt_keyset_remove(NULL, key) == SALT_ERROR);
+    assert_true(salt_keyset_contains(NULL, key) == SALT_ERROR);
+
+    /* A check without a set rejects the peer. */
+    assert_true(salt_keyset_allow(NULL, key) == SALT_ERROR);
+    assert_true(salt_keyset_deny(NULL, key) == SALT_ERROR);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(keyset_add_remove, setup, teardown),
+        cmocka_unit_test_setup_teardown(keyset_full, setup, teardown),
+        cmocka_unit_test_setup_teardown(keyset_handshake, setup, teardown),
+        cmocka_unit_test_setup_teardown(keyset_invalid, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
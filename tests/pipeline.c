@@ -0,0 +1,437 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "cfifo.h"
+#include "salt.h"
+#include "salt_pipeline.h"
+#include "salt_mock.h"
+#include "test_data.h"
+
+#define PIPELINE_SESSIONS   (2U)
+#define PIPELINE_RECORDS    (4U)
+#define PIPELINE_CRYPTO     (2U)
+#define PIPELINE_BUF_SIZE   (256U)
+
+typedef struct pipeline_test_s {
+    salt_mock_t             *mocks[PIPELINE_SESSIONS];
+    salt_io_channel_t       rx[PIPELINE_SESSIONS];
+    salt_io_channel_t       tx[PIPELINE_SESSIONS];
+    salt_pipeline_session_t sessions[PIPELINE_SESSIONS];
+    salt_pipeline_t         pipeline;
+    salt_pipeline_record_t  records[PIPELINE_RECORDS];
+    uint8_t                 memory[PIPELINE_RECORDS][PIPELINE_BUF_SIZE];
+    salt_pipeline_ring_t    rings[SALT_PIPELINE_RINGS(2U, PIPELINE_CRYPTO)];
+    salt_pipeline_record_t  *slots[SALT_PIPELINE_SLOTS(PIPELINE_RECORDS, 1U, PIPELINE_CRYPTO)];
+    uint32_t                handled;
+    uint8_t                 scratch[PIPELINE_BUF_SIZE];
+    uint8_t                 client_buffer[PIPELINE_BUF_SIZE];
+} pipeline_test_t;
+
+/* Echoes the messages of a record, a record starting with "drop" gets no reply. */
+static salt_ret_t echo_handler(void *p_context, salt_pipeline_record_t *p_record)
+{
+    pipeline_test_t *test = (pipeline_test_t *) p_context;
+    uint16_t sizes[4];
+    uint16_t count = 0;
+    uint32_t offset = 0;
+
+    test->handled++;
+
+    do {
+        memcpy(&test->scratch[offset], p_record->msg.read.p_payload,
+               p_record->msg.read.message_size);
+        sizes[count++] = p_record->msg.read.message_size;
+        offset += p_record->msg.read.message_size;
+    } while (salt_read_next(&p_record->msg) == SALT_SUCCESS);
+
+    if ((sizes[0] == 4U) && (memcmp(test->scratch, "drop", 4) == 0)) {
+        return SALT_PENDING;
+    }
+
+    assert_true(salt_write_begin(p_record->p_data, p_record->size, &p_record->msg) == SALT_SUCCESS);
+    offset = 0;
+    for (uint16_t i = 0; i < count; i++) {
+        assert_true(salt_write_next(&p_record->msg, &test->scratch[offset], sizes[i]) == SALT_SUCCESS);
+        offset += sizes[i];
+    }
+
+    return SALT_SUCCESS;
+}
+
+static int setup(void **state) {
+    pipeline_test_t *test = malloc(sizeof(pipeline_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    memset(test, 0x00U, sizeof(pipeline_test_t));
+    salt_mocks_create_established(test->mocks, PIPELINE_SESSIONS);
+    for (uint32_t i = 0; i < PIPELINE_SESSIONS; i++) {
+        test->rx[i].p_context = test->mocks[i]->client_to_host;
+        test->tx[i].p_context = test->mocks[i]->host_to_client;
+        salt_pipeline_session_init(&test->sessions[i], i);
+    }
+    assert_true(salt_pipeline_init(&test->pipeline, test->records, PIPELINE_RECORDS,
+                                   &test->memory[0][0], PIPELINE_BUF_SIZE, 1U, PIPELINE_CRYPTO,
+                                   test->rings, test->slots, echo_handler, test) == SALT_SUCCESS);
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    pipeline_test_t *test = (pipeline_test_t *) *state;
+    salt_mocks_delete(test->mocks, PIPELINE_SESSIONS);
+    free(test);
+    return 0;
+}
+
+/* Sends a record with one message from the client of a session. */
+static void client_send(pipeline_test_t *test, uint32_t session, const char *p_text)
+{
+    salt_msg_t msg;
+
+    assert_true(salt_write_begin(test->client_buffer, sizeof(test->client_buffer), &msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&msg, (uint8_t *) p_text, (uint16_t) strlen(p_text)) == SALT_SUCCESS);
+    assert_true(salt_write_execute(test->mocks[session]->client_channel, &msg, false) == SALT_SUCCESS);
+}
+
+/* Expects a record with one message on the client of a session. */
+static void client_expect(pipeline_test_t *test, uint32_t session, const char *p_text)
+{
+    salt_msg_t msg;
+
+    assert_true(salt_read_begin(test->mocks[session]->client_channel, test->client_buffer,
+                                sizeof(test->client_buffer), &msg) == SALT_SUCCESS);
+    assert_int_equal(msg.read.messages_left, 0);
+    assert_int_equal(msg.read.message_size, strlen(p_text));
+    assert_memory_equal(msg.read.p_payload, p_text, strlen(p_text));
+}
+
+/* Reads a record of a session on the I/O thread and posts it. */
+static salt_pipeline_record_t *host_receive(pipeline_test_t *test, uint32_t session)
+{
+    salt_pipeline_record_t *p_record = salt_pipeline_acquire(&test->pipeline, 0);
+
+    assert_non_null(p_record);
+    assert_true(salt_pipeline_read(&test->rx[session], test->mocks[session]->host_channel->read_impl,
+                                   p_record) == SALT_SUCCESS);
+    assert_true(salt_pipeline_post(&test->pipeline, p_record, test->mocks[session]->host_channel,
+                                   &test->sessions[session]) == SALT_SUCCESS);
+
+    return p_record;
+}
+
+/* Takes the next handled record on the I/O thread, writes it and releases it. */
+static void host_send(pipeline_test_t *test, uint32_t session, salt_ret_t status)
+{
+    salt_pipeline_record_t *p_record = salt_pipeline_take(&test->pipeline, 0);
+
+    assert_non_null(p_record);
+    assert_int_equal(p_record->session, test->sessions[session].index);
+    assert_int_equal(p_record->status, status);
+    if (SALT_SUCCESS == status) {
+        assert_true(salt_pipeline_write(&test->tx[session], test->mocks[session]->host_channel->write_impl,
+                                        p_record) == SALT_SUCCESS);
+    }
+    else {
+        assert_true(salt_pipeline_write(&test->tx[session], test->mocks[session]->host_channel->write_impl,
+                                        p_record) == SALT_ERROR);
+    }
+    assert_true(salt_pipeline_release(&test->pipeline, p_record) == SALT_SUCCESS);
+}
+
+static void pipeline_echo(void **state)
+{
+    pipeline_test_t *test = (pipeline_test_t *) *state;
+    salt_msg_t msg;
+
+    client_send(test, 0, "s0 first");
+    client_send(test, 0, "s0 second");
+    client_send(test, 1, "s1 first");
+    for (uint32_t i = 0; i < 3U; i++) {
+        host_receive(test, (i < 2U) ? 0U : 1U);
+    }
+
+    /* Session 0 is on worker 0 and session 1 on worker 1. */
+    assert_null(salt_pipeline_take(&test->pipeline, 0));
+    assert_true(salt_pipeline_execute(&test->pipeline, 1) == SALT_SUCCESS);
+    assert_true(salt_pipeline_execute(&test->pipeline, 1) == SALT_PENDING);
+    assert_true(salt_pipeline_execute(&test->pipeline, 0) == SALT_SUCCESS);
+    assert_true(salt_pipeline_execute(&test->pipeline, 0) == SALT_SUCCESS);
+    assert_true(salt_pipeline_execute(&test->pipeline, 0) == SALT_PENDING);
+    assert_int_equal(test->handled, 3);
+
+    /* The records of a session come back in order. */
+    host_send(test, 0, SALT_SUCCESS);
+    host_send(test, 0, SALT_SUCCESS);
+    host_send(test, 1, SALT_SUCCESS);
+    assert_null(salt_pipeline_take(&test->pipeline, 0));
+
+    client_expect(test, 0, "s0 first");
+    client_expect(test, 0, "s0 second");
+    client_expect(test, 1, "s1 first");
+
+    /* Several messages in one record. */
+    assert_true(salt_write_begin(test->client_buffer, sizeof(test->client_buffer), &msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&msg, (uint8_t *) "one", 3) == SALT_SUCCESS);
+    assert_true(salt_write_next(&msg, (uint8_t *) "three", 5) == SALT_SUCCESS);
+    assert_true(salt_write_execute(test->mocks[1]->client_channel, &msg, false) == SALT_SUCCESS);
+    host_receive(test, 1);
+    assert_true(salt_pipeline_execute(&test->pipeline, 1) == SALT_SUCCESS);
+    host_send(test, 1, SALT_SUCCESS);
+
+    assert_true(salt_read_begin(test->mocks[1]->client_channel, test->client_buffer,
+                                sizeof(test->client_buffer), &msg) == SALT_SUCCESS);
+    assert_int_equal(msg.read.messages_left, 1);
+    assert_memory_equal(msg.read.p_payload, "one", 3);
+    assert_true(salt_read_next(&msg) == SALT_SUCCESS);
+    assert_int_equal(msg.read.message_size, 5);
+    assert_memory_equal(msg.read.p_payload, "three", 5);
+}
+
+static void pipeline_pending(void **state)
+{
+    pipeline_test_t *test = (pipeline_test_t *) *state;
+    salt_pipeline_record_t *p_record;
+    uint8_t wire[64];
+    size_t size = sizeof(wire);
+    size_t part = 6;
+
+    /* No reply, the next reply still uses the right nonce. */
+    client_send(test, 0, "drop");
+    client_send(test, 0, "kept");
+    host_receive(test, 0);
+    host_receive(test, 0);
+    assert_true(salt_pipeline_execute(&test->pipeline, 0) == SALT_SUCCESS);
+    assert_true(salt_pipeline_execute(&test->pipeline, 0) == SALT_SUCCESS);
+    host_send(test, 0, SALT_PENDING);
+    host_send(test, 0, SALT_SUCCESS);
+    client_expect(test, 0, "kept");
+
+    /* A record that arrives in parts is read across calls. */
+    client_send(test, 1, "partial");
+    cfifo_read(test->mocks[1]->client_to_host, wire, &size);
+    assert_true(size > part);
+    size -= part;
+    cfifo_write(test->mocks[1]->client_to_host, wire, &part);
+    p_record = salt_pipeline_acquire(&test->pipeline, 0);
+    assert_non_null(p_record);
+    assert_true(salt_pipeline_read(&test->rx[1], test->mocks[1]->host_channel->read_impl,
+                                   p_record) == SALT_PENDING);
+    cfifo_write(test->mocks[1]->client_to_host, &wire[part], &size);
+    assert_true(salt_pipeline_read(&test->rx[1], test->mocks[1]->host_channel->read_impl,
+                                   p_record) == SALT_SUCCESS);
+    assert_true(salt_pipeline_post(&test->pipeline, p_record, test->mocks[1]->host_channel,
+                                   &test->sessions[1]) == SALT_SUCCESS);
+    assert_true(salt_pipeline_execute(&test->pipeline, 1) == SALT_SUCCESS);
+    host_send(test, 1, SALT_SUCCESS);
+    client_expect(test, 1, "partial");
+}
+
+static void pipeline_error(void **state)
+{
+    pipeline_test_t *test = (pipeline_test_t *) *state;
+    salt_pipeline_record_t *p_record;
+    uint8_t big[2U * PIPELINE_BUF_SIZE];
+    salt_msg_t msg;
+
+    /* A corrupted record closes its session, the other is not affected. */
+    client_send(test, 0, "corrupted");
+    client_send(test, 1, "intact");
+    p_record = host_receive(test, 0);
+    p_record->p_data[SALT_READ_RECORD_OFFSET + p_record->length - 1U] ^= 0x01U;
+    host_receive(test, 1);
+    assert_true(salt_pipeline_execute(&test->pipeline, 0) == SALT_SUCCESS);
+    assert_true(salt_pipeline_execute(&test->pipeline, 1) == SALT_SUCCESS);
+    assert_int_equal(test->handled, 1);
+    host_send(test, 0, SALT_ERROR);
+    assert_int_equal(test->mocks[0]->host_channel->err_code, SALT_ERR_DECRYPTION);
+    host_send(test, 1, SALT_SUCCESS);
+    client_expect(test, 1, "intact");
+
+    /* A record larger than the record buffer. */
+    memset(test->scratch, 0x42U, sizeof(test->scratch));
+    assert_true(salt_write_begin(big, sizeof(big), &msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&msg, test->scratch, PIPELINE_BUF_SIZE) == SALT_SUCCESS);
+    assert_true(salt_write_execute(test->mocks[1]->client_channel, &msg, false) == SALT_SUCCESS);
+    p_record = salt_pipeline_acquire(&test->pipeline, 0);
+    assert_non_null(p_record);
+    assert_true(salt_pipeline_read(&test->rx[1], test->mocks[1]->host_channel->read_impl,
+                                   p_record) == SALT_ERROR);
+    assert_int_equal(test->rx[1].err_code, SALT_ERR_BUFF_TO_SMALL);
+
+    /* The receive side hands the record to the send side, which releases it. */
+    assert_true(salt_pipeline_fail(&test->pipeline, p_record, 1U) == SALT_SUCCESS);
+    host_send(test, 1, SALT_ERROR);
+    assert_null(salt_pipeline_take(&test->pipeline, 0));
+}
+
+static void pipeline_assign(void **state)
+{
+    pipeline_test_t *test = (pipeline_test_t *) *state;
+    salt_pipeline_record_t *p_record;
+
+    /* Session 2 would start at worker 0, which is busy with session 0. */
+    salt_pipeline_session_init(&test->sessions[1], 2U);
+    client_send(test, 0, "s0 first");
+    client_send(test, 0, "s0 second");
+    host_receive(test, 0);
+    host_receive(test, 0);
+    assert_int_equal(test->sessions[0].worker, 0);
+
+    for (uint32_t i = 0; i < 2U; i++) {
+        client_send(test, 1, "s2");
+        p_record = salt_pipeline_acquire(&test->pipeline, 0);
+        assert_non_null(p_record);
+        assert_true(salt_pipeline_read(&test->rx[1], test->mocks[1]->host_channel->read_impl,
+                                       p_record) == SALT_SUCCESS);
+        assert_true(salt_pipeline_post(&test->pipeline, p_record, test->mocks[1]->host_channel,
+                                       &test->sessions[1]) == SALT_SUCCESS);
+
+        /* The second time worker 0 is idle, the session stays on worker 1. */
+        assert_int_equal(test->sessions[1].worker, 1);
+        assert_true(salt_pipeline_execute(&test->pipeline, 1) == SALT_SUCCESS);
+        p_record = salt_pipeline_take(&test->pipeline, 0);
+        assert_non_null(p_record);
+        assert_int_equal(p_record->session, 2);
+        assert_true(salt_pipeline_write(&test->tx[1], test->mocks[1]->host_channel->write_impl,
+                                        p_record) == SALT_SUCCESS);
+        assert_true(salt_pipeline_release(&test->pipeline, p_record) == SALT_SUCCESS);
+        client_expect(test, 1, "s2");
+
+        if (0U == i) {
+            assert_true(salt_pipeline_execute(&test->pipeline, 0) == SALT_SUCCESS);
+            assert_true(salt_pipeline_execute(&test->pipeline, 0) == SALT_SUCCESS);
+            host_send(test, 0, SALT_SUCCESS);
+            host_send(test, 0, SALT_SUCCESS);
+            client_expect(test, 0, "s0 first");
+            client_expect(test, 0, "s0 second");
+        }
+    }
+}
+
+static void pipeline_migrate(void **state)
+{
+    pipeline_test_t *test = (pipeline_test_t *) *state;
+
+    /* Session 0 is idle on worker 0. */
+    client_send(test, 0, "s0 first");
+    host_receive(test, 0);
+    assert_int_equal(test->sessions[0].worker, 0);
+    assert_true(salt_pipeline_execute(&test->pipeline, 0) == SALT_SUCCESS);
+    host_send(test, 0, SALT_SUCCESS);
+    client_expect(test, 0, "s0 first");
+
+    /* Session 2 starts at worker 0 and keeps it busy. */
+    salt_pipeline_session_init(&test->sessions[1], 2U);
+    client_send(test, 1, "s2 first");
+    client_send(test, 1, "s2 second");
+    host_receive(test, 1);
+    host_receive(test, 1);
+    assert_int_equal(test->sessions[1].worker, 0);
+
+    /* Session 0 has nothing in the pipeline, it moves to the idle worker. */
+    client_send(test, 0, "s0 moved");
+    host_receive(test, 0);
+    assert_int_equal(test->sessions[0].worker, 1);
+
+    /* Worker 0 is now idle, but session 0 stays while its record is queued. */
+    assert_true(salt_pipeline_execute(&test->pipeline, 0) == SALT_SUCCESS);
+    assert_true(salt_pipeline_execute(&test->pipeline, 0) == SALT_SUCCESS);
+    client_send(test, 0, "s0 kept");
+    host_receive(test, 0);
+    assert_int_equal(test->sessions[0].worker, 1);
+    assert_true(salt_pipeline_execute(&test->pipeline, 1) == SALT_SUCCESS);
+    assert_true(salt_pipeline_execute(&test->pipeline, 1) == SALT_SUCCESS);
+    assert_true(salt_pipeline_execute(&test->pipeline, 1) == SALT_PENDING);
+
+    /* The nonces of session 0 carry over from worker 0 to worker 1. */
+    host_send(test, 1, SALT_SUCCESS);
+    host_send(test, 1, SALT_SUCCESS);
+    host_send(test, 0, SALT_SUCCESS);
+    host_send(test, 0, SALT_SUCCESS);
+    assert_null(salt_pipeline_take(&test->pipeline, 0));
+    assert_int_equal(test->sessions[0].taken, test->sessions[0].posted);
+
+    client_expect(test, 1, "s2 first");
+    client_expect(test, 1, "s2 second");
+    client_expect(test, 0, "s0 moved");
+    client_expect(test, 0, "s0 kept");
+}
+
+static void pipeline_invalid(void **state)
+{
+    pipeline_test_t *test = (pipeline_test_t *) *state;
+    salt_pipeline_record_t *p_records[PIPELINE_RECORDS];
+
+    /* All records are free, one more release overflows the free ring. */
+    for (uint32_t i = 0; i < PIPELINE_RECORDS; i++) {
+        p_records[i] = salt_pipeline_acquire(&test->pipeline, 0);
+        assert_non_null(p_records[i]);
+    }
+    assert_null(salt_pipeline_acquire(&test->pipeline, 0));
+    for (uint32_t i = 0; i < PIPELINE_RECORDS; i++) {
+        assert_true(salt_pipeline_release(&test->pipeline, p_records[i]) == SALT_SUCCESS);
+    }
+    assert_true(salt_pipeline_release(&test->pipeline, p_records[0]) == SALT_ERROR);
+
+    assert_null(salt_pipeline_acquire(&test->pipeline, 1));
+    assert_null(salt_pipeline_take(&test->pipeline, 1));
+    assert_true(salt_pipeline_execute(&test->pipeline, PIPELINE_CRYPTO) == SALT_ERROR);
+    assert_true(salt_pipeline_execute(NULL, 0) == SALT_ERROR);
+    assert_true(salt_pipeline_post(&test->pipeline, p_records[0], NULL,
+                                   &test->sessions[0]) == SALT_ERROR);
+    assert_true(salt_pipeline_post(&test->pipeline, p_records[0],
+                                   test->mocks[0]->host_channel, NULL) == SALT_ERROR);
+    /* A session with a record in the pipeline keeps its worker. */
+    test->sessions[0].worker = PIPELINE_CRYPTO;
+    test->sessions[0].posted = 1U;
+    assert_true(salt_pipeline_post(&test->pipeline, p_records[0],
+                                   test->mocks[0]->host_channel,
+                                   &test->sessions[0]) == SALT_ERROR);
+    assert_int_equal(test->sessions[0].posted, 1);
+    assert_true(salt_pipeline_fail(NULL, p_records[0], 0) == SALT_ERROR);
+    assert_true(salt_pipeline_read(&test->rx[0], NULL, p_records[0]) == SALT_ERROR);
+    p_records[0]->status = SALT_PENDING;
+    assert_true(salt_pipeline_write(&test->tx[0], test->mocks[0]->host_channel->write_impl,
+                                    p_records[0]) == SALT_ERROR);
+
+    assert_true(salt_pipeline_init(&test->pipeline, test->records, 3U,
+                                   &test->memory[0][0], PIPELINE_BUF_SIZE, 1U, PIPELINE_CRYPTO,
+                                   test->rings, test->slots, echo_handler, test) == SALT_ERROR);
+    assert_true(salt_pipeline_init(&test->pipeline, test->records, PIPELINE_RECORDS,
+                                   &test->memory[0][0], SALT_WRITE_OVERHEAD_SIZE - 1U, 1U,
+                                   PIPELINE_CRYPTO, test->rings, test->slots,
+                                   echo_handler, test) == SALT_ERROR);
+    assert_true(salt_pipeline_init(&test->pipeline, test->records, PIPELINE_RECORDS,
+                                   &test->memory[0][0], PIPELINE_BUF_SIZE, 1U, 0U,
+                                   test->rings, test->slots, echo_handler, test) == SALT_ERROR);
+    assert_true(salt_pipeline_init(&test->pipeline, test->records, PIPELINE_RECORDS,
+                                   &test->memory[0][0], PIPELINE_BUF_SIZE, 1U, PIPELINE_CRYPTO,
+                                   test->rings, test->slots, NULL, test) == SALT_ERROR);
+
+    /* Two I/O threads with two records each, the records stay with their thread. */
+    assert_true(salt_pipeline_init(&test->pipeline, test->records, 2U,
+                                   &test->memory[0][0], PIPELINE_BUF_SIZE, 2U, 1U,
+                                   test->rings, test->slots, echo_handler, test) == SALT_SUCCESS);
+    assert_ptr_equal(salt_pipeline_acquire(&test->pipeline, 1), &test->records[2]);
+    assert_ptr_equal(salt_pipeline_acquire(&test->pipeline, 0), &test->records[0]);
+    assert_int_equal(test->records[3].io, 1);
+    assert_ptr_equal(test->records[3].p_data, test->memory[3]);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(pipeline_echo, setup, teardown),
+        cmocka_unit_test_setup_teardown(pipeline_pending, setup, teardown),
+        cmocka_unit_test_setup_teardown(pipeline_error, setup, teardown),
+        cmocka_unit_test_setup_teardown(pipeline_assign, setup, teardown),
+        cmocka_unit_test_setup_teardown(pipeline_migrate, setup, teardown),
+        cmocka_unit_test_setup_teardown(pipeline_invalid, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
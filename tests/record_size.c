@@ -0,0 +1,154 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "salt.h"
+#include "salti_util.h"
+
+#ifndef USE_SODIUM
+void randombytes(unsigned char *p_bytes, unsigned long long length)
+{
+    memset(p_bytes, 0x00, length);
+}
+#endif
+
+static uint32_t now;
+
+static salt_ret_t test_get_time(salt_time_t *p_time, uint32_t *p_now)
+{
+    (void) p_time;
+    *p_now = now;
+    return SALT_SUCCESS;
+}
+
+static salt_time_t test_time = {
+    test_get_time,
+    NULL
+};
+
+static salt_ret_t test_write(salt_io_channel_t *p_wchannel)
+{
+    p_wchannel->size = p_wchannel->size_expected;
+    return SALT_SUCCESS;
+}
+
+static salt_ret_t test_read(salt_io_channel_t *p_rchannel)
+{
+    (void) p_rchannel;
+    return SALT_ERROR;
+}
+
+static void create_established(salt_channel_t *p_channel, salt_time_t *p_time)
+{
+    uint8_t hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
+    assert_true(salt_create(p_channel, SALT_SERVER, test_write, test_read, p_time) == SALT_SUCCESS);
+    assert_true(salt_create_signature(p_channel) == SALT_SUCCESS);
+    assert_true(salt_init_session(p_channel, hndsk_buffer, sizeof(hndsk_buffer)) == SALT_SUCCESS);
+    p_channel->state = SALT_SESSION_ESTABLISHED;
+}
+
+static void write_record(salt_channel_t *p_channel, uint32_t fill)
+{
+    uint8_t buffer[4096];
+    uint8_t payload[4096];
+    salt_msg_t msg;
+    uint32_t size = salt_record_size_next(p_channel, sizeof(buffer));
+
+    memset(payload, 0xAA, sizeof(payload));
+    assert_true(salt_write_begin(buffer, size, &msg) == SALT_SUCCESS);
+    if (fill > msg.write.buffer_available - 2U) {
+        fill = msg.write.buffer_available - 2U;
+    }
+    assert_true(salt_write_next(&msg, payload, fill) == SALT_SUCCESS);
+    assert_true(salt_write_execute(p_channel, &msg, false) == SALT_SUCCESS);
+}
+
+static void record_size_init(void **state)
+{
+    salt_channel_t channel;
+    salt_record_size_t record_size;
+
+    create_established(&channel, NULL);
+
+    /* Without adaptive record size the whole buffer is used. */
+    assert_int_equal(salt_record_size_next(&channel, 4096), 4096);
+
+    assert_true(salt_record_size_init(&channel, NULL, 512, 4096, 100) == SALT_ERROR);
+    channel.state = SALT_SESSION_ESTABLISHED;
+    assert_true(salt_record_size_init(&channel, &record_size, SALT_WRITE_OVERHEAD_SIZE, 4096, 100) == SALT_ERROR);
+    channel.state = SALT_SESSION_ESTABLISHED;
+    assert_true(salt_record_size_init(&channel, &record_size, 4096, 512, 100) == SALT_ERROR);
+    channel.state = SALT_SESSION_ESTABLISHED;
+    assert_true(salt_record_size_init(&channel, &record_size, 512, 4096, 100) == SALT_SUCCESS);
+
+    assert_int_equal(salt_record_size_next(&channel, 4096), 512);
+    assert_int_equal(salt_record_size_next(&channel, 256), 256);
+}
+
+static void record_size_grow(void **state)
+{
+    salt_channel_t channel;
+    salt_record_size_t record_size;
+
+    create_established(&channel, NULL);
+    assert_true(salt_record_size_init(&channel, &record_size, 512, 3000, 100) == SALT_SUCCESS);
+
+    /* Small records does not indicate a busy stream. */
+    for (uint32_t i = 0; i < 16; i++) {
+        write_record(&channel, 10);
+    }
+    assert_int_equal(salt_record_size_next(&channel, 4096), 512);
+
+    /* Filled records doubles the size, up to max size. */
+    for (uint32_t i = 0; i < 4; i++) {
+        write_record(&channel, 4096);
+    }
+    assert_int_equal(salt_record_size_next(&channel, 4096), 1024);
+    for (uint32_t i = 0; i < 4; i++) {
+        write_record(&channel, 4096);
+    }
+    assert_int_equal(salt_record_size_next(&channel, 4096), 2048);
+    for (uint32_t i = 0; i < 4; i++) {
+        write_record(&channel, 4096);
+    }
+    assert_int_equal(salt_record_size_next(&channel, 4096), 3000);
+    for (uint32_t i = 0; i < 8; i++) {
+        write_record(&channel, 4096);
+    }
+    assert_int_equal(salt_record_size_next(&channel, 4096), 3000);
+
+    salt_record_size_reset(&record_size);
+    assert_int_equal(salt_record_size_next(&channel, 4096), 512);
+}
+
+static void record_size_idle(void **state)
+{
+    salt_channel_t channel;
+    salt_record_size_t record_size;
+
+    now = 1000;
+    create_established(&channel, &test_time);
+    assert_true(salt_record_size_init(&channel, &record_size, 512, 4096, 100) == SALT_SUCCESS);
+
+    for (uint32_t i = 0; i < 4; i++) {
+        now += 10;
+        write_record(&channel, 4096);
+    }
+    now += 100;
+    assert_int_equal(salt_record_size_next(&channel, 4096), 1024);
+    now += 1;
+    assert_int_equal(salt_record_size_next(&channel, 4096), 512);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(record_size_init),
+        cmocka_unit_test(record_size_grow),
+        cmocka_unit_test(record_size_idle),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
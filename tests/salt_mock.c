@@ -71,6 +71,46 @@ void salt_mock_delete(salt_mock_t* mock)
     free(mock);
 }
 
+void salt_mock_handshake(salt_mock_t *mock)
+{
+    salt_ret_t host_ret = SALT_PENDING;
+    salt_ret_t client_ret = SALT_PENDING;
+
+    /* A test may set its own signature before. */
+    if (SALT_CREATED == mock->host_channel->state) {
+        assert_true(salt_create_signature(mock->host_channel) == SALT_SUCCESS);
+    }
+    if (SALT_CREATED == mock->client_channel->state) {
+        assert_true(salt_create_signature(mock->client_channel) == SALT_SUCCESS);
+    }
+    assert_true(salt_init_session(mock->host_channel, mock->host_hndsk_buffer,
+                                  sizeof(mock->host_hndsk_buffer)) == SALT_SUCCESS);
+    assert_true(salt_init_session(mock->client_channel, mock->client_hndsk_buffer,
+                                  sizeof(mock->client_hndsk_buffer)) == SALT_SUCCESS);
+
+    while ((host_ret | client_ret) != SALT_SUCCESS) {
+        client_ret = salt_handshake(mock->client_channel, NULL);
+        assert_true(client_ret != SALT_ERROR);
+        host_ret = salt_handshake(mock->host_channel, NULL);
+        assert_true(host_ret != SALT_ERROR);
+    }
+}
+
+void salt_mocks_create_established(salt_mock_t **mocks, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        mocks[i] = salt_mock_create();
+        salt_mock_handshake(mocks[i]);
+    }
+}
+
+void salt_mocks_delete(salt_mock_t **mocks, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        salt_mock_delete(mocks[i]);
+    }
+}
+
 salt_time_t *salt_time_mock_create(void)
 {
     salt_time_t *mock;
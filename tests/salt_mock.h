@@ -49,6 +49,10 @@ typedef struct salt_mock_s {
     salt_channel_t  *client_channel;
     salt_channel_t  *host_channel;
 
+    /* Used by the channels until the handshake is done */
+    uint8_t         client_hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
+    uint8_t         host_hndsk_buffer[SALT_HNDSHK_BUFFER_SIZE];
+
 } salt_mock_t;
 
 /*======= Public function declarations ======================================*/
@@ -56,6 +60,11 @@ typedef struct salt_mock_s {
 salt_mock_t *salt_mock_create(void);
 void salt_mock_delete(salt_mock_t* mock);
 
+/* Handshake between the client and host channel of the mock. */
+void salt_mock_handshake(salt_mock_t *mock);
+void salt_mocks_create_established(salt_mock_t **mocks, uint32_t count);
+void salt_mocks_delete(salt_mock_t **mocks, uint32_t count);
+
 salt_time_t *salt_time_mock_create(void);
 void salt_time_mock_set_next(salt_time_t *mock, uint32_t time);
 void salt_time_mock_delete(salt_time_t *mock);
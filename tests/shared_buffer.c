@@ -0,0 +1,150 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "cfifo.h"
+#include "salt.h"
+#include "salti_util.h"
+#include "salt_mock.h"
+#include "test_data.h"
+
+#define SHARED_BUF_SIZE     (SALT_HNDSHK_BUFFER_SIZE + 64U)
+#define SHARED_CANARY       (0xA5U)
+
+typedef struct shared_buffer_test_s {
+    salt_mock_t     *mock;
+    uint8_t         host_rx_buffer[SHARED_BUF_SIZE];
+    uint8_t         client_rx_buffer[SHARED_BUF_SIZE];
+    uint8_t         tx_buffer[SHARED_BUF_SIZE];
+} shared_buffer_test_t;
+
+static int setup(void **state) {
+    shared_buffer_test_t *test = malloc(sizeof(shared_buffer_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    memset(test, SHARED_CANARY, sizeof(shared_buffer_test_t));
+    test->mock = salt_mock_create();
+    assert_true(salt_create_signature(test->mock->host_channel) == SALT_SUCCESS);
+    assert_true(salt_create_signature(test->mock->client_channel) == SALT_SUCCESS);
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    shared_buffer_test_t *test = (shared_buffer_test_t *) *state;
+    salt_mock_delete(test->mock);
+    free(test);
+    return 0;
+}
+
+/* The handshake region is cleared and the rest of the buffer is untouched. */
+static void assert_released(salt_channel_t *p_channel, const uint8_t *p_buffer)
+{
+    uint8_t zero[SALT_HNDSHK_BUFFER_SIZE] = { 0x00 };
+
+    assert_null(p_channel->hdshk_buffer);
+    assert_int_equal(p_channel->hdshk_buffer_size, 0);
+    assert_memory_equal(p_buffer, zero, sizeof(zero));
+    for (uint32_t i = SALT_HNDSHK_BUFFER_SIZE; i < SHARED_BUF_SIZE; i++) {
+        assert_int_equal(p_buffer[i], SHARED_CANARY);
+    }
+}
+
+static void shared_buffer_handshake(void **state)
+{
+    shared_buffer_test_t *test = (shared_buffer_test_t *) *state;
+    salt_channel_t *p_client = test->mock->client_channel;
+    salt_channel_t *p_host = test->mock->host_channel;
+    salt_ret_t host_ret = SALT_PENDING;
+    salt_ret_t client_ret = SALT_PENDING;
+    uint8_t message[16];
+    salt_msg_t msg;
+
+    assert_true(salt_init_session_in_buffer(p_host, test->host_rx_buffer,
+                                            sizeof(test->host_rx_buffer)) == SALT_SUCCESS);
+    assert_true(salt_init_session_in_buffer(p_client, test->client_rx_buffer,
+                                            sizeof(test->client_rx_buffer)) == SALT_SUCCESS);
+    assert_int_equal(p_client->hdshk_buffer_size, SALT_HNDSHK_BUFFER_SIZE);
+
+    while ((host_ret | client_ret) != SALT_SUCCESS) {
+        client_ret = salt_handshake(p_client, NULL);
+        assert_true(client_ret != SALT_ERROR);
+        host_ret = salt_handshake(p_host, NULL);
+        assert_true(host_ret != SALT_ERROR);
+    }
+
+    assert_released(p_host, test->host_rx_buffer);
+    assert_released(p_client, test->client_rx_buffer);
+
+    /* The same buffers are now used for records. */
+    memset(message, 0x01, sizeof(message));
+    assert_true(salt_write_begin(test->tx_buffer, sizeof(test->tx_buffer), &msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&msg, message, sizeof(message)) == SALT_SUCCESS);
+    assert_true(salt_write_execute(p_client, &msg, false) == SALT_SUCCESS);
+    assert_true(salt_read_begin(p_host, test->host_rx_buffer, sizeof(test->host_rx_buffer), &msg) == SALT_SUCCESS);
+    assert_int_equal(msg.read.message_size, sizeof(message));
+    assert_memory_equal(msg.read.p_payload, message, sizeof(message));
+
+    /* A handshake call on the established session does not touch the buffer. */
+    assert_true(salt_handshake(p_host, NULL) == SALT_ERROR);
+    assert_memory_equal(msg.read.p_payload, message, sizeof(message));
+}
+
+static void shared_buffer_failed_handshake(void **state)
+{
+    shared_buffer_test_t *test = (shared_buffer_test_t *) *state;
+    salt_channel_t *p_client = test->mock->client_channel;
+    salt_channel_t *p_host = test->mock->host_channel;
+    salt_ret_t host_ret = SALT_PENDING;
+    salt_ret_t client_ret = SALT_PENDING;
+    uint8_t wrong_host[api_crypto_sign_PUBLICKEYBYTES];
+
+    memset(wrong_host, 0x01, sizeof(wrong_host));
+
+    assert_true(salt_init_session_in_buffer(p_host, test->host_rx_buffer,
+                                            sizeof(test->host_rx_buffer)) == SALT_SUCCESS);
+    assert_true(salt_init_session_in_buffer(p_client, test->client_rx_buffer,
+                                            sizeof(test->client_rx_buffer)) == SALT_SUCCESS);
+
+    /* The client asks for another host, the host answers NoSuchServer. */
+    while ((SALT_PENDING == host_ret) || (SALT_PENDING == client_ret)) {
+        if (SALT_PENDING == client_ret) {
+            client_ret = salt_handshake(p_client, wrong_host);
+        }
+        if (SALT_PENDING == host_ret) {
+            host_ret = salt_handshake(p_host, NULL);
+        }
+    }
+
+    assert_true(client_ret == SALT_ERROR);
+    assert_released(p_host, test->host_rx_buffer);
+    assert_released(p_client, test->client_rx_buffer);
+}
+
+static void shared_buffer_invalid(void **state)
+{
+    shared_buffer_test_t *test = (shared_buffer_test_t *) *state;
+    salt_channel_t *p_client = test->mock->client_channel;
+
+    assert_true(salt_init_session_in_buffer(NULL, test->client_rx_buffer,
+                                            sizeof(test->client_rx_buffer)) == SALT_ERROR);
+    assert_true(salt_init_session_in_buffer(p_client, NULL,
+                                            sizeof(test->client_rx_buffer)) == SALT_ERROR);
+    assert_true(salt_init_session_in_buffer(p_client, test->client_rx_buffer,
+                                            SALT_HNDSHK_BUFFER_SIZE - 1U) == SALT_ERROR);
+    assert_int_equal(p_client->err_code, SALT_ERR_BUFF_TO_SMALL);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(shared_buffer_handshake, setup, teardown),
+        cmocka_unit_test_setup_teardown(shared_buffer_failed_handshake, setup, teardown),
+        cmocka_unit_test_setup_teardown(shared_buffer_invalid, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,187 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "cfifo.h"
+#include "salt.h"
+#include "salti_util.h"
+#include "salt_mock.h"
+#include "test_data.h"
+
+#define SIGN_POOL_ENTRIES   (4U)
+
+typedef struct sign_pool_test_s {
+    salt_mock_t             *mock;
+    salt_sign_pool_t        host_pool;
+    salt_sign_pool_entry_t  host_entries[SIGN_POOL_ENTRIES];
+    salt_sign_pool_t        client_pool;
+    salt_sign_pool_entry_t  client_entries[SIGN_POOL_ENTRIES];
+    int                     locked;
+    uint32_t                lock_count;
+} sign_pool_test_t;
+
+static void test_lock(void *p_context)
+{
+    sign_pool_test_t *test = (sign_pool_test_t *) p_context;
+    assert_int_equal(test->locked, 0);
+    test->locked = 1;
+    test->lock_count++;
+}
+
+static void test_unlock(void *p_context)
+{
+    sign_pool_test_t *test = (sign_pool_test_t *) p_context;
+    assert_int_equal(test->locked, 1);
+    test->locked = 0;
+}
+
+static int setup(void **state) {
+    sign_pool_test_t *test = malloc(sizeof(sign_pool_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    memset(test, 0x00, sizeof(sign_pool_test_t));
+    test->mock = salt_mock_create();
+    assert_true(salt_create_signature(test->mock->host_channel) == SALT_SUCCESS);
+    assert_true(salt_create_signature(test->mock->client_channel) == SALT_SUCCESS);
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    sign_pool_test_t *test = (sign_pool_test_t *) *state;
+    salt_mock_delete(test->mock);
+    free(test);
+    return 0;
+}
+
+static void pool_create(sign_pool_test_t *test)
+{
+    assert_true(salt_sign_pool_init(&test->host_pool, test->host_entries, SIGN_POOL_ENTRIES,
+                                    test->mock->host_channel->my_sk_sec,
+                                    test_lock, test_unlock, test) == SALT_SUCCESS);
+    assert_true(salt_sign_pool_init(&test->client_pool, test->client_entries, SIGN_POOL_ENTRIES,
+                                    test->mock->client_channel->my_sk_sec,
+                                    NULL, NULL, NULL) == SALT_SUCCESS);
+    assert_true(salt_set_sign_pool(test->mock->host_channel, &test->host_pool) == SALT_SUCCESS);
+    assert_true(salt_set_sign_pool(test->mock->client_channel, &test->client_pool) == SALT_SUCCESS);
+}
+
+/*
+ * Fills one entry, or skips the test if the crypto library can not precompute
+ * signatures, e.g., libsodium. The failed entry is then returned to the pool.
+ */
+static void pool_fill_or_skip(salt_sign_pool_t *p_pool)
+{
+    if (salt_sign_pool_fill(p_pool) == SALT_ERROR) {
+        assert_int_equal(salt_sign_pool_available(p_pool), 0);
+        assert_int_equal(p_pool->p_entries[0].state, SALT_SIGN_POOL_EMPTY);
+        skip();
+    }
+}
+
+static void sign_pool_handshake(void **state)
+{
+    sign_pool_test_t *test = (sign_pool_test_t *) *state;
+    salt_ret_t ret;
+    uint32_t filled = 0;
+
+    pool_create(test);
+
+    pool_fill_or_skip(&test->host_pool);
+    filled++;
+
+    do {
+        ret = salt_sign_pool_fill(&test->host_pool);
+        assert_true(ret != SALT_ERROR);
+        filled += (SALT_SUCCESS == ret) ? 1U : 0U;
+    } while (SALT_SUCCESS == ret);
+    assert_int_equal(filled, SIGN_POOL_ENTRIES);
+    assert_int_equal(salt_sign_pool_available(&test->host_pool), SIGN_POOL_ENTRIES);
+    assert_true(salt_sign_pool_fill(&test->client_pool) == SALT_SUCCESS);
+
+    salt_mock_handshake(test->mock);
+
+    /* Each side used one commitment, the used entry is wiped. */
+    assert_int_equal(test->host_pool.taken, 1);
+    assert_int_equal(test->host_pool.missed, 0);
+    assert_int_equal(salt_sign_pool_available(&test->host_pool), SIGN_POOL_ENTRIES - 1U);
+    assert_int_equal(test->client_pool.taken, 1);
+    assert_int_equal(salt_sign_pool_available(&test->client_pool), 0);
+    for (uint32_t i = 0; i < SIGN_POOL_ENTRIES; i++) {
+        if (SALT_SIGN_POOL_EMPTY == test->host_entries[i].state) {
+            uint8_t zero[api_crypto_sign_PRECOMPUTEDBYTES] = { 0x00 };
+            assert_memory_equal(test->host_entries[i].precomputed, zero, sizeof(zero));
+        }
+    }
+
+    /* The lock was always released. */
+    assert_int_equal(test->locked, 0);
+    assert_true(test->lock_count > 0);
+}
+
+static void sign_pool_empty(void **state)
+{
+    sign_pool_test_t *test = (sign_pool_test_t *) *state;
+
+    pool_create(test);
+
+    /* Nothing precomputed, the handshake signs as usual. */
+    salt_mock_handshake(test->mock);
+    assert_int_equal(test->host_pool.taken, 0);
+    assert_int_equal(test->host_pool.missed, 1);
+    assert_int_equal(test->client_pool.missed, 1);
+}
+
+static void sign_pool_other_key(void **state)
+{
+    sign_pool_test_t *test = (sign_pool_test_t *) *state;
+    uint8_t precomputed[api_crypto_sign_PRECOMPUTEDBYTES];
+
+    /* The client uses a pool made for the host key. */
+    pool_create(test);
+    assert_true(salt_set_sign_pool(test->mock->client_channel, &test->host_pool) == SALT_SUCCESS);
+    pool_fill_or_skip(&test->host_pool);
+
+    assert_true(salt_sign_pool_take(&test->host_pool,
+                                    test->mock->client_channel->my_sk_pub,
+                                    precomputed) == SALT_ERROR);
+
+    salt_mock_handshake(test->mock);
+
+    /* Only the host used the commitment. */
+    assert_int_equal(test->host_pool.taken, 1);
+    assert_int_equal(salt_sign_pool_available(&test->host_pool), 0);
+}
+
+static void sign_pool_invalid(void **state)
+{
+    sign_pool_test_t *test = (sign_pool_test_t *) *state;
+    uint8_t *p_sk_sec = test->mock->host_channel->my_sk_sec;
+
+    assert_true(salt_sign_pool_init(&test->host_pool, test->host_entries, 0,
+                                    p_sk_sec, NULL, NULL, NULL) == SALT_ERROR);
+    assert_true(salt_sign_pool_init(&test->host_pool, NULL, SIGN_POOL_ENTRIES,
+                                    p_sk_sec, NULL, NULL, NULL) == SALT_ERROR);
+    assert_true(salt_sign_pool_init(&test->host_pool, test->host_entries, SIGN_POOL_ENTRIES,
+                                    p_sk_sec, test_lock, NULL, test) == SALT_ERROR);
+
+    /* The pool can not be changed after the handshake has started. */
+    pool_create(test);
+    salt_mock_handshake(test->mock);
+    assert_true(salt_set_sign_pool(test->mock->host_channel, NULL) == SALT_ERROR);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(sign_pool_handshake, setup, teardown),
+        cmocka_unit_test_setup_teardown(sign_pool_empty, setup, teardown),
+        cmocka_unit_test_setup_teardown(sign_pool_other_key, setup, teardown),
+        cmocka_unit_test_setup_teardown(sign_pool_invalid, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
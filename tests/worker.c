@@ -0,0 +1,165 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include "cfifo.h"
+#include "salt.h"
+#include "salti_util.h"
+#include "salt_mock.h"
+#include "test_data.h"
+
+/*
+ * Deferred worker. The task is run on the second poll, i.e., after the client
+ * has verified M3, to check that the handshake does not depend on when the
+ * helper thread runs.
+ */
+typedef struct worker_test_s {
+    salt_mock_t         *mock;
+    salt_worker_t       worker;
+    salt_worker_task_t  task;
+    void                *p_arg;
+    salt_ret_t          start_ret;
+    uint32_t            polls;
+    salt_state_t        state_when_run;
+} worker_test_t;
+
+static salt_ret_t test_start(salt_worker_t *p_worker, salt_worker_task_t task, void *p_arg)
+{
+    worker_test_t *test = (worker_test_t *) p_worker->p_context;
+    assert_null(test->task);
+    if (SALT_SUCCESS == test->start_ret) {
+        test->task = task;
+        test->p_arg = p_arg;
+    }
+    return test->start_ret;
+}
+
+static salt_ret_t test_poll(salt_worker_t *p_worker)
+{
+    worker_test_t *test = (worker_test_t *) p_worker->p_context;
+    assert_non_null(test->task);
+    if (++test->polls < 2) {
+        return SALT_PENDING;
+    }
+    test->state_when_run = test->mock->client_channel->state;
+    test->task(test->p_arg);
+    test->task = NULL;
+    return SALT_SUCCESS;
+}
+
+static int setup(void **state) {
+    worker_test_t *test = malloc(sizeof(worker_test_t));
+    if (NULL == test) {
+        return -1;
+    }
+    memset(test, 0x00, sizeof(worker_test_t));
+    test->mock = salt_mock_create();
+    test->start_ret = SALT_SUCCESS;
+    assert_true(salt_create_signature(test->mock->host_channel) == SALT_SUCCESS);
+    assert_true(salt_create_signature(test->mock->client_channel) == SALT_SUCCESS);
+    assert_true(salt_worker_init(test->mock->client_channel, &test->worker,
+                                 test_start, test_poll, test) == SALT_SUCCESS);
+    *state = test;
+    return 0;
+}
+
+static int teardown(void **state) {
+    worker_test_t *test = (worker_test_t *) *state;
+    salt_mock_delete(test->mock);
+    free(test);
+    return 0;
+}
+
+static void session_works(salt_mock_t *mock)
+{
+    uint8_t tx_buffer[128];
+    uint8_t rx_buffer[128];
+    uint8_t message[4] = { 0x01, 0x02, 0x03, 0x04 };
+    salt_msg_t msg;
+
+    assert_true(salt_write_begin(tx_buffer, sizeof(tx_buffer), &msg) == SALT_SUCCESS);
+    assert_true(salt_write_next(&msg, message, sizeof(message)) == SALT_SUCCESS);
+    assert_true(salt_write_execute(mock->client_channel, &msg, false) == SALT_SUCCESS);
+    assert_true(salt_read_begin(mock->host_channel, rx_buffer, sizeof(rx_buffer), &msg) == SALT_SUCCESS);
+    assert_int_equal(msg.read.message_size, sizeof(message));
+    assert_memory_equal(msg.read.p_payload, message, sizeof(message));
+}
+
+static void worker_handshake(void **state)
+{
+    worker_test_t *test = (worker_test_t *) *state;
+    uint8_t zero[SALT_WORKER_SIGN_SIZE] = { 0x00 };
+
+    salt_mock_handshake(test->mock);
+
+    /* The M4 signature was joined after M3 was verified. */
+    assert_int_equal(test->polls, 2);
+    assert_int_equal(test->state_when_run, SALT_M4_WRAP);
+    assert_false(test->worker.started);
+    assert_memory_equal(test->worker.sign_buffer, zero, sizeof(zero));
+
+    session_works(test->mock);
+}
+
+static void worker_not_started(void **state)
+{
+    worker_test_t *test = (worker_test_t *) *state;
+
+    /* The client signs M4 itself if the helper thread can not be started. */
+    test->start_ret = SALT_ERROR;
+    salt_mock_handshake(test->mock);
+    assert_int_equal(test->polls, 0);
+
+    session_works(test->mock);
+}
+
+static void worker_sign_pool(void **state)
+{
+    worker_test_t *test = (worker_test_t *) *state;
+    salt_channel_t *p_client = test->mock->client_channel;
+    salt_sign_pool_entry_t entries[2];
+    salt_sign_pool_t pool;
+
+    assert_true(salt_sign_pool_init(&pool, entries, 2, p_client->my_sk_sec,
+                                    NULL, NULL, NULL) == SALT_SUCCESS);
+    assert_true(salt_set_sign_pool(p_client, &pool) == SALT_SUCCESS);
+
+    /* Precomputed signing is optional for a crypto library, e.g., libsodium. */
+    if (salt_sign_pool_fill(&pool) == SALT_ERROR) {
+        assert_int_equal(salt_sign_pool_available(&pool), 0);
+        skip();
+    }
+
+    /* The commitment is taken by the client and used by the worker. */
+    salt_mock_handshake(test->mock);
+    assert_int_equal(pool.taken, 1);
+    assert_int_equal(test->polls, 2);
+
+    session_works(test->mock);
+}
+
+static void worker_invalid(void **state)
+{
+    worker_test_t *test = (worker_test_t *) *state;
+    salt_worker_t worker;
+
+    assert_true(salt_worker_init(test->mock->host_channel, &worker,
+                                 test_start, test_poll, test) == SALT_ERROR);
+    assert_int_equal(test->mock->host_channel->err_code, SALT_ERR_NOT_SUPPORTED);
+    assert_true(salt_worker_init(test->mock->client_channel, &worker,
+                                 NULL, test_poll, test) == SALT_ERROR);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test_setup_teardown(worker_handshake, setup, teardown),
+        cmocka_unit_test_setup_teardown(worker_not_started, setup, teardown),
+        cmocka_unit_test_setup_teardown(worker_sign_pool, setup, teardown),
+        cmocka_unit_test_setup_teardown(worker_invalid, setup, teardown),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}